@@ -75,21 +75,10 @@ int main(void) {
 
     // Create a giant sphere at the origin
     int radius = 20;
-
-    for (int x = -radius; x <= radius; x++) {
-        for (int y = -radius; y <= radius; y++) {
-            for (int z = -radius; z <= radius; z++) {
-                if (x * x + y * y + z * z <= radius * radius) {
-
-                    raxel_voxel_t sphere_voxel = {
-                        .material = 255,
-                    };
-
-                    raxel_voxel_world_place_voxel(world, x, y, z, sphere_voxel);
-                }
-            }
-        }
-    }
+    raxel_voxel_t sphere_voxel = {
+        .material = 255,
+    };
+    raxel_voxel_world_fill_sphere(world, 0, 0, 0, radius, sphere_voxel);
 
     vec3 camera_position = {0.0f, 0.0f, -50.0f};
     float camera_rotation = 0.0f;
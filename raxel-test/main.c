@@ -5,10 +5,12 @@
 #include "tests/container.h"
 #include "tests/hashtable.h"
 #include "tests/bvh.h"
+#include "tests/voxel.h"
 
 int main() {
     register_container_tests();
     register_hashtable_tests();
     register_bvh_tests();
+    register_voxel_tests();
     return raxel_test_run_all();
 }
\ No newline at end of file
@@ -0,0 +1,2683 @@
+#include <raxel/core/util.h>
+#include <raxel/core/assets.h>
+#include <raxel/core/voxel.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+/*------------------------------------------------------------
+  Test: Placing and reading voxels, including negative coords.
+------------------------------------------------------------*/
+RAXEL_TEST(test_voxel_world_place_get) {
+    raxel_allocator_t allocator = raxel_default_allocator();
+    raxel_voxel_world_t *world = raxel_voxel_world_create(&allocator);
+
+    raxel_coord_t coords[][3] = {
+        {0, 0, 0}, {31, 31, 31}, {32, 0, 0}, {-1, -1, -1}, {-32, 5, -33}, {100, -200, 300},
+    };
+    int n = sizeof(coords) / sizeof(coords[0]);
+    for (int i = 0; i < n; i++) {
+        raxel_voxel_t voxel = {.material = (raxel_material_handle_t)(i + 1)};
+        raxel_voxel_world_place_voxel(world, coords[i][0], coords[i][1], coords[i][2], voxel);
+    }
+    for (int i = 0; i < n; i++) {
+        raxel_voxel_t voxel = raxel_voxel_world_get_voxel(world, coords[i][0], coords[i][1], coords[i][2]);
+        RAXEL_TEST_ASSERT_EQUAL_UINT(voxel.material, (raxel_material_handle_t)(i + 1));
+    }
+
+    // untouched voxels in existing and missing chunks are empty
+    RAXEL_TEST_ASSERT_EQUAL_UINT(raxel_voxel_world_get_voxel(world, 1, 0, 0).material, 0);
+    RAXEL_TEST_ASSERT_EQUAL_UINT(raxel_voxel_world_get_voxel(world, 5000, 0, 0).material, 0);
+    RAXEL_TEST_ASSERT(raxel_voxel_world_get_chunk(world, 0, 0, 0) != NULL);
+    RAXEL_TEST_ASSERT(raxel_voxel_world_get_chunk(world, -1, -1, -1) != NULL);
+    RAXEL_TEST_ASSERT(raxel_voxel_world_get_chunk(world, -1, 0, -2) != NULL);
+    RAXEL_TEST_ASSERT(raxel_voxel_world_get_chunk(world, 7, 7, 7) == NULL);
+
+    raxel_voxel_world_destroy(world);
+}
+
+/*------------------------------------------------------------
+  Test: Chunk pool handles stay valid as the pool grows.
+------------------------------------------------------------*/
+RAXEL_TEST(test_voxel_chunk_pool) {
+    raxel_allocator_t allocator = raxel_default_allocator();
+    raxel_voxel_chunk_pool_t *pool = raxel_voxel_chunk_pool_create(&allocator);
+
+    raxel_voxel_chunk_handle_t first = raxel_voxel_chunk_pool_alloc(pool);
+    raxel_voxel_chunk_t *first_ptr = raxel_voxel_chunk_pool_get(pool, first);
+    raxel_voxel_chunk_set(first_ptr, 123, (raxel_voxel_t){42});
+
+    // grow well past a single page
+    raxel_voxel_chunk_handle_t handles[RAXEL_VOXEL_CHUNK_POOL_PAGE_CHUNKS * 3];
+    for (int i = 0; i < RAXEL_VOXEL_CHUNK_POOL_PAGE_CHUNKS * 3; i++) {
+        handles[i] = raxel_voxel_chunk_pool_alloc(pool);
+        raxel_voxel_chunk_set(raxel_voxel_chunk_pool_get(pool, handles[i]), 0, (raxel_voxel_t){(raxel_material_handle_t)i});
+    }
+    RAXEL_TEST_ASSERT_EQUAL_PTR(raxel_voxel_chunk_pool_get(pool, first), first_ptr);
+    RAXEL_TEST_ASSERT_EQUAL_UINT(raxel_voxel_chunk_get(first_ptr, 123).material, 42);
+    for (int i = 0; i < RAXEL_VOXEL_CHUNK_POOL_PAGE_CHUNKS * 3; i++) {
+        RAXEL_TEST_ASSERT_EQUAL_UINT(raxel_voxel_chunk_get(raxel_voxel_chunk_pool_get(pool, handles[i]), 0).material, (raxel_material_handle_t)i);
+    }
+
+    // freed slots are reused, and come back empty
+    raxel_voxel_chunk_pool_free(pool, handles[5]);
+    raxel_voxel_chunk_handle_t reused = raxel_voxel_chunk_pool_alloc(pool);
+    RAXEL_TEST_ASSERT_EQUAL_UINT(reused, handles[5]);
+    RAXEL_TEST_ASSERT_EQUAL_UINT(raxel_voxel_chunk_get(raxel_voxel_chunk_pool_get(pool, reused), 0).material, 0);
+    RAXEL_TEST_ASSERT_EQUAL_INT((int)pool->num_live, RAXEL_VOXEL_CHUNK_POOL_PAGE_CHUNKS * 3 + 1);
+
+    raxel_voxel_chunk_pool_destroy(pool);
+}
+
+/*------------------------------------------------------------
+  Test: Palette storage widens, compacts and stays exact.
+------------------------------------------------------------*/
+RAXEL_TEST(test_voxel_chunk_palette) {
+    raxel_allocator_t allocator = raxel_default_allocator();
+    raxel_voxel_chunk_t chunk;
+    raxel_voxel_chunk_init(&chunk, &allocator);
+    raxel_voxel_t *reference = malloc(RAXEL_VOXEL_CHUNK_VOLUME * sizeof(raxel_voxel_t));
+    raxel_voxel_t *decoded = malloc(RAXEL_VOXEL_CHUNK_VOLUME * sizeof(raxel_voxel_t));
+    memset(reference, 0, RAXEL_VOXEL_CHUNK_VOLUME * sizeof(raxel_voxel_t));
+    RAXEL_TEST_ASSERT_EQUAL_UINT(chunk.bits, 0);
+
+    // walk the palette through every width with a deterministic pseudo-random pattern
+    uint32_t seed = 12345;
+    uint32_t widths[] = {2, 4, 16, 256, 4000};
+    uint32_t expected_bits[] = {1, 2, 4, 8, 16};
+    for (int w = 0; w < 5; w++) {
+        for (int i = 0; i < 20000; i++) {
+            seed = seed * 1664525u + 1013904223u;
+            raxel_size_t index = (seed >> 8) % RAXEL_VOXEL_CHUNK_VOLUME;
+            raxel_voxel_t voxel = {.material = (seed >> 4) % widths[w]};
+            raxel_voxel_chunk_set(&chunk, index, voxel);
+            reference[index] = voxel;
+        }
+        RAXEL_TEST_ASSERT_EQUAL_UINT(chunk.bits, expected_bits[w]);
+        raxel_voxel_chunk_decode(&chunk, decoded);
+        RAXEL_TEST_ASSERT(memcmp(decoded, reference, RAXEL_VOXEL_CHUNK_VOLUME * sizeof(raxel_voxel_t)) == 0);
+    }
+
+    // spans across word boundaries
+    raxel_voxel_chunk_fill_span(&chunk, 1000, 3000, (raxel_voxel_t){7});
+    for (raxel_size_t i = 1000; i < 4000; i++) reference[i].material = 7;
+    raxel_voxel_chunk_decode(&chunk, decoded);
+    RAXEL_TEST_ASSERT(memcmp(decoded, reference, RAXEL_VOXEL_CHUNK_VOLUME * sizeof(raxel_voxel_t)) == 0);
+
+    // overwriting most of the chunk lets compaction shrink the palette again
+    raxel_voxel_chunk_fill_span(&chunk, 0, RAXEL_VOXEL_CHUNK_VOLUME - 1, (raxel_voxel_t){3});
+    raxel_voxel_chunk_compact(&chunk);
+    RAXEL_TEST_ASSERT_EQUAL_UINT(chunk.bits, 1);
+    RAXEL_TEST_ASSERT_EQUAL_UINT(raxel_voxel_chunk_get(&chunk, 0).material, 3);
+    RAXEL_TEST_ASSERT_EQUAL_UINT(raxel_voxel_chunk_get(&chunk, RAXEL_VOXEL_CHUNK_VOLUME - 1).material,
+                                 reference[RAXEL_VOXEL_CHUNK_VOLUME - 1].material);
+
+    // a 16-bit chunk with a few hundred materials only allocates palette for those
+    for (raxel_size_t i = 0; i < 300; i++) {
+        raxel_voxel_chunk_set(&chunk, i, (raxel_voxel_t){.material = (raxel_material_handle_t)(100 + i)});
+    }
+    RAXEL_TEST_ASSERT_EQUAL_UINT(chunk.bits, 16);
+    RAXEL_TEST_ASSERT(chunk.palette_capacity >= chunk.palette_size && chunk.palette_capacity <= 2 * chunk.palette_size);
+    RAXEL_TEST_ASSERT_EQUAL_UINT(raxel_voxel_chunk_get(&chunk, 299).material, 399);
+    RAXEL_TEST_ASSERT((unsigned)raxel_voxel_chunk_memory_usage(&chunk) <
+                      sizeof(raxel_voxel_chunk_t) + RAXEL_VOXEL_CHUNK_VOLUME * sizeof(uint16_t) + 2048 * sizeof(raxel_material_handle_t) +
+                          RAXEL_VOXEL_CHUNK_OCCUPANCY_WORDS * sizeof(uint64_t));
+
+    // uniform chunks own no storage
+    raxel_voxel_chunk_fill(&chunk, (raxel_voxel_t){9});
+    RAXEL_TEST_ASSERT_EQUAL_UINT(chunk.bits, 0);
+    RAXEL_TEST_ASSERT_EQUAL_UINT(raxel_voxel_chunk_get(&chunk, 4242).material, 9);
+    RAXEL_TEST_ASSERT_EQUAL_INT((int)raxel_voxel_chunk_memory_usage(&chunk), (int)sizeof(raxel_voxel_chunk_t));
+
+    raxel_voxel_chunk_release(&chunk);
+    free(reference);
+    free(decoded);
+}
+
+/*------------------------------------------------------------
+  Test: Occupancy mask and solid count follow every edit.
+------------------------------------------------------------*/
+RAXEL_TEST(test_voxel_chunk_occupancy) {
+    raxel_allocator_t allocator = raxel_default_allocator();
+    raxel_voxel_chunk_t chunk;
+    raxel_voxel_chunk_init(&chunk, &allocator);
+    RAXEL_TEST_ASSERT(raxel_voxel_chunk_is_empty(&chunk));
+    RAXEL_TEST_ASSERT_EQUAL_UINT((unsigned)raxel_voxel_chunk_next_solid(&chunk, 0), RAXEL_VOXEL_CHUNK_VOLUME);
+
+    // mix single sets, spans and clears, then compare against the decoded voxels
+    uint32_t seed = 777;
+    for (int i = 0; i < 5000; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        raxel_size_t index = (seed >> 8) % RAXEL_VOXEL_CHUNK_VOLUME;
+        raxel_voxel_t voxel = {.material = (seed >> 4) % 3};
+        if (i % 10 == 0) {
+            raxel_size_t count = (seed >> 20) % 200;
+            if (index + count > RAXEL_VOXEL_CHUNK_VOLUME) count = RAXEL_VOXEL_CHUNK_VOLUME - index;
+            raxel_voxel_chunk_fill_span(&chunk, index, count, voxel);
+        } else {
+            raxel_voxel_chunk_set(&chunk, index, voxel);
+        }
+    }
+    raxel_voxel_t *decoded = malloc(RAXEL_VOXEL_CHUNK_VOLUME * sizeof(raxel_voxel_t));
+    raxel_voxel_chunk_decode(&chunk, decoded);
+    uint32_t solid = 0;
+    int mask_matches = 1;
+    for (raxel_size_t i = 0; i < RAXEL_VOXEL_CHUNK_VOLUME; i++) {
+        solid += decoded[i].material != 0;
+        mask_matches &= raxel_voxel_chunk_is_solid(&chunk, i) == (decoded[i].material != 0);
+    }
+    RAXEL_TEST_ASSERT(mask_matches);
+    RAXEL_TEST_ASSERT_EQUAL_UINT(chunk.solid_count, solid);
+
+    // enumeration visits exactly the solid voxels, in order
+    uint32_t visited = 0;
+    int in_order = 1;
+    raxel_size_t previous = 0;
+    for (raxel_size_t i = raxel_voxel_chunk_next_solid(&chunk, 0); i < RAXEL_VOXEL_CHUNK_VOLUME;
+         i = raxel_voxel_chunk_next_solid(&chunk, i + 1)) {
+        in_order &= (visited == 0 || i > previous) && decoded[i].material != 0;
+        previous = i;
+        visited++;
+    }
+    RAXEL_TEST_ASSERT(in_order);
+    RAXEL_TEST_ASSERT_EQUAL_UINT(visited, solid);
+
+    // uniform chunks drop the mask, and punching one hole into a full chunk brings it back
+    raxel_voxel_chunk_fill(&chunk, (raxel_voxel_t){4});
+    RAXEL_TEST_ASSERT(chunk.occupancy == NULL);
+    RAXEL_TEST_ASSERT(raxel_voxel_chunk_is_full(&chunk));
+    raxel_voxel_chunk_set(&chunk, 100, (raxel_voxel_t){0});
+    RAXEL_TEST_ASSERT_EQUAL_UINT(chunk.solid_count, RAXEL_VOXEL_CHUNK_VOLUME - 1);
+    RAXEL_TEST_ASSERT(!raxel_voxel_chunk_is_solid(&chunk, 100));
+    RAXEL_TEST_ASSERT_EQUAL_UINT((unsigned)raxel_voxel_chunk_next_solid(&chunk, 100), 101);
+    raxel_voxel_chunk_fill_span(&chunk, 0, RAXEL_VOXEL_CHUNK_VOLUME - 1, (raxel_voxel_t){0});
+    raxel_voxel_chunk_set(&chunk, RAXEL_VOXEL_CHUNK_VOLUME - 1, (raxel_voxel_t){0});
+    RAXEL_TEST_ASSERT(raxel_voxel_chunk_is_empty(&chunk));
+
+    raxel_voxel_chunk_release(&chunk);
+    free(decoded);
+}
+
+/*------------------------------------------------------------
+  Test: Batched edits match voxel-by-voxel placement.
+------------------------------------------------------------*/
+RAXEL_TEST(test_voxel_world_batched_edits) {
+    raxel_allocator_t allocator = raxel_default_allocator();
+    raxel_voxel_world_t *world = raxel_voxel_world_create(&allocator);
+    raxel_voxel_t solid = {.material = 7};
+
+    // sphere straddling chunk boundaries on every axis
+    const int cx = 3, cy = -5, cz = 30, radius = 20;
+    raxel_voxel_world_fill_sphere(world, cx, cy, cz, radius, solid);
+    for (int z = cz - radius - 1; z <= cz + radius + 1; z++) {
+        for (int y = cy - radius - 1; y <= cy + radius + 1; y++) {
+            for (int x = cx - radius - 1; x <= cx + radius + 1; x++) {
+                int inside = (x - cx) * (x - cx) + (y - cy) * (y - cy) + (z - cz) * (z - cz) <= radius * radius;
+                RAXEL_TEST_ASSERT_EQUAL_UINT(raxel_voxel_world_get_voxel(world, x, y, z).material, inside ? 7u : 0u);
+            }
+        }
+    }
+
+    // carving a box out of the sphere
+    raxel_voxel_world_fill_box(world, -40, -3, 28, 40, 2, 33, (raxel_voxel_t){0});
+    for (int z = 26; z <= 35; z++) {
+        for (int y = -5; y <= 4; y++) {
+            for (int x = -20; x <= 20; x++) {
+                int in_box = y >= -3 && y <= 2 && z >= 28 && z <= 33;
+                int inside = (x - cx) * (x - cx) + (y - cy) * (y - cy) + (z - cz) * (z - cz) <= radius * radius;
+                RAXEL_TEST_ASSERT_EQUAL_UINT(raxel_voxel_world_get_voxel(world, x, y, z).material,
+                                             (inside && !in_box) ? 7u : 0u);
+            }
+        }
+    }
+
+    // scattered placement
+    raxel_coord_t coords[] = {100, 100, 100, 101, 100, 100, -100, 64, 0, 100, 100, 100};
+    raxel_voxel_t voxels[] = {{1}, {2}, {3}, {4}};
+    raxel_voxel_world_place_voxels(world, coords, voxels, 4);
+    RAXEL_TEST_ASSERT_EQUAL_UINT(raxel_voxel_world_get_voxel(world, 100, 100, 100).material, 4);
+    RAXEL_TEST_ASSERT_EQUAL_UINT(raxel_voxel_world_get_voxel(world, 101, 100, 100).material, 2);
+    RAXEL_TEST_ASSERT_EQUAL_UINT(raxel_voxel_world_get_voxel(world, -100, 64, 0).material, 3);
+
+    // erasing where there are no chunks creates none
+    raxel_size_t num_chunks = raxel_list_size(world->chunks);
+    raxel_voxel_world_fill_box(world, 1000, 1000, 1000, 1100, 1040, 1040, (raxel_voxel_t){0});
+    raxel_voxel_world_fill_sphere(world, -1000, 0, 0, 40, (raxel_voxel_t){0});
+    raxel_voxel_world_place_voxel(world, 0, 1000, 0, (raxel_voxel_t){0});
+    raxel_coord_t empty_coords[] = {0, -1000, 0, 5000, 0, 0};
+    raxel_voxel_t empty_voxels[] = {{0}, {0}};
+    raxel_voxel_world_place_voxels(world, empty_coords, empty_voxels, 2);
+    RAXEL_TEST_ASSERT(raxel_list_size(world->chunks) == num_chunks);
+
+    raxel_voxel_world_destroy(world);
+}
+
+/*------------------------------------------------------------
+  Test: Only new and edited chunks reach the GPU buffer.
+------------------------------------------------------------*/
+
+// A storage buffer without a device: mapped stands in for the GPU copy.
+static raxel_sb_buffer_t *__voxel_test_cpu_sb_buffer(raxel_allocator_t *allocator, raxel_voxel_world_t *world) {
+    raxel_sb_buffer_t *buffer = calloc(1, sizeof(raxel_sb_buffer_t));
+    buffer->data_size = raxel_voxel_world_gpu_size(world);
+    buffer->data = calloc(1, buffer->data_size);
+    buffer->mapped = calloc(1, buffer->data_size);
+    buffer->dirty_ranges = raxel_list_create_reserve(raxel_sb_range_t, allocator, 16);
+    buffer->allocator = allocator;
+    return buffer;
+}
+
+static void __voxel_test_destroy_cpu_sb_buffer(raxel_sb_buffer_t *buffer) {
+    raxel_list_destroy(buffer->dirty_ranges);
+    free(buffer->data);
+    free(buffer->mapped);
+    free(buffer);
+}
+
+// Chunk x coordinates of the slots the shader would currently draw, as a bit set.
+static uint32_t __voxel_test_drawn_chunks(raxel_sb_buffer_t *buffer) {
+    __raxel_voxel_world_gpu_t *gpu_world = buffer->data;
+    uint32_t drawn = 0;
+    for (uint32_t s = 0; s < gpu_world->num_loaded_chunks; s++) {
+        if (gpu_world->chunks[s].meta.state == RAXEL_VOXEL_CHUNK_STATE_DEFAULT) {
+            drawn |= 1u << gpu_world->chunks[s].meta.x;
+        }
+    }
+    return drawn;
+}
+
+// A row of ten chunks along x with one marker voxel each, created far to near so list order is
+// the opposite of distance order from the origin.
+static void __voxel_test_chunk_row(raxel_voxel_world_t *world) {
+    for (int c = 9; c >= 0; c--) {
+        raxel_voxel_world_place_voxel(world, c * RAXEL_VOXEL_CHUNK_SIZE + 1, 2, 3, (raxel_voxel_t){(raxel_material_handle_t)(c + 1)});
+    }
+}
+
+static raxel_voxel_world_update_options_t __voxel_test_camera_at(float chunk_x, float view_distance) {
+    raxel_voxel_world_update_options_t options = {0};
+    options.view_distance = view_distance;
+    options.camera_position[0] = (chunk_x + 0.5f) * RAXEL_VOXEL_CHUNK_SIZE;
+    options.camera_position[1] = 0.5f * RAXEL_VOXEL_CHUNK_SIZE;
+    options.camera_position[2] = 0.5f * RAXEL_VOXEL_CHUNK_SIZE;
+    return options;
+}
+
+static unsigned __voxel_test_stage_at(raxel_voxel_world_t *world, raxel_voxel_gpu_mirror_t *mirror, float chunk_x, float view_distance, raxel_size_t *bytes) {
+    raxel_voxel_world_update_options_t options = __voxel_test_camera_at(chunk_x, view_distance);
+    raxel_size_t written = raxel_voxel_world_stage_upload(world, &options, mirror);
+    *bytes = raxel_sb_buffer_flush(mirror->buffer, NULL);
+    return (unsigned)written;
+}
+
+RAXEL_TEST(test_voxel_world_incremental_upload) {
+    raxel_allocator_t allocator = raxel_default_allocator();
+    raxel_voxel_world_t *world = raxel_voxel_world_create(&allocator);
+    world->residency_hysteresis = 0.0f;
+    raxel_sb_buffer_t *buffer = __voxel_test_cpu_sb_buffer(&allocator, world);
+    __raxel_voxel_world_gpu_t *gpu_world = buffer->data;
+    raxel_voxel_gpu_mirror_t mirror;
+    raxel_voxel_gpu_mirror_init(&mirror, buffer, &allocator);
+
+    __voxel_test_chunk_row(world);
+
+    raxel_size_t bytes;
+    RAXEL_TEST_ASSERT_EQUAL_UINT(__voxel_test_stage_at(world, &mirror, 0, 2.5f, &bytes), 3);
+    RAXEL_TEST_ASSERT(memcmp(buffer->mapped, buffer->data, buffer->data_size) == 0);
+
+    // nothing changed: nothing is written or uploaded
+    RAXEL_TEST_ASSERT_EQUAL_UINT(__voxel_test_stage_at(world, &mirror, 0, 2.5f, &bytes), 0);
+    RAXEL_TEST_ASSERT_EQUAL_UINT((unsigned)bytes, 0);
+
+    // one edit re-uploads one chunk
+    raxel_voxel_world_place_voxel(world, 33, 4, 4, (raxel_voxel_t){42});
+    RAXEL_TEST_ASSERT_EQUAL_UINT(__voxel_test_stage_at(world, &mirror, 0, 2.5f, &bytes), 1);
+    RAXEL_TEST_ASSERT(bytes < 2 * sizeof(raxel_voxel_gpu_chunk_t));
+    RAXEL_TEST_ASSERT(memcmp(buffer->mapped, buffer->data, buffer->data_size) == 0);
+
+    // moving the camera only writes chunks that were not resident yet
+    RAXEL_TEST_ASSERT_EQUAL_UINT(__voxel_test_stage_at(world, &mirror, 1, 2.5f, &bytes), 1);
+    RAXEL_TEST_ASSERT_EQUAL_UINT(__voxel_test_stage_at(world, &mirror, 5, 2.5f, &bytes), 4);
+    RAXEL_TEST_ASSERT(memcmp(buffer->mapped, buffer->data, buffer->data_size) == 0);
+    RAXEL_TEST_ASSERT_EQUAL_UINT(__voxel_test_drawn_chunks(buffer), 0xF8u);  // chunks 3..7
+
+    // chunks that left the view are still cached, so coming back writes nothing
+    RAXEL_TEST_ASSERT_EQUAL_UINT(__voxel_test_stage_at(world, &mirror, 0, 2.5f, &bytes), 0);
+    RAXEL_TEST_ASSERT_EQUAL_UINT(__voxel_test_drawn_chunks(buffer), 0x07u);  // chunks 0..2
+
+    // every drawn slot holds the chunk its meta names
+    int slots_match = 1;
+    for (uint32_t s = 0; s < gpu_world->num_loaded_chunks; s++) {
+        raxel_voxel_chunk_meta_t meta = gpu_world->chunks[s].meta;
+        slots_match &= gpu_world->chunks[s].voxels[1 + 2 * 32 + 3 * 32 * 32].material == (raxel_material_handle_t)(meta.x + 1);
+    }
+    RAXEL_TEST_ASSERT(slots_match);
+
+    raxel_voxel_gpu_mirror_release(&mirror);
+    __voxel_test_destroy_cpu_sb_buffer(buffer);
+    raxel_voxel_world_destroy(world);
+}
+
+/*------------------------------------------------------------
+  Test: The chunk budget goes to the nearest chunks.
+------------------------------------------------------------*/
+RAXEL_TEST(test_voxel_world_residency) {
+    raxel_allocator_t allocator = raxel_default_allocator();
+    raxel_voxel_world_t *world = raxel_voxel_world_create(&allocator);
+    world->chunk_budget = 3;
+    world->residency_hysteresis = 0.5f;
+    raxel_sb_buffer_t *buffer = __voxel_test_cpu_sb_buffer(&allocator, world);
+    raxel_voxel_gpu_mirror_t mirror;
+    raxel_voxel_gpu_mirror_init(&mirror, buffer, &allocator);
+    __voxel_test_chunk_row(world);
+
+    // all ten chunks are in view, the budget goes to the nearest three
+    raxel_size_t bytes;
+    RAXEL_TEST_ASSERT_EQUAL_UINT(__voxel_test_stage_at(world, &mirror, 0, 10.0f, &bytes), 3);
+    RAXEL_TEST_ASSERT_EQUAL_UINT(__voxel_test_drawn_chunks(buffer), 0x007u);  // chunks 0..2
+
+    // chunk 3 is nearer than chunk 0 now (1.4 vs 1.6), but not by more than the hysteresis
+    RAXEL_TEST_ASSERT_EQUAL_UINT(__voxel_test_stage_at(world, &mirror, 1.1f, 10.0f, &bytes), 0);
+    RAXEL_TEST_ASSERT_EQUAL_UINT(__voxel_test_drawn_chunks(buffer), 0x007u);
+    RAXEL_TEST_ASSERT_EQUAL_UINT(__voxel_test_stage_at(world, &mirror, 2, 10.0f, &bytes), 1);
+    RAXEL_TEST_ASSERT_EQUAL_UINT(__voxel_test_drawn_chunks(buffer), 0x00Eu);  // chunks 1..3
+
+    raxel_voxel_gpu_mirror_release(&mirror);
+    __voxel_test_destroy_cpu_sb_buffer(buffer);
+    raxel_voxel_world_destroy(world);
+
+    // with a short view distance fewer chunks are loaded than there are slots, and the other
+    // slots cache recently unloaded chunks
+    world = raxel_voxel_world_create(&allocator);
+    world->chunk_budget = 3;
+    world->residency_hysteresis = 0.0f;
+    buffer = __voxel_test_cpu_sb_buffer(&allocator, world);
+    raxel_voxel_gpu_mirror_init(&mirror, buffer, &allocator);
+    __voxel_test_chunk_row(world);
+    RAXEL_TEST_ASSERT_EQUAL_UINT(__voxel_test_stage_at(world, &mirror, 0, 0.9f, &bytes), 1);
+    RAXEL_TEST_ASSERT_EQUAL_UINT(__voxel_test_stage_at(world, &mirror, 2, 0.9f, &bytes), 1);
+    RAXEL_TEST_ASSERT_EQUAL_UINT(__voxel_test_stage_at(world, &mirror, 4, 0.9f, &bytes), 1);
+    RAXEL_TEST_ASSERT_EQUAL_UINT(__voxel_test_stage_at(world, &mirror, 0, 0.9f, &bytes), 0);  // cached
+    RAXEL_TEST_ASSERT_EQUAL_UINT(__voxel_test_stage_at(world, &mirror, 6, 0.9f, &bytes), 1);  // evicts chunk 2
+    RAXEL_TEST_ASSERT_EQUAL_UINT(__voxel_test_stage_at(world, &mirror, 4, 0.9f, &bytes), 0);  // still cached
+    RAXEL_TEST_ASSERT_EQUAL_UINT(__voxel_test_stage_at(world, &mirror, 2, 0.9f, &bytes), 1);
+    RAXEL_TEST_ASSERT_EQUAL_UINT(__voxel_test_drawn_chunks(buffer), 0x004u);
+    RAXEL_TEST_ASSERT_EQUAL_UINT(((__raxel_voxel_world_gpu_t *)buffer->data)->num_loaded_chunks, 3);
+
+    raxel_voxel_gpu_mirror_release(&mirror);
+    __voxel_test_destroy_cpu_sb_buffer(buffer);
+    raxel_voxel_world_destroy(world);
+}
+
+/*------------------------------------------------------------
+  Test: A worker streams complete snapshots into the back buffer.
+------------------------------------------------------------*/
+
+// Calls raxel_voxel_world_stream_update like a render loop would, until the worker swaps in a
+// snapshot for which done() holds. Returns the new front buffer, or NULL after about two seconds.
+static raxel_sb_buffer_t *__voxel_test_stream_until(raxel_voxel_world_t *world,
+                                                    raxel_voxel_world_update_options_t *options,
+                                                    int (*done)(raxel_sb_buffer_t *buffer)) {
+    struct timespec frame = { 0, 1000000 };
+    for (int i = 0; i < 2000; i++) {
+        raxel_sb_buffer_t *front = raxel_voxel_world_stream_update(world, options);
+        if (front && done(front)) {
+            return front;
+        }
+        nanosleep(&frame, NULL);
+    }
+    return NULL;
+}
+
+static int __voxel_test_draws_near(raxel_sb_buffer_t *buffer) {
+    return __voxel_test_drawn_chunks(buffer) == 0x07u;
+}
+
+static int __voxel_test_draws_far(raxel_sb_buffer_t *buffer) {
+    return __voxel_test_drawn_chunks(buffer) == 0xF8u;
+}
+
+static int __voxel_test_has_edit(raxel_sb_buffer_t *buffer) {
+    __raxel_voxel_world_gpu_t *gpu_world = buffer->data;
+    for (uint32_t s = 0; s < gpu_world->num_loaded_chunks; s++) {
+        if (gpu_world->chunks[s].meta.x == 1 && gpu_world->chunks[s].voxels[4 + 4 * 32 + 4 * 32 * 32].material == 42) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+RAXEL_TEST(test_voxel_world_streaming) {
+    raxel_allocator_t allocator = raxel_default_allocator();
+    raxel_voxel_world_t *world = raxel_voxel_world_create(&allocator);
+    world->residency_hysteresis = 0.0f;
+    raxel_sb_buffer_t *buffers[2] = {
+        __voxel_test_cpu_sb_buffer(&allocator, world),
+        __voxel_test_cpu_sb_buffer(&allocator, world),
+    };
+    __voxel_test_chunk_row(world);
+    raxel_voxel_world_start_streaming(world, buffers[0], buffers[1]);
+
+    // the first snapshot lands in the back buffer, flushed as a whole
+    raxel_voxel_world_update_options_t options = __voxel_test_camera_at(0, 2.5f);
+    raxel_sb_buffer_t *front = __voxel_test_stream_until(world, &options, __voxel_test_draws_near);
+    RAXEL_TEST_ASSERT(front == buffers[1]);
+    RAXEL_TEST_ASSERT(memcmp(front->mapped, front->data, front->data_size) == 0);
+
+    // edits go through the world lock while the worker runs
+    raxel_voxel_world_place_voxel(world, 36, 4, 4, (raxel_voxel_t){42});
+    front = __voxel_test_stream_until(world, &options, __voxel_test_has_edit);
+    RAXEL_TEST_ASSERT(front == buffers[0]);
+    RAXEL_TEST_ASSERT_EQUAL_UINT(raxel_voxel_world_get_voxel(world, 36, 4, 4).material, 42);
+
+    // crossing chunks only hands the camera over, the swap follows once the snapshot is complete
+    options = __voxel_test_camera_at(5, 2.5f);
+    front = __voxel_test_stream_until(world, &options, __voxel_test_draws_far);
+    RAXEL_TEST_ASSERT(front != NULL);
+    RAXEL_TEST_ASSERT(memcmp(front->mapped, front->data, front->data_size) == 0);
+    RAXEL_TEST_ASSERT(((__raxel_voxel_world_gpu_t *)front->data)->bvh.n_nodes > 0);
+
+    raxel_voxel_world_stop_streaming(world);
+    RAXEL_TEST_ASSERT(world->__stream == NULL);
+    raxel_voxel_world_destroy(world);
+    __voxel_test_destroy_cpu_sb_buffer(buffers[0]);
+    __voxel_test_destroy_cpu_sb_buffer(buffers[1]);
+}
+
+/*------------------------------------------------------------
+  Test: Chunks round-trip through region files and page on demand.
+------------------------------------------------------------*/
+
+static void __voxel_test_remove_directory(const char *directory, raxel_allocator_t *allocator) {
+    raxel_list(raxel_string_t) names = raxel_file_list_directory(directory, allocator);
+    for (raxel_size_t i = 0; i < raxel_list_size(names); i++) {
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s", directory, raxel_string_data(&names[i]));
+        remove(path);
+        raxel_string_destroy(&names[i]);
+    }
+    raxel_list_destroy(names);
+    rmdir(directory);
+}
+
+// Different storage in every chunk: uniform, 1-bit, wide palettes, and a negative region.
+static void __voxel_test_region_world(raxel_voxel_world_t *world) {
+    raxel_voxel_world_fill_box(world, 0, 0, 0, 31, 31, 31, (raxel_voxel_t){7});
+    raxel_voxel_world_fill_sphere(world, 48, 16, 16, 12, (raxel_voxel_t){3});
+    for (int i = 0; i < 300; i++) {
+        raxel_voxel_world_place_voxel(world, 64 + i % 32, (i * 7) % 32, (i * 13) % 32, (raxel_voxel_t){(raxel_material_handle_t)(1 + i % 40)});
+    }
+    raxel_voxel_world_place_voxel(world, -5, -600, 9, (raxel_voxel_t){99});
+}
+
+RAXEL_TEST(test_voxel_world_regions) {
+    raxel_allocator_t allocator = raxel_default_allocator();
+    char directory[] = "/tmp/raxel_regions_XXXXXX";
+    RAXEL_TEST_ASSERT(mkdtemp(directory) != NULL);
+
+    raxel_voxel_world_t *source = raxel_voxel_world_create(&allocator);
+    __voxel_test_region_world(source);
+    RAXEL_TEST_ASSERT_EQUAL_INT(raxel_voxel_world_save(source), -1);  // no directory yet
+    RAXEL_TEST_ASSERT_EQUAL_INT(raxel_voxel_world_open_regions(source, directory), 0);
+    RAXEL_TEST_ASSERT_EQUAL_INT(raxel_voxel_world_save(source), 0);
+
+    raxel_list(raxel_string_t) names = raxel_file_list_directory(directory, &allocator);
+    RAXEL_TEST_ASSERT_EQUAL_UINT((unsigned)raxel_list_size(names), 2);  // regions (0, 0, 0) and (-1, -2, 0)
+    for (raxel_size_t i = 0; i < raxel_list_size(names); i++) {
+        raxel_string_destroy(&names[i]);
+    }
+    raxel_list_destroy(names);
+
+    // nothing is read until it is touched
+    raxel_voxel_world_t *world = raxel_voxel_world_create(&allocator);
+    RAXEL_TEST_ASSERT_EQUAL_INT(raxel_voxel_world_open_regions(world, directory), 0);
+    RAXEL_TEST_ASSERT_EQUAL_UINT((unsigned)raxel_list_size(world->chunks), 0);
+    RAXEL_TEST_ASSERT_EQUAL_UINT(raxel_voxel_world_get_voxel(world, -5, -600, 9).material, 99);
+    RAXEL_TEST_ASSERT_EQUAL_UINT((unsigned)raxel_list_size(world->chunks), 1);
+
+    int same = 1;
+    for (raxel_coord_t z = 0; z < 32; z++) {
+        for (raxel_coord_t y = 0; y < 32; y++) {
+            for (raxel_coord_t x = 0; x < 96; x++) {
+                same &= raxel_voxel_world_get_voxel(world, x, y, z).material == raxel_voxel_world_get_voxel(source, x, y, z).material;
+            }
+        }
+    }
+    RAXEL_TEST_ASSERT(same);
+    RAXEL_TEST_ASSERT_EQUAL_UINT((unsigned)raxel_list_size(world->chunks), 4);
+    raxel_voxel_chunk_t *sphere_chunk = raxel_voxel_world_get_chunk(world, 1, 0, 0);
+    RAXEL_TEST_ASSERT_EQUAL_UINT(sphere_chunk->solid_count, raxel_voxel_world_get_chunk(source, 1, 0, 0)->solid_count);
+
+    // an edit is saved, and the chunks of its region that were never read are carried over
+    raxel_voxel_world_destroy(world);
+    world = raxel_voxel_world_create(&allocator);
+    raxel_voxel_world_open_regions(world, directory);
+    raxel_voxel_world_place_voxel(world, 40, 16, 16, (raxel_voxel_t){5});
+    RAXEL_TEST_ASSERT_EQUAL_UINT((unsigned)raxel_list_size(world->chunks), 1);
+    RAXEL_TEST_ASSERT_EQUAL_INT(raxel_voxel_world_save(world), 0);
+    raxel_voxel_world_destroy(world);
+
+    world = raxel_voxel_world_create(&allocator);
+    raxel_voxel_world_open_regions(world, directory);
+    RAXEL_TEST_ASSERT_EQUAL_UINT(raxel_voxel_world_get_voxel(world, 40, 16, 16).material, 5);
+    RAXEL_TEST_ASSERT_EQUAL_UINT(raxel_voxel_world_get_voxel(world, 10, 10, 10).material, 7);
+    RAXEL_TEST_ASSERT_EQUAL_UINT(raxel_voxel_world_get_voxel(world, 64 + 299 % 32, (299 * 7) % 32, (299 * 13) % 32).material, 1 + 299 % 40);
+
+    // staging pages in the chunks around the camera, and drops unchanged ones once far away
+    raxel_voxel_world_destroy(world);
+    world = raxel_voxel_world_create(&allocator);
+    world->residency_hysteresis = 0.0f;
+    raxel_voxel_world_open_regions(world, directory);
+    raxel_sb_buffer_t *buffer = __voxel_test_cpu_sb_buffer(&allocator, world);
+    raxel_voxel_gpu_mirror_t mirror;
+    raxel_voxel_gpu_mirror_init(&mirror, buffer, &allocator);
+    raxel_size_t bytes;
+    RAXEL_TEST_ASSERT_EQUAL_UINT(__voxel_test_stage_at(world, &mirror, 0, 2.5f, &bytes), 3);
+    RAXEL_TEST_ASSERT_EQUAL_UINT((unsigned)raxel_list_size(world->chunks), 3);
+    RAXEL_TEST_ASSERT_EQUAL_UINT(__voxel_test_drawn_chunks(buffer), 0x7u);
+    raxel_voxel_world_place_voxel(world, 1, 1, 1, (raxel_voxel_t){0});  // chunk 0 now only lives in RAM
+    __voxel_test_stage_at(world, &mirror, 30, 2.5f, &bytes);
+    RAXEL_TEST_ASSERT_EQUAL_UINT((unsigned)raxel_list_size(world->chunks), 1);
+    RAXEL_TEST_ASSERT_EQUAL_UINT(raxel_voxel_world_get_voxel(world, 1, 1, 1).material, 0);
+    RAXEL_TEST_ASSERT_EQUAL_UINT(__voxel_test_drawn_chunks(buffer), 0);
+    __voxel_test_stage_at(world, &mirror, 0, 2.5f, &bytes);
+    RAXEL_TEST_ASSERT_EQUAL_UINT(__voxel_test_drawn_chunks(buffer), 0x7u);
+
+    raxel_voxel_gpu_mirror_release(&mirror);
+    __voxel_test_destroy_cpu_sb_buffer(buffer);
+    raxel_voxel_world_destroy(world);
+    raxel_voxel_world_destroy(source);
+    __voxel_test_remove_directory(directory, &allocator);
+}
+
+// Every loaded chunk is found at its own coordinates, holds its own marker voxel, and the index
+// has no entries beyond the loaded chunks.
+static int __voxel_test_paged_chunks_consistent(raxel_voxel_world_t *world) {
+    int consistent = world->chunk_index->__size == raxel_list_size(world->chunks);
+    for (raxel_size_t i = 0; i < raxel_list_size(world->chunks); i++) {
+        raxel_voxel_chunk_meta_t meta = world->chunk_meta[i];
+        raxel_voxel_chunk_t *chunk = raxel_voxel_chunk_pool_get(world->chunk_pool, world->chunks[i]);
+        raxel_coord_t m = meta.x % 32;
+        consistent &= raxel_voxel_world_get_chunk(world, meta.x, meta.y, meta.z) == chunk;
+        consistent &= chunk->solid_count == 1;
+        consistent &= raxel_voxel_chunk_get(chunk, m + m * 32 + 5 * 32 * 32).material == (raxel_material_handle_t)(1 + meta.x % 250);
+    }
+    return consistent;
+}
+
+RAXEL_TEST(test_voxel_world_region_paging) {
+    raxel_allocator_t allocator = raxel_default_allocator();
+    char directory[] = "/tmp/raxel_regions_XXXXXX";
+    RAXEL_TEST_ASSERT(mkdtemp(directory) != NULL);
+
+    // a row of 300 chunks, each with one voxel that tells it apart
+    raxel_voxel_world_t *source = raxel_voxel_world_create(&allocator);
+    for (raxel_coord_t x = 0; x < 300; x++) {
+        raxel_voxel_world_place_voxel(source, x * 32 + x % 32, x % 32, 5, (raxel_voxel_t){(raxel_material_handle_t)(1 + x % 250)});
+    }
+    raxel_voxel_world_open_regions(source, directory);
+    RAXEL_TEST_ASSERT_EQUAL_INT(raxel_voxel_world_save(source), 0);
+    raxel_voxel_world_destroy(source);
+
+    // walk the camera along the row and back, paging chunks in ahead of it and out behind it; the
+    // index is rebuilt around removed chunks every step
+    raxel_voxel_world_t *world = raxel_voxel_world_create(&allocator);
+    world->residency_hysteresis = 0.0f;
+    raxel_voxel_world_open_regions(world, directory);
+    raxel_sb_buffer_t *buffer = __voxel_test_cpu_sb_buffer(&allocator, world);
+    raxel_voxel_gpu_mirror_t mirror;
+    raxel_voxel_gpu_mirror_init(&mirror, buffer, &allocator);
+    raxel_size_t bytes;
+    int consistent = 1;
+    raxel_size_t max_loaded = 0;
+    for (int step = 0; step < 2 * 300 / 3; step++) {
+        int x = (step < 100) ? step * 3 : 597 - step * 3;
+        __voxel_test_stage_at(world, &mirror, (float)x, 6.0f, &bytes);
+        consistent &= __voxel_test_paged_chunks_consistent(world);
+        if (raxel_list_size(world->chunks) > max_loaded) max_loaded = raxel_list_size(world->chunks);
+
+        // touching a far chunk pages it in between the staged ones
+        raxel_coord_t far = (raxel_coord_t)((x + 150) % 300);
+        raxel_coord_t m = far % 32;
+        consistent &= raxel_voxel_world_get_voxel(world, far * 32 + m, m, 5).material == (raxel_material_handle_t)(1 + far % 250);
+        consistent &= __voxel_test_paged_chunks_consistent(world);
+    }
+    RAXEL_TEST_ASSERT(consistent);
+    RAXEL_TEST_ASSERT(max_loaded < 300);  // chunks really were paged out
+    RAXEL_TEST_ASSERT(raxel_list_size(world->chunks) < 300);
+
+    raxel_voxel_gpu_mirror_release(&mirror);
+    __voxel_test_destroy_cpu_sb_buffer(buffer);
+    raxel_voxel_world_destroy(world);
+    __voxel_test_remove_directory(directory, &allocator);
+}
+
+/*------------------------------------------------------------
+  Test: The 64-tree holds the same voxels as the chunks it was built from.
+------------------------------------------------------------*/
+
+// Amanatides-Woo walk over the world's voxels, the reference for raxel_tree64_raycast.
+static int __voxel_test_world_raycast(raxel_voxel_world_t *world, const float origin[3], const float dir[3], float max_t, raxel_coord_t voxel[3]) {
+    raxel_coord_t step[3];
+    float t_max[3], t_delta[3];
+    for (int k = 0; k < 3; k++) {
+        voxel[k] = (raxel_coord_t)floorf(origin[k]);
+        step[k] = dir[k] > 0.0f ? 1 : -1;
+        t_delta[k] = fabsf(1.0f / dir[k]);
+        t_max[k] = ((float)voxel[k] + (dir[k] > 0.0f ? 1.0f : 0.0f) - origin[k]) / dir[k];
+    }
+    float t = 0.0f;
+    while (t <= max_t) {
+        if (raxel_voxel_world_get_voxel(world, voxel[0], voxel[1], voxel[2]).material != 0) {
+            return 1;
+        }
+        int k = t_max[0] < t_max[1] ? (t_max[0] < t_max[2] ? 0 : 2) : (t_max[1] < t_max[2] ? 1 : 2);
+        t = t_max[k];
+        t_max[k] += t_delta[k];
+        voxel[k] += step[k];
+    }
+    return 0;
+}
+
+// A sphere of one material, a box with a top layer of another, and scattered single voxels.
+static void __voxel_test_tree_world(raxel_voxel_world_t *world) {
+    raxel_voxel_world_fill_sphere(world, 0, 0, 0, 20, (raxel_voxel_t){1});
+    raxel_voxel_world_fill_box(world, 30, -10, -5, 60, 5, 25, (raxel_voxel_t){2});
+    raxel_voxel_world_fill_box(world, 30, 5, -5, 60, 5, 25, (raxel_voxel_t){3});
+    for (int i = 0; i < 200; i++) {
+        raxel_voxel_world_place_voxel(world, (i * 37) % 90 - 40, (i * 53) % 70 - 35, (i * 29) % 80 - 30,
+                                      (raxel_voxel_t){(raxel_material_handle_t)(4 + i % 5)});
+    }
+}
+
+// Number of voxels around the test world where the tree and the world disagree.
+static int __voxel_test_tree_mismatches(raxel_voxel_world_t *world, raxel_tree64_t *tree) {
+    int mismatches = 0;
+    for (int z = -48; z < 72; z++) {
+        for (int y = -48; y < 48; y++) {
+            for (int x = -48; x < 104; x++) {
+                mismatches += raxel_tree64_get(tree, x, y, z) != raxel_voxel_world_get_voxel(world, x, y, z).material;
+            }
+        }
+    }
+    return mismatches;
+}
+
+RAXEL_TEST(test_voxel_tree64) {
+    raxel_allocator_t allocator = raxel_default_allocator();
+    raxel_voxel_world_t *world = raxel_voxel_world_create(&allocator);
+    __voxel_test_tree_world(world);
+    raxel_size_t num_chunks = raxel_list_size(world->chunks);
+    raxel_tree64_chunk_ref_t *refs = malloc(num_chunks * sizeof(raxel_tree64_chunk_ref_t));
+    for (raxel_size_t i = 0; i < num_chunks; i++) {
+        raxel_voxel_chunk_meta_t meta = world->chunk_meta[i];
+        refs[i] = (raxel_tree64_chunk_ref_t){meta.x, meta.y, meta.z, raxel_voxel_chunk_pool_get(world->chunk_pool, world->chunks[i])};
+    }
+
+    raxel_tree64_t tree;
+    raxel_tree64_init(&tree, &allocator);
+    RAXEL_TEST_ASSERT_EQUAL_INT(raxel_tree64_build(&tree, refs, num_chunks), 0);
+    RAXEL_TEST_ASSERT_EQUAL_INT(__voxel_test_tree_mismatches(world, &tree), 0);
+    RAXEL_TEST_ASSERT_EQUAL_INT((int)tree.num_chunks, (int)num_chunks);
+    RAXEL_TEST_LOG("64-tree of %zu chunks: %zu bytes (dense: %zu bytes)\n", num_chunks,
+                   raxel_tree64_pool_size(&tree) * sizeof(uint32_t), num_chunks * sizeof(raxel_voxel_gpu_chunk_t));
+
+    // --- Rays hit the same voxels as a walk over the world ---
+    int mismatches = 0;
+    int hits = 0;
+    const float origins[3][3] = {{-70.3f, 5.2f, -60.7f}, {10.1f, 60.4f, 10.6f}, {3.3f, 2.2f, 1.1f}};
+    for (int o = 0; o < 3; o++) {
+        for (int i = 0; i < 200; i++) {
+            float a = 0.0314159f * (float)i;
+            float b = 0.0271828f * (float)(i * 7 % 200) - 2.7f;
+            float dir[3] = {cosf(a) * cosf(b), sinf(b), sinf(a) * cosf(b)};
+            raxel_coord_t expected[3];
+            raxel_tree64_hit_t hit;
+            int expect_hit = __voxel_test_world_raycast(world, origins[o], dir, 200.0f, expected);
+            int got_hit = raxel_tree64_raycast(&tree, origins[o], dir, 200.0f, &hit);
+            if (expect_hit != got_hit ||
+                (got_hit && (hit.voxel[0] != expected[0] || hit.voxel[1] != expected[1] || hit.voxel[2] != expected[2] ||
+                             hit.material != raxel_voxel_world_get_voxel(world, expected[0], expected[1], expected[2]).material))) {
+                mismatches++;
+            }
+            hits += got_hit;
+        }
+    }
+    RAXEL_TEST_ASSERT_EQUAL_INT(mismatches, 0);
+    RAXEL_TEST_ASSERT(hits > 100);
+
+    // a ray along -z from outside enters the sphere through its +z face
+    raxel_tree64_hit_t hit;
+    float origin[3] = {0.5f, 0.5f, 100.5f};
+    float backward[3] = {0.0f, 0.0f, -1.0f};
+    RAXEL_TEST_ASSERT_EQUAL_INT(raxel_tree64_raycast(&tree, origin, backward, 1000.0f, &hit), 1);
+    RAXEL_TEST_ASSERT_EQUAL_INT(hit.voxel[2], 20);
+    RAXEL_TEST_ASSERT(hit.normal[2] == 1.0f && hit.t == 79.5f);
+
+    // --- Edits only append, and leave the same voxels a build would ---
+    raxel_size_t built_size = raxel_tree64_pool_size(&tree);
+    raxel_voxel_world_place_voxel(world, 5, 5, 5, (raxel_voxel_t){0});
+    raxel_voxel_world_place_voxel(world, 100, 3, 3, (raxel_voxel_t){9});
+    raxel_voxel_world_fill_box(world, 30, -10, -5, 60, 5, 25, (raxel_voxel_t){0});
+    for (raxel_size_t i = 0; i < raxel_list_size(world->chunks); i++) {
+        raxel_voxel_chunk_meta_t meta = world->chunk_meta[i];
+        if (meta.x >= 0) {
+            RAXEL_TEST_ASSERT_EQUAL_INT(raxel_tree64_set_chunk(&tree, meta.x, meta.y, meta.z,
+                                                               raxel_voxel_chunk_pool_get(world->chunk_pool, world->chunks[i])), 0);
+        }
+    }
+    RAXEL_TEST_ASSERT(raxel_tree64_pool_size(&tree) > built_size && tree.garbage > 0);
+    RAXEL_TEST_ASSERT_EQUAL_INT(__voxel_test_tree_mismatches(world, &tree), 0);
+    RAXEL_TEST_ASSERT_EQUAL_UINT(raxel_tree64_get(&tree, 100, 3, 3), 9);
+    RAXEL_TEST_ASSERT_EQUAL_INT(raxel_tree64_set_chunk(&tree, 1000, 0, 0, NULL), -1);  // outside the root
+
+    raxel_tree64_release(&tree);
+    free(refs);
+    raxel_voxel_world_destroy(world);
+}
+
+/*------------------------------------------------------------
+  Test: The 64-tree backend fits a thousand chunks in a fixed budget.
+------------------------------------------------------------*/
+RAXEL_TEST(test_voxel_world_tree64_backend) {
+    raxel_allocator_t allocator = raxel_default_allocator();
+    raxel_voxel_world_t *world = raxel_voxel_world_create(&allocator);
+    world->backend = RAXEL_VOXEL_BACKEND_TREE64;
+    world->chunk_budget = 2048;
+    world->tree_memory_budget = 16u << 20;
+    raxel_sb_buffer_t *buffer = __voxel_test_cpu_sb_buffer(&allocator, world);
+    __raxel_voxel_world_gpu_t *gpu_world = buffer->data;
+    raxel_voxel_gpu_mirror_t mirror;
+    raxel_voxel_gpu_mirror_init(&mirror, buffer, &allocator);
+
+    // 32 x 32 chunks of bumpy terrain, stone under a layer of grass
+    const int extent = 32 * RAXEL_VOXEL_CHUNK_SIZE;
+    for (int z = 0; z < extent; z += 8) {
+        for (int x = 0; x < extent; x += 8) {
+            int height = 8 + (x / 8 * 7 + z / 8 * 13) % 12;
+            raxel_voxel_world_fill_box(world, x, 0, z, x + 7, height - 1, z + 7, (raxel_voxel_t){1});
+            raxel_voxel_world_fill_box(world, x, height, z, x + 7, height, z + 7, (raxel_voxel_t){2});
+        }
+    }
+    RAXEL_TEST_ASSERT_EQUAL_INT((int)raxel_list_size(world->chunks), 1024);
+
+    raxel_voxel_world_update_options_t options = {0};
+    options.view_distance = 64.0f;
+    options.camera_position[0] = extent / 2 + 0.5f;
+    options.camera_position[1] = 64.5f;
+    options.camera_position[2] = extent / 2 + 0.5f;
+    raxel_size_t words = raxel_voxel_world_stage_upload(world, &options, &mirror);
+    raxel_sb_buffer_flush(buffer, NULL);
+    RAXEL_TEST_ASSERT_EQUAL_INT((int)world->__num_loaded_chunks, 1024);
+    RAXEL_TEST_ASSERT_EQUAL_INT((int)world->__tree.num_chunks, 1024);
+    RAXEL_TEST_ASSERT_EQUAL_UINT(gpu_world->backend, RAXEL_VOXEL_BACKEND_TREE64);
+    RAXEL_TEST_ASSERT_EQUAL_INT((int)gpu_world->tree.pool_size, (int)words);
+    RAXEL_TEST_ASSERT(words * sizeof(uint32_t) <= world->tree_memory_budget);
+    uint32_t *gpu_pool = (uint32_t *)buffer->mapped + gpu_world->tree.pool_offset;
+    RAXEL_TEST_ASSERT(memcmp(gpu_pool, world->__tree.pool, words * sizeof(uint32_t)) == 0);
+    RAXEL_TEST_LOG("64-tree backend: 1024 chunks in %zu KiB (dense slots: %zu KiB)\n",
+                   words * sizeof(uint32_t) / 1024, (raxel_size_t)1024 * sizeof(raxel_voxel_gpu_chunk_t) / 1024);
+
+    // looking straight down from the camera lands on the grass
+    raxel_tree64_hit_t hit;
+    float down[3] = {0.0f, -1.0f, 0.0f};
+    RAXEL_TEST_ASSERT_EQUAL_INT(raxel_tree64_raycast(&world->__tree, options.camera_position, down, 1000.0f, &hit), 1);
+    RAXEL_TEST_ASSERT_EQUAL_UINT(hit.material, 2);
+    RAXEL_TEST_ASSERT(hit.normal[1] == 1.0f);
+
+    // --- An edit appends a few words, the rest of the pool stays put on the GPU ---
+    raxel_voxel_world_place_voxel(world, 40, 60, 40, (raxel_voxel_t){3});
+    raxel_size_t edit_words = raxel_voxel_world_stage_upload(world, &options, &mirror);
+    raxel_size_t bytes = raxel_sb_buffer_flush(buffer, NULL);
+    RAXEL_TEST_ASSERT(edit_words > 0 && edit_words * 16 < words);
+    RAXEL_TEST_ASSERT(bytes < words * sizeof(uint32_t) / 4);
+    RAXEL_TEST_ASSERT_EQUAL_UINT(raxel_tree64_get(&world->__tree, 40, 60, 40), 3);
+    RAXEL_TEST_ASSERT(memcmp(gpu_pool, world->__tree.pool, gpu_world->tree.pool_size * sizeof(uint32_t)) == 0);
+    RAXEL_TEST_ASSERT_EQUAL_UINT((unsigned)raxel_voxel_world_stage_upload(world, &options, &mirror), 0);
+
+    // --- Over budget, the farthest chunks are left out ---
+    world->tree_memory_budget = words * sizeof(uint32_t) / 2;
+    raxel_voxel_world_place_voxel(world, 41, 60, 40, (raxel_voxel_t){3});
+    raxel_voxel_world_stage_upload(world, &options, &mirror);
+    RAXEL_TEST_ASSERT(raxel_tree64_pool_size(&world->__tree) * sizeof(uint32_t) <= world->tree_memory_budget);
+    RAXEL_TEST_ASSERT(world->__tree.num_chunks < 1024 && world->__tree.num_chunks > 256);
+    RAXEL_TEST_ASSERT_EQUAL_UINT(raxel_tree64_get(&world->__tree, extent / 2, 0, extent / 2), 1);
+    RAXEL_TEST_ASSERT_EQUAL_UINT(raxel_tree64_get(&world->__tree, 0, 0, 0), 0);
+
+    raxel_voxel_gpu_mirror_release(&mirror);
+    __voxel_test_destroy_cpu_sb_buffer(buffer);
+    raxel_voxel_world_destroy(world);
+}
+
+/*------------------------------------------------------------
+  Benchmark: Binned SAH against median splits, on the demo
+  sphere and on a terrain world.
+------------------------------------------------------------*/
+
+typedef struct __voxel_test_bvh_cost {
+    double sah;         // expected node visits plus primitive tests for a random ray through the root
+    double node_visits; // per ray, measured
+    double prim_tests;  // per ray, measured
+    int hits;
+} __voxel_test_bvh_cost_t;
+
+static float __voxel_test_area(const raxel_bvh_bounds_t *b) {
+    vec3 d;
+    glm_vec3_sub((float *)b->max, (float *)b->min, d);
+    return 2.0f * (d[0] * d[1] + d[1] * d[2] + d[2] * d[0]);
+}
+
+static int __voxel_test_slab(const raxel_bvh_bounds_t *b, const float o[3], const float inv_d[3], float t_max, float *t_near) {
+    float t0 = 0.0f, t1 = t_max;
+    for (int k = 0; k < 3; k++) {
+        float a = (b->min[k] - o[k]) * inv_d[k];
+        float c = (b->max[k] - o[k]) * inv_d[k];
+        t0 = fmaxf(t0, fminf(a, c));
+        t1 = fminf(t1, fmaxf(a, c));
+    }
+    *t_near = t0;
+    return t0 <= t1;
+}
+
+// Closest hit against the primitive boxes, near child first, counting the work it takes.
+static int __voxel_test_bvh_closest(const raxel_bvh_accel_t *bvh, const raxel_bvh_bounds_t *bounds, const int *indices,
+                                    const float o[3], const float d[3], int *node_visits, int *prim_tests) {
+    float inv_d[3] = {1.0f / d[0], 1.0f / d[1], 1.0f / d[2]};
+    float best = 1e30f;
+    int stack[64];
+    int sp = 0;
+    stack[sp++] = 0;
+    while (sp > 0) {
+        const raxel_linear_bvh_node_t *node = &bvh->nodes[stack[--sp]];
+        float t;
+        (*node_visits)++;
+        if (!__voxel_test_slab(&node->bounds, o, inv_d, best, &t)) {
+            continue;
+        }
+        if (node->n_primitives > 0) {
+            for (uint32_t i = 0; i < node->n_primitives; i++) {
+                (*prim_tests)++;
+                if (__voxel_test_slab(&bounds[indices[node->primitives_offset + i]], o, inv_d, best, &t)) {
+                    best = t;
+                }
+            }
+        } else {
+            int near = (int)(node - bvh->nodes) + 1;
+            int far = node->second_child_offset;
+            if (d[node->axis] < 0.0f) {
+                int tmp = near;
+                near = far;
+                far = tmp;
+            }
+            stack[sp++] = far;
+            stack[sp++] = near;
+        }
+    }
+    return best < 1e30f;
+}
+
+static __voxel_test_bvh_cost_t __voxel_test_bvh_cost(const raxel_bvh_accel_t *bvh, const raxel_bvh_bounds_t *bounds, const int *indices) {
+    __voxel_test_bvh_cost_t cost = {0};
+    float root_area = __voxel_test_area(&bvh->nodes[0].bounds);
+    for (int i = 0; i < bvh->n_nodes; i++) {
+        const raxel_linear_bvh_node_t *node = &bvh->nodes[i];
+        cost.sah += __voxel_test_area(&node->bounds) / root_area * (node->n_primitives > 0 ? (double)node->n_primitives : 1.0);
+    }
+
+    // a fixed set of rays from a sphere around the scene towards points near its center
+    const int n_rays = 4096;
+    const raxel_bvh_bounds_t *root = &bvh->nodes[0].bounds;
+    vec3 center, extent;
+    glm_vec3_add((float *)root->min, (float *)root->max, center);
+    glm_vec3_scale(center, 0.5f, center);
+    glm_vec3_sub((float *)root->max, (float *)root->min, extent);
+    float radius = glm_vec3_norm(extent);
+    uint32_t seed = 12345;
+    int node_visits = 0, prim_tests = 0;
+    for (int r = 0; r < n_rays; r++) {
+        float u[5];
+        for (int k = 0; k < 5; k++) {
+            seed = seed * 1664525u + 1013904223u;
+            u[k] = (float)(seed >> 8) / (float)(1u << 24);
+        }
+        float z = 2.0f * u[0] - 1.0f;
+        float phi = 6.2831853f * u[1];
+        float s = sqrtf(1.0f - z * z);
+        float o[3] = {center[0] + radius * s * cosf(phi), center[1] + radius * z, center[2] + radius * s * sinf(phi)};
+        float d[3];
+        for (int k = 0; k < 3; k++) {
+            d[k] = center[k] + (u[2 + k] - 0.5f) * extent[k] * 0.5f - o[k];
+        }
+        cost.hits += __voxel_test_bvh_closest(bvh, bounds, indices, o, d, &node_visits, &prim_tests);
+    }
+    cost.node_visits = (double)node_visits / n_rays;
+    cost.prim_tests = (double)prim_tests / n_rays;
+    return cost;
+}
+
+static int __voxel_test_gather_voxels(raxel_voxel_world_t *world, const raxel_coord_t min[3], const raxel_coord_t max[3],
+                                      raxel_bvh_bounds_t **out_bounds, raxel_allocator_t *allocator) {
+    int n = 0, capacity = 1024;
+    raxel_bvh_bounds_t *bounds = raxel_malloc(allocator, capacity * sizeof(raxel_bvh_bounds_t));
+    for (raxel_coord_t z = min[2]; z <= max[2]; z++) {
+        for (raxel_coord_t y = min[1]; y <= max[1]; y++) {
+            for (raxel_coord_t x = min[0]; x <= max[0]; x++) {
+                if (raxel_voxel_world_get_voxel(world, x, y, z).material == 0) {
+                    continue;
+                }
+                if (n == capacity) {
+                    raxel_bvh_bounds_t *grown = raxel_malloc(allocator, 2 * capacity * sizeof(raxel_bvh_bounds_t));
+                    memcpy(grown, bounds, capacity * sizeof(raxel_bvh_bounds_t));
+                    raxel_free(allocator, bounds);
+                    bounds = grown;
+                    capacity *= 2;
+                }
+                bounds[n] = (raxel_bvh_bounds_t){{(float)x, (float)y, (float)z}, {x + 1.0f, y + 1.0f, z + 1.0f}};
+                n++;
+            }
+        }
+    }
+    *out_bounds = bounds;
+    return n;
+}
+
+static void __voxel_test_compare_bvh_methods(const char *name, raxel_bvh_bounds_t *bounds, int n, raxel_allocator_t *allocator) {
+    static const char *method_names[] = {"SAH", "median", "LBVH", "LBVH + treelets"};
+    const raxel_bvh_build_method_t methods[] = {RAXEL_BVH_BUILD_SAH, RAXEL_BVH_BUILD_MEDIAN, RAXEL_BVH_BUILD_LBVH, RAXEL_BVH_BUILD_LBVH_TREELETS};
+    __voxel_test_bvh_cost_t costs[4];
+    int *indices = raxel_malloc(allocator, n * sizeof(int));
+    for (int m = 0; m < 4; m++) {
+        for (int i = 0; i < n; i++) {
+            indices[i] = i;
+        }
+        clock_t start = clock();
+        raxel_bvh_accel_t *bvh = raxel_bvh_accel_build_with_method(bounds, indices, n, MAX_LEAF_SIZE_BVH, methods[m], allocator);
+        double ms = 1000.0 * (double)(clock() - start) / CLOCKS_PER_SEC;
+
+        // every primitive ends up in exactly one leaf that contains it
+        int covered = 0;
+        int *seen = calloc(n, sizeof(int));
+        for (int i = 0; i < bvh->n_nodes; i++) {
+            const raxel_linear_bvh_node_t *node = &bvh->nodes[i];
+            for (uint32_t p = 0; p < node->n_primitives; p++) {
+                const raxel_bvh_bounds_t *b = &bounds[indices[node->primitives_offset + p]];
+                covered += !seen[indices[node->primitives_offset + p]]++ &&
+                           b->min[0] >= node->bounds.min[0] && b->max[0] <= node->bounds.max[0] &&
+                           b->min[1] >= node->bounds.min[1] && b->max[1] <= node->bounds.max[1] &&
+                           b->min[2] >= node->bounds.min[2] && b->max[2] <= node->bounds.max[2];
+            }
+        }
+        free(seen);
+        RAXEL_TEST_ASSERT_EQUAL_INT(covered, n);
+
+        costs[m] = __voxel_test_bvh_cost(bvh, bounds, indices);
+        RAXEL_TEST_LOG("%s, %d voxels, %s: %d nodes in %.1f ms, SAH cost %.1f, per ray %.1f nodes + %.1f primitives (%d hits)\n",
+                       name, n, method_names[m], bvh->n_nodes, ms, costs[m].sah, costs[m].node_visits, costs[m].prim_tests, costs[m].hits);
+        raxel_bvh_accel_destroy(bvh, allocator);
+    }
+    // all trees find the same closest hits, SAH with less work than median, and the treelets
+    // make the LBVH cheaper
+    for (int m = 1; m < 4; m++) {
+        RAXEL_TEST_ASSERT_EQUAL_INT(costs[0].hits, costs[m].hits);
+    }
+    RAXEL_TEST_ASSERT(costs[0].sah < costs[1].sah);
+    RAXEL_TEST_ASSERT(costs[3].sah < costs[2].sah);
+    raxel_free(allocator, indices);
+}
+
+// Rolling hills, 128 x 128 columns of up to 25 voxels.
+static void __voxel_test_terrain_world(raxel_voxel_world_t *world) {
+    for (raxel_coord_t z = 0; z < 128; z++) {
+        for (raxel_coord_t x = 0; x < 128; x++) {
+            raxel_coord_t height = (raxel_coord_t)(12.0f + 8.0f * sinf(x * 0.07f) * cosf(z * 0.05f) + 4.0f * sinf((x + z) * 0.21f));
+            raxel_voxel_world_fill_box(world, x, 0, z, x, height, z, (raxel_voxel_t){1});
+        }
+    }
+}
+
+RAXEL_TEST(test_voxel_bvh_sah_benchmark) {
+    raxel_allocator_t allocator = raxel_default_allocator();
+    raxel_bvh_bounds_t *bounds;
+
+    // the demo scene
+    raxel_voxel_world_t *world = raxel_voxel_world_create(&allocator);
+    raxel_voxel_world_fill_sphere(world, 0, 0, 0, 20, (raxel_voxel_t){255});
+    int n = __voxel_test_gather_voxels(world, (raxel_coord_t[3]){-21, -21, -21}, (raxel_coord_t[3]){21, 21, 21}, &bounds, &allocator);
+    __voxel_test_compare_bvh_methods("Sphere", bounds, n, &allocator);
+    raxel_free(&allocator, bounds);
+    raxel_voxel_world_destroy(world);
+
+    world = raxel_voxel_world_create(&allocator);
+    __voxel_test_terrain_world(world);
+    n = __voxel_test_gather_voxels(world, (raxel_coord_t[3]){0, 0, 0}, (raxel_coord_t[3]){127, 31, 127}, &bounds, &allocator);
+    __voxel_test_compare_bvh_methods("Terrain", bounds, n, &allocator);
+    raxel_free(&allocator, bounds);
+    raxel_voxel_world_destroy(world);
+}
+
+/*------------------------------------------------------------
+  Test: The BVH grows past a million voxels, on the CPU and
+  in the GPU world buffer.
+------------------------------------------------------------*/
+
+static int __voxel_test_bvh_depth(const raxel_bvh_accel_t *bvh, int index) {
+    const raxel_linear_bvh_node_t *node = &bvh->nodes[index];
+    if (node->n_primitives > 0) {
+        return 1;
+    }
+    int a = __voxel_test_bvh_depth(bvh, index + 1);
+    int b = __voxel_test_bvh_depth(bvh, node->second_child_offset);
+    return 1 + (a > b ? a : b);
+}
+
+typedef struct __voxel_test_bvh_census {
+    int nodes;       // of both levels
+    int wide_nodes;  // of both levels, as uploaded
+    int voxels;      // in chunk BVH leaves
+    int oversized;   // chunk BVH leaves over the leaf size
+    int depth;       // deepest chunk BVH
+} __voxel_test_bvh_census_t;
+
+static __voxel_test_bvh_census_t __voxel_test_bvh_count(raxel_voxel_world_t *world, int max_leaf_size) {
+    __voxel_test_bvh_census_t census = {0};
+    census.nodes = world->__bvh->n_nodes;
+    census.wide_nodes = world->__wide_bvh->n_nodes;
+    for (raxel_size_t i = 0; i < raxel_list_size(world->__bvh_instances); i++) {
+        const raxel_bvh_accel_t *bvh = world->__chunk_bvhs[world->__bvh_instances[i].chunk].bvh;
+        census.nodes += bvh->n_nodes;
+        census.wide_nodes += world->__chunk_bvhs[world->__bvh_instances[i].chunk].wide->n_nodes;
+        for (int n = 0; n < bvh->n_nodes; n++) {
+            census.voxels += (int)bvh->nodes[n].n_primitives;
+            census.oversized += bvh->nodes[n].n_primitives > (uint32_t)max_leaf_size;
+        }
+        int depth = __voxel_test_bvh_depth(bvh, 0);
+        census.depth = depth > census.depth ? depth : census.depth;
+    }
+    return census;
+}
+
+RAXEL_TEST(test_voxel_bvh_million_voxels) {
+    raxel_allocator_t allocator = raxel_default_allocator();
+    raxel_voxel_world_t *world = raxel_voxel_world_create(&allocator);
+    world->chunk_budget = 64;
+    // 130 x 64 x 128 voxels over 5 x 2 x 4 chunks, with a tunnel so not every chunk is full
+    raxel_voxel_world_fill_box(world, 0, 0, 0, 129, 63, 127, (raxel_voxel_t){1});
+    raxel_voxel_world_fill_box(world, 0, 20, 50, 129, 30, 60, (raxel_voxel_t){0});
+    const int expected = 130 * 64 * 128 - 130 * 11 * 11;
+
+    raxel_sb_buffer_t *buffer = __voxel_test_cpu_sb_buffer(&allocator, world);
+    __raxel_voxel_world_gpu_t *gpu_world = buffer->data;
+    raxel_voxel_gpu_mirror_t mirror;
+    raxel_voxel_gpu_mirror_init(&mirror, buffer, &allocator);
+    raxel_voxel_world_update_options_t options = {0};
+    options.view_distance = 1000.0f;
+    clock_t start = clock();
+    raxel_voxel_world_stage_upload(world, &options, &mirror);
+    double ms = 1000.0 * (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    RAXEL_TEST_ASSERT(world->__bvh != NULL);
+    RAXEL_TEST_ASSERT_EQUAL_INT((int)raxel_list_size(world->__bvh_instances), 40);
+    __voxel_test_bvh_census_t census = __voxel_test_bvh_count(world, MAX_LEAF_SIZE_BVH);
+    RAXEL_TEST_ASSERT(census.nodes > 1024);
+    RAXEL_TEST_ASSERT_EQUAL_INT(census.voxels, expected);
+    RAXEL_TEST_ASSERT_EQUAL_INT(census.oversized, 0);
+    RAXEL_TEST_ASSERT(census.depth < 32);  // BVH_STACK_SIZE in voxel.comp
+    RAXEL_TEST_LOG("BVH over %d voxels: %d nodes, chunk BVHs up to depth %d, staged in %.1f ms\n",
+                   census.voxels, census.nodes, census.depth, ms);
+
+    // the buffer holds every wide node after the instances, where the header says
+    RAXEL_TEST_ASSERT_EQUAL_UINT(gpu_world->bvh.n_total_nodes, (uint32_t)census.wide_nodes);
+    RAXEL_TEST_ASSERT(census.wide_nodes < census.nodes);
+    raxel_wide_bvh_node_t *nodes = (raxel_wide_bvh_node_t *)((uint32_t *)gpu_world + gpu_world->bvh.node_offset);
+    RAXEL_TEST_ASSERT(nodes == __raxel_voxel_world_gpu_bvh_nodes(gpu_world));
+    RAXEL_TEST_ASSERT(memcmp(nodes, world->__wide_bvh->nodes, world->__wide_bvh->n_nodes * sizeof(raxel_wide_bvh_node_t)) == 0);
+    RAXEL_TEST_LOG("Uploaded as %d wide nodes, %zu KiB\n", census.wide_nodes, census.wide_nodes * sizeof(raxel_wide_bvh_node_t) / 1024);
+
+    // a budget too small for it coarsens the leaves instead of dropping voxels
+    world->bvh_node_budget = 4096;
+    raxel_voxel_world_place_voxel(world, 0, 25, 55, (raxel_voxel_t){2});
+    raxel_voxel_world_stage_upload(world, &options, &mirror);
+    census = __voxel_test_bvh_count(world, RAXEL_VOXEL_CHUNK_VOLUME);
+    RAXEL_TEST_ASSERT(census.wide_nodes <= 4096);
+    RAXEL_TEST_ASSERT_EQUAL_INT(census.voxels, expected + 1);
+    RAXEL_TEST_ASSERT_EQUAL_UINT(gpu_world->bvh.n_total_nodes, (uint32_t)census.wide_nodes);
+
+    raxel_voxel_gpu_mirror_release(&mirror);
+    __voxel_test_destroy_cpu_sb_buffer(buffer);
+    raxel_voxel_world_destroy(world);
+}
+
+/*------------------------------------------------------------
+  Test: The two-level BVH finds the same voxels as a DDA walk,
+  and an edit rebuilds only the edited chunk's BVH.
+------------------------------------------------------------*/
+
+// Rays from around the test world towards it; returns how many hit a different voxel than the
+// reference walk.
+static int __voxel_test_bvh_raycast_mismatches(raxel_voxel_world_t *world, int n_rays) {
+    int mismatches = 0;
+    uint32_t seed = 777;
+    for (int r = 0; r < n_rays; r++) {
+        float u[6];
+        for (int k = 0; k < 6; k++) {
+            seed = seed * 1664525u + 1013904223u;
+            u[k] = (float)(seed >> 8) / (float)(1u << 24);
+        }
+        float origin[3] = { -60.0f + 180.0f * u[0], -60.0f + 120.0f * u[1], -60.0f + 140.0f * u[2] };
+        float target[3] = { -40.0f + 100.0f * u[3], -35.0f + 70.0f * u[4], -30.0f + 80.0f * u[5] };
+        float dir[3];
+        glm_vec3_sub(target, origin, dir);
+        glm_vec3_normalize(dir);
+        raxel_coord_t expected[3];
+        int expected_hit = __voxel_test_world_raycast(world, origin, dir, 400.0f, expected);
+        raxel_voxel_bvh_hit_t hit;
+        int got_hit = raxel_voxel_world_bvh_raycast(world, origin, dir, 400.0f, &hit);
+        if (expected_hit != got_hit) {
+            mismatches++;
+        } else if (got_hit && (hit.voxel[0] != expected[0] || hit.voxel[1] != expected[1] || hit.voxel[2] != expected[2])) {
+            // rays through an edge or corner may pick either of the touching voxels
+            float t_expected = 0.0f;
+            raxel_bvh_bounds_t box = { { expected[0], expected[1], expected[2] }, { expected[0] + 1.0f, expected[1] + 1.0f, expected[2] + 1.0f } };
+            float inv_dir[3] = { 1.0f / dir[0], 1.0f / dir[1], 1.0f / dir[2] };
+            __voxel_test_slab(&box, origin, inv_dir, 400.0f, &t_expected);
+            mismatches += fabsf(t_expected - hit.t) > 1e-3f ||
+                          raxel_voxel_world_get_voxel(world, hit.voxel[0], hit.voxel[1], hit.voxel[2]).material == 0;
+        } else if (got_hit) {
+            mismatches += hit.material != raxel_voxel_world_get_voxel(world, expected[0], expected[1], expected[2]).material;
+        }
+    }
+    return mismatches;
+}
+
+// Instances in the buffer that do not point at an exact copy of their chunk BVH, in a range of
+// its own after the top level.
+static int __voxel_test_bvh_layout_errors(raxel_voxel_world_t *world, raxel_sb_buffer_t *buffer) {
+    __raxel_voxel_world_gpu_t *gpu_world = buffer->data;
+    __raxel_voxel_bvh_instance_gpu_t *instances = __raxel_voxel_world_gpu_bvh_instances(gpu_world);
+    raxel_wide_bvh_node_t *nodes = __raxel_voxel_world_gpu_bvh_nodes(gpu_world);
+    raxel_size_t capacity = (buffer->data_size - (raxel_size_t)((char *)nodes - (char *)gpu_world)) / sizeof(raxel_wide_bvh_node_t);
+    raxel_size_t num_instances = raxel_list_size(world->__bvh_instances);
+    int errors = gpu_world->bvh.n_instances != (uint32_t)num_instances;
+    uint32_t total_nodes = gpu_world->bvh.n_nodes;
+    for (raxel_size_t i = 0; i < num_instances && !errors; i++) {
+        raxel_voxel_bvh_instance_t *instance = &world->__bvh_instances[i];
+        raxel_wide_bvh_t *chunk_bvh = world->__chunk_bvhs[instance->chunk].wide;
+        uint32_t first = instances[i].first_node;
+        uint32_t end = first + instances[i].n_nodes;
+        errors += instances[i].n_nodes != (uint32_t)chunk_bvh->n_nodes;
+        errors += first < gpu_world->bvh.n_nodes || end > capacity;
+        errors += instances[i].origin[0] != (float)instance->origin[0];
+        errors += gpu_world->chunks[instances[i].slot].meta.x * RAXEL_VOXEL_CHUNK_SIZE != instance->origin[0];
+        errors += end <= capacity && memcmp(&nodes[first], chunk_bvh->nodes, chunk_bvh->n_nodes * sizeof(raxel_wide_bvh_node_t)) != 0;
+        for (raxel_size_t j = 0; j < i; j++) {
+            errors += first < instances[j].first_node + instances[j].n_nodes && instances[j].first_node < end;
+        }
+        total_nodes += instances[i].n_nodes;
+    }
+    return errors + (gpu_world->bvh.n_total_nodes != total_nodes);
+}
+
+RAXEL_TEST(test_voxel_world_two_level_bvh) {
+    raxel_allocator_t allocator = raxel_default_allocator();
+    raxel_voxel_world_t *world = raxel_voxel_world_create(&allocator);
+    world->chunk_budget = 64;
+    __voxel_test_tree_world(world);
+    raxel_sb_buffer_t *buffer = __voxel_test_cpu_sb_buffer(&allocator, world);
+    __raxel_voxel_world_gpu_t *gpu_world = buffer->data;
+    raxel_voxel_gpu_mirror_t mirror;
+    raxel_voxel_gpu_mirror_init(&mirror, buffer, &allocator);
+    raxel_voxel_world_update_options_t options = {0};
+    options.view_distance = 1000.0f;
+    raxel_voxel_world_stage_upload(world, &options, &mirror);
+
+    raxel_size_t num_instances = raxel_list_size(world->__bvh_instances);
+    RAXEL_TEST_ASSERT(num_instances > 1);
+    RAXEL_TEST_ASSERT_EQUAL_INT(__voxel_test_bvh_raycast_mismatches(world, 2000), 0);
+
+    // the buffer has one instance per chunk BVH, each in its own range after the top level
+    RAXEL_TEST_ASSERT_EQUAL_INT(__voxel_test_bvh_layout_errors(world, buffer), 0);
+    raxel_sb_buffer_flush(buffer, NULL);
+
+    // an edit rebuilds the edited chunk's BVH and the top level, the other chunk BVHs are kept
+    raxel_size_t num_handles = raxel_list_size(world->__chunk_bvhs);
+    uint32_t *before = malloc(num_handles * sizeof(uint32_t));
+    for (raxel_size_t h = 0; h < num_handles; h++) {
+        before[h] = world->__chunk_bvhs[h].revision;
+    }
+    raxel_voxel_world_fill_box(world, 2, 2, 2, 5, 5, 5, (raxel_voxel_t){9});
+    raxel_voxel_world_stage_upload(world, &options, &mirror);
+    raxel_voxel_chunk_handle_t edited = raxel_voxel_world_get_chunk_handle(world, 0, 0, 0);
+    int rebuilt = 0;
+    for (raxel_size_t h = 0; h < num_handles; h++) {
+        rebuilt += h != edited && world->__chunk_bvhs[h].revision != before[h];
+    }
+    RAXEL_TEST_ASSERT_EQUAL_INT(rebuilt, 0);
+    RAXEL_TEST_ASSERT(world->__chunk_bvhs[edited].revision != before[edited]);
+    free(before);
+    RAXEL_TEST_ASSERT_EQUAL_INT(__voxel_test_bvh_raycast_mismatches(world, 2000), 0);
+
+    // and only those reach the buffer: the chunk's voxels and BVH, the top level and the instances
+    raxel_size_t bytes = raxel_sb_buffer_flush(buffer, NULL);
+    raxel_size_t bvh_bytes = (mirror.bvh_top_nodes + (raxel_size_t)world->__chunk_bvhs[edited].wide->n_nodes) * sizeof(raxel_wide_bvh_node_t) +
+                             num_instances * sizeof(__raxel_voxel_bvh_instance_gpu_t);
+    RAXEL_TEST_ASSERT(bytes <= sizeof(__raxel_voxel_world_gpu_t) + sizeof(raxel_voxel_gpu_chunk_t) + bvh_bytes);
+    RAXEL_TEST_ASSERT(bytes < sizeof(raxel_voxel_gpu_chunk_t) + gpu_world->bvh.n_total_nodes * sizeof(raxel_wide_bvh_node_t));
+    RAXEL_TEST_ASSERT_EQUAL_INT(__voxel_test_bvh_layout_errors(world, buffer), 0);
+    RAXEL_TEST_ASSERT(memcmp(buffer->mapped, buffer->data, buffer->data_size) == 0);
+    RAXEL_TEST_LOG("Edit of one chunk uploaded %zu KiB, the whole BVH is %zu KiB\n", bytes / 1024,
+                   gpu_world->bvh.n_total_nodes * sizeof(raxel_wide_bvh_node_t) / 1024);
+
+    // chunk BVHs that leave the loaded set keep their nodes, so coming back copies none of them
+    raxel_voxel_gpu_bvh_range_t *ranges = malloc(raxel_list_size(mirror.bvh_of_chunk) * sizeof(raxel_voxel_gpu_bvh_range_t));
+    memcpy(ranges, mirror.bvh_of_chunk, raxel_list_size(mirror.bvh_of_chunk) * sizeof(raxel_voxel_gpu_bvh_range_t));
+    world->residency_hysteresis = 0.0f;
+    options.view_distance = 1.0f;
+    raxel_voxel_world_stage_upload(world, &options, &mirror);
+    RAXEL_TEST_LOG("%zu of %zu chunk BVHs loaded\n", raxel_list_size(world->__bvh_instances), num_instances);
+    RAXEL_TEST_ASSERT(raxel_list_size(world->__bvh_instances) < num_instances);
+    RAXEL_TEST_ASSERT_EQUAL_INT(__voxel_test_bvh_layout_errors(world, buffer), 0);
+    options.view_distance = 1000.0f;
+    raxel_voxel_world_stage_upload(world, &options, &mirror);
+    RAXEL_TEST_ASSERT_EQUAL_INT(__voxel_test_bvh_layout_errors(world, buffer), 0);
+    int moved = 0;
+    for (raxel_size_t i = 0; i < num_instances; i++) {
+        raxel_voxel_chunk_handle_t handle = world->__bvh_instances[i].chunk;
+        moved += memcmp(&ranges[handle], &mirror.bvh_of_chunk[handle], sizeof(raxel_voxel_gpu_bvh_range_t)) != 0;
+    }
+    RAXEL_TEST_ASSERT_EQUAL_INT(moved, 0);
+    free(ranges);
+
+    // a chunk BVH that outgrows its range moves past the last one, and once there is no room left
+    // the ranges are laid out anew
+    world->bvh_node_budget = gpu_world->bvh.n_total_nodes * 5 / 4;
+    raxel_sb_buffer_t *small_buffer = __voxel_test_cpu_sb_buffer(&allocator, world);
+    raxel_voxel_gpu_mirror_t small_mirror;
+    raxel_voxel_gpu_mirror_init(&small_mirror, small_buffer, &allocator);
+    raxel_voxel_world_stage_upload(world, &options, &small_mirror);
+    RAXEL_TEST_ASSERT_EQUAL_INT(__voxel_test_bvh_layout_errors(world, small_buffer), 0);
+    int layout_errors = 0;
+    int repacked = 0;
+    for (int k = 0; k < 40 && !repacked; k++) {
+        raxel_size_t end = small_mirror.bvh_end;
+        for (int j = 0; j < 100; j++) {
+            raxel_voxel_world_place_voxel(world, 21 + (j * 7) % 11, (j * 3 + k) % 32, (j * 5 + k * 11) % 32, (raxel_voxel_t){5});
+        }
+        raxel_voxel_world_stage_upload(world, &options, &small_mirror);
+        layout_errors += __voxel_test_bvh_layout_errors(world, small_buffer);
+        repacked = small_mirror.bvh_end < end;
+    }
+    RAXEL_TEST_ASSERT(repacked);
+    RAXEL_TEST_ASSERT_EQUAL_INT(layout_errors, 0);
+    RAXEL_TEST_ASSERT_EQUAL_INT(__voxel_test_bvh_raycast_mismatches(world, 2000), 0);
+    raxel_voxel_gpu_mirror_release(&small_mirror);
+    __voxel_test_destroy_cpu_sb_buffer(small_buffer);
+
+    raxel_voxel_gpu_mirror_release(&mirror);
+    __voxel_test_destroy_cpu_sb_buffer(buffer);
+    raxel_voxel_world_destroy(world);
+}
+
+/*------------------------------------------------------------
+  Test: A parallel BVH build gives exactly the serial build's
+  nodes and primitive order, a pool of one thread and a pool of
+  four build trees of the same cost that find the same hits, and
+  chunk BVHs built on the world's build pool match too.
+------------------------------------------------------------*/
+static double __voxel_test_wall_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return 1000.0 * (double)now.tv_sec + (double)now.tv_nsec / 1e6;
+}
+
+// Builds the same BVH serially and on the pool; returns how many of nodes and indices differ.
+static int __voxel_test_compare_parallel_build(const char *name, raxel_bvh_bounds_t *bounds, int n, raxel_bvh_build_method_t method,
+                                               raxel_thread_pool_t *pool, raxel_allocator_t *allocator) {
+    int *serial_indices = raxel_malloc(allocator, n * sizeof(int));
+    int *parallel_indices = raxel_malloc(allocator, n * sizeof(int));
+    for (int i = 0; i < n; i++) {
+        serial_indices[i] = parallel_indices[i] = i;
+    }
+    double start = __voxel_test_wall_ms();
+    raxel_bvh_accel_t *serial = raxel_bvh_accel_build_with_method(bounds, serial_indices, n, MAX_LEAF_SIZE_BVH, method, allocator);
+    double serial_ms = __voxel_test_wall_ms() - start;
+    start = __voxel_test_wall_ms();
+    raxel_bvh_accel_t *parallel = raxel_bvh_accel_build_parallel(bounds, parallel_indices, n, MAX_LEAF_SIZE_BVH, method, pool, allocator);
+    double parallel_ms = __voxel_test_wall_ms() - start;
+    RAXEL_TEST_LOG("%s, %d primitives: serial build %.1f ms, %d threads %.1f ms\n",
+                   name, n, serial_ms, raxel_thread_pool_size(pool), parallel_ms);
+
+    int differences = serial->n_nodes != parallel->n_nodes;
+    if (!differences) {
+        differences += memcmp(serial->nodes, parallel->nodes, serial->n_nodes * sizeof(raxel_linear_bvh_node_t)) != 0;
+        differences += memcmp(serial_indices, parallel_indices, n * sizeof(int)) != 0;
+    }
+    raxel_bvh_accel_destroy(serial, allocator);
+    raxel_bvh_accel_destroy(parallel, allocator);
+    raxel_free(allocator, serial_indices);
+    raxel_free(allocator, parallel_indices);
+    return differences;
+}
+
+// Builds the same BVH on a pool of one thread and on a pool of four; returns how many of the SAH
+// cost, node count and hits of a fixed set of rays differ.
+static int __voxel_test_compare_pool_builds(raxel_bvh_bounds_t *bounds, int n, raxel_allocator_t *allocator) {
+    const int thread_counts[2] = {1, 4};
+    raxel_bvh_accel_t *bvhs[2];
+    int *indices[2];
+    raxel_bvh_stats_t stats[2];
+    for (int p = 0; p < 2; p++) {
+        raxel_thread_pool_t *pool = raxel_thread_pool_create(thread_counts[p] - 1, allocator);
+        indices[p] = raxel_malloc(allocator, n * sizeof(int));
+        for (int i = 0; i < n; i++) {
+            indices[p][i] = i;
+        }
+        double start = __voxel_test_wall_ms();
+        bvhs[p] = raxel_bvh_accel_build_parallel(bounds, indices[p], n, MAX_LEAF_SIZE_BVH, RAXEL_BVH_BUILD_SAH, pool, allocator);
+        double ms = __voxel_test_wall_ms() - start;
+        raxel_bvh_accel_stats(bvhs[p], 0, &stats[p]);
+        RAXEL_TEST_LOG("%d primitives on a pool of %d threads: %.1f ms, SAH cost %.3f\n",
+                       n, raxel_thread_pool_size(pool), ms, stats[p].sah_cost);
+        raxel_thread_pool_destroy(pool);
+    }
+    int differences = stats[0].sah_cost != stats[1].sah_cost;
+    differences += stats[0].n_nodes != stats[1].n_nodes;
+    int n_hits = 0;
+    // rays from above the scene to points spread through it
+    for (int r = 0; r < 2000; r++) {
+        float origin[3] = { -20.0f + (float)(r % 7), 60.0f, -20.0f + (float)(r % 11) };
+        float target[3] = { (float)((r * 37) % 128) + 0.5f, (float)((r * 11) % 32) + 0.25f, (float)((r * 53) % 128) + 0.75f };
+        float direction[3];
+        glm_vec3_sub(target, origin, direction);
+        glm_vec3_normalize(direction);
+        raxel_bvh_hit_t hits[2];
+        int got_hit[2];
+        for (int p = 0; p < 2; p++) {
+            got_hit[p] = raxel_bvh_accel_intersect(bvhs[p], bounds, indices[p], origin, direction, 1e30f, &hits[p]);
+        }
+        differences += got_hit[0] != got_hit[1] || (got_hit[0] && (hits[0].primitive != hits[1].primitive || hits[0].t != hits[1].t));
+        n_hits += got_hit[0];
+    }
+    RAXEL_TEST_LOG("%d of 2000 rays hit\n", n_hits);
+    for (int p = 0; p < 2; p++) {
+        raxel_bvh_accel_destroy(bvhs[p], allocator);
+        raxel_free(allocator, indices[p]);
+    }
+    return differences;
+}
+
+RAXEL_TEST(test_voxel_bvh_parallel_build) {
+    raxel_allocator_t allocator = raxel_default_allocator();
+    raxel_thread_pool_t *pool = raxel_thread_pool_create(3, &allocator);
+    RAXEL_TEST_ASSERT(pool != NULL);
+    RAXEL_TEST_ASSERT_EQUAL_INT(raxel_thread_pool_size(pool), 4);
+
+    raxel_voxel_world_t *world = raxel_voxel_world_create(&allocator);
+    __voxel_test_terrain_world(world);
+    raxel_bvh_bounds_t *bounds;
+    int n = __voxel_test_gather_voxels(world, (raxel_coord_t[3]){0, 0, 0}, (raxel_coord_t[3]){127, 31, 127}, &bounds, &allocator);
+    RAXEL_TEST_ASSERT_EQUAL_INT(__voxel_test_compare_parallel_build("Terrain, SAH", bounds, n, RAXEL_BVH_BUILD_SAH, pool, &allocator), 0);
+    RAXEL_TEST_ASSERT_EQUAL_INT(__voxel_test_compare_parallel_build("Terrain, median", bounds, n, RAXEL_BVH_BUILD_MEDIAN, pool, &allocator), 0);
+    // too few primitives to split up, built on the calling thread
+    RAXEL_TEST_ASSERT_EQUAL_INT(__voxel_test_compare_parallel_build("Terrain corner", bounds, 1000, RAXEL_BVH_BUILD_SAH, pool, &allocator), 0);
+    RAXEL_TEST_ASSERT_EQUAL_INT(__voxel_test_compare_pool_builds(bounds, n, &allocator), 0);
+    raxel_free(&allocator, bounds);
+    raxel_voxel_world_destroy(world);
+    raxel_thread_pool_destroy(pool);
+
+    // the same world staged with one build thread and with four
+    raxel_voxel_world_t *worlds[2];
+    raxel_sb_buffer_t *buffers[2];
+    raxel_voxel_gpu_mirror_t mirrors[2];
+    raxel_voxel_world_update_options_t options = {0};
+    options.view_distance = 1000.0f;
+    for (int w = 0; w < 2; w++) {
+        worlds[w] = raxel_voxel_world_create(&allocator);
+        worlds[w]->bvh_build_threads = w == 0 ? 1 : 4;
+        __voxel_test_terrain_world(worlds[w]);
+        buffers[w] = __voxel_test_cpu_sb_buffer(&allocator, worlds[w]);
+        raxel_voxel_gpu_mirror_init(&mirrors[w], buffers[w], &allocator);
+        raxel_voxel_world_stage_upload(worlds[w], &options, &mirrors[w]);
+    }
+    RAXEL_TEST_ASSERT(raxel_list_size(worlds[0]->__bvh_instances) > 1);
+    RAXEL_TEST_ASSERT(worlds[0]->__bvh_build_pool == NULL);
+    RAXEL_TEST_ASSERT(worlds[1]->__bvh_build_pool != NULL);
+    RAXEL_TEST_ASSERT_EQUAL_UINT(((__raxel_voxel_world_gpu_t *)buffers[0]->data)->bvh.n_total_nodes,
+                                 ((__raxel_voxel_world_gpu_t *)buffers[1]->data)->bvh.n_total_nodes);
+    RAXEL_TEST_ASSERT(memcmp(buffers[0]->data, buffers[1]->data, buffers[0]->data_size) == 0);
+    for (int w = 0; w < 2; w++) {
+        raxel_voxel_gpu_mirror_release(&mirrors[w]);
+        __voxel_test_destroy_cpu_sb_buffer(buffers[w]);
+        raxel_voxel_world_destroy(worlds[w]);
+    }
+}
+
+/*------------------------------------------------------------
+  Test: Chunk BVHs built as LBVHs find the same voxels.
+------------------------------------------------------------*/
+RAXEL_TEST(test_voxel_world_lbvh) {
+    raxel_allocator_t allocator = raxel_default_allocator();
+    const raxel_bvh_build_method_t methods[] = {RAXEL_BVH_BUILD_LBVH, RAXEL_BVH_BUILD_LBVH_TREELETS};
+    for (int m = 0; m < 2; m++) {
+        raxel_voxel_world_t *world = raxel_voxel_world_create(&allocator);
+        world->bvh_build_method = methods[m];
+        world->chunk_budget = 64;
+        __voxel_test_tree_world(world);
+        raxel_sb_buffer_t *buffer = __voxel_test_cpu_sb_buffer(&allocator, world);
+        raxel_voxel_gpu_mirror_t mirror;
+        raxel_voxel_gpu_mirror_init(&mirror, buffer, &allocator);
+        raxel_voxel_world_update_options_t options = {0};
+        options.view_distance = 1000.0f;
+        raxel_voxel_world_stage_upload(world, &options, &mirror);
+        RAXEL_TEST_ASSERT(raxel_list_size(world->__bvh_instances) > 1);
+        RAXEL_TEST_ASSERT_EQUAL_INT(__voxel_test_bvh_raycast_mismatches(world, 2000), 0);
+
+        raxel_voxel_gpu_mirror_release(&mirror);
+        __voxel_test_destroy_cpu_sb_buffer(buffer);
+        raxel_voxel_world_destroy(world);
+    }
+}
+
+/*------------------------------------------------------------
+  Test: Refitting tracks moved primitives, and edits of a few
+  voxels are patched into the chunk BVHs instead of rebuilding.
+------------------------------------------------------------*/
+
+// Nodes whose bounds are not exactly the union of their primitives or children.
+static int __voxel_test_bvh_loose_nodes(const raxel_bvh_accel_t *bvh, const raxel_bvh_bounds_t *bounds, const int *indices) {
+    int loose = 0;
+    for (int i = 0; i < bvh->n_nodes; i++) {
+        const raxel_linear_bvh_node_t *node = &bvh->nodes[i];
+        raxel_bvh_bounds_t expected = {{1e30f, 1e30f, 1e30f}, {-1e30f, -1e30f, -1e30f}};
+        const raxel_bvh_bounds_t *parts[2] = {&bvh->nodes[i + 1].bounds, &bvh->nodes[node->second_child_offset].bounds};
+        int n_parts = node->n_primitives > 0 ? (int)node->n_primitives : 2;
+        for (int p = 0; p < n_parts; p++) {
+            const raxel_bvh_bounds_t *part = node->n_primitives > 0 ? &bounds[indices[node->primitives_offset + p]] : parts[p];
+            for (int k = 0; k < 3; k++) {
+                expected.min[k] = fminf(expected.min[k], part->min[k]);
+                expected.max[k] = fmaxf(expected.max[k], part->max[k]);
+            }
+        }
+        loose += memcmp(&expected, &node->bounds, sizeof(raxel_bvh_bounds_t)) != 0;
+    }
+    return loose;
+}
+
+RAXEL_TEST(test_voxel_bvh_refit) {
+    raxel_allocator_t allocator = raxel_default_allocator();
+    raxel_voxel_world_t *world = raxel_voxel_world_create(&allocator);
+    raxel_voxel_world_fill_sphere(world, 0, 0, 0, 12, (raxel_voxel_t){1});
+    raxel_bvh_bounds_t *bounds;
+    int n = __voxel_test_gather_voxels(world, (raxel_coord_t[3]){-13, -13, -13}, (raxel_coord_t[3]){13, 13, 13}, &bounds, &allocator);
+    int *indices = raxel_malloc(&allocator, n * sizeof(int));
+    for (int i = 0; i < n; i++) {
+        indices[i] = i;
+    }
+    raxel_bvh_accel_t *bvh = raxel_bvh_accel_build(bounds, indices, n, 4, &allocator);
+    raxel_linear_bvh_node_t *built = raxel_malloc(&allocator, bvh->n_nodes * sizeof(raxel_linear_bvh_node_t));
+    memcpy(built, bvh->nodes, bvh->n_nodes * sizeof(raxel_linear_bvh_node_t));
+
+    // nothing moved, nothing changes
+    raxel_bvh_accel_refit(bvh, bounds, indices);
+    RAXEL_TEST_ASSERT(memcmp(built, bvh->nodes, bvh->n_nodes * sizeof(raxel_linear_bvh_node_t)) == 0);
+
+    // every tenth voxel drifts away; the bounds follow and stay tight
+    for (int i = 0; i < n; i += 10) {
+        glm_vec3_adds(bounds[i].min, 3.5f, bounds[i].min);
+        glm_vec3_adds(bounds[i].max, 3.5f, bounds[i].max);
+    }
+    raxel_bvh_accel_refit(bvh, bounds, indices);
+    RAXEL_TEST_ASSERT_EQUAL_INT(__voxel_test_bvh_loose_nodes(bvh, bounds, indices), 0);
+    RAXEL_TEST_ASSERT(memcmp(built, bvh->nodes, bvh->n_nodes * sizeof(raxel_linear_bvh_node_t)) != 0);
+
+    raxel_free(&allocator, built);
+    raxel_bvh_accel_destroy(bvh, &allocator);
+    raxel_free(&allocator, indices);
+    raxel_free(&allocator, bounds);
+    raxel_voxel_world_destroy(world);
+}
+
+RAXEL_TEST(test_voxel_world_bvh_patch) {
+    raxel_allocator_t allocator = raxel_default_allocator();
+    raxel_voxel_world_t *world = raxel_voxel_world_create(&allocator);
+    world->chunk_budget = 64;
+    __voxel_test_tree_world(world);
+    raxel_sb_buffer_t *buffer = __voxel_test_cpu_sb_buffer(&allocator, world);
+    __raxel_voxel_world_gpu_t *gpu_world = buffer->data;
+    raxel_voxel_gpu_mirror_t mirror;
+    raxel_voxel_gpu_mirror_init(&mirror, buffer, &allocator);
+    raxel_voxel_world_update_options_t options = {0};
+    options.view_distance = 1000.0f;
+    raxel_voxel_world_stage_upload(world, &options, &mirror);
+    raxel_voxel_chunk_handle_t handle = raxel_voxel_world_get_chunk_handle(world, 0, 0, 0);
+    raxel_voxel_chunk_bvh_t *chunk_bvh = &world->__chunk_bvhs[handle];
+    int n_nodes = chunk_bvh->bvh->n_nodes;
+
+    // dig a few voxels out of the sphere and put one next to it, like a player would
+    for (int i = 0; i < 4; i++) {
+        raxel_voxel_world_place_voxel(world, 18 - i, 2, 3, (raxel_voxel_t){0});
+        raxel_voxel_world_place_voxel(world, 24, 2 + i, 3, (raxel_voxel_t){6});
+        raxel_voxel_world_stage_upload(world, &options, &mirror);
+    }
+    chunk_bvh = &world->__chunk_bvhs[handle];
+    RAXEL_TEST_ASSERT_EQUAL_UINT(chunk_bvh->patched_edits, 8);
+    RAXEL_TEST_ASSERT_EQUAL_INT(chunk_bvh->bvh->n_nodes, n_nodes);
+    RAXEL_TEST_ASSERT_EQUAL_INT(__voxel_test_bvh_raycast_mismatches(world, 2000), 0);
+
+    // the leaves still hold every voxel exactly once, and the bounds are tight
+    int n = (int)raxel_list_size(chunk_bvh->voxels);
+    raxel_bvh_bounds_t *bounds = raxel_malloc(&allocator, n * sizeof(raxel_bvh_bounds_t));
+    int *indices = raxel_malloc(&allocator, n * sizeof(int));
+    int leaf_voxels = 0;
+    for (int i = 0; i < n; i++) {
+        int v = chunk_bvh->voxels[i];
+        bounds[i] = (raxel_bvh_bounds_t){{(float)(v % 32), (float)(v / 32 % 32), (float)(v / 1024)}, {v % 32 + 1.0f, v / 32 % 32 + 1.0f, v / 1024 + 1.0f}};
+        indices[i] = i;
+    }
+    for (int i = 0; i < chunk_bvh->bvh->n_nodes; i++) {
+        leaf_voxels += (int)chunk_bvh->bvh->nodes[i].n_primitives;
+    }
+    RAXEL_TEST_ASSERT_EQUAL_INT(leaf_voxels, n);
+    RAXEL_TEST_ASSERT_EQUAL_INT(n, (int)raxel_voxel_chunk_pool_get(world->chunk_pool, handle)->solid_count);
+    RAXEL_TEST_ASSERT_EQUAL_INT(__voxel_test_bvh_loose_nodes(chunk_bvh->bvh, bounds, indices), 0);
+    raxel_free(&allocator, bounds);
+    raxel_free(&allocator, indices);
+
+    // the patched nodes reach the GPU, collapsed again
+    __raxel_voxel_bvh_instance_gpu_t *instances = __raxel_voxel_world_gpu_bvh_instances(gpu_world);
+    raxel_wide_bvh_node_t *nodes = __raxel_voxel_world_gpu_bvh_nodes(gpu_world);
+    int uploaded = 0;
+    for (uint32_t i = 0; i < gpu_world->bvh.n_instances; i++) {
+        if (world->__bvh_instances[i].chunk == handle) {
+            uploaded = instances[i].n_nodes == (uint32_t)chunk_bvh->wide->n_nodes &&
+                       memcmp(&nodes[instances[i].first_node], chunk_bvh->wide->nodes, chunk_bvh->wide->n_nodes * sizeof(raxel_wide_bvh_node_t)) == 0;
+        }
+    }
+    RAXEL_TEST_ASSERT(uploaded);
+
+    // a big edit rebuilds
+    raxel_voxel_world_fill_box(world, 0, 0, 0, 8, 8, 8, (raxel_voxel_t){0});
+    raxel_voxel_world_stage_upload(world, &options, &mirror);
+    chunk_bvh = &world->__chunk_bvhs[handle];
+    RAXEL_TEST_ASSERT_EQUAL_UINT(chunk_bvh->patched_edits, 0);
+    RAXEL_TEST_ASSERT_EQUAL_INT(__voxel_test_bvh_raycast_mismatches(world, 2000), 0);
+
+    raxel_voxel_gpu_mirror_release(&mirror);
+    __voxel_test_destroy_cpu_sb_buffer(buffer);
+    raxel_voxel_world_destroy(world);
+}
+
+/*------------------------------------------------------------
+  Test: A BVH rebuilt in place with a kept scratch is the tree
+  a fresh build gives, and once grown allocates nothing.
+------------------------------------------------------------*/
+
+static void *__voxel_test_counting_alloc(void *ctx, raxel_size_t size) {
+    __atomic_fetch_add((raxel_size_t *)ctx, 1, __ATOMIC_RELAXED);
+    return malloc(size);
+}
+
+static void __voxel_test_counting_free(void *ctx, void *ptr) {
+    free(ptr);
+}
+
+static void *__voxel_test_counting_copy(void *dest, const void *src, raxel_size_t n) {
+    return memcpy(dest, src, n);
+}
+
+RAXEL_TEST(test_voxel_bvh_rebuild_in_place) {
+    raxel_allocator_t allocator = raxel_default_allocator();
+    raxel_size_t allocations = 0;
+    raxel_allocator_t counting = {
+        .ctx = &allocations,
+        .alloc = __voxel_test_counting_alloc,
+        .free = __voxel_test_counting_free,
+        .copy = __voxel_test_counting_copy,
+    };
+    raxel_thread_pool_t *pool = raxel_thread_pool_create(3, &allocator);
+    RAXEL_TEST_ASSERT(pool != NULL);
+    raxel_voxel_world_t *world = raxel_voxel_world_create(&allocator);
+    __voxel_test_terrain_world(world);
+    raxel_bvh_bounds_t *bounds;
+    int n = __voxel_test_gather_voxels(world, (raxel_coord_t[3]){0, 0, 0}, (raxel_coord_t[3]){63, 31, 63}, &bounds, &allocator);
+    raxel_voxel_world_destroy(world);
+    int *indices = raxel_malloc(&allocator, n * sizeof(int));
+    int *fresh_indices = raxel_malloc(&allocator, n * sizeof(int));
+
+    const raxel_bvh_build_method_t methods[] = {RAXEL_BVH_BUILD_SAH, RAXEL_BVH_BUILD_MEDIAN, RAXEL_BVH_BUILD_LBVH, RAXEL_BVH_BUILD_LBVH_TREELETS};
+    for (int m = 0; m < 4; m++) {
+        for (int pooled = 0; pooled < 2; pooled++) {
+            raxel_thread_pool_t *build_pool = pooled ? pool : NULL;
+            raxel_bvh_build_scratch_t scratch;
+            raxel_bvh_build_scratch_init(&scratch, &counting);
+            raxel_bvh_accel_t *bvh = raxel_bvh_accel_create(&counting);
+            // the first build grows everything, a smaller one and the same one again reuse it
+            const int sizes[] = {n, n / 2, n};
+            raxel_size_t grown = 0;
+            for (int r = 0; r < 3; r++) {
+                for (int i = 0; i < n; i++) {
+                    indices[i] = i;
+                }
+                raxel_bvh_accel_rebuild(bvh, bounds, indices, sizes[r], MAX_LEAF_SIZE_BVH, methods[m], build_pool, &scratch);
+                if (r == 0) {
+                    grown = allocations;
+                }
+            }
+            RAXEL_TEST_ASSERT_EQUAL_INT((int)(allocations - grown), 0);
+
+            for (int i = 0; i < n; i++) {
+                fresh_indices[i] = i;
+            }
+            raxel_bvh_accel_t *fresh = raxel_bvh_accel_build_with_method(bounds, fresh_indices, n, MAX_LEAF_SIZE_BVH, methods[m], &allocator);
+            RAXEL_TEST_ASSERT_EQUAL_INT(bvh->n_nodes, fresh->n_nodes);
+            RAXEL_TEST_ASSERT(memcmp(bvh->nodes, fresh->nodes, fresh->n_nodes * sizeof(raxel_linear_bvh_node_t)) == 0);
+            RAXEL_TEST_ASSERT(memcmp(indices, fresh_indices, n * sizeof(int)) == 0);
+            raxel_bvh_accel_destroy(fresh, &allocator);
+            raxel_bvh_accel_destroy(bvh, &counting);
+            raxel_bvh_build_scratch_release(&scratch);
+        }
+    }
+    raxel_free(&allocator, indices);
+    raxel_free(&allocator, fresh_indices);
+    raxel_free(&allocator, bounds);
+    raxel_thread_pool_destroy(pool);
+
+    // the world rebuilds its BVHs in place too
+    world = raxel_voxel_world_create(&allocator);
+    world->chunk_budget = 64;
+    __voxel_test_tree_world(world);
+    raxel_sb_buffer_t *buffer = __voxel_test_cpu_sb_buffer(&allocator, world);
+    raxel_voxel_gpu_mirror_t mirror;
+    raxel_voxel_gpu_mirror_init(&mirror, buffer, &allocator);
+    raxel_voxel_world_update_options_t options = {0};
+    options.view_distance = 1000.0f;
+    raxel_voxel_world_stage_upload(world, &options, &mirror);
+    raxel_voxel_chunk_handle_t handle = raxel_voxel_world_get_chunk_handle(world, 0, 0, 0);
+    raxel_bvh_accel_t *top = world->__bvh;
+    raxel_bvh_accel_t *chunk = world->__chunk_bvhs[handle].bvh;
+    raxel_voxel_world_fill_box(world, 0, 0, 0, 8, 8, 8, (raxel_voxel_t){0});
+    raxel_voxel_world_stage_upload(world, &options, &mirror);
+    RAXEL_TEST_ASSERT(world->__bvh == top);
+    RAXEL_TEST_ASSERT(world->__chunk_bvhs[handle].bvh == chunk);
+    RAXEL_TEST_ASSERT_EQUAL_UINT(world->__chunk_bvhs[handle].patched_edits, 0);
+    RAXEL_TEST_ASSERT_EQUAL_INT(__voxel_test_bvh_raycast_mismatches(world, 2000), 0);
+    raxel_voxel_gpu_mirror_release(&mirror);
+    __voxel_test_destroy_cpu_sb_buffer(buffer);
+    raxel_voxel_world_destroy(world);
+}
+
+/*------------------------------------------------------------
+  Test: Collapsing a BVH into wide quantized nodes keeps every
+  primitive inside its decoded boxes, and a traversal testing
+  all children of a node at once finds the same closest hits.
+------------------------------------------------------------*/
+
+// Checks the wide subtree at index: every child box decodes inside the boxes above it, every
+// primitive sits in its leaf's box and is seen once. Returns the number of errors.
+static int __voxel_test_wide_bvh_check(const raxel_wide_bvh_t *wide, int index, const raxel_bvh_bounds_t *bounds,
+                                       const int *indices, int *seen, const raxel_bvh_bounds_t *inside) {
+    const raxel_wide_bvh_node_t *node = &wide->nodes[index];
+    int errors = node->n_children < 1 || node->n_children > wide->width;
+    for (int c = 0; c < node->n_children; c++) {
+        raxel_bvh_bounds_t box;
+        raxel_wide_bvh_child_bounds(node, c, &box);
+        // the primitives below must lie in every box on the way down, so only the overlap counts
+        for (int k = 0; k < 3; k++) {
+            box.min[k] = fmaxf(box.min[k], inside->min[k]);
+            box.max[k] = fminf(box.max[k], inside->max[k]);
+        }
+        if (!(node->children[c] & RAXEL_WIDE_BVH_LEAF)) {
+            errors += (int)node->children[c] <= index;
+            errors += __voxel_test_wide_bvh_check(wide, (int)node->children[c], bounds, indices, seen, &box);
+            continue;
+        }
+        uint32_t first = node->children[c] & ~RAXEL_WIDE_BVH_LEAF;
+        for (uint32_t p = first; p < first + node->n_primitives[c]; p++) {
+            const raxel_bvh_bounds_t *b = &bounds[indices[p]];
+            errors += seen[indices[p]]++ != 0;
+            for (int k = 0; k < 3; k++) {
+                errors += b->min[k] < box.min[k] || b->max[k] > box.max[k];
+            }
+        }
+    }
+    return errors;
+}
+
+// Closest hit through a wide BVH, the way voxel.comp walks it: all children of a node are tested,
+// leaves right away, and the hit interior children are pushed far to near.
+static float __voxel_test_wide_bvh_closest(const raxel_wide_bvh_t *wide, const raxel_bvh_bounds_t *bounds, const int *indices,
+                                           const float o[3], const float d[3], int *node_visits) {
+    float inv_d[3] = {1.0f / d[0], 1.0f / d[1], 1.0f / d[2]};
+    float best = 1e30f;
+    int stack[64];
+    float stack_t[64];
+    int sp = 0;
+    stack[sp] = 0;
+    stack_t[sp++] = 0.0f;
+    while (sp > 0) {
+        sp--;
+        if (stack_t[sp] > best) {
+            continue;
+        }
+        const raxel_wide_bvh_node_t *node = &wide->nodes[stack[sp]];
+        (*node_visits)++;
+        int hit_nodes[RAXEL_WIDE_BVH_MAX_WIDTH];
+        float hit_t[RAXEL_WIDE_BVH_MAX_WIDTH];
+        int n_hit = 0;
+        for (int c = 0; c < node->n_children; c++) {
+            raxel_bvh_bounds_t box;
+            float t;
+            raxel_wide_bvh_child_bounds(node, c, &box);
+            if (!__voxel_test_slab(&box, o, inv_d, best, &t)) {
+                continue;
+            }
+            if (node->children[c] & RAXEL_WIDE_BVH_LEAF) {
+                uint32_t first = node->children[c] & ~RAXEL_WIDE_BVH_LEAF;
+                for (uint32_t p = first; p < first + node->n_primitives[c]; p++) {
+                    if (__voxel_test_slab(&bounds[indices[p]], o, inv_d, best, &t)) {
+                        best = t;
+                    }
+                }
+                continue;
+            }
+            // insertion sort, farthest first
+            int j = n_hit++;
+            while (j > 0 && hit_t[j - 1] < t) {
+                hit_nodes[j] = hit_nodes[j - 1];
+                hit_t[j] = hit_t[j - 1];
+                j--;
+            }
+            hit_nodes[j] = (int)node->children[c];
+            hit_t[j] = t;
+        }
+        for (int j = 0; j < n_hit; j++) {
+            stack[sp] = hit_nodes[j];
+            stack_t[sp++] = hit_t[j];
+        }
+    }
+    return best;
+}
+
+static void __voxel_test_wide_bvh(const char *name, raxel_bvh_bounds_t *bounds, int n, raxel_allocator_t *allocator) {
+    int *indices = raxel_malloc(allocator, n * sizeof(int));
+    for (int i = 0; i < n; i++) {
+        indices[i] = i;
+    }
+    raxel_bvh_accel_t *bvh = raxel_bvh_accel_build_with_method(bounds, indices, n, MAX_LEAF_SIZE_BVH, RAXEL_BVH_BUILD_SAH, allocator);
+    raxel_wide_bvh_t *wide = raxel_wide_bvh_create(allocator);
+    int *seen = raxel_malloc(allocator, n * sizeof(int));
+    const raxel_bvh_bounds_t *root = &bvh->nodes[0].bounds;
+    vec3 center, extent;
+    glm_vec3_add((float *)root->min, (float *)root->max, center);
+    glm_vec3_scale(center, 0.5f, center);
+    glm_vec3_sub((float *)root->max, (float *)root->min, extent);
+    float radius = glm_vec3_norm(extent);
+    const raxel_bvh_bounds_t everywhere = {{-1e30f, -1e30f, -1e30f}, {1e30f, 1e30f, 1e30f}};
+
+    int binary_visits = 0, binary_prims = 0;
+    int prev_nodes = bvh->n_nodes;
+    const int widths[] = {2, 4, 8};
+    for (int w = 0; w < 3; w++) {
+        raxel_wide_bvh_collapse(wide, bvh, widths[w]);
+        RAXEL_TEST_ASSERT_EQUAL_INT(wide->width, widths[w]);
+        RAXEL_TEST_ASSERT_EQUAL_INT((int)raxel_list_size(wide->nodes), wide->n_nodes);
+        RAXEL_TEST_ASSERT(wide->n_nodes < prev_nodes);
+        prev_nodes = wide->n_nodes;
+        memset(seen, 0, n * sizeof(int));
+        RAXEL_TEST_ASSERT_EQUAL_INT(__voxel_test_wide_bvh_check(wide, 0, bounds, indices, seen, &everywhere), 0);
+        int unseen = 0;
+        for (int i = 0; i < n; i++) {
+            unseen += seen[i] != 1;
+        }
+        RAXEL_TEST_ASSERT_EQUAL_INT(unseen, 0);
+
+        // the same closest hits as testing every primitive, for a fixed set of rays into the scene
+        const int n_rays = 1024;
+        uint32_t seed = 12345;
+        int wide_visits = 0, mismatches = 0;
+        for (int r = 0; r < n_rays; r++) {
+            float u[5];
+            for (int k = 0; k < 5; k++) {
+                seed = seed * 1664525u + 1013904223u;
+                u[k] = (float)(seed >> 8) / (float)(1u << 24);
+            }
+            float z = 2.0f * u[0] - 1.0f;
+            float phi = 6.2831853f * u[1];
+            float s = sqrtf(1.0f - z * z);
+            float o[3] = {center[0] + radius * s * cosf(phi), center[1] + radius * z, center[2] + radius * s * sinf(phi)};
+            float d[3], inv_d[3];
+            for (int k = 0; k < 3; k++) {
+                d[k] = center[k] + (u[2 + k] - 0.5f) * extent[k] * 0.5f - o[k];
+                inv_d[k] = 1.0f / d[k];
+            }
+            float expected = 1e30f, t;
+            for (int i = 0; i < n; i++) {
+                if (__voxel_test_slab(&bounds[i], o, inv_d, expected, &t)) {
+                    expected = t;
+                }
+            }
+            mismatches += __voxel_test_wide_bvh_closest(wide, bounds, indices, o, d, &wide_visits) != expected;
+            if (w == 0) {
+                __voxel_test_bvh_closest(bvh, bounds, indices, o, d, &binary_visits, &binary_prims);
+            }
+        }
+        RAXEL_TEST_ASSERT_EQUAL_INT(mismatches, 0);
+        RAXEL_TEST_LOG("%s, %d voxels, %d wide: %d nodes (binary %d), per ray %.1f nodes (binary %.1f), %.0f node bytes (binary %.0f)\n",
+                       name, n, widths[w], wide->n_nodes, bvh->n_nodes, (double)wide_visits / n_rays, (double)binary_visits / n_rays,
+                       (double)wide_visits / n_rays * sizeof(raxel_wide_bvh_node_t),
+                       (double)binary_visits / n_rays * sizeof(raxel_linear_bvh_node_t));
+    }
+
+    // a lone leaf still gets a root to hang from
+    raxel_bvh_accel_t *single = raxel_bvh_accel_build_with_method(bounds, indices, 1, MAX_LEAF_SIZE_BVH, RAXEL_BVH_BUILD_SAH, allocator);
+    raxel_wide_bvh_collapse(wide, single, 8);
+    RAXEL_TEST_ASSERT_EQUAL_INT(wide->n_nodes, 1);
+    RAXEL_TEST_ASSERT_EQUAL_UINT(wide->nodes[0].children[0], RAXEL_WIDE_BVH_LEAF | 0u);
+    raxel_bvh_accel_destroy(single, allocator);
+
+    raxel_free(allocator, seen);
+    raxel_wide_bvh_destroy(wide, allocator);
+    raxel_bvh_accel_destroy(bvh, allocator);
+    raxel_free(allocator, indices);
+}
+
+RAXEL_TEST(test_voxel_wide_bvh) {
+    raxel_allocator_t allocator = raxel_default_allocator();
+    raxel_bvh_bounds_t *bounds;
+    RAXEL_TEST_ASSERT_EQUAL_INT((int)RAXEL_WIDE_BVH_NODE_WORDS, 28);  // voxel.comp reads nodes this size
+
+    raxel_voxel_world_t *world = raxel_voxel_world_create(&allocator);
+    raxel_voxel_world_fill_sphere(world, 0, 0, 0, 20, (raxel_voxel_t){255});
+    int n = __voxel_test_gather_voxels(world, (raxel_coord_t[3]){-21, -21, -21}, (raxel_coord_t[3]){21, 21, 21}, &bounds, &allocator);
+    __voxel_test_wide_bvh("Sphere", bounds, n, &allocator);
+    raxel_free(&allocator, bounds);
+    raxel_voxel_world_destroy(world);
+
+    world = raxel_voxel_world_create(&allocator);
+    __voxel_test_terrain_world(world);
+    n = __voxel_test_gather_voxels(world, (raxel_coord_t[3]){0, 0, 0}, (raxel_coord_t[3]){127, 31, 127}, &bounds, &allocator);
+    __voxel_test_wide_bvh("Terrain", bounds, n, &allocator);
+    raxel_free(&allocator, bounds);
+    raxel_voxel_world_destroy(world);
+}
+
+/*------------------------------------------------------------
+  Test: Ray packets find the hits single rays find, in a BVH
+  over boxes and down both levels of the world BVH.
+------------------------------------------------------------*/
+
+// Rays of a packet start at one point on a sphere around center and fan out towards a small
+// patch near it, like a screen tile of a camera.
+static void __voxel_test_ray_packet(raxel_bvh_ray_packet_t *packet, int n_rays, const float center[3], float radius, float spread, uint32_t *seed) {
+    float u[5];
+    for (int k = 0; k < 5; k++) {
+        *seed = *seed * 1664525u + 1013904223u;
+        u[k] = (float)(*seed >> 8) / (float)(1u << 24);
+    }
+    float z = 2.0f * u[0] - 1.0f;
+    float phi = 6.2831853f * u[1];
+    float s = sqrtf(1.0f - z * z);
+    float origin[3] = {center[0] + radius * s * cosf(phi), center[1] + radius * z, center[2] + radius * s * sinf(phi)};
+    float target[3] = {center[0] + (u[2] - 0.5f) * radius, center[1] + (u[3] - 0.5f) * radius * 0.5f, center[2] + (u[4] - 0.5f) * radius};
+    packet->n_rays = n_rays;
+    for (int i = 0; i < n_rays; i++) {
+        float offset[3] = {(float)(i % 4) - 1.5f, (float)(i / 4) - 1.5f, 0.0f};
+        float dir[3];
+        for (int k = 0; k < 3; k++) {
+            dir[k] = target[k] + offset[k] * spread - origin[k];
+        }
+        glm_vec3_normalize(dir);
+        for (int k = 0; k < 3; k++) {
+            packet->origin[k][i] = origin[k];
+            packet->direction[k][i] = dir[k];
+        }
+        packet->max_t[i] = 4.0f * radius;
+    }
+}
+
+RAXEL_TEST(test_voxel_bvh_packet_raycast) {
+    raxel_allocator_t allocator = raxel_default_allocator();
+    raxel_voxel_world_t *world = raxel_voxel_world_create(&allocator);
+    __voxel_test_terrain_world(world);
+    raxel_bvh_bounds_t *bounds;
+    int n = __voxel_test_gather_voxels(world, (raxel_coord_t[3]){0, 0, 0}, (raxel_coord_t[3]){63, 31, 63}, &bounds, &allocator);
+    raxel_voxel_world_destroy(world);
+    int *indices = raxel_malloc(&allocator, n * sizeof(int));
+    for (int i = 0; i < n; i++) {
+        indices[i] = i;
+    }
+    raxel_bvh_accel_t *bvh = raxel_bvh_accel_build_with_method(bounds, indices, n, MAX_LEAF_SIZE_BVH, RAXEL_BVH_BUILD_SAH, &allocator);
+    const float center[3] = {32.0f, 16.0f, 32.0f};
+    const float radius = 80.0f;
+
+    // single rays against every box
+    uint32_t seed = 99;
+    int single_mismatches = 0, hits = 0;
+    raxel_bvh_ray_packet_t packet;
+    for (int r = 0; r < 256; r++) {
+        __voxel_test_ray_packet(&packet, 1, center, radius, 0.0f, &seed);
+        float origin[3] = {packet.origin[0][0], packet.origin[1][0], packet.origin[2][0]};
+        float dir[3] = {packet.direction[0][0], packet.direction[1][0], packet.direction[2][0]};
+        float inv_dir[3] = {1.0f / dir[0], 1.0f / dir[1], 1.0f / dir[2]};
+        float expected = packet.max_t[0], t;
+        for (int i = 0; i < n; i++) {
+            if (__voxel_test_slab(&bounds[i], origin, inv_dir, expected, &t)) {
+                expected = t;
+            }
+        }
+        raxel_bvh_hit_t hit;
+        int got = raxel_bvh_accel_intersect(bvh, bounds, indices, origin, dir, packet.max_t[0], &hit);
+        single_mismatches += got != (expected < packet.max_t[0]) || (got && hit.t != expected);
+        if (got) {
+            single_mismatches += !__voxel_test_slab(&bounds[hit.primitive], origin, inv_dir, packet.max_t[0], &t) || t != hit.t;
+        }
+        hits += got;
+    }
+    RAXEL_TEST_ASSERT_EQUAL_INT(single_mismatches, 0);
+    RAXEL_TEST_ASSERT(hits > 64);
+
+    // packets of every size against single rays, and how fast each goes
+    const int n_packets = 4096;
+    raxel_bvh_ray_packet_t *packets = raxel_malloc(&allocator, n_packets * sizeof(raxel_bvh_ray_packet_t));
+    raxel_bvh_hit_t *expected = raxel_malloc(&allocator, n_packets * RAXEL_BVH_PACKET_MAX_RAYS * sizeof(raxel_bvh_hit_t));
+    raxel_bvh_hit_t *got = raxel_malloc(&allocator, n_packets * RAXEL_BVH_PACKET_MAX_RAYS * sizeof(raxel_bvh_hit_t));
+    uint32_t *expected_masks = raxel_malloc(&allocator, n_packets * sizeof(uint32_t));
+    uint32_t *got_masks = raxel_malloc(&allocator, n_packets * sizeof(uint32_t));
+    const int sizes[] = {1, 4, 5, 8, 16};
+    for (int s = 0; s < 5; s++) {
+        seed = 1234;
+        for (int r = 0; r < n_packets; r++) {
+            __voxel_test_ray_packet(&packets[r], sizes[s], center, radius, 0.4f, &seed);
+        }
+        double start = __voxel_test_wall_ms();
+        for (int r = 0; r < n_packets; r++) {
+            expected_masks[r] = 0;
+            for (int i = 0; i < sizes[s]; i++) {
+                float origin[3] = {packets[r].origin[0][i], packets[r].origin[1][i], packets[r].origin[2][i]};
+                float dir[3] = {packets[r].direction[0][i], packets[r].direction[1][i], packets[r].direction[2][i]};
+                raxel_bvh_hit_t *hit = &expected[r * RAXEL_BVH_PACKET_MAX_RAYS + i];
+                expected_masks[r] |= (uint32_t)raxel_bvh_accel_intersect(bvh, bounds, indices, origin, dir, packets[r].max_t[i], hit) << i;
+            }
+        }
+        double single_ms = __voxel_test_wall_ms() - start;
+        start = __voxel_test_wall_ms();
+        for (int r = 0; r < n_packets; r++) {
+            got_masks[r] = raxel_bvh_accel_intersect_packet(bvh, bounds, indices, &packets[r], &got[r * RAXEL_BVH_PACKET_MAX_RAYS]);
+        }
+        double packet_ms = __voxel_test_wall_ms() - start;
+        int mismatches = 0;
+        for (int r = 0; r < n_packets; r++) {
+            mismatches += got_masks[r] != expected_masks[r];
+            for (int i = 0; i < sizes[s]; i++) {
+                // boxes touching at the entry point are a tie either may win, the distance is the same
+                int k = r * RAXEL_BVH_PACKET_MAX_RAYS + i;
+                mismatches += (got_masks[r] >> i & 1u) && got[k].t != expected[k].t;
+            }
+        }
+        RAXEL_TEST_ASSERT_EQUAL_INT(mismatches, 0);
+        double n_rays = (double)n_packets * sizes[s];
+        RAXEL_TEST_LOG("%d voxels, packets of %d: %.0f rays/s single, %.0f rays/s in packets\n",
+                       n, sizes[s], n_rays / single_ms * 1000.0, n_rays / packet_ms * 1000.0);
+    }
+    raxel_free(&allocator, packets);
+    raxel_free(&allocator, expected);
+    raxel_free(&allocator, got);
+    raxel_free(&allocator, expected_masks);
+    raxel_free(&allocator, got_masks);
+    raxel_bvh_accel_destroy(bvh, &allocator);
+    raxel_free(&allocator, indices);
+    raxel_free(&allocator, bounds);
+
+    // the world's packets agree with its single rays, voxel, distance and material
+    world = raxel_voxel_world_create(&allocator);
+    world->chunk_budget = 64;
+    __voxel_test_tree_world(world);
+    raxel_sb_buffer_t *buffer = __voxel_test_cpu_sb_buffer(&allocator, world);
+    raxel_voxel_gpu_mirror_t mirror;
+    raxel_voxel_gpu_mirror_init(&mirror, buffer, &allocator);
+    raxel_voxel_world_update_options_t options = {0};
+    options.view_distance = 1000.0f;
+    raxel_voxel_world_stage_upload(world, &options, &mirror);
+    int mismatches = 0, world_hits = 0;
+    seed = 4321;
+    for (int r = 0; r < 512; r++) {
+        __voxel_test_ray_packet(&packet, 16, (float[3]){10.0f, 10.0f, 10.0f}, 60.0f, 1.5f, &seed);
+        raxel_voxel_bvh_hit_t got[RAXEL_BVH_PACKET_MAX_RAYS];
+        uint32_t got_mask = raxel_voxel_world_bvh_raycast_packet(world, &packet, got);
+        for (int i = 0; i < 16; i++) {
+            float origin[3] = {packet.origin[0][i], packet.origin[1][i], packet.origin[2][i]};
+            float dir[3] = {packet.direction[0][i], packet.direction[1][i], packet.direction[2][i]};
+            raxel_voxel_bvh_hit_t expected;
+            int expected_hit = raxel_voxel_world_bvh_raycast(world, origin, dir, packet.max_t[i], &expected);
+            world_hits += expected_hit;
+            if (expected_hit != (int)(got_mask >> i & 1u)) {
+                mismatches++;
+            } else if (expected_hit) {
+                mismatches += got[i].t != expected.t || got[i].material == 0;
+            }
+        }
+    }
+    RAXEL_TEST_ASSERT_EQUAL_INT(mismatches, 0);
+    RAXEL_TEST_ASSERT(world_hits > 512);
+    raxel_voxel_gpu_mirror_release(&mirror);
+    __voxel_test_destroy_cpu_sb_buffer(buffer);
+    raxel_voxel_world_destroy(world);
+}
+
+/*------------------------------------------------------------
+  Test: Same-material voxels merge into boxes that cover every
+  solid voxel once, and the world BVH is built over far fewer
+  of them than there are voxels.
+------------------------------------------------------------*/
+
+// Voxels the boxes get wrong: solid ones not covered exactly once by a box of their material,
+// and empty ones covered at all.
+static int __voxel_test_box_cover_errors(const raxel_voxel_chunk_t *chunk, const raxel_voxel_chunk_box_t *boxes, raxel_size_t num_boxes) {
+    uint8_t *covered = calloc(RAXEL_VOXEL_CHUNK_VOLUME, 1);
+    int errors = 0;
+    for (raxel_size_t b = 0; b < num_boxes; b++) {
+        for (int z = boxes[b].min[2]; z < boxes[b].max[2]; z++) {
+            for (int y = boxes[b].min[1]; y < boxes[b].max[1]; y++) {
+                for (int x = boxes[b].min[0]; x < boxes[b].max[0]; x++) {
+                    raxel_size_t i = (raxel_size_t)x + (raxel_size_t)y * 32 + (raxel_size_t)z * 1024;
+                    errors += raxel_voxel_chunk_get(chunk, i).material != boxes[b].material;
+                    covered[i]++;
+                }
+            }
+        }
+    }
+    for (raxel_size_t i = 0; i < RAXEL_VOXEL_CHUNK_VOLUME; i++) {
+        errors += covered[i] != (uint8_t)raxel_voxel_chunk_is_solid(chunk, i);
+    }
+    free(covered);
+    return errors;
+}
+
+// Merges every chunk of a world; returns the number of boxes and counts the voxels and errors.
+static raxel_size_t __voxel_test_merge_world(raxel_voxel_world_t *world, raxel_size_t *num_voxels, int *errors) {
+    raxel_voxel_t *scratch = malloc(RAXEL_VOXEL_CHUNK_VOLUME * sizeof(raxel_voxel_t));
+    raxel_voxel_chunk_box_t *boxes = malloc(RAXEL_VOXEL_CHUNK_VOLUME * sizeof(raxel_voxel_chunk_box_t));
+    raxel_size_t num_boxes = 0;
+    *num_voxels = 0;
+    *errors = 0;
+    for (raxel_size_t i = 0; i < raxel_list_size(world->chunks); i++) {
+        const raxel_voxel_chunk_t *chunk = raxel_voxel_chunk_pool_get(world->chunk_pool, world->chunks[i]);
+        raxel_size_t n = raxel_voxel_chunk_merge_boxes(chunk, scratch, boxes);
+        *errors += __voxel_test_box_cover_errors(chunk, boxes, n);
+        *num_voxels += chunk->solid_count;
+        num_boxes += n;
+    }
+    free(scratch);
+    free(boxes);
+    return num_boxes;
+}
+
+RAXEL_TEST(test_voxel_chunk_merge_boxes) {
+    raxel_allocator_t allocator = raxel_default_allocator();
+    raxel_voxel_t *scratch = malloc(RAXEL_VOXEL_CHUNK_VOLUME * sizeof(raxel_voxel_t));
+    raxel_voxel_chunk_box_t *boxes = malloc(RAXEL_VOXEL_CHUNK_VOLUME * sizeof(raxel_voxel_chunk_box_t));
+    raxel_voxel_chunk_t chunk;
+    raxel_voxel_chunk_init(&chunk, &allocator);
+    RAXEL_TEST_ASSERT_EQUAL_UINT((unsigned)raxel_voxel_chunk_merge_boxes(&chunk, scratch, boxes), 0);
+    raxel_voxel_chunk_fill(&chunk, (raxel_voxel_t){7});
+    RAXEL_TEST_ASSERT_EQUAL_UINT((unsigned)raxel_voxel_chunk_merge_boxes(&chunk, scratch, boxes), 1);
+    RAXEL_TEST_ASSERT_EQUAL_UINT(boxes[0].max[1], 32);
+    RAXEL_TEST_ASSERT_EQUAL_UINT(boxes[0].material, 7);
+
+    // a solid chunk with a hole and a block of another material
+    for (raxel_size_t i = 0; i < RAXEL_VOXEL_CHUNK_VOLUME; i++) {
+        int x = (int)(i % 32), y = (int)(i / 32 % 32), z = (int)(i / 1024);
+        if (x >= 4 && x < 12 && y >= 4 && y < 12 && z >= 4 && z < 12) {
+            raxel_voxel_chunk_set(&chunk, i, (raxel_voxel_t){3});
+        } else if (x == 20 && y == 20 && z == 20) {
+            raxel_voxel_chunk_set(&chunk, i, (raxel_voxel_t){0});
+        }
+    }
+    raxel_size_t n = raxel_voxel_chunk_merge_boxes(&chunk, scratch, boxes);
+    RAXEL_TEST_ASSERT_EQUAL_INT(__voxel_test_box_cover_errors(&chunk, boxes, n), 0);
+    RAXEL_TEST_ASSERT(n < 16);
+
+    // random materials and spans, the worst case for merging
+    uint32_t seed = 31337;
+    for (int i = 0; i < 5000; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        raxel_size_t index = (seed >> 8) % RAXEL_VOXEL_CHUNK_VOLUME;
+        raxel_size_t count = (seed >> 20) % 300;
+        if (index + count > RAXEL_VOXEL_CHUNK_VOLUME) count = RAXEL_VOXEL_CHUNK_VOLUME - index;
+        raxel_voxel_chunk_fill_span(&chunk, index, count, (raxel_voxel_t){(seed >> 4) % 3});
+    }
+    n = raxel_voxel_chunk_merge_boxes(&chunk, scratch, boxes);
+    RAXEL_TEST_ASSERT_EQUAL_INT(__voxel_test_box_cover_errors(&chunk, boxes, n), 0);
+    RAXEL_TEST_ASSERT(n <= chunk.solid_count);
+    raxel_voxel_chunk_release(&chunk);
+    free(scratch);
+    free(boxes);
+
+    // the demo sphere and the terrain, and the world BVH over their boxes
+    for (int scene = 0; scene < 2; scene++) {
+        raxel_voxel_world_t *world = raxel_voxel_world_create(&allocator);
+        if (scene == 0) {
+            raxel_voxel_world_fill_sphere(world, 0, 0, 0, 20, (raxel_voxel_t){255});
+        } else {
+            __voxel_test_terrain_world(world);
+        }
+        raxel_size_t num_voxels;
+        int errors;
+        raxel_size_t num_boxes = __voxel_test_merge_world(world, &num_voxels, &errors);
+        RAXEL_TEST_ASSERT_EQUAL_INT(errors, 0);
+        RAXEL_TEST_ASSERT(num_boxes * 10 < num_voxels);
+
+        raxel_sb_buffer_t *buffer = __voxel_test_cpu_sb_buffer(&allocator, world);
+        raxel_voxel_gpu_mirror_t mirror;
+        raxel_voxel_gpu_mirror_init(&mirror, buffer, &allocator);
+        raxel_voxel_world_update_options_t options = {0};
+        options.view_distance = 1000.0f;
+        raxel_voxel_world_stage_upload(world, &options, &mirror);
+        double start = __voxel_test_wall_ms();
+        raxel_bvh_accel_t *bvh = raxel_bvh_accel_build_from_voxel_world(world, MAX_LEAF_SIZE_BVH, &allocator);
+        double ms = __voxel_test_wall_ms() - start;
+        RAXEL_TEST_ASSERT(bvh != NULL);
+        int leaf_prims = 0;
+        for (int i = 0; i < bvh->n_nodes; i++) {
+            leaf_prims += (int)bvh->nodes[i].n_primitives;
+        }
+        RAXEL_TEST_ASSERT_EQUAL_INT(leaf_prims, (int)num_boxes);
+        RAXEL_TEST_LOG("%s: %zu voxels merged into %zu boxes, world BVH of %d nodes in %.1f ms\n",
+                       scene == 0 ? "Sphere" : "Terrain", num_voxels, num_boxes, bvh->n_nodes, ms);
+        raxel_bvh_accel_destroy(bvh, &allocator);
+        raxel_voxel_gpu_mirror_release(&mirror);
+        __voxel_test_destroy_cpu_sb_buffer(buffer);
+        raxel_voxel_world_destroy(world);
+    }
+}
+
+/*------------------------------------------------------------
+  Test: BVH stats agree with the tree, tell SAH from median
+  builds, and count the leaves a node budget forces.
+------------------------------------------------------------*/
+static int __voxel_test_histogram_sum(const int *histogram, int bins) {
+    int sum = 0;
+    for (int b = 0; b < bins; b++) {
+        sum += histogram[b];
+    }
+    return sum;
+}
+
+RAXEL_TEST(test_voxel_bvh_stats) {
+    raxel_allocator_t allocator = raxel_default_allocator();
+    raxel_bvh_bounds_t *bounds;
+    raxel_voxel_world_t *world = raxel_voxel_world_create(&allocator);
+    __voxel_test_terrain_world(world);
+    int n = __voxel_test_gather_voxels(world, (raxel_coord_t[3]){0, 0, 0}, (raxel_coord_t[3]){127, 31, 127}, &bounds, &allocator);
+    int *indices = raxel_malloc(&allocator, n * sizeof(int));
+
+    static const char *method_names[] = {"SAH", "median"};
+    const raxel_bvh_build_method_t methods[] = {RAXEL_BVH_BUILD_SAH, RAXEL_BVH_BUILD_MEDIAN};
+    raxel_bvh_stats_t stats[2];
+    raxel_bvh_trace_cost_t costs[2];
+    for (int m = 0; m < 2; m++) {
+        for (int i = 0; i < n; i++) {
+            indices[i] = i;
+        }
+        raxel_bvh_accel_t *bvh = raxel_bvh_accel_build_with_method(bounds, indices, n, MAX_LEAF_SIZE_BVH, methods[m], &allocator);
+        raxel_bvh_accel_stats(bvh, 0, &stats[m]);
+        RAXEL_TEST_ASSERT_EQUAL_INT(stats[m].n_nodes, bvh->n_nodes);
+        RAXEL_TEST_ASSERT_EQUAL_INT(stats[m].n_leaves, (bvh->n_nodes + 1) / 2);
+        RAXEL_TEST_ASSERT_EQUAL_INT(stats[m].n_primitives, n);
+        RAXEL_TEST_ASSERT_EQUAL_INT(__voxel_test_histogram_sum(stats[m].depth_histogram, RAXEL_BVH_STATS_MAX_DEPTH), stats[m].n_leaves);
+        RAXEL_TEST_ASSERT_EQUAL_INT(__voxel_test_histogram_sum(stats[m].leaf_size_histogram, RAXEL_BVH_STATS_LEAF_SIZE_BINS), stats[m].n_leaves);
+        RAXEL_TEST_ASSERT_EQUAL_INT(stats[m].max_depth + 1, __voxel_test_bvh_depth(bvh, 0));
+        RAXEL_TEST_ASSERT_EQUAL_INT(stats[m].n_forced_leaves, 0);
+        RAXEL_TEST_ASSERT(stats[m].overlap_ratio >= 0.0f && stats[m].overlap_ratio < 1.0f);
+        RAXEL_TEST_ASSERT(fabsf(stats[m].sah_cost - (float)__voxel_test_bvh_cost(bvh, bounds, indices).sah) < 1e-3f * stats[m].sah_cost);
+
+        // judged against a smaller leaf size, every leaf over it counts as forced
+        raxel_bvh_stats_t strict;
+        raxel_bvh_accel_stats(bvh, 4, &strict);
+        RAXEL_TEST_ASSERT_EQUAL_INT(strict.n_forced_leaves, stats[m].n_leaves - __voxel_test_histogram_sum(strict.leaf_size_histogram, 3));
+
+        // the same rays every time, and the node visits agree with a reference traversal
+        raxel_bvh_trace_cost_t again;
+        raxel_bvh_accel_trace_cost(bvh, bounds, indices, 4096, 12345, &allocator, &costs[m]);
+        raxel_bvh_accel_trace_cost(bvh, bounds, indices, 4096, 12345, &allocator, &again);
+        RAXEL_TEST_ASSERT(memcmp(&costs[m], &again, sizeof(again)) == 0);
+        RAXEL_TEST_ASSERT(costs[m].n_hits > 0);
+        RAXEL_TEST_ASSERT(costs[m].mean_node_visits <= (float)costs[m].p99_node_visits);
+        RAXEL_TEST_ASSERT(costs[m].p99_node_visits <= costs[m].max_node_visits);
+        RAXEL_TEST_LOG("Terrain, %s: SAH cost %.1f, overlap %.3f, depth %d, %zu KiB, per ray %.1f nodes (p99 %d) + %.1f primitives\n",
+                       method_names[m], stats[m].sah_cost, stats[m].overlap_ratio, stats[m].max_depth, stats[m].memory_bytes / 1024,
+                       costs[m].mean_node_visits, costs[m].p99_node_visits, costs[m].mean_primitive_tests);
+        raxel_bvh_accel_destroy(bvh, &allocator);
+    }
+    RAXEL_TEST_ASSERT(stats[0].sah_cost < stats[1].sah_cost);
+    RAXEL_TEST_ASSERT_EQUAL_INT(costs[0].n_hits, costs[1].n_hits);
+    raxel_free(&allocator, indices);
+    raxel_free(&allocator, bounds);
+
+    // the world BVH: both levels together, and a budget too small for it forces bigger leaves
+    raxel_sb_buffer_t *buffer = __voxel_test_cpu_sb_buffer(&allocator, world);
+    raxel_voxel_gpu_mirror_t mirror;
+    raxel_voxel_gpu_mirror_init(&mirror, buffer, &allocator);
+    raxel_voxel_world_update_options_t options = {0};
+    options.view_distance = 1000.0f;
+    raxel_voxel_world_stage_upload(world, &options, &mirror);
+    raxel_bvh_stats_t world_stats;
+    raxel_voxel_world_bvh_stats(world, &world_stats);
+    __voxel_test_bvh_census_t census = __voxel_test_bvh_count(world, MAX_LEAF_SIZE_BVH);
+    RAXEL_TEST_ASSERT_EQUAL_INT(world_stats.n_nodes, census.nodes);
+    RAXEL_TEST_ASSERT_EQUAL_INT(world_stats.n_primitives, n);
+    RAXEL_TEST_ASSERT_EQUAL_INT(world_stats.n_forced_leaves, 0);
+    RAXEL_TEST_ASSERT_EQUAL_INT((int)(world_stats.gpu_bytes / sizeof(raxel_wide_bvh_node_t)), census.wide_nodes);
+
+    world->bvh_node_budget = 64;
+    raxel_voxel_world_place_voxel(world, 0, 31, 0, (raxel_voxel_t){2});
+    raxel_voxel_world_stage_upload(world, &options, &mirror);
+    raxel_voxel_world_bvh_stats(world, &world_stats);
+    census = __voxel_test_bvh_count(world, MAX_LEAF_SIZE_BVH);
+    RAXEL_TEST_ASSERT(world_stats.n_forced_leaves > 0);
+    RAXEL_TEST_ASSERT_EQUAL_INT(world_stats.n_forced_leaves, census.oversized);
+    RAXEL_TEST_ASSERT_EQUAL_INT(world_stats.n_primitives, n + 1);
+    raxel_bvh_stats_print(&world_stats);
+
+    raxel_voxel_gpu_mirror_release(&mirror);
+    __voxel_test_destroy_cpu_sb_buffer(buffer);
+    raxel_voxel_world_destroy(world);
+}
+
+/*------------------------------------------------------------
+  Test: The CPU port of voxel.comp renders the same image on
+  any number of threads, agrees with the CPU raycasts, and
+  writes PPM and PFM files.
+------------------------------------------------------------*/
+
+// The ray main() in voxel.comp casts for a pixel.
+static void __voxel_test_render_ray(const raxel_voxel_render_pc_t *pc, int x, int y, int width, int height, float origin[3], float dir[3]) {
+    mat4 inv_view;
+    glm_mat4_inv((vec4 *)pc->view, inv_view);
+    float tan_fov = tanf(pc->fov * 0.5f);
+    float u = ((float)x / (float)width * 2.0f - 1.0f) * (float)width / (float)height;
+    float v = (float)y / (float)height * 2.0f - 1.0f;
+    vec4 eye = {0.0f, 0.0f, 0.0f, 1.0f}, view_dir = {u * tan_fov, v * tan_fov, -1.0f, 0.0f}, o, d;
+    glm_mat4_mulv(inv_view, eye, o);
+    glm_mat4_mulv(inv_view, view_dir, d);
+    glm_vec3_normalize(d);
+    glm_vec3_copy(o, origin);
+    glm_vec3_copy(d, dir);
+}
+
+static long __voxel_test_file_size(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (!file) return -1;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fclose(file);
+    return size;
+}
+
+RAXEL_TEST(test_voxel_render_reference) {
+    raxel_allocator_t allocator = raxel_default_allocator();
+    raxel_thread_pool_t *pool = raxel_thread_pool_create(3, &allocator);
+    const int width = 160, height = 120;
+    raxel_voxel_render_pc_t pc = {0};
+    glm_lookat((vec3){64.5f, 48.0f, 170.0f}, (vec3){64.0f, 8.0f, 64.0f}, (vec3){0.0f, 1.0f, 0.0f}, pc.view);
+    pc.fov = glm_rad(60.0f);
+    pc.rays_per_pixel = 1;
+    raxel_voxel_image_t serial, image, shaded;
+    raxel_voxel_image_init(&serial, width, height, &allocator);
+    raxel_voxel_image_init(&image, width, height, &allocator);
+    raxel_voxel_image_init(&shaded, width, height, &allocator);
+
+    for (int backend = 0; backend < 2; backend++) {
+        raxel_voxel_world_t *world = raxel_voxel_world_create(&allocator);
+        world->backend = backend == 0 ? RAXEL_VOXEL_BACKEND_BVH : RAXEL_VOXEL_BACKEND_TREE64;
+        __voxel_test_terrain_world(world);
+        raxel_sb_buffer_t *buffer = __voxel_test_cpu_sb_buffer(&allocator, world);
+        raxel_voxel_gpu_mirror_t mirror;
+        raxel_voxel_gpu_mirror_init(&mirror, buffer, &allocator);
+        raxel_voxel_world_update_options_t options = {0};
+        options.view_distance = 1000.0f;
+        raxel_voxel_world_stage_upload(world, &options, &mirror);
+        raxel_sb_buffer_flush(buffer, NULL);
+        const __raxel_voxel_world_gpu_t *gpu_world = buffer->mapped;
+
+        // every debug mode gives the same pixels on one thread and on four
+        for (int mode = 0; mode < 5; mode++) {
+            pc.debug_mode = mode;
+            raxel_voxel_render(gpu_world, &pc, &serial, NULL, NULL);
+            raxel_voxel_render(gpu_world, &pc, &image, pool, NULL);
+            RAXEL_TEST_ASSERT(memcmp(serial.pixels, image.pixels, (size_t)width * height * 4 * sizeof(float)) == 0);
+        }
+
+        // depth against the CPU raycasts: both backends hit the same voxels
+        pc.debug_mode = 2;
+        raxel_voxel_render_stats_t stats;
+        raxel_voxel_render(gpu_world, &pc, &image, pool, &stats);
+        int misses = 0, hits = 0;
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                float origin[3], dir[3];
+                __voxel_test_render_ray(&pc, x, y, width, height, origin, dir);
+                float depth = image.pixels[((size_t)y * width + x) * 4];
+                float t;
+                int hit;
+                if (backend == 0) {
+                    raxel_voxel_bvh_hit_t bvh_hit;
+                    hit = raxel_voxel_world_bvh_raycast(world, origin, dir, 1000.0f, &bvh_hit);
+                    t = bvh_hit.t;
+                } else {
+                    raxel_tree64_hit_t tree_hit;
+                    hit = raxel_tree64_raycast(&world->__tree, origin, dir, 1000.0f, &tree_hit);
+                    t = tree_hit.t;
+                }
+                misses += hit ? fabsf(depth * 1000.0f - t) > 1e-3f : depth != 1.0f;
+                hits += hit;
+            }
+        }
+        RAXEL_TEST_ASSERT_EQUAL_INT(misses, 0);
+        RAXEL_TEST_ASSERT(hits > width * height / 4);
+        RAXEL_TEST_ASSERT(stats.n_rays == (uint64_t)width * height);
+        RAXEL_TEST_ASSERT(stats.n_hits >= (uint64_t)hits);
+        RAXEL_TEST_LOG("%s backend: %dx%d in %.1f ms on %d threads, %.2f Mrays/s\n", backend == 0 ? "BVH" : "64-tree",
+                       width, height, stats.ms, raxel_thread_pool_size(pool), stats.rays_per_second / 1e6);
+
+        // the BVH walks its leaves voxel by voxel, so it shades the faces the 64-tree does
+        pc.debug_mode = 0;
+        raxel_voxel_render(gpu_world, &pc, backend == 0 ? &shaded : &image, pool, NULL);
+        if (backend == 1) {
+            int differing = 0;
+            for (size_t i = 0; i < (size_t)width * height * 4; i++) {
+                differing += fabsf(shaded.pixels[i] - image.pixels[i]) > 1e-4f;
+            }
+            RAXEL_TEST_ASSERT(differing < width * height / 100);  // rays through voxel edges may pick either face
+        }
+
+        raxel_voxel_gpu_mirror_release(&mirror);
+        __voxel_test_destroy_cpu_sb_buffer(buffer);
+        raxel_voxel_world_destroy(world);
+    }
+
+    // the shaded image on disk
+    char directory[] = "/tmp/raxel_render_XXXXXX";
+    RAXEL_TEST_ASSERT(mkdtemp(directory) != NULL);
+    char ppm[64], pfm[64];
+    snprintf(ppm, sizeof(ppm), "%s/frame.ppm", directory);
+    snprintf(pfm, sizeof(pfm), "%s/frame.pfm", directory);
+    RAXEL_TEST_ASSERT_EQUAL_INT(raxel_voxel_image_write_ppm(&image, ppm), 0);
+    RAXEL_TEST_ASSERT_EQUAL_INT(raxel_voxel_image_write_pfm(&image, pfm), 0);
+    RAXEL_TEST_ASSERT(__voxel_test_file_size(ppm) == (long)strlen("P6\n160 120\n255\n") + width * height * 3);
+    RAXEL_TEST_ASSERT(__voxel_test_file_size(pfm) == (long)strlen("PF\n160 120\n-1.0\n") + width * height * 3 * (long)sizeof(float));
+    remove(ppm);
+    remove(pfm);
+    rmdir(directory);
+
+    raxel_voxel_image_release(&serial);
+    raxel_voxel_image_release(&image);
+    raxel_voxel_image_release(&shaded);
+    raxel_thread_pool_destroy(pool);
+}
+
+/*------------------------------------------------------------
+  Test: The chunk DDA the shader runs in BVH leaves finds the
+  nearest solid voxel in a box and the face the ray entered.
+------------------------------------------------------------*/
+RAXEL_TEST(test_voxel_chunk_dda) {
+    raxel_voxel_gpu_chunk_t *chunk = calloc(1, sizeof(raxel_voxel_gpu_chunk_t));
+    uint32_t seed = 4242;
+    for (int i = 0; i < RAXEL_VOXEL_CHUNK_VOLUME; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        chunk->voxels[i].material = (seed >> 24) < 8 ? 1 + (seed >> 8) % 5 : 0;
+    }
+
+    int mismatches = 0, hits = 0;
+    for (int r = 0; r < 20000; r++) {
+        float u[9];
+        for (int k = 0; k < 9; k++) {
+            seed = seed * 1664525u + 1013904223u;
+            u[k] = (float)(seed >> 8) / (float)(1u << 24);
+        }
+        // from anywhere around or inside the chunk, through a random box that need not be voxel aligned
+        float origin[3], dir[3], box_min[3], box_max[3];
+        for (int k = 0; k < 3; k++) {
+            origin[k] = -16.0f + 64.0f * u[k];
+            dir[k] = 8.0f + 16.0f * u[3 + k] - origin[k];
+            float a = -2.0f + 36.0f * u[6 + k];
+            box_min[k] = a < 16.0f ? a : a - 18.0f;
+            box_max[k] = box_min[k] + 4.0f + 0.375f * (float)(r % 40);
+        }
+        if (r % 3 == 0) {
+            dir[r / 3 % 3] = 0.0f;  // in the plane of some face
+        }
+        glm_vec3_normalize(dir);
+        float max_t = r % 5 == 0 ? 20.0f : 1000.0f;
+
+        // every solid voxel the ray crosses inside the box, the one it enters first
+        float inv_dir[3] = {1.0f / dir[0], 1.0f / dir[1], 1.0f / dir[2]};
+        float best = max_t;
+        int expected = -1;
+        for (int i = 0; i < RAXEL_VOXEL_CHUNK_VOLUME; i++) {
+            int v[3] = {i % 32, i / 32 % 32, i / 1024};
+            if (chunk->voxels[i].material == 0) continue;
+            raxel_bvh_bounds_t voxel = {{v[0], v[1], v[2]}, {v[0] + 1.0f, v[1] + 1.0f, v[2] + 1.0f}};
+            raxel_bvh_bounds_t clipped;
+            int overlaps = 1;
+            for (int k = 0; k < 3; k++) {
+                clipped.min[k] = fmaxf(voxel.min[k], box_min[k]);
+                clipped.max[k] = fminf(voxel.max[k], box_max[k]);
+                overlaps &= clipped.min[k] < clipped.max[k];
+            }
+            float t, t_clipped;
+            if (overlaps && __voxel_test_slab(&clipped, origin, inv_dir, max_t, &t_clipped) && __voxel_test_slab(&voxel, origin, inv_dir, 1e30f, &t) &&
+                (t < best || expected < 0)) {
+                best = t;
+                expected = i;
+            }
+        }
+
+        raxel_voxel_dda_hit_t hit;
+        int got = raxel_voxel_gpu_chunk_dda(chunk, origin, dir, box_min, box_max, max_t, &hit);
+        if (got != (expected >= 0)) {
+            mismatches++;
+            continue;
+        }
+        if (!got) continue;
+        hits++;
+        // ties at shared edges may pick either voxel, but never a different distance
+        int index = hit.voxel[0] + hit.voxel[1] * 32 + hit.voxel[2] * 1024;
+        mismatches += fabsf(hit.t - best) > 1e-3f || chunk->voxels[index].material != hit.material || hit.material == 0;
+        // the normal is the face of the voxel the ray entered through, where it crosses at hit.t
+        float length = fabsf(hit.normal[0]) + fabsf(hit.normal[1]) + fabsf(hit.normal[2]);
+        for (int k = 0; k < 3 && hit.t > 0.0f; k++) {
+            if (hit.normal[k] != 0.0f) {
+                float face = (float)hit.voxel[k] + (hit.normal[k] > 0.0f ? 1.0f : 0.0f);
+                mismatches += hit.normal[k] * dir[k] >= 0.0f || fabsf(origin[k] + dir[k] * hit.t - face) > 1e-3f;
+            }
+        }
+        mismatches += hit.t > 0.0f ? length != 1.0f : length != 0.0f;
+    }
+    RAXEL_TEST_ASSERT_EQUAL_INT(mismatches, 0);
+    RAXEL_TEST_ASSERT(hits > 1000);
+    free(chunk);
+}
+
+/*------------------------------------------------------------
+  Test: The CPU world raycast finds the voxel a plain
+  voxel-by-voxel walk finds, with the face it entered through.
+------------------------------------------------------------*/
+RAXEL_TEST(test_voxel_world_raycast) {
+    raxel_allocator_t allocator = raxel_default_allocator();
+    raxel_voxel_world_t *world = raxel_voxel_world_create(&allocator);
+    __voxel_test_tree_world(world);
+    // a chunk that exists but holds nothing, for the walk to skip like a missing one
+    raxel_voxel_world_place_voxel(world, -70, 0, 0, (raxel_voxel_t){1});
+    raxel_voxel_world_place_voxel(world, -70, 0, 0, (raxel_voxel_t){0});
+
+    enum { n_rays = 4000 };
+    float *origins = malloc(sizeof(float) * 3 * n_rays);
+    float *dirs = malloc(sizeof(float) * 3 * n_rays);
+    uint32_t seed = 2024;
+    for (int r = 0; r < n_rays; r++) {
+        float u[6];
+        for (int k = 0; k < 6; k++) {
+            seed = seed * 1664525u + 1013904223u;
+            u[k] = (float)(seed >> 8) / (float)(1u << 24);
+        }
+        float origin[3] = { -120.0f + 240.0f * u[0], -60.0f + 120.0f * u[1], -60.0f + 140.0f * u[2] };
+        float target[3] = { -40.0f + 100.0f * u[3], -35.0f + 70.0f * u[4], -30.0f + 80.0f * u[5] };
+        glm_vec3_sub(target, origin, &dirs[r * 3]);
+        glm_vec3_normalize(&dirs[r * 3]);
+        memcpy(&origins[r * 3], origin, sizeof(origin));
+    }
+
+    int mismatches = 0, hits = 0;
+    double reference_ms = 0.0, raycast_ms = 0.0;
+    for (int r = 0; r < n_rays; r++) {
+        const float *origin = &origins[r * 3], *dir = &dirs[r * 3];
+        raxel_coord_t expected[3];
+        double start = __voxel_test_wall_ms();
+        int expected_hit = __voxel_test_world_raycast(world, origin, dir, 400.0f, expected);
+        reference_ms += __voxel_test_wall_ms() - start;
+        raxel_voxel_raycast_hit_t hit;
+        start = __voxel_test_wall_ms();
+        int got_hit = raxel_voxel_world_raycast(world, origin, dir, 400.0f, &hit);
+        raycast_ms += __voxel_test_wall_ms() - start;
+        if (expected_hit != got_hit) {
+            mismatches++;
+            continue;
+        }
+        if (!got_hit) {
+            mismatches += hit.material != 0;
+            continue;
+        }
+        hits++;
+        // rays through an edge or corner may pick either of the touching voxels, but not another distance
+        float inv_dir[3] = { 1.0f / dir[0], 1.0f / dir[1], 1.0f / dir[2] };
+        raxel_bvh_bounds_t box = { { expected[0], expected[1], expected[2] }, { expected[0] + 1.0f, expected[1] + 1.0f, expected[2] + 1.0f } };
+        float t_expected;
+        __voxel_test_slab(&box, origin, inv_dir, 400.0f, &t_expected);
+        mismatches += fabsf(t_expected - hit.t) > 1e-3f;
+        mismatches += hit.material == 0 || hit.material != raxel_voxel_world_get_voxel(world, hit.voxel[0], hit.voxel[1], hit.voxel[2]).material;
+        // the ray crosses the entered face at t, and the voxel in front of it is empty
+        int face = -1;
+        for (int k = 0; k < 3; k++) {
+            if (hit.normal[k] != 0) {
+                mismatches += face >= 0 || hit.normal[k] * dir[k] >= 0.0f;
+                face = k;
+            }
+        }
+        if (face < 0) {
+            mismatches += hit.t != 0.0f;
+            continue;
+        }
+        float plane = (float)hit.voxel[face] + (hit.normal[face] > 0 ? 1.0f : 0.0f);
+        mismatches += fabsf(origin[face] + dir[face] * hit.t - plane) > 1e-3f;
+        mismatches += raxel_voxel_world_get_voxel(world, hit.voxel[0] + hit.normal[0], hit.voxel[1] + hit.normal[1], hit.voxel[2] + hit.normal[2]).material != 0;
+    }
+    RAXEL_TEST_ASSERT_EQUAL_INT(mismatches, 0);
+    RAXEL_TEST_ASSERT(hits > n_rays / 4);
+    RAXEL_TEST_LOG("%d rays: %.1f ms stepping voxels, %.1f ms skipping empty cells\n", n_rays, reference_ms, raycast_ms);
+
+    // the batch finds what the rays find one by one
+    raxel_voxel_raycast_hit_t *batch = malloc(sizeof(raxel_voxel_raycast_hit_t) * n_rays);
+    RAXEL_TEST_ASSERT_EQUAL_INT((int)raxel_voxel_world_raycast_batch(world, origins, dirs, 400.0f, n_rays, batch), hits);
+    int batch_mismatches = 0;
+    for (int r = 0; r < n_rays; r++) {
+        raxel_voxel_raycast_hit_t hit;
+        raxel_voxel_world_raycast(world, &origins[r * 3], &dirs[r * 3], 400.0f, &hit);
+        batch_mismatches += memcmp(&hit, &batch[r], sizeof(hit)) != 0;
+    }
+    RAXEL_TEST_ASSERT_EQUAL_INT(batch_mismatches, 0);
+
+    // from inside a voxel, along an axis, and short of the first voxel
+    raxel_voxel_raycast_hit_t hit;
+    float inside[3] = { 0.5f, 0.5f, 0.5f }, down[3] = { 0.0f, -1.0f, 0.0f };
+    RAXEL_TEST_ASSERT(raxel_voxel_world_raycast(world, inside, down, 10.0f, &hit));
+    RAXEL_TEST_ASSERT(hit.t == 0.0f && hit.normal[0] == 0 && hit.normal[1] == 0 && hit.normal[2] == 0 && hit.material == 1);
+    float above[3] = { 45.5f, 40.5f, 10.5f };
+    RAXEL_TEST_ASSERT(raxel_voxel_world_raycast(world, above, down, 100.0f, &hit));
+    RAXEL_TEST_ASSERT(hit.voxel[0] == 45 && hit.voxel[1] == 5 && hit.voxel[2] == 10 && hit.normal[1] == 1 && hit.material == 3);
+    RAXEL_TEST_ASSERT(fabsf(hit.t - 34.5f) < 1e-4f);
+    RAXEL_TEST_ASSERT(!raxel_voxel_world_raycast(world, above, down, 34.0f, &hit) && hit.material == 0);
+
+    free(batch);
+    free(origins);
+    free(dirs);
+    raxel_voxel_world_destroy(world);
+}
+
+/*------------------------------------------------------------
+  Benchmark: Fill a 512^3 world (16^3 chunks) voxel by voxel.
+------------------------------------------------------------*/
+RAXEL_TEST(test_voxel_world_fill_benchmark) {
+    raxel_allocator_t allocator = raxel_default_allocator();
+    raxel_voxel_world_t *world = raxel_voxel_world_create(&allocator);
+
+    const int extent = 512;
+    raxel_voxel_t voxel = {.material = 1};
+    clock_t start = clock();
+    for (int z = 0; z < extent; z++) {
+        for (int y = 0; y < extent; y++) {
+            for (int x = 0; x < extent; x++) {
+                raxel_voxel_world_place_voxel(world, x, y, z, voxel);
+            }
+        }
+    }
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    RAXEL_TEST_LOG("Filled %d^3 world (%zu chunks) in %.3f s\n", extent, raxel_list_size(world->chunk_meta), seconds);
+
+    RAXEL_TEST_ASSERT_EQUAL_INT((int)raxel_list_size(world->chunk_meta), (extent / RAXEL_VOXEL_CHUNK_SIZE) *
+                                                                           (extent / RAXEL_VOXEL_CHUNK_SIZE) *
+                                                                           (extent / RAXEL_VOXEL_CHUNK_SIZE));
+    RAXEL_TEST_ASSERT_EQUAL_UINT(raxel_voxel_world_get_voxel(world, extent - 1, extent - 1, extent - 1).material, 1);
+
+    raxel_voxel_world_destroy(world);
+
+    world = raxel_voxel_world_create(&allocator);
+    start = clock();
+    raxel_voxel_world_fill_box(world, 0, 0, 0, extent - 1, extent - 1, extent - 1, voxel);
+    seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    RAXEL_TEST_LOG("Filled %d^3 world with fill_box in %.3f s\n", extent, seconds);
+    raxel_size_t bytes = 0;
+    for (raxel_size_t i = 0; i < raxel_list_size(world->chunks); i++) {
+        bytes += raxel_voxel_chunk_memory_usage(raxel_voxel_chunk_pool_get(world->chunk_pool, world->chunks[i]));
+    }
+    RAXEL_TEST_LOG("Chunk memory: %zu KiB (dense: %zu KiB)\n", bytes / 1024,
+                   raxel_list_size(world->chunks) * RAXEL_VOXEL_CHUNK_VOLUME * sizeof(raxel_voxel_t) / 1024);
+    RAXEL_TEST_ASSERT_EQUAL_UINT(raxel_voxel_world_get_voxel(world, extent - 1, 0, extent - 1).material, 1);
+    raxel_voxel_world_destroy(world);
+}
+
+/*------------------------------------------------------------
+  Registration of all tests.
+------------------------------------------------------------*/
+void register_voxel_tests() {
+    RAXEL_TEST_REGISTER(test_voxel_world_place_get);
+    RAXEL_TEST_REGISTER(test_voxel_chunk_pool);
+    RAXEL_TEST_REGISTER(test_voxel_chunk_palette);
+    RAXEL_TEST_REGISTER(test_voxel_chunk_occupancy);
+    RAXEL_TEST_REGISTER(test_voxel_world_batched_edits);
+    RAXEL_TEST_REGISTER(test_voxel_world_incremental_upload);
+    RAXEL_TEST_REGISTER(test_voxel_world_residency);
+    RAXEL_TEST_REGISTER(test_voxel_world_streaming);
+    RAXEL_TEST_REGISTER(test_voxel_world_regions);
+    RAXEL_TEST_REGISTER(test_voxel_world_region_paging);
+    RAXEL_TEST_REGISTER(test_voxel_tree64);
+    RAXEL_TEST_REGISTER(test_voxel_world_tree64_backend);
+    RAXEL_TEST_REGISTER(test_voxel_bvh_sah_benchmark);
+    RAXEL_TEST_REGISTER(test_voxel_bvh_million_voxels);
+    RAXEL_TEST_REGISTER(test_voxel_world_two_level_bvh);
+    RAXEL_TEST_REGISTER(test_voxel_bvh_parallel_build);
+    RAXEL_TEST_REGISTER(test_voxel_world_lbvh);
+    RAXEL_TEST_REGISTER(test_voxel_bvh_refit);
+    RAXEL_TEST_REGISTER(test_voxel_world_bvh_patch);
+    RAXEL_TEST_REGISTER(test_voxel_bvh_rebuild_in_place);
+    RAXEL_TEST_REGISTER(test_voxel_wide_bvh);
+    RAXEL_TEST_REGISTER(test_voxel_bvh_packet_raycast);
+    RAXEL_TEST_REGISTER(test_voxel_chunk_merge_boxes);
+    RAXEL_TEST_REGISTER(test_voxel_bvh_stats);
+    RAXEL_TEST_REGISTER(test_voxel_render_reference);
+    RAXEL_TEST_REGISTER(test_voxel_chunk_dda);
+    RAXEL_TEST_REGISTER(test_voxel_world_raycast);
+    RAXEL_TEST_REGISTER(test_voxel_world_fill_benchmark);
+}
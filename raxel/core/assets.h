@@ -0,0 +1,7 @@
+#ifndef __ASSETS_H__
+#define __ASSETS_H__
+
+#include "assets/raxel_file.h"
+#include "assets/raxel_region.h"
+
+#endif // __ASSETS_H__
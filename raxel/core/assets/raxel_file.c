@@ -0,0 +1,88 @@
+#include "raxel_file.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+int raxel_file_map(raxel_file_map_t *map, const char *path) {
+    map->data = NULL;
+    map->size = 0;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    if (st.st_size > 0) {
+        void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            return -1;
+        }
+        map->data = data;
+        map->size = (raxel_size_t)st.st_size;
+    }
+    // the mapping keeps the file alive
+    close(fd);
+    return 0;
+}
+
+void raxel_file_unmap(raxel_file_map_t *map) {
+    if (map->data) {
+        munmap((void *)map->data, map->size);
+    }
+    map->data = NULL;
+    map->size = 0;
+}
+
+int raxel_file_write(const char *path, const void *data, raxel_size_t size) {
+    raxel_size_t path_length = strlen(path);
+    char *tmp_path = malloc(path_length + 5);
+    memcpy(tmp_path, path, path_length);
+    memcpy(tmp_path + path_length, ".tmp", 5);
+
+    FILE *file = fopen(tmp_path, "wb");
+    if (!file) {
+        free(tmp_path);
+        return -1;
+    }
+    int ok = fwrite(data, 1, size, file) == size;
+    ok &= fclose(file) == 0;
+    ok = ok && rename(tmp_path, path) == 0;
+    if (!ok) {
+        remove(tmp_path);
+    }
+    free(tmp_path);
+    return ok ? 0 : -1;
+}
+
+int raxel_file_is_directory(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+raxel_list(raxel_string_t) raxel_file_list_directory(const char *path, raxel_allocator_t *allocator) {
+    raxel_list(raxel_string_t) names = raxel_list_create_reserve(raxel_string_t, allocator, 16);
+    DIR *dir = opendir(path);
+    if (!dir) {
+        return names;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+        raxel_string_t name = raxel_string_create(allocator, strlen(entry->d_name) + 1);
+        raxel_string_append(&name, entry->d_name);
+        raxel_list_push_back(names, name);
+    }
+    closedir(dir);
+    return names;
+}
@@ -3,7 +3,35 @@
 
 #include <raxel/core/util.h>
 
+// A read-only mapping of a whole file. Pages are only read from disk when they are touched, so
+// mapping a large file and reading a small part of it is cheap.
+typedef struct raxel_file_map {
+    const void *data;  // NULL for an empty file
+    raxel_size_t size;
+} raxel_file_map_t;
 
+/**
+ * Map a file for reading.
+ *
+ * @return 0 on success, -1 if the file could not be opened or mapped.
+ */
+int raxel_file_map(raxel_file_map_t *map, const char *path);
+void raxel_file_unmap(raxel_file_map_t *map);
 
+/**
+ * Write a whole file. The data goes to a temporary file first, which then replaces path, so
+ * readers never see a half-written file and existing mappings of the old file stay valid.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+int raxel_file_write(const char *path, const void *data, raxel_size_t size);
 
-#endif // __RAXEL_FILE_H__
\ No newline at end of file
+int raxel_file_is_directory(const char *path);
+
+/**
+ * Names of the entries in a directory, skipping hidden ones. Empty if the directory
+ * does not exist. Destroy the strings and the list when done.
+ */
+raxel_list(raxel_string_t) raxel_file_list_directory(const char *path, raxel_allocator_t *allocator);
+
+#endif // __RAXEL_FILE_H__
@@ -0,0 +1,233 @@
+// raxel_region.c
+
+#include "raxel_region.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// =============================================================================
+// 0. File Names
+// =============================================================================
+
+void raxel_region_file_name(char *out, raxel_size_t out_size, raxel_coord_t region_x, raxel_coord_t region_y, raxel_coord_t region_z) {
+    snprintf(out, out_size, "r.%d.%d.%d" RAXEL_REGION_FILE_EXTENSION, region_x, region_y, region_z);
+}
+
+int raxel_region_parse_file_name(const char *name, raxel_coord_t *region_x, raxel_coord_t *region_y, raxel_coord_t *region_z) {
+    int consumed = 0;
+    if (sscanf(name, "r.%d.%d.%d%n", region_x, region_y, region_z, &consumed) != 3) {
+        return 0;
+    }
+    return strcmp(name + consumed, RAXEL_REGION_FILE_EXTENSION) == 0;
+}
+
+// =============================================================================
+// 1. Chunk Blobs
+// =============================================================================
+
+#define __RAXEL_REGION_RUN_BIT 0x80000000u
+
+typedef struct __raxel_region_blob_header {
+    uint32_t bits;
+    uint32_t palette_size;
+} __raxel_region_blob_header_t;
+
+static void __raxel_region_append(raxel_list(uint8_t) *blobs, const void *data, raxel_size_t size) {
+    raxel_size_t needed = raxel_list_size(*blobs) + size;
+    if (needed > raxel_list_capacity(*blobs)) {
+        raxel_size_t capacity = raxel_list_capacity(*blobs) * 2;
+        raxel_list_resize(*blobs, capacity > needed ? capacity : needed);
+    }
+    memcpy(*blobs + raxel_list_size(*blobs), data, size);
+    raxel_list_size(*blobs) = needed;
+}
+
+// Run-length encodes words into blobs. Runs shorter than three words are kept literal.
+static void __raxel_region_encode_words(raxel_list(uint8_t) *blobs, const uint64_t *words, raxel_size_t n) {
+    raxel_size_t i = 0;
+    while (i < n) {
+        raxel_size_t run = 1;
+        while (i + run < n && words[i + run] == words[i] && run < __RAXEL_REGION_RUN_BIT - 1) {
+            run++;
+        }
+        if (run >= 3) {
+            uint32_t count = (uint32_t)run | __RAXEL_REGION_RUN_BIT;
+            __raxel_region_append(blobs, &count, sizeof(count));
+            __raxel_region_append(blobs, &words[i], sizeof(uint64_t));
+            i += run;
+            continue;
+        }
+        // literals until the next run of three
+        raxel_size_t end = i + 1;
+        while (end < n && !(end + 2 < n && words[end] == words[end + 1] && words[end] == words[end + 2])) {
+            end++;
+        }
+        uint32_t count = (uint32_t)(end - i);
+        __raxel_region_append(blobs, &count, sizeof(count));
+        __raxel_region_append(blobs, &words[i], count * sizeof(uint64_t));
+        i = end;
+    }
+}
+
+// Returns 0 when exactly n words were decoded from the size bytes at src.
+static int __raxel_region_decode_words(const uint8_t *src, raxel_size_t size, uint64_t *words, raxel_size_t n) {
+    raxel_size_t pos = 0;
+    raxel_size_t i = 0;
+    while (i < n) {
+        uint32_t count;
+        if (pos + sizeof(count) > size) return -1;
+        memcpy(&count, src + pos, sizeof(count));
+        pos += sizeof(count);
+        raxel_size_t length = count & ~__RAXEL_REGION_RUN_BIT;
+        if (length == 0 || length > n - i) return -1;
+        if (count & __RAXEL_REGION_RUN_BIT) {
+            uint64_t word;
+            if (pos + sizeof(word) > size) return -1;
+            memcpy(&word, src + pos, sizeof(word));
+            pos += sizeof(word);
+            for (raxel_size_t k = 0; k < length; k++) {
+                words[i++] = word;
+            }
+        } else {
+            if (pos + length * sizeof(uint64_t) > size) return -1;
+            memcpy(&words[i], src + pos, length * sizeof(uint64_t));
+            pos += length * sizeof(uint64_t);
+            i += length;
+        }
+    }
+    return pos == size ? 0 : -1;
+}
+
+// =============================================================================
+// 2. Reading
+// =============================================================================
+
+int raxel_region_open(raxel_region_t *region, const char *path) {
+    region->header = NULL;
+    if (raxel_file_map(&region->map, path) != 0) {
+        return -1;
+    }
+    const raxel_region_header_t *header = region->map.data;
+    if (region->map.size < sizeof(raxel_region_header_t) ||
+        header->magic != RAXEL_REGION_MAGIC ||
+        header->version != RAXEL_REGION_VERSION ||
+        header->chunk_size != RAXEL_VOXEL_CHUNK_SIZE ||
+        header->region_size != RAXEL_REGION_SIZE) {
+        RAXEL_CORE_LOG_ERROR("%s is not a compatible region file\n", path);
+        raxel_file_unmap(&region->map);
+        return -1;
+    }
+    for (raxel_size_t e = 0; e < RAXEL_REGION_CHUNKS; e++) {
+        const raxel_region_entry_t *entry = &header->entries[e];
+        if (entry->size != 0 && (entry->offset < sizeof(raxel_region_header_t) ||
+                                 (raxel_size_t)entry->offset + entry->size > region->map.size)) {
+            RAXEL_CORE_LOG_ERROR("%s has an entry outside of the file\n", path);
+            raxel_file_unmap(&region->map);
+            return -1;
+        }
+    }
+    region->header = header;
+    return 0;
+}
+
+void raxel_region_close(raxel_region_t *region) {
+    raxel_file_unmap(&region->map);
+    region->header = NULL;
+}
+
+int raxel_region_read_chunk(const raxel_region_t *region, raxel_size_t entry, raxel_voxel_chunk_t *chunk) {
+    if (!raxel_region_has_chunk(region, entry)) {
+        return -1;
+    }
+    const uint8_t *blob = (const uint8_t *)region->map.data + region->header->entries[entry].offset;
+    raxel_size_t size = region->header->entries[entry].size;
+
+    __raxel_region_blob_header_t blob_header;
+    if (size < sizeof(blob_header)) return -1;
+    memcpy(&blob_header, blob, sizeof(blob_header));
+    uint32_t bits = blob_header.bits;
+    if ((bits != 0 && bits != 1 && bits != 2 && bits != 4 && bits != 8 && bits != 16) ||
+        blob_header.palette_size == 0 || blob_header.palette_size > (1u << bits)) {
+        return -1;
+    }
+    raxel_size_t palette_bytes = blob_header.palette_size * sizeof(raxel_material_handle_t);
+    if (size < sizeof(blob_header) + palette_bytes) return -1;
+    raxel_material_handle_t *palette = raxel_malloc(chunk->allocator, palette_bytes);
+    memcpy(palette, blob + sizeof(blob_header), palette_bytes);
+
+    uint64_t *data = NULL;
+    raxel_size_t words = RAXEL_VOXEL_CHUNK_PACKED_WORDS(bits);
+    int result = 0;
+    if (words > 0) {
+        data = raxel_malloc(chunk->allocator, words * sizeof(uint64_t));
+        raxel_size_t offset = sizeof(blob_header) + palette_bytes;
+        result = __raxel_region_decode_words(blob + offset, size - offset, data, words);
+    }
+    if (result == 0) {
+        raxel_voxel_chunk_assign_packed(chunk, bits, palette, blob_header.palette_size, data);
+    }
+    raxel_free(chunk->allocator, palette);
+    if (data) {
+        raxel_free(chunk->allocator, data);
+    }
+    return result;
+}
+
+// =============================================================================
+// 3. Writing
+// =============================================================================
+
+void raxel_region_writer_init(raxel_region_writer_t *writer, raxel_allocator_t *allocator) {
+    memset(&writer->header, 0, sizeof(writer->header));
+    writer->header.magic = RAXEL_REGION_MAGIC;
+    writer->header.version = RAXEL_REGION_VERSION;
+    writer->header.chunk_size = RAXEL_VOXEL_CHUNK_SIZE;
+    writer->header.region_size = RAXEL_REGION_SIZE;
+    writer->blobs = raxel_list_create_reserve(uint8_t, allocator, 4096);
+}
+
+void raxel_region_writer_release(raxel_region_writer_t *writer) {
+    raxel_list_destroy(writer->blobs);
+}
+
+void raxel_region_writer_add_chunk(raxel_region_writer_t *writer, raxel_size_t entry, const raxel_voxel_chunk_t *chunk) {
+    raxel_size_t start = raxel_list_size(writer->blobs);
+    __raxel_region_blob_header_t blob_header = { chunk->bits, chunk->palette_size };
+    __raxel_region_append(&writer->blobs, &blob_header, sizeof(blob_header));
+    if (chunk->bits == 0) {
+        __raxel_region_append(&writer->blobs, &chunk->uniform_material, sizeof(raxel_material_handle_t));
+    } else {
+        __raxel_region_append(&writer->blobs, chunk->palette, chunk->palette_size * sizeof(raxel_material_handle_t));
+        __raxel_region_encode_words(&writer->blobs, chunk->data, RAXEL_VOXEL_CHUNK_PACKED_WORDS(chunk->bits));
+    }
+    writer->header.entries[entry].offset = (uint32_t)start;
+    writer->header.entries[entry].size = (uint32_t)(raxel_list_size(writer->blobs) - start);
+}
+
+void raxel_region_writer_copy_chunk(raxel_region_writer_t *writer, raxel_size_t entry, const raxel_region_t *region) {
+    if (!raxel_region_has_chunk(region, entry)) {
+        return;
+    }
+    const raxel_region_entry_t *source = &region->header->entries[entry];
+    raxel_size_t start = raxel_list_size(writer->blobs);
+    __raxel_region_append(&writer->blobs, (const uint8_t *)region->map.data + source->offset, source->size);
+    writer->header.entries[entry].offset = (uint32_t)start;
+    writer->header.entries[entry].size = source->size;
+}
+
+int raxel_region_writer_save(raxel_region_writer_t *writer, const char *path) {
+    raxel_size_t blob_bytes = raxel_list_size(writer->blobs);
+    raxel_size_t file_size = sizeof(raxel_region_header_t) + blob_bytes;
+    uint8_t *file = malloc(file_size);
+    raxel_region_header_t *header = (raxel_region_header_t *)file;
+    *header = writer->header;
+    for (raxel_size_t e = 0; e < RAXEL_REGION_CHUNKS; e++) {
+        if (header->entries[e].size != 0) {
+            header->entries[e].offset += (uint32_t)sizeof(raxel_region_header_t);
+        }
+    }
+    memcpy(file + sizeof(raxel_region_header_t), writer->blobs, blob_bytes);
+    int result = raxel_file_write(path, file, file_size);
+    free(file);
+    return result;
+}
@@ -0,0 +1,119 @@
+#ifndef __RAXEL_REGION_H__
+#define __RAXEL_REGION_H__
+
+#include <raxel/core/assets/raxel_file.h>
+#include <raxel/core/util.h>
+#include <raxel/core/voxel/raxel_chunk.h>  // for raxel_voxel_chunk_t
+#include <stdint.h>
+
+// Region files store the chunks of a RAXEL_REGION_SIZE^3 block of chunk coordinates. The file
+// starts with a header holding one (offset, size) entry per chunk, followed by the chunk blobs.
+// Every blob is compressed on its own, so a single chunk can be read through the mapping without
+// touching the rest of the file.
+//
+// A blob is the chunk's palette form -- bits, palette size, palette -- followed by its packed index
+// words, run-length encoded: each run starts with a uint32_t count, and if the top bit is set the
+// next word repeats count times, otherwise count literal words follow. All values are little endian.
+
+#define RAXEL_REGION_SIZE 16
+#define RAXEL_REGION_CHUNKS (RAXEL_REGION_SIZE * RAXEL_REGION_SIZE * RAXEL_REGION_SIZE)
+#define RAXEL_REGION_MAGIC 0x47525852u  // "RXRG"
+#define RAXEL_REGION_VERSION 1
+#define RAXEL_REGION_FILE_EXTENSION ".rxr"
+
+typedef struct raxel_region_entry {
+    uint32_t offset;  // from the start of the file
+    uint32_t size;    // 0 when the region does not hold the chunk
+} raxel_region_entry_t;
+
+typedef struct raxel_region_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t chunk_size;   // RAXEL_VOXEL_CHUNK_SIZE of the writer
+    uint32_t region_size;  // RAXEL_REGION_SIZE of the writer
+    raxel_region_entry_t entries[RAXEL_REGION_CHUNKS];
+} raxel_region_header_t;
+
+// Floor division of a chunk coordinate by the region size.
+static inline raxel_coord_t raxel_region_coord(raxel_coord_t chunk_coord) {
+    return (chunk_coord >= 0) ? (chunk_coord / RAXEL_REGION_SIZE)
+                              : ((chunk_coord - RAXEL_REGION_SIZE + 1) / RAXEL_REGION_SIZE);
+}
+
+// Index of a chunk in its region's header.
+static inline raxel_size_t raxel_region_entry_index(raxel_coord_t chunk_x, raxel_coord_t chunk_y, raxel_coord_t chunk_z) {
+    raxel_size_t lx = (raxel_size_t)(chunk_x - raxel_region_coord(chunk_x) * RAXEL_REGION_SIZE);
+    raxel_size_t ly = (raxel_size_t)(chunk_y - raxel_region_coord(chunk_y) * RAXEL_REGION_SIZE);
+    raxel_size_t lz = (raxel_size_t)(chunk_z - raxel_region_coord(chunk_z) * RAXEL_REGION_SIZE);
+    return lx + ly * RAXEL_REGION_SIZE + lz * RAXEL_REGION_SIZE * RAXEL_REGION_SIZE;
+}
+
+/**
+ * Write the file name of a region, "r.<x>.<y>.<z>.rxr", into out.
+ */
+void raxel_region_file_name(char *out, raxel_size_t out_size, raxel_coord_t region_x, raxel_coord_t region_y, raxel_coord_t region_z);
+
+/**
+ * Parse a region file name.
+ *
+ * @return 1 if name is a region file name, 0 otherwise.
+ */
+int raxel_region_parse_file_name(const char *name, raxel_coord_t *region_x, raxel_coord_t *region_y, raxel_coord_t *region_z);
+
+/**------------------------------------------------------------------------
+ *                           READING
+ *------------------------------------------------------------------------**/
+
+typedef struct raxel_region {
+    raxel_file_map_t map;
+    const raxel_region_header_t *header;  // points into the mapping
+} raxel_region_t;
+
+/**
+ * Map a region file and check its header.
+ *
+ * @return 0 on success, -1 if the file is missing or not a valid region file.
+ */
+int raxel_region_open(raxel_region_t *region, const char *path);
+void raxel_region_close(raxel_region_t *region);
+
+static inline int raxel_region_has_chunk(const raxel_region_t *region, raxel_size_t entry) {
+    return region->header->entries[entry].size != 0;
+}
+
+/**
+ * Decompress a chunk of the region into an initialized chunk, replacing its contents.
+ *
+ * @return 0 on success, -1 if the region does not hold the chunk or its blob is corrupt.
+ */
+int raxel_region_read_chunk(const raxel_region_t *region, raxel_size_t entry, raxel_voxel_chunk_t *chunk);
+
+/**------------------------------------------------------------------------
+ *                           WRITING
+ *------------------------------------------------------------------------**/
+
+// Region files are written whole: collect the chunks, then save.
+typedef struct raxel_region_writer {
+    raxel_region_header_t header;  // offsets relative to the start of blobs until saved
+    raxel_list(uint8_t) blobs;
+} raxel_region_writer_t;
+
+void raxel_region_writer_init(raxel_region_writer_t *writer, raxel_allocator_t *allocator);
+void raxel_region_writer_release(raxel_region_writer_t *writer);
+
+/**
+ * Compress a chunk into the region. A chunk may only be added once.
+ */
+void raxel_region_writer_add_chunk(raxel_region_writer_t *writer, raxel_size_t entry, const raxel_voxel_chunk_t *chunk);
+
+/**
+ * Copy a chunk's blob from an existing region as is, e.g. to keep chunks that were never loaded.
+ */
+void raxel_region_writer_copy_chunk(raxel_region_writer_t *writer, raxel_size_t entry, const raxel_region_t *region);
+
+/**
+ * @return 0 on success, -1 if the file could not be written.
+ */
+int raxel_region_writer_save(raxel_region_writer_t *writer, const char *path);
+
+#endif // __RAXEL_REGION_H__
@@ -137,16 +137,23 @@ void raxel_compute_shader_set_sb(raxel_compute_shader_t *shader,
                                  raxel_pipeline_t *pipeline,
                                  raxel_sb_buffer_desc_t *desc) {
     // Create the storage buffer using the pipeline's allocator.
-    shader->sb_buffer = raxel_sb_buffer_create(&pipeline->resources.allocator,
-                                               desc,
-                                               pipeline->resources.device,
-                                               pipeline->resources.device_physical);
+    raxel_sb_buffer_t *buffer = raxel_sb_buffer_create(&pipeline->resources.allocator,
+                                                       desc,
+                                                       pipeline->resources.device,
+                                                       pipeline->resources.device_physical);
+    raxel_compute_shader_bind_sb(shader, pipeline, buffer);
+}
+
+void raxel_compute_shader_bind_sb(raxel_compute_shader_t *shader,
+                                  raxel_pipeline_t *pipeline,
+                                  raxel_sb_buffer_t *buffer) {
+    shader->sb_buffer = buffer;
 
     // Update the compute shader's descriptor set.
     VkDescriptorBufferInfo buffer_info = {0};
-    buffer_info.buffer = shader->sb_buffer->buffer;
+    buffer_info.buffer = buffer->buffer;
     buffer_info.offset = 0;
-    buffer_info.range = shader->sb_buffer->data_size;
+    buffer_info.range = buffer->data_size;
 
     VkWriteDescriptorSet write = {0};
     write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -65,6 +65,18 @@ void raxel_compute_shader_push_pc(raxel_compute_shader_t *shader, VkCommandBuffe
  */
 void raxel_compute_shader_set_sb(raxel_compute_shader_t *shader, raxel_pipeline_t *pipeline, raxel_sb_buffer_desc_t *desc);
 
+/**
+ * @brief Points the compute shader's storage buffer binding at an existing buffer.
+ * 
+ * The descriptor set is updated in place, so only call this while no dispatch using it
+ * is in flight (the compute pass waits for its dispatch, so between frames is fine).
+ * The shader does not take ownership of the buffer.
+ * 
+ * @param shader Pointer to the compute shader.
+ * @param buffer The storage buffer to bind.
+ */
+void raxel_compute_shader_bind_sb(raxel_compute_shader_t *shader, raxel_pipeline_t *pipeline, raxel_sb_buffer_t *buffer);
+
 
 
 // -----------------------------------------------------------------------------
@@ -28,6 +28,7 @@ raxel_sb_buffer_t *raxel_sb_buffer_create(raxel_allocator_t *allocator,
     
     // Allocate CPU–side memory.
     buffer->data = raxel_malloc(allocator, buffer->data_size);
+    buffer->dirty_ranges = raxel_list_create_reserve(raxel_sb_range_t, allocator, 16);
 
     // Create the Vulkan buffer
     VkBufferCreateInfo buf_info = {0};
@@ -66,6 +67,10 @@ raxel_sb_buffer_t *raxel_sb_buffer_create(raxel_allocator_t *allocator,
     VK_CHECK(vkAllocateMemory(device, &alloc_info, NULL, &buffer->memory));
     VK_CHECK(vkBindBufferMemory(device, buffer->buffer, buffer->memory, 0));
 
+    // The memory is host-coherent, so it stays mapped for the buffer's lifetime and
+    // updates are plain memcpys.
+    VK_CHECK(vkMapMemory(device, buffer->memory, 0, buffer->data_size, 0, &buffer->mapped));
+
     return buffer;
 }
 
@@ -87,25 +92,89 @@ void raxel_sb_buffer_set(raxel_sb_buffer_t *buffer, char *name, void *data)
         raxel_sb_entry_t *entry = &buffer->entries[i];
         if (strcmp(entry->name, name) == 0) {
             memcpy((char *)buffer->data + entry->offset, data, entry->size);
+            raxel_sb_buffer_mark_dirty(buffer, entry->offset, entry->size);
             return;
         }
     }
     RAXEL_CORE_LOG_ERROR("Field '%s' not found in storage buffer\n", name);
 }
 
+void raxel_sb_buffer_mark_dirty(raxel_sb_buffer_t *buffer, raxel_size_t offset, raxel_size_t size)
+{
+    if (size == 0) {
+        return;
+    }
+    if (offset + size > buffer->data_size) {
+        RAXEL_CORE_LOG_ERROR("Dirty range [%zu, %zu) exceeds storage buffer size %zu\n", offset, offset + size, buffer->data_size);
+        return;
+    }
+    // extend the previous range when writes arrive in order, which is the common case
+    raxel_size_t n = raxel_list_size(buffer->dirty_ranges);
+    if (n > 0) {
+        raxel_sb_range_t *last = &buffer->dirty_ranges[n - 1];
+        if (offset >= last->offset && offset <= last->offset + last->size) {
+            raxel_size_t end = offset + size;
+            if (end > last->offset + last->size) {
+                last->size = end - last->offset;
+            }
+            return;
+        }
+    }
+    raxel_sb_range_t range = {.offset = offset, .size = size};
+    raxel_list_push_back(buffer->dirty_ranges, range);
+}
+
+static int __raxel_sb_range_compare(const void *a, const void *b)
+{
+    const raxel_sb_range_t *ra = a;
+    const raxel_sb_range_t *rb = b;
+    return (ra->offset > rb->offset) - (ra->offset < rb->offset);
+}
+
+raxel_size_t raxel_sb_buffer_flush(raxel_sb_buffer_t *buffer, raxel_pipeline_t *pipeline)
+{
+    (void)pipeline;
+    raxel_size_t n = raxel_list_size(buffer->dirty_ranges);
+    if (n == 0) {
+        return 0;
+    }
+    raxel_sb_range_t *ranges = buffer->dirty_ranges;
+    qsort(ranges, n, sizeof(raxel_sb_range_t), __raxel_sb_range_compare);
+
+    raxel_size_t bytes = 0;
+    raxel_size_t start = ranges[0].offset;
+    raxel_size_t end = ranges[0].offset + ranges[0].size;
+    for (raxel_size_t i = 1; i <= n; i++) {
+        if (i < n && ranges[i].offset <= end) {
+            if (ranges[i].offset + ranges[i].size > end) {
+                end = ranges[i].offset + ranges[i].size;
+            }
+            continue;
+        }
+        memcpy((char *)buffer->mapped + start, (char *)buffer->data + start, end - start);
+        bytes += end - start;
+        if (i < n) {
+            start = ranges[i].offset;
+            end = ranges[i].offset + ranges[i].size;
+        }
+    }
+    raxel_list_size(buffer->dirty_ranges) = 0;
+    return bytes;
+}
+
 void raxel_sb_buffer_update(raxel_sb_buffer_t *buffer, raxel_pipeline_t *pipeline) {
-    void *mapped = NULL;
-    VkDevice device = pipeline->resources.device;
-    VK_CHECK(vkMapMemory(device, buffer->memory, 0, buffer->data_size, 0, &mapped));
-    memcpy(mapped, buffer->data, buffer->data_size);
-    vkUnmapMemory(device, buffer->memory);
+    (void)pipeline;
+    memcpy(buffer->mapped, buffer->data, buffer->data_size);
+    raxel_list_size(buffer->dirty_ranges) = 0;
 }
 
 
 void raxel_sb_buffer_destroy(raxel_sb_buffer_t *buffer, VkDevice device)
 {
     raxel_list_destroy(buffer->entries);
+    raxel_list_destroy(buffer->dirty_ranges);
     raxel_free(buffer->allocator, buffer->data);
+    vkUnmapMemory(device, buffer->memory);
     vkDestroyBuffer(device, buffer->buffer, NULL);
     vkFreeMemory(device, buffer->memory, NULL);
     raxel_free(buffer->allocator, buffer);
@@ -16,14 +16,22 @@ typedef struct raxel_sb_buffer_desc {
     raxel_size_t entry_count;   // Number of entries in the array
 } raxel_sb_buffer_desc_t;
 
+// A byte range of the CPU-side mirror that differs from the GPU copy.
+typedef struct raxel_sb_range {
+    raxel_size_t offset;
+    raxel_size_t size;
+} raxel_sb_range_t;
+
 typedef struct raxel_sb_buffer {
-    raxel_array(raxel_sb_entry_t) entries;  // Array of entries
-    void *data;                             // CPU–side data mirror
-    raxel_size_t data_size;                 // Total size of the data buffer
-    raxel_allocator_t *allocator;           // Allocator used for memory
+    raxel_array(raxel_sb_entry_t) entries;      // Array of entries
+    void *data;                                 // CPU–side data mirror
+    raxel_size_t data_size;                     // Total size of the data buffer
+    raxel_list(raxel_sb_range_t) dirty_ranges;  // Ranges of data written since the last flush
+    raxel_allocator_t *allocator;               // Allocator used for memory
 
     VkBuffer buffer;        // Vulkan buffer handle
     VkDeviceMemory memory;  // Device memory bound to the buffer
+    void *mapped;           // Persistent host mapping of memory
 } raxel_sb_buffer_t;
 
 #define RAXEL_SB_DESC(...)                                                                  \
@@ -52,7 +60,7 @@ raxel_sb_buffer_t *raxel_sb_buffer_create(raxel_allocator_t *allocator,
 void *raxel_sb_buffer_get(raxel_sb_buffer_t *buffer, char *name);
 
 /**
- * Write data into the storage buffer for a given field name.
+ * Write data into the storage buffer for a given field name. The field is marked dirty.
  *
  * @param buffer The storage buffer.
  * @param name Field name.
@@ -60,9 +68,29 @@ void *raxel_sb_buffer_get(raxel_sb_buffer_t *buffer, char *name);
  */
 void raxel_sb_buffer_set(raxel_sb_buffer_t *buffer, char *name, void *data);
 
+/**
+ * Record that a byte range of the CPU-side mirror was written directly and needs to
+ * reach the GPU on the next flush.
+ *
+ * @param buffer The storage buffer.
+ * @param offset Start of the range in bytes.
+ * @param size Size of the range in bytes.
+ */
+void raxel_sb_buffer_mark_dirty(raxel_sb_buffer_t *buffer, raxel_size_t offset, raxel_size_t size);
+
+/**
+ * @brief Upload only the dirty ranges to the GPU. Overlapping and adjacent ranges are
+ * merged first, so each byte is copied at most once.
+ *
+ * @param buffer The storage buffer.
+ * @param pipeline The pipeline owning the device.
+ * @return The number of bytes copied.
+ */
+raxel_size_t raxel_sb_buffer_flush(raxel_sb_buffer_t *buffer, raxel_pipeline_t *pipeline);
+
 
 /**
- * @brief Update the storage buffer on the GPU.
+ * @brief Update the whole storage buffer on the GPU, regardless of dirty ranges.
  * 
  * @param buffer The storage buffer.
  * @param device Vulkan device.
@@ -6,5 +6,6 @@
 #include "util/raxel_debug.h"
 #include "util/raxel_mem.h"
 #include "util/raxel_test.h"
+#include "util/raxel_thread.h"
 
 #endif // __UTIL_H__
\ No newline at end of file
@@ -84,6 +84,7 @@ static void raxel_hashtable_rehash(raxel_hashtable_t *ht, raxel_size_t new_capac
     ht->__buckets = new_buckets;
     ht->__capacity = new_capacity;
     ht->__bucket_size = new_bucket_size;
+    ht->__tombstones = 0;
 }
 
 /*---------------------------------------------------------------
@@ -101,6 +102,7 @@ raxel_hashtable_t *__raxel_hashtable_create(raxel_allocator_t *allocator,
     raxel_hashtable_t *ht = (raxel_hashtable_t *)raxel_malloc(allocator, sizeof(raxel_hashtable_t));
     ht->__capacity = initial_capacity;
     ht->__size = 0;
+    ht->__tombstones = 0;
     ht->__key_size = key_size;
     ht->__value_size = value_size;
     ht->__allocator = allocator;
@@ -121,12 +123,15 @@ void raxel_hashtable_destroy(raxel_hashtable_t *ht) {
 }
 
 int raxel_hashtable_insert(raxel_hashtable_t *ht, const void *key, const void *value) {
-    // Rehash if load factor >= 70%.
-    if (ht->__size * 100 / ht->__capacity >= 70) {
-        raxel_hashtable_rehash(ht, ht->__capacity * 2);
+    // Rehash if load factor >= 70%. Tombstones count too, so every probe chain ends in an empty
+    // bucket; when they are most of the load, rehashing at the same capacity clears them.
+    if ((ht->__size + ht->__tombstones) * 100 / ht->__capacity >= 70) {
+        raxel_size_t new_capacity = (ht->__size * 100 / ht->__capacity >= 35) ? ht->__capacity * 2 : ht->__capacity;
+        raxel_hashtable_rehash(ht, new_capacity);
     }
     uint64_t hash = ht->__hash(key, ht->__key_size);
     raxel_size_t index = hash % ht->__capacity;
+    void *tombstone = NULL;  // the first one on the chain, reused if the key is not further down
     for (;;) {
         void *bucket = (void *)((char *)ht->__buckets + index * ht->__bucket_size);
         uint8_t *state = (uint8_t *)bucket;
@@ -139,8 +144,17 @@ int raxel_hashtable_insert(raxel_hashtable_t *ht, const void *key, const void *v
                 memcpy(bucket_value, value, ht->__value_size);
                 return 0;  // updated
             }
+        } else if (*state == 2) {
+            if (!tombstone) {
+                tombstone = bucket;
+            }
         } else {
-            // Found empty bucket (or tombstone).
+            // Found the end of the chain: the key is not in the table.
+            if (tombstone) {
+                bucket = tombstone;
+                state = (uint8_t *)bucket;
+                ht->__tombstones--;
+            }
             *state = 1;
             memcpy((char *)bucket + 1, key, ht->__key_size);
             memcpy((char *)bucket + 1 + ht->__key_size, value, ht->__value_size);
@@ -187,6 +201,7 @@ int raxel_hashtable_remove(raxel_hashtable_t *ht, const void *key) {
                 // Mark as tombstone.
                 *state = 2;
                 ht->__size--;
+                ht->__tombstones++;
                 return 1;
             }
         }
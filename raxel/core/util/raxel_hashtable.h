@@ -13,6 +13,7 @@ extern "C" {
 typedef struct raxel_hashtable {
     raxel_size_t __capacity;    // total number of buckets
     raxel_size_t __size;        // number of active entries
+    raxel_size_t __tombstones;  // number of removed entries still in the probe chains
     raxel_size_t __key_size;    // size of a key in bytes
     raxel_size_t __value_size;  // size of a value in bytes
     raxel_allocator_t *__allocator;
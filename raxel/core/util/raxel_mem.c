@@ -15,7 +15,7 @@ void *raxel_copy(raxel_allocator_t *allocator, void *dest, const void *src, raxe
     return allocator->copy(dest, src, n);
 }
 
-static void raxel_default_alloc(void *ctx, raxel_size_t size) {
+static void *raxel_default_alloc(void *ctx, raxel_size_t size) {
     return malloc(size);
 }
 
@@ -72,4 +72,9 @@ void raxel_arena_allocator_destroy(raxel_allocator_t *allocator) {
     free(arena_ctx->arena);
     free(arena_ctx);
     free(allocator);
+}
+
+void raxel_arena_allocator_reset(raxel_allocator_t *allocator) {
+    raxel_arena_ctx_t *arena_ctx = (raxel_arena_ctx_t *)allocator->ctx;
+    arena_ctx->used = 0;
 }
\ No newline at end of file
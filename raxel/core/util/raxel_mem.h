@@ -31,6 +31,8 @@ typedef struct raxel_arena_ctx {
 
 raxel_allocator_t *raxel_arena_allocator(raxel_size_t size);
 void raxel_arena_allocator_destroy(raxel_allocator_t *allocator);
+// Free everything allocated from the arena at once, keeping its memory for the next allocations.
+void raxel_arena_allocator_reset(raxel_allocator_t *allocator);
 
 #ifdef __cplusplus
 }
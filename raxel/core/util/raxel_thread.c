@@ -0,0 +1,155 @@
+#include "raxel_thread.h"
+
+#include <unistd.h>
+
+int raxel_thread_create(raxel_thread_t *thread, raxel_thread_fn_t fn, void *arg) {
+    return pthread_create(thread, NULL, fn, arg);
+}
+
+void raxel_thread_join(raxel_thread_t thread) {
+    pthread_join(thread, NULL);
+}
+
+void raxel_mutex_init(raxel_mutex_t *mutex) {
+    pthread_mutex_init(mutex, NULL);
+}
+
+void raxel_mutex_destroy(raxel_mutex_t *mutex) {
+    pthread_mutex_destroy(mutex);
+}
+
+void raxel_mutex_lock(raxel_mutex_t *mutex) {
+    pthread_mutex_lock(mutex);
+}
+
+void raxel_mutex_unlock(raxel_mutex_t *mutex) {
+    pthread_mutex_unlock(mutex);
+}
+
+void raxel_cond_init(raxel_cond_t *cond) {
+    pthread_cond_init(cond, NULL);
+}
+
+void raxel_cond_destroy(raxel_cond_t *cond) {
+    pthread_cond_destroy(cond);
+}
+
+void raxel_cond_wait(raxel_cond_t *cond, raxel_mutex_t *mutex) {
+    pthread_cond_wait(cond, mutex);
+}
+
+void raxel_cond_signal(raxel_cond_t *cond) {
+    pthread_cond_signal(cond);
+}
+
+void raxel_cond_broadcast(raxel_cond_t *cond) {
+    pthread_cond_broadcast(cond);
+}
+
+int raxel_thread_hardware_concurrency(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+struct raxel_thread_pool {
+    raxel_allocator_t *allocator;
+    raxel_thread_t *threads;
+    int num_threads;
+    raxel_mutex_t mutex;
+    raxel_cond_t work_cond;  // a run started or the pool is stopping
+    raxel_cond_t done_cond;  // the last task of a run finished
+    raxel_thread_task_fn_t fn;
+    void *arg;
+    int num_tasks;
+    int next_task;
+    int num_done;
+    int stop;
+};
+
+// Takes tasks of the current run until none are left. Called and returns with the mutex held.
+static void __raxel_thread_pool_drain(raxel_thread_pool_t *pool) {
+    while (pool->next_task < pool->num_tasks) {
+        int task = pool->next_task++;
+        raxel_mutex_unlock(&pool->mutex);
+        pool->fn(pool->arg, task);
+        raxel_mutex_lock(&pool->mutex);
+        if (++pool->num_done == pool->num_tasks) {
+            raxel_cond_signal(&pool->done_cond);
+        }
+    }
+}
+
+static void *__raxel_thread_pool_main(void *arg) {
+    raxel_thread_pool_t *pool = arg;
+    raxel_mutex_lock(&pool->mutex);
+    while (!pool->stop) {
+        __raxel_thread_pool_drain(pool);
+        if (!pool->stop) {
+            raxel_cond_wait(&pool->work_cond, &pool->mutex);
+        }
+    }
+    raxel_mutex_unlock(&pool->mutex);
+    return NULL;
+}
+
+raxel_thread_pool_t *raxel_thread_pool_create(int num_threads, raxel_allocator_t *allocator) {
+    raxel_thread_pool_t *pool = raxel_malloc(allocator, sizeof(raxel_thread_pool_t));
+    pool->allocator = allocator;
+    pool->threads = raxel_malloc(allocator, (num_threads + 1) * sizeof(raxel_thread_t));
+    pool->num_threads = 0;
+    raxel_mutex_init(&pool->mutex);
+    raxel_cond_init(&pool->work_cond);
+    raxel_cond_init(&pool->done_cond);
+    pool->fn = NULL;
+    pool->arg = NULL;
+    pool->num_tasks = 0;
+    pool->next_task = 0;
+    pool->num_done = 0;
+    pool->stop = 0;
+    for (int i = 0; i < num_threads; i++) {
+        if (raxel_thread_create(&pool->threads[i], __raxel_thread_pool_main, pool) != 0) {
+            raxel_thread_pool_destroy(pool);
+            return NULL;
+        }
+        pool->num_threads++;
+    }
+    return pool;
+}
+
+void raxel_thread_pool_destroy(raxel_thread_pool_t *pool) {
+    if (!pool) return;
+    raxel_mutex_lock(&pool->mutex);
+    pool->stop = 1;
+    raxel_cond_broadcast(&pool->work_cond);
+    raxel_mutex_unlock(&pool->mutex);
+    for (int i = 0; i < pool->num_threads; i++) {
+        raxel_thread_join(pool->threads[i]);
+    }
+    raxel_cond_destroy(&pool->done_cond);
+    raxel_cond_destroy(&pool->work_cond);
+    raxel_mutex_destroy(&pool->mutex);
+    raxel_free(pool->allocator, pool->threads);
+    raxel_free(pool->allocator, pool);
+}
+
+int raxel_thread_pool_size(raxel_thread_pool_t *pool) {
+    return pool->num_threads + 1;
+}
+
+void raxel_thread_pool_run(raxel_thread_pool_t *pool, int num_tasks, raxel_thread_task_fn_t fn, void *arg) {
+    if (num_tasks <= 0) return;
+    raxel_mutex_lock(&pool->mutex);
+    pool->fn = fn;
+    pool->arg = arg;
+    pool->num_tasks = num_tasks;
+    pool->next_task = 0;
+    pool->num_done = 0;
+    if (pool->num_threads > 0 && num_tasks > 1) {
+        raxel_cond_broadcast(&pool->work_cond);
+    }
+    __raxel_thread_pool_drain(pool);
+    while (pool->num_done < pool->num_tasks) {
+        raxel_cond_wait(&pool->done_cond, &pool->mutex);
+    }
+    raxel_mutex_unlock(&pool->mutex);
+}
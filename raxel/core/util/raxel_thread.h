@@ -0,0 +1,68 @@
+#ifndef __RAXEL_THREAD_H__
+#define __RAXEL_THREAD_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif  // __cplusplus
+
+#include <pthread.h>
+
+#include "raxel_mem.h"
+
+// Thin wrappers around pthreads, so engine code does not depend on the threading API directly.
+
+typedef pthread_t raxel_thread_t;
+typedef pthread_mutex_t raxel_mutex_t;
+typedef pthread_cond_t raxel_cond_t;
+
+typedef void *(*raxel_thread_fn_t)(void *arg);
+
+/**
+ * Start a thread running fn(arg).
+ *
+ * @return 0 on success.
+ */
+int raxel_thread_create(raxel_thread_t *thread, raxel_thread_fn_t fn, void *arg);
+void raxel_thread_join(raxel_thread_t thread);
+
+void raxel_mutex_init(raxel_mutex_t *mutex);
+void raxel_mutex_destroy(raxel_mutex_t *mutex);
+void raxel_mutex_lock(raxel_mutex_t *mutex);
+void raxel_mutex_unlock(raxel_mutex_t *mutex);
+
+void raxel_cond_init(raxel_cond_t *cond);
+void raxel_cond_destroy(raxel_cond_t *cond);
+// Atomically releases the mutex and waits; the mutex is held again on return.
+void raxel_cond_wait(raxel_cond_t *cond, raxel_mutex_t *mutex);
+void raxel_cond_signal(raxel_cond_t *cond);
+void raxel_cond_broadcast(raxel_cond_t *cond);
+
+// Number of processors online, at least 1.
+int raxel_thread_hardware_concurrency(void);
+
+// A fixed set of worker threads for fork-join parallelism. raxel_thread_pool_run hands the tasks
+// to the workers and the calling thread alike and returns once all of them are done, so a pool of
+// num_threads runs up to num_threads + 1 tasks at once. Tasks must not call back into the pool.
+typedef struct raxel_thread_pool raxel_thread_pool_t;
+
+typedef void (*raxel_thread_task_fn_t)(void *arg, int task);
+
+/**
+ * Start num_threads workers; 0 gives a pool that runs everything on the calling thread.
+ *
+ * @return NULL if a worker could not be started.
+ */
+raxel_thread_pool_t *raxel_thread_pool_create(int num_threads, raxel_allocator_t *allocator);
+void raxel_thread_pool_destroy(raxel_thread_pool_t *pool);
+
+// Threads that run tasks, the calling thread included.
+int raxel_thread_pool_size(raxel_thread_pool_t *pool);
+
+// Calls fn(arg, task) once for every task in [0, num_tasks), roughly in order, and waits for all.
+void raxel_thread_pool_run(raxel_thread_pool_t *pool, int num_tasks, raxel_thread_task_fn_t fn, void *arg);
+
+#ifdef __cplusplus
+}
+#endif  // __cplusplus
+
+#endif // __RAXEL_THREAD_H__
@@ -1,6 +1,9 @@
 #ifndef __VOXEL_H__
 #define __VOXEL_H__
 
+#include "voxel/raxel_chunk.h"
+#include "voxel/raxel_tree64.h"
 #include "voxel/raxel_voxel.h"
+#include "voxel/raxel_voxel_render.h"
 
 #endif // __VOXEL_H__
\ No newline at end of file
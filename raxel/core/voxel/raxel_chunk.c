@@ -0,0 +1,504 @@
+// raxel_chunk.c
+
+#include "raxel_chunk.h"
+
+#include <string.h>
+
+// =============================================================================
+// 1. Occupancy
+// =============================================================================
+
+// Makes sure the occupancy mask exists before a partial change. Returns 0 when the change is a
+// no-op (filling a full chunk or clearing an empty one).
+static int __raxel_voxel_chunk_occupancy_prepare(raxel_voxel_chunk_t *chunk, int solid) {
+    if (chunk->occupancy) {
+        return 1;
+    }
+    if (solid ? (chunk->solid_count == RAXEL_VOXEL_CHUNK_VOLUME) : (chunk->solid_count == 0)) {
+        return 0;
+    }
+    chunk->occupancy = raxel_malloc(chunk->allocator, RAXEL_VOXEL_CHUNK_OCCUPANCY_WORDS * sizeof(uint64_t));
+    memset(chunk->occupancy, chunk->solid_count ? 0xFF : 0x00, RAXEL_VOXEL_CHUNK_OCCUPANCY_WORDS * sizeof(uint64_t));
+    return 1;
+}
+
+// Sets or clears the occupancy of count voxels starting at start, keeping solid_count in sync.
+static void __raxel_voxel_chunk_occupancy_fill(raxel_voxel_chunk_t *chunk, raxel_size_t start, raxel_size_t count, int solid) {
+    if (!__raxel_voxel_chunk_occupancy_prepare(chunk, solid)) {
+        return;
+    }
+    raxel_size_t i = start;
+    raxel_size_t end = start + count;
+    while (i < end) {
+        raxel_size_t word = i >> 6;
+        uint32_t offset = (uint32_t)(i & 63);
+        raxel_size_t n = 64 - offset;
+        if (n > end - i) {
+            n = end - i;
+        }
+        uint64_t mask = (n == 64) ? ~0ULL : (((1ULL << n) - 1) << offset);
+        uint32_t was_solid = (uint32_t)__builtin_popcountll(chunk->occupancy[word] & mask);
+        if (solid) {
+            chunk->occupancy[word] |= mask;
+            chunk->solid_count += (uint32_t)n - was_solid;
+        } else {
+            chunk->occupancy[word] &= ~mask;
+            chunk->solid_count -= was_solid;
+        }
+        i += n;
+    }
+}
+
+// =============================================================================
+// 2. Palette Storage
+// =============================================================================
+
+#define __RAXEL_CHUNK_WORDS(bits) RAXEL_VOXEL_CHUNK_PACKED_WORDS(bits)
+
+void raxel_voxel_chunk_init(raxel_voxel_chunk_t *chunk, raxel_allocator_t *allocator) {
+    chunk->uniform_material = 0;
+    chunk->palette = NULL;
+    chunk->data = NULL;
+    chunk->occupancy = NULL;
+    chunk->solid_count = 0;
+    chunk->revision = 0;
+    chunk->palette_size = 1;
+    chunk->palette_capacity = 0;
+    chunk->bits = 0;
+    chunk->allocator = allocator;
+}
+
+// Frees the palette storage only, the occupancy mask is untouched.
+static void __raxel_voxel_chunk_release_palette(raxel_voxel_chunk_t *chunk) {
+    if (chunk->palette) {
+        raxel_free(chunk->allocator, chunk->palette);
+    }
+    if (chunk->data) {
+        raxel_free(chunk->allocator, chunk->data);
+    }
+    chunk->palette = NULL;
+    chunk->data = NULL;
+    chunk->palette_capacity = 0;
+}
+
+void raxel_voxel_chunk_release(raxel_voxel_chunk_t *chunk) {
+    __raxel_voxel_chunk_release_palette(chunk);
+    if (chunk->occupancy) {
+        raxel_free(chunk->allocator, chunk->occupancy);
+    }
+    chunk->occupancy = NULL;
+}
+
+// Smallest supported index width that can address n palette entries.
+static uint32_t __raxel_voxel_chunk_bits_for(uint32_t n) {
+    if (n <= 1) return 0;
+    uint32_t bits = 1;
+    while ((1u << bits) < n) {
+        bits <<= 1;
+    }
+    return bits;
+}
+
+static inline uint32_t __raxel_voxel_chunk_read_index(const uint64_t *data, uint32_t bits, raxel_size_t index) {
+    raxel_size_t bit = index * bits;
+    return (uint32_t)((data[bit >> 6] >> (bit & 63)) & ((1ULL << bits) - 1));
+}
+
+static inline void __raxel_voxel_chunk_write_index(uint64_t *data, uint32_t bits, raxel_size_t index, uint32_t value) {
+    raxel_size_t bit = index * bits;
+    uint64_t mask = ((1ULL << bits) - 1) << (bit & 63);
+    data[bit >> 6] = (data[bit >> 6] & ~mask) | (((uint64_t)value << (bit & 63)) & mask);
+}
+
+// Re-encode the chunk at new_bits, mapping every old palette index through remap (or keeping it
+// when remap is NULL). new_palette holds room for new_palette_capacity entries.
+static void __raxel_voxel_chunk_repack(raxel_voxel_chunk_t *chunk,
+                                       uint32_t new_bits,
+                                       raxel_material_handle_t *new_palette,
+                                       uint32_t new_palette_size,
+                                       uint32_t new_palette_capacity,
+                                       const uint32_t *remap) {
+    uint64_t *new_data = NULL;
+    if (new_bits > 0) {
+        new_data = raxel_malloc(chunk->allocator, __RAXEL_CHUNK_WORDS(new_bits) * sizeof(uint64_t));
+        memset(new_data, 0, __RAXEL_CHUNK_WORDS(new_bits) * sizeof(uint64_t));
+        if (chunk->bits > 0) {
+            for (raxel_size_t i = 0; i < RAXEL_VOXEL_CHUNK_VOLUME; i++) {
+                uint32_t old_index = __raxel_voxel_chunk_read_index(chunk->data, chunk->bits, i);
+                uint32_t new_index = remap ? remap[old_index] : old_index;
+                __raxel_voxel_chunk_write_index(new_data, new_bits, i, new_index);
+            }
+        }
+        // a uniform chunk maps every voxel to index 0, which the zeroed data already encodes
+    } else {
+        chunk->uniform_material = new_palette ? new_palette[0] : chunk->uniform_material;
+    }
+    __raxel_voxel_chunk_release_palette(chunk);
+    chunk->data = new_data;
+    chunk->palette = (new_bits > 0) ? new_palette : NULL;
+    if (new_bits == 0 && new_palette) {
+        raxel_free(chunk->allocator, new_palette);
+    }
+    chunk->palette_size = new_palette_size;
+    chunk->palette_capacity = (new_bits > 0) ? new_palette_capacity : 0;
+    chunk->bits = new_bits;
+}
+
+void raxel_voxel_chunk_compact(raxel_voxel_chunk_t *chunk) {
+    if (chunk->bits == 0) {
+        return;
+    }
+    raxel_allocator_t *allocator = chunk->allocator;
+    uint32_t *remap = raxel_malloc(allocator, chunk->palette_size * sizeof(uint32_t));
+    memset(remap, 0, chunk->palette_size * sizeof(uint32_t));
+    for (raxel_size_t i = 0; i < RAXEL_VOXEL_CHUNK_VOLUME; i++) {
+        remap[__raxel_voxel_chunk_read_index(chunk->data, chunk->bits, i)] = 1;
+    }
+    uint32_t used = 0;
+    for (uint32_t i = 0; i < chunk->palette_size; i++) {
+        used += remap[i];
+    }
+    uint32_t new_bits = __raxel_voxel_chunk_bits_for(used);
+    raxel_material_handle_t *new_palette = raxel_malloc(allocator, used * sizeof(raxel_material_handle_t));
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < chunk->palette_size; i++) {
+        if (remap[i]) {
+            new_palette[n] = chunk->palette[i];
+            remap[i] = n++;
+        }
+    }
+    if (used != chunk->palette_size || new_bits != chunk->bits) {
+        __raxel_voxel_chunk_repack(chunk, new_bits, new_palette, used, used, remap);
+    } else {
+        raxel_free(allocator, new_palette);
+    }
+    raxel_free(allocator, remap);
+}
+
+// Returns the palette index of a material, adding it (and compacting/widening the storage) if needed.
+static uint32_t __raxel_voxel_chunk_palette_index(raxel_voxel_chunk_t *chunk, raxel_material_handle_t material) {
+    if (chunk->bits == 0) {
+        if (chunk->uniform_material == material) {
+            return 0;
+        }
+        // uniform -> 1 bit: [old, new]
+        raxel_material_handle_t *palette = raxel_malloc(chunk->allocator, 2 * sizeof(raxel_material_handle_t));
+        palette[0] = chunk->uniform_material;
+        palette[1] = material;
+        __raxel_voxel_chunk_repack(chunk, 1, palette, 2, 2, NULL);
+        return 1;
+    }
+    for (uint32_t i = 0; i < chunk->palette_size; i++) {
+        if (chunk->palette[i] == material) {
+            return i;
+        }
+    }
+    if (chunk->palette_size == (1u << chunk->bits) || chunk->palette_size >= RAXEL_VOXEL_CHUNK_VOLUME) {
+        // full, or more entries than voxels: drop dead entries first, and only widen if that was not enough
+        raxel_voxel_chunk_compact(chunk);
+        if (chunk->bits == 0) {
+            return __raxel_voxel_chunk_palette_index(chunk, material);
+        }
+        if (chunk->palette_size == (1u << chunk->bits)) {
+            uint32_t new_bits = chunk->bits * 2;
+            uint32_t capacity = chunk->palette_size * 2;
+            raxel_material_handle_t *palette = raxel_malloc(chunk->allocator, capacity * sizeof(raxel_material_handle_t));
+            memcpy(palette, chunk->palette, chunk->palette_size * sizeof(raxel_material_handle_t));
+            __raxel_voxel_chunk_repack(chunk, new_bits, palette, chunk->palette_size, capacity, NULL);
+        }
+    }
+    if (chunk->palette_size == chunk->palette_capacity) {
+        // the indices have room for more entries than the palette holds, so only the palette grows
+        uint32_t capacity = chunk->palette_capacity * 2;
+        if (capacity > (1u << chunk->bits)) {
+            capacity = 1u << chunk->bits;
+        }
+        raxel_material_handle_t *palette = raxel_malloc(chunk->allocator, capacity * sizeof(raxel_material_handle_t));
+        memcpy(palette, chunk->palette, chunk->palette_size * sizeof(raxel_material_handle_t));
+        raxel_free(chunk->allocator, chunk->palette);
+        chunk->palette = palette;
+        chunk->palette_capacity = capacity;
+    }
+    chunk->palette[chunk->palette_size] = material;
+    return chunk->palette_size++;
+}
+
+void raxel_voxel_chunk_set(raxel_voxel_chunk_t *chunk, raxel_size_t index, raxel_voxel_t voxel) {
+    raxel_material_handle_t previous = raxel_voxel_chunk_get(chunk, index).material;
+    if (previous == voxel.material) {
+        return;
+    }
+    chunk->revision++;
+    if ((previous != 0) != (voxel.material != 0)) {
+        __raxel_voxel_chunk_occupancy_fill(chunk, index, 1, voxel.material != 0);
+    }
+    uint32_t palette_index = __raxel_voxel_chunk_palette_index(chunk, voxel.material);
+    __raxel_voxel_chunk_write_index(chunk->data, chunk->bits, index, palette_index);
+}
+
+void raxel_voxel_chunk_fill_span(raxel_voxel_chunk_t *chunk, raxel_size_t start, raxel_size_t count, raxel_voxel_t voxel) {
+    if (count == 0) {
+        return;
+    }
+    if (start == 0 && count >= RAXEL_VOXEL_CHUNK_VOLUME) {
+        raxel_voxel_chunk_fill(chunk, voxel);
+        return;
+    }
+    if (chunk->bits == 0 && chunk->uniform_material == voxel.material) {
+        return;
+    }
+    chunk->revision++;
+    __raxel_voxel_chunk_occupancy_fill(chunk, start, count, voxel.material != 0);
+    uint32_t palette_index = __raxel_voxel_chunk_palette_index(chunk, voxel.material);
+    uint32_t bits = chunk->bits;
+
+    // the index replicated across a whole word; spans then become masked word stores
+    uint64_t pattern = 0;
+    for (uint32_t b = 0; b < 64; b += bits) {
+        pattern |= (uint64_t)palette_index << b;
+    }
+    raxel_size_t bit = start * bits;
+    raxel_size_t bit_end = (start + count) * bits;
+    while (bit < bit_end) {
+        raxel_size_t word = bit >> 6;
+        uint32_t offset = (uint32_t)(bit & 63);
+        raxel_size_t n = 64 - offset;
+        if (n > bit_end - bit) {
+            n = bit_end - bit;
+        }
+        uint64_t mask = (n == 64) ? ~0ULL : (((1ULL << n) - 1) << offset);
+        chunk->data[word] = (chunk->data[word] & ~mask) | (pattern & mask);
+        bit += n;
+    }
+}
+
+void raxel_voxel_chunk_fill(raxel_voxel_chunk_t *chunk, raxel_voxel_t voxel) {
+    if (chunk->bits == 0 && chunk->uniform_material == voxel.material) {
+        return;
+    }
+    raxel_voxel_chunk_release(chunk);
+    chunk->revision++;
+    chunk->solid_count = voxel.material ? RAXEL_VOXEL_CHUNK_VOLUME : 0;
+    chunk->uniform_material = voxel.material;
+    chunk->palette_size = 1;
+    chunk->palette_capacity = 0;
+    chunk->bits = 0;
+}
+
+void raxel_voxel_chunk_assign_packed(raxel_voxel_chunk_t *chunk,
+                                     uint32_t bits,
+                                     const raxel_material_handle_t *palette,
+                                     uint32_t palette_size,
+                                     const uint64_t *data) {
+    raxel_voxel_chunk_release(chunk);
+    chunk->revision++;
+    if (bits == 0) {
+        chunk->uniform_material = palette[0];
+        chunk->palette_size = 1;
+        chunk->bits = 0;
+        chunk->solid_count = palette[0] ? RAXEL_VOXEL_CHUNK_VOLUME : 0;
+        return;
+    }
+    // one spare entry, so indices past palette_size can be pointed at an empty one
+    uint32_t capacity = palette_size < (1u << bits) ? palette_size + 1 : palette_size;
+    chunk->palette = raxel_malloc(chunk->allocator, capacity * sizeof(raxel_material_handle_t));
+    memcpy(chunk->palette, palette, palette_size * sizeof(raxel_material_handle_t));
+    chunk->data = raxel_malloc(chunk->allocator, __RAXEL_CHUNK_WORDS(bits) * sizeof(uint64_t));
+    memcpy(chunk->data, data, __RAXEL_CHUNK_WORDS(bits) * sizeof(uint64_t));
+    chunk->palette_size = palette_size;
+    chunk->palette_capacity = capacity;
+    chunk->bits = bits;
+
+    // indices past palette_size read as empty
+    for (raxel_size_t v = 0; v < RAXEL_VOXEL_CHUNK_VOLUME; v++) {
+        if (__raxel_voxel_chunk_read_index(chunk->data, bits, v) >= chunk->palette_size) {
+            if (chunk->palette_size == palette_size) {
+                chunk->palette[chunk->palette_size++] = 0;
+            }
+            __raxel_voxel_chunk_write_index(chunk->data, bits, v, palette_size);
+        }
+    }
+    data = chunk->data;
+
+    // one occupancy word covers 64 voxels, i.e. `bits` packed words
+    uint64_t *occupancy = raxel_malloc(chunk->allocator, RAXEL_VOXEL_CHUNK_OCCUPANCY_WORDS * sizeof(uint64_t));
+    uint32_t solid_count = 0;
+    raxel_size_t i = 0;
+    for (raxel_size_t w = 0; w < RAXEL_VOXEL_CHUNK_OCCUPANCY_WORDS; w++) {
+        uint64_t word = 0;
+        for (uint32_t k = 0; k < 64; k++, i++) {
+            word |= (uint64_t)(chunk->palette[__raxel_voxel_chunk_read_index(data, bits, i)] != 0) << k;
+        }
+        occupancy[w] = word;
+        solid_count += (uint32_t)__builtin_popcountll(word);
+    }
+    chunk->solid_count = solid_count;
+    if (solid_count == 0 || solid_count == RAXEL_VOXEL_CHUNK_VOLUME) {
+        raxel_free(chunk->allocator, occupancy);  // implied by solid_count
+    } else {
+        chunk->occupancy = occupancy;
+    }
+}
+
+void raxel_voxel_chunk_decode(const raxel_voxel_chunk_t *chunk, raxel_voxel_t *out) {
+    if (chunk->solid_count == 0) {
+        memset(out, 0, RAXEL_VOXEL_CHUNK_VOLUME * sizeof(raxel_voxel_t));
+        return;
+    }
+    if (chunk->bits == 0) {
+        for (raxel_size_t i = 0; i < RAXEL_VOXEL_CHUNK_VOLUME; i++) {
+            out[i].material = chunk->uniform_material;
+        }
+        return;
+    }
+    uint32_t bits = chunk->bits;
+    uint32_t per_word = 64 / bits;
+    uint64_t mask = (1ULL << bits) - 1;
+    raxel_size_t i = 0;
+    for (raxel_size_t w = 0; w < __RAXEL_CHUNK_WORDS(bits); w++) {
+        uint64_t word = chunk->data[w];
+        for (uint32_t k = 0; k < per_word; k++, i++) {
+            out[i].material = chunk->palette[word & mask];
+            word >>= bits;
+        }
+    }
+}
+
+raxel_size_t raxel_voxel_chunk_memory_usage(const raxel_voxel_chunk_t *chunk) {
+    raxel_size_t bytes = sizeof(raxel_voxel_chunk_t);
+    if (chunk->bits > 0) {
+        bytes += chunk->palette_capacity * sizeof(raxel_material_handle_t);
+        bytes += __RAXEL_CHUNK_WORDS(chunk->bits) * sizeof(uint64_t);
+    }
+    if (chunk->occupancy) {
+        bytes += RAXEL_VOXEL_CHUNK_OCCUPANCY_WORDS * sizeof(uint64_t);
+    }
+    return bytes;
+}
+
+raxel_size_t raxel_voxel_chunk_merge_boxes(const raxel_voxel_chunk_t *chunk, raxel_voxel_t *scratch, raxel_voxel_chunk_box_t *out) {
+    const int n = RAXEL_VOXEL_CHUNK_SIZE;
+    if (chunk->solid_count == 0) {
+        return 0;
+    }
+    if (chunk->bits == 0) {
+        *out = (raxel_voxel_chunk_box_t){ .min = {0, 0, 0}, .max = {n, n, n}, .material = chunk->uniform_material };
+        return 1;
+    }
+    // covered voxels are cleared in the decoded copy, so only uncovered ones can start or grow a box
+    raxel_voxel_chunk_decode(chunk, scratch);
+    raxel_size_t num_boxes = 0;
+    for (raxel_size_t i = raxel_voxel_chunk_next_solid(chunk, 0); i < RAXEL_VOXEL_CHUNK_VOLUME; i = raxel_voxel_chunk_next_solid(chunk, i + 1)) {
+        raxel_material_handle_t material = scratch[i].material;
+        if (material == 0) {
+            continue;
+        }
+        int x0 = (int)(i % n), y0 = (int)(i / n % n), z0 = (int)(i / (n * n));
+        int x1 = x0 + 1;
+        while (x1 < n && scratch[i + (x1 - x0)].material == material) {
+            x1++;
+        }
+        int y1 = y0 + 1;
+        for (; y1 < n; y1++) {
+            raxel_voxel_t *row = &scratch[i + (raxel_size_t)(y1 - y0) * n];
+            int x = 0;
+            while (x < x1 - x0 && row[x].material == material) {
+                x++;
+            }
+            if (x < x1 - x0) {
+                break;
+            }
+        }
+        int z1 = z0 + 1;
+        for (; z1 < n; z1++) {
+            int full = 1;
+            for (int y = y0; y < y1 && full; y++) {
+                raxel_voxel_t *row = &scratch[(raxel_size_t)z1 * n * n + (raxel_size_t)y * n + x0];
+                for (int x = 0; x < x1 - x0; x++) {
+                    if (row[x].material != material) {
+                        full = 0;
+                        break;
+                    }
+                }
+            }
+            if (!full) {
+                break;
+            }
+        }
+        for (int z = z0; z < z1; z++) {
+            for (int y = y0; y < y1; y++) {
+                memset(&scratch[(raxel_size_t)z * n * n + (raxel_size_t)y * n + x0], 0, (x1 - x0) * sizeof(raxel_voxel_t));
+            }
+        }
+        out[num_boxes++] = (raxel_voxel_chunk_box_t){
+            .min = {(uint8_t)x0, (uint8_t)y0, (uint8_t)z0},
+            .max = {(uint8_t)x1, (uint8_t)y1, (uint8_t)z1},
+            .material = material,
+        };
+    }
+    return num_boxes;
+}
+
+// =============================================================================
+// 3. Chunk Pool
+// =============================================================================
+
+raxel_voxel_chunk_pool_t *raxel_voxel_chunk_pool_create(raxel_allocator_t *allocator) {
+    raxel_voxel_chunk_pool_t *pool = raxel_malloc(allocator, sizeof(raxel_voxel_chunk_pool_t));
+    pool->pages = raxel_list_create_reserve(raxel_voxel_chunk_t *, allocator, 8);
+    pool->free_list = raxel_list_create_reserve(raxel_voxel_chunk_handle_t, allocator, 8);
+    pool->num_handles = 0;
+    pool->num_live = 0;
+    pool->allocator = allocator;
+    return pool;
+}
+
+void raxel_voxel_chunk_pool_destroy(raxel_voxel_chunk_pool_t *pool) {
+    // freed chunks have already released (and cleared) their storage, so this is safe for every handle
+    for (raxel_size_t h = 0; h < pool->num_handles; h++) {
+        raxel_voxel_chunk_release(raxel_voxel_chunk_pool_get(pool, (raxel_voxel_chunk_handle_t)h));
+    }
+    for (raxel_size_t i = 0; i < raxel_list_size(pool->pages); i++) {
+        raxel_free(pool->allocator, pool->pages[i]);
+    }
+    raxel_list_destroy(pool->pages);
+    raxel_list_destroy(pool->free_list);
+    raxel_free(pool->allocator, pool);
+}
+
+raxel_voxel_chunk_handle_t raxel_voxel_chunk_pool_alloc(raxel_voxel_chunk_pool_t *pool) {
+    raxel_voxel_chunk_handle_t handle;
+    uint32_t revision = 0;
+    raxel_size_t num_free = raxel_list_size(pool->free_list);
+    if (num_free > 0) {
+        handle = pool->free_list[num_free - 1];
+        raxel_list_size(pool->free_list) = num_free - 1;
+        // a reused handle must not look like an unchanged copy of the chunk it replaced
+        revision = raxel_voxel_chunk_pool_get(pool, handle)->revision + 1;
+    } else {
+        if (pool->num_handles == raxel_list_size(pool->pages) * RAXEL_VOXEL_CHUNK_POOL_PAGE_CHUNKS) {
+            // only the page table grows, the pages themselves never move
+            raxel_voxel_chunk_t *page = raxel_malloc(pool->allocator, RAXEL_VOXEL_CHUNK_POOL_PAGE_CHUNKS * sizeof(raxel_voxel_chunk_t));
+            if (!page) {
+                RAXEL_CORE_FATAL_ERROR("Failed to allocate chunk pool page\n");
+                return RAXEL_VOXEL_CHUNK_HANDLE_INVALID;
+            }
+            raxel_list_push_back(pool->pages, page);
+        }
+        handle = (raxel_voxel_chunk_handle_t)pool->num_handles++;
+    }
+    pool->num_live++;
+    raxel_voxel_chunk_t *chunk = raxel_voxel_chunk_pool_get(pool, handle);
+    raxel_voxel_chunk_init(chunk, pool->allocator);
+    chunk->revision = revision;
+    return handle;
+}
+
+void raxel_voxel_chunk_pool_free(raxel_voxel_chunk_pool_t *pool, raxel_voxel_chunk_handle_t handle) {
+    if (handle == RAXEL_VOXEL_CHUNK_HANDLE_INVALID) {
+        return;
+    }
+    raxel_voxel_chunk_release(raxel_voxel_chunk_pool_get(pool, handle));
+    raxel_list_push_back(pool->free_list, handle);
+    pool->num_live--;
+}
@@ -0,0 +1,215 @@
+#ifndef __RAXEL_CHUNK_H__
+#define __RAXEL_CHUNK_H__
+
+#include <raxel/core/util.h>  // for raxel_allocator_t, raxel_list, etc.
+#include <stdint.h>
+
+typedef uint32_t raxel_material_handle_t;
+typedef int32_t raxel_coord_t;
+
+typedef struct raxel_voxel {
+    raxel_material_handle_t material;
+} raxel_voxel_t;
+
+#define RAXEL_VOXEL_CHUNK_SIZE 32
+#define RAXEL_VOXEL_CHUNK_VOLUME (RAXEL_VOXEL_CHUNK_SIZE * RAXEL_VOXEL_CHUNK_SIZE * RAXEL_VOXEL_CHUNK_SIZE)
+#define RAXEL_VOXEL_CHUNK_OCCUPANCY_WORDS (RAXEL_VOXEL_CHUNK_VOLUME / 64)
+#define RAXEL_VOXEL_CHUNK_PACKED_WORDS(bits) ((raxel_size_t)RAXEL_VOXEL_CHUNK_VOLUME * (bits) / 64)
+
+typedef enum raxel_voxel_chunk_state {
+    RAXEL_VOXEL_CHUNK_STATE_DEFAULT = 0,
+    // GPU copy only: the slot keeps an unloaded chunk for reuse. The shader does not read the state,
+    // it skips these slots because no BVH instance refers to them.
+    RAXEL_VOXEL_CHUNK_STATE_CACHED,
+    RAXEL_VOXEL_CHUNK_STATE_COUNT,
+} raxel_voxel_chunk_state_t;
+
+typedef struct raxel_voxel_chunk_meta {
+    // defines the bottom-left corner of the chunk
+    raxel_coord_t x;
+    raxel_coord_t y;
+    raxel_coord_t z;
+    raxel_voxel_chunk_state_t state;
+} raxel_voxel_chunk_meta_t;
+
+// Chunks are palette compressed: every voxel stores an index into the chunk's palette of materials,
+// bit-packed into 64-bit words at 0, 1, 2, 4, 8 or 16 bits per voxel. Since the widths divide 64, an
+// index never straddles two words. At 0 bits the chunk is uniform and only uniform_material is used.
+// Placing a material that does not fit the palette transparently compacts and/or widens the storage.
+//
+// Next to the palette, every chunk tracks which voxels are non-empty: one occupancy bit per voxel (in
+// flat index order, so a 64-bit word covers two x-rows) and the number of solid voxels. The mask is
+// only allocated once the chunk is partially filled; while it is NULL the chunk is either completely
+// empty or completely solid, which solid_count tells apart.
+typedef struct raxel_voxel_chunk {
+    raxel_material_handle_t uniform_material;  // the material of every voxel when bits == 0
+    raxel_material_handle_t *palette;          // palette_size entries, room for palette_capacity; NULL when bits == 0
+    uint64_t *data;                            // packed palette indices; NULL when bits == 0
+    uint64_t *occupancy;                       // RAXEL_VOXEL_CHUNK_OCCUPANCY_WORDS words, or NULL (see above)
+    uint32_t solid_count;                      // number of voxels with a non-zero material
+    uint32_t revision;                         // bumped on every edit, used to find stale GPU copies
+    uint32_t palette_size;
+    uint32_t palette_capacity;                 // grows by doubling up to (1 << bits), not allocated up front
+    uint32_t bits;                             // bits per voxel index: 0, 1, 2, 4, 8 or 16
+    raxel_allocator_t *allocator;
+} raxel_voxel_chunk_t;
+
+/**
+ * Initialize a chunk as uniformly empty. Does not allocate.
+ */
+void raxel_voxel_chunk_init(raxel_voxel_chunk_t *chunk, raxel_allocator_t *allocator);
+
+/**
+ * Free the palette, packed data and occupancy mask of a chunk.
+ */
+void raxel_voxel_chunk_release(raxel_voxel_chunk_t *chunk);
+
+static inline raxel_voxel_t raxel_voxel_chunk_get(const raxel_voxel_chunk_t *chunk, raxel_size_t index) {
+    raxel_voxel_t voxel;
+    if (chunk->bits == 0) {
+        voxel.material = chunk->uniform_material;
+        return voxel;
+    }
+    raxel_size_t bit = index * chunk->bits;
+    uint64_t palette_index = (chunk->data[bit >> 6] >> (bit & 63)) & ((1ULL << chunk->bits) - 1);
+    voxel.material = chunk->palette[palette_index];
+    return voxel;
+}
+
+static inline int raxel_voxel_chunk_is_empty(const raxel_voxel_chunk_t *chunk) {
+    return chunk->solid_count == 0;
+}
+
+static inline int raxel_voxel_chunk_is_full(const raxel_voxel_chunk_t *chunk) {
+    return chunk->solid_count == RAXEL_VOXEL_CHUNK_VOLUME;
+}
+
+// 64 occupancy bits starting at voxel word * 64.
+static inline uint64_t raxel_voxel_chunk_occupancy_word(const raxel_voxel_chunk_t *chunk, raxel_size_t word) {
+    if (!chunk->occupancy) {
+        return chunk->solid_count ? ~0ULL : 0ULL;
+    }
+    return chunk->occupancy[word];
+}
+
+static inline int raxel_voxel_chunk_is_solid(const raxel_voxel_chunk_t *chunk, raxel_size_t index) {
+    return (int)((raxel_voxel_chunk_occupancy_word(chunk, index >> 6) >> (index & 63)) & 1);
+}
+
+/**
+ * Returns the flat index of the first solid voxel at or after index, or RAXEL_VOXEL_CHUNK_VOLUME
+ * if there is none. Iterate the solid voxels of a chunk with:
+ *   for (i = raxel_voxel_chunk_next_solid(c, 0); i < RAXEL_VOXEL_CHUNK_VOLUME; i = raxel_voxel_chunk_next_solid(c, i + 1))
+ */
+static inline raxel_size_t raxel_voxel_chunk_next_solid(const raxel_voxel_chunk_t *chunk, raxel_size_t index) {
+    if (chunk->solid_count == 0 || index >= RAXEL_VOXEL_CHUNK_VOLUME) {
+        return RAXEL_VOXEL_CHUNK_VOLUME;
+    }
+    raxel_size_t word = index >> 6;
+    uint64_t bits = raxel_voxel_chunk_occupancy_word(chunk, word) & (~0ULL << (index & 63));
+    while (!bits) {
+        if (++word == RAXEL_VOXEL_CHUNK_OCCUPANCY_WORDS) {
+            return RAXEL_VOXEL_CHUNK_VOLUME;
+        }
+        bits = raxel_voxel_chunk_occupancy_word(chunk, word);
+    }
+    return (word << 6) + (raxel_size_t)__builtin_ctzll(bits);
+}
+
+void raxel_voxel_chunk_set(raxel_voxel_chunk_t *chunk, raxel_size_t index, raxel_voxel_t voxel);
+
+/**
+ * Set count consecutive voxels starting at a flat index, e.g. an x-row. Whole packed words
+ * are written at once.
+ */
+void raxel_voxel_chunk_fill_span(raxel_voxel_chunk_t *chunk, raxel_size_t start, raxel_size_t count, raxel_voxel_t voxel);
+
+/**
+ * Set every voxel in the chunk, turning it back into a uniform chunk.
+ */
+void raxel_voxel_chunk_fill(raxel_voxel_chunk_t *chunk, raxel_voxel_t voxel);
+
+/**
+ * Replace the contents of a chunk with packed storage, e.g. as read back from disk: palette_size
+ * materials (at most 1 << bits) and RAXEL_VOXEL_CHUNK_PACKED_WORDS(bits) words of indices. For a
+ * uniform chunk bits is 0, palette[0] is its material and data is ignored. The occupancy mask and
+ * solid count are rebuilt.
+ */
+void raxel_voxel_chunk_assign_packed(raxel_voxel_chunk_t *chunk,
+                                     uint32_t bits,
+                                     const raxel_material_handle_t *palette,
+                                     uint32_t palette_size,
+                                     const uint64_t *data);
+
+/**
+ * Drop unused palette entries and shrink the index width if possible.
+ */
+void raxel_voxel_chunk_compact(raxel_voxel_chunk_t *chunk);
+
+/**
+ * Expand the chunk into RAXEL_VOXEL_CHUNK_VOLUME dense voxels (e.g. for GPU upload).
+ */
+void raxel_voxel_chunk_decode(const raxel_voxel_chunk_t *chunk, raxel_voxel_t *out);
+
+/**
+ * Bytes of memory owned by the chunk, including the chunk struct itself.
+ */
+raxel_size_t raxel_voxel_chunk_memory_usage(const raxel_voxel_chunk_t *chunk);
+
+// An axis-aligned box of voxels of one material, in chunk-local voxel coordinates.
+typedef struct raxel_voxel_chunk_box {
+    uint8_t min[3];
+    uint8_t max[3];  // exclusive, up to RAXEL_VOXEL_CHUNK_SIZE
+    raxel_material_handle_t material;
+} raxel_voxel_chunk_box_t;
+
+/**
+ * Cover the solid voxels of a chunk with boxes of one material each, so every solid voxel is in
+ * exactly one box. Greedy in flat index order: from the first voxel not yet covered, a run along x
+ * grows into a slab along y and the slab into a box along z, as far as the material continues.
+ *
+ * @param scratch RAXEL_VOXEL_CHUNK_VOLUME voxels to work in.
+ * @param out Room for solid_count boxes, the most there can be.
+ * @return The number of boxes written.
+ */
+raxel_size_t raxel_voxel_chunk_merge_boxes(const raxel_voxel_chunk_t *chunk, raxel_voxel_t *scratch, raxel_voxel_chunk_box_t *out);
+
+/**------------------------------------------------------------------------
+ *                           CHUNK POOL
+ *------------------------------------------------------------------------**/
+
+// Chunks live in fixed-size pages that are never moved or reallocated, so a handle (and the
+// pointer it resolves to) stays valid until the chunk is freed, no matter how much the pool grows.
+typedef uint32_t raxel_voxel_chunk_handle_t;
+
+#define RAXEL_VOXEL_CHUNK_HANDLE_INVALID UINT32_MAX
+// Chunk headers are small now that voxel data lives in the palette storage, so a page holds
+// 64 of them (one allocation per 64 loaded chunks) rather than the 16 dense chunks it used to.
+#define RAXEL_VOXEL_CHUNK_POOL_PAGE_CHUNKS 64
+
+typedef struct raxel_voxel_chunk_pool {
+    raxel_list(raxel_voxel_chunk_t *) pages;            // each page holds RAXEL_VOXEL_CHUNK_POOL_PAGE_CHUNKS chunks
+    raxel_list(raxel_voxel_chunk_handle_t) free_list;  // handles of freed chunks, reused first
+    raxel_size_t num_handles;                           // handles handed out so far, live or freed
+    raxel_size_t num_live;                              // chunks currently allocated
+    raxel_allocator_t *allocator;                       // used for pages and chunk storage
+} raxel_voxel_chunk_pool_t;
+
+raxel_voxel_chunk_pool_t *raxel_voxel_chunk_pool_create(raxel_allocator_t *allocator);
+void raxel_voxel_chunk_pool_destroy(raxel_voxel_chunk_pool_t *pool);
+
+/**
+ * Allocate a chunk from the pool. The chunk starts out uniformly empty.
+ */
+raxel_voxel_chunk_handle_t raxel_voxel_chunk_pool_alloc(raxel_voxel_chunk_pool_t *pool);
+
+/**
+ * Return a chunk (and its storage) to the pool. The handle must not be used afterwards.
+ */
+void raxel_voxel_chunk_pool_free(raxel_voxel_chunk_pool_t *pool, raxel_voxel_chunk_handle_t handle);
+
+static inline raxel_voxel_chunk_t *raxel_voxel_chunk_pool_get(raxel_voxel_chunk_pool_t *pool, raxel_voxel_chunk_handle_t handle) {
+    return &pool->pages[handle / RAXEL_VOXEL_CHUNK_POOL_PAGE_CHUNKS][handle % RAXEL_VOXEL_CHUNK_POOL_PAGE_CHUNKS];
+}
+
+#endif  // __RAXEL_CHUNK_H__
@@ -0,0 +1,569 @@
+// raxel_tree64.c
+
+#include "raxel_tree64.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// =============================================================================
+// 0. Pool and Node Helpers
+// =============================================================================
+
+// Appends words to the pool and returns the offset of the first one.
+static uint32_t __raxel_tree64_alloc(raxel_tree64_t *tree, raxel_size_t words) {
+    raxel_size_t offset = raxel_list_size(tree->pool);
+    if (offset + words > raxel_list_capacity(tree->pool)) {
+        raxel_size_t capacity = raxel_list_capacity(tree->pool) * 2;
+        if (capacity < offset + words) {
+            capacity = offset + words;
+        }
+        raxel_list_resize(tree->pool, capacity);
+    }
+    raxel_list_size(tree->pool) = offset + words;
+    return (uint32_t)offset;
+}
+
+static inline raxel_tree64_node_t __raxel_tree64_read(const raxel_tree64_t *tree, uint32_t offset) {
+    raxel_tree64_node_t node;
+    memcpy(&node, &tree->pool[offset], sizeof(node));
+    return node;
+}
+
+static inline void __raxel_tree64_write(raxel_tree64_t *tree, uint32_t offset, const raxel_tree64_node_t *node) {
+    memcpy(&tree->pool[offset], node, sizeof(*node));
+}
+
+static inline uint64_t __raxel_tree64_mask(const raxel_tree64_node_t *node) {
+    return ((uint64_t)node->mask[1] << 32) | node->mask[0];
+}
+
+static inline void __raxel_tree64_set_mask(raxel_tree64_node_t *node, uint64_t mask) {
+    node->mask[0] = (uint32_t)mask;
+    node->mask[1] = (uint32_t)(mask >> 32);
+}
+
+static inline uint32_t __raxel_tree64_rank(uint64_t mask, uint32_t child) {
+    return (uint32_t)__builtin_popcountll(mask & ((1ULL << child) - 1));
+}
+
+static inline raxel_tree64_node_t __raxel_tree64_empty_node(void) {
+    raxel_tree64_node_t node = {{0, 0}, 0, RAXEL_TREE64_NODE_INTERIOR};
+    return node;
+}
+
+// Turns the packed children of a node into the node itself. A node whose children are all solid
+// with one material collapses into a solid node, everything else gets its children block
+// appended. Returns 0 if there are no children.
+static int __raxel_tree64_finish(raxel_tree64_t *tree, uint64_t mask, const raxel_tree64_node_t *children, raxel_tree64_node_t *out) {
+    uint32_t n = (uint32_t)__builtin_popcountll(mask);
+    if (n == 0) {
+        return 0;
+    }
+    int solid = 1;
+    for (uint32_t i = 0; i < n && solid; i++) {
+        solid = children[i].kind == RAXEL_TREE64_NODE_SOLID &&
+                children[i].mask[0] == UINT32_MAX && children[i].mask[1] == UINT32_MAX &&
+                children[i].first == children[0].first;
+    }
+    __raxel_tree64_set_mask(out, mask);
+    if (solid) {
+        out->kind = RAXEL_TREE64_NODE_SOLID;
+        out->first = children[0].first;
+        return 1;
+    }
+    out->kind = RAXEL_TREE64_NODE_INTERIOR;
+    out->first = __raxel_tree64_alloc(tree, n * RAXEL_TREE64_NODE_WORDS);
+    memcpy(&tree->pool[out->first], children, n * sizeof(raxel_tree64_node_t));
+    return 1;
+}
+
+// =============================================================================
+// 1. Nodes from Chunks
+// =============================================================================
+
+// Level 1 node for the 4^3 voxels starting at local chunk coordinates (x0, y0, z0). Returns 0
+// if they are all empty.
+static int __raxel_tree64_make_brick(raxel_tree64_t *tree, const raxel_voxel_chunk_t *chunk,
+                                     uint32_t x0, uint32_t y0, uint32_t z0, raxel_tree64_node_t *out) {
+    // an occupancy word covers two x-rows, take 4 bits of each row
+    uint64_t mask = 0;
+    for (uint32_t z = 0; z < 4; z++) {
+        for (uint32_t y = 0; y < 4; y++) {
+            raxel_size_t flat = x0 + (y0 + y) * RAXEL_VOXEL_CHUNK_SIZE + (z0 + z) * RAXEL_VOXEL_CHUNK_SIZE * RAXEL_VOXEL_CHUNK_SIZE;
+            uint64_t bits = (raxel_voxel_chunk_occupancy_word(chunk, flat >> 6) >> (flat & 63)) & 0xF;
+            mask |= bits << RAXEL_TREE64_CHILD_INDEX(0, y, z);
+        }
+    }
+    if (!mask) {
+        return 0;
+    }
+    __raxel_tree64_set_mask(out, mask);
+    if (chunk->bits == 0) {
+        out->kind = RAXEL_TREE64_NODE_SOLID;
+        out->first = chunk->uniform_material;
+        return 1;
+    }
+
+    // materials of the solid voxels in mask order; bricks of a single material store it inline
+    raxel_material_handle_t materials[64];
+    uint32_t n = 0;
+    int uniform = 1;
+    for (uint64_t m = mask; m; m &= m - 1) {
+        uint32_t i = (uint32_t)__builtin_ctzll(m);
+        raxel_size_t flat = (x0 + (i & 3)) +
+                            (y0 + ((i >> 2) & 3)) * RAXEL_VOXEL_CHUNK_SIZE +
+                            (z0 + (i >> 4)) * RAXEL_VOXEL_CHUNK_SIZE * RAXEL_VOXEL_CHUNK_SIZE;
+        materials[n] = raxel_voxel_chunk_get(chunk, flat).material;
+        uniform &= materials[n] == materials[0];
+        n++;
+    }
+    if (uniform) {
+        out->kind = RAXEL_TREE64_NODE_SOLID;
+        out->first = materials[0];
+        return 1;
+    }
+    out->kind = RAXEL_TREE64_NODE_VOXELS;
+    out->first = __raxel_tree64_alloc(tree, n);
+    memcpy(&tree->pool[out->first], materials, n * sizeof(raxel_material_handle_t));
+    return 1;
+}
+
+// Level 2 node for one 16^3 octant of a chunk (bit 0 of octant selects the upper half in x,
+// bit 1 in y, bit 2 in z). Returns 0 if the octant is empty.
+static int __raxel_tree64_make_cell(raxel_tree64_t *tree, const raxel_voxel_chunk_t *chunk, uint32_t octant, raxel_tree64_node_t *out) {
+    if (!chunk || raxel_voxel_chunk_is_empty(chunk)) {
+        return 0;
+    }
+    if (chunk->bits == 0 && raxel_voxel_chunk_is_full(chunk)) {
+        __raxel_tree64_set_mask(out, ~0ULL);
+        out->kind = RAXEL_TREE64_NODE_SOLID;
+        out->first = chunk->uniform_material;
+        return 1;
+    }
+    uint32_t x0 = (octant & 1) * 16;
+    uint32_t y0 = ((octant >> 1) & 1) * 16;
+    uint32_t z0 = ((octant >> 2) & 1) * 16;
+    raxel_tree64_node_t bricks[64];
+    uint32_t n = 0;
+    uint64_t mask = 0;
+    for (uint32_t i = 0; i < 64; i++) {
+        if (__raxel_tree64_make_brick(tree, chunk, x0 + (i & 3) * 4, y0 + ((i >> 2) & 3) * 4, z0 + (i >> 4) * 4, &bricks[n])) {
+            mask |= 1ULL << i;
+            n++;
+        }
+    }
+    return __raxel_tree64_finish(tree, mask, bricks, out);
+}
+
+// =============================================================================
+// 2. Build
+// =============================================================================
+
+void raxel_tree64_init(raxel_tree64_t *tree, raxel_allocator_t *allocator) {
+    tree->allocator = allocator;
+    tree->pool = raxel_list_create_reserve(uint32_t, allocator, 1024);
+    tree->generation = 0;
+    raxel_tree64_build(tree, NULL, 0);
+}
+
+void raxel_tree64_release(raxel_tree64_t *tree) {
+    raxel_list_destroy(tree->pool);
+    tree->pool = NULL;
+}
+
+// A level 2 cell of the tree, keyed by its path from the root: 6 bits per level, the root's
+// child index in the highest bits. Sorting by key puts the cells below any node next to each
+// other, in child order.
+typedef struct __raxel_tree64_cell {
+    uint64_t key;
+    const raxel_voxel_chunk_t *chunk;
+    uint32_t octant;
+} __raxel_tree64_cell_t;
+
+static int __raxel_tree64_cell_compare(const void *a, const void *b) {
+    uint64_t ka = ((const __raxel_tree64_cell_t *)a)->key;
+    uint64_t kb = ((const __raxel_tree64_cell_t *)b)->key;
+    return (ka > kb) - (ka < kb);
+}
+
+static uint64_t __raxel_tree64_cell_key(uint32_t cx, uint32_t cy, uint32_t cz, uint32_t depth) {
+    uint64_t key = 0;
+    for (uint32_t level = depth; level >= 3; level--) {
+        uint32_t shift = 2 * (level - 3);
+        uint32_t child = RAXEL_TREE64_CHILD_INDEX((cx >> shift) & 3, (cy >> shift) & 3, (cz >> shift) & 3);
+        key = (key << 6) | child;
+    }
+    return key;
+}
+
+// Node at level for cells[begin, end), which all lie in it. Children are written before their
+// parent, so the pool ends up in post-order.
+static int __raxel_tree64_emit(raxel_tree64_t *tree, const __raxel_tree64_cell_t *cells,
+                               raxel_size_t begin, raxel_size_t end, uint32_t level, raxel_tree64_node_t *out) {
+    if (level == 2) {
+        return __raxel_tree64_make_cell(tree, cells[begin].chunk, cells[begin].octant, out);
+    }
+    uint32_t shift = 6 * (level - 3);
+    raxel_tree64_node_t children[64];
+    uint32_t n = 0;
+    uint64_t mask = 0;
+    raxel_size_t i = begin;
+    while (i < end) {
+        uint32_t child = (uint32_t)(cells[i].key >> shift) & 63;
+        raxel_size_t j = i + 1;
+        while (j < end && ((uint32_t)(cells[j].key >> shift) & 63) == child) {
+            j++;
+        }
+        if (__raxel_tree64_emit(tree, cells, i, j, level - 1, &children[n])) {
+            mask |= 1ULL << child;
+            n++;
+        }
+        i = j;
+    }
+    return __raxel_tree64_finish(tree, mask, children, out);
+}
+
+int raxel_tree64_build(raxel_tree64_t *tree, const raxel_tree64_chunk_ref_t *chunks, raxel_size_t n) {
+    tree->generation++;
+    raxel_list_size(tree->pool) = 0;
+    tree->garbage = 0;
+    tree->num_chunks = 0;
+    tree->origin[0] = tree->origin[1] = tree->origin[2] = 0;
+    tree->depth = 3;
+
+    // --- Fit the root around the non-empty chunks ---
+    raxel_coord_t min[3] = {0, 0, 0};
+    raxel_coord_t max[3] = {0, 0, 0};
+    for (raxel_size_t i = 0; i < n; i++) {
+        if (raxel_voxel_chunk_is_empty(chunks[i].chunk)) {
+            continue;
+        }
+        raxel_coord_t c[3] = {chunks[i].x, chunks[i].y, chunks[i].z};
+        for (int k = 0; k < 3; k++) {
+            if (tree->num_chunks == 0 || c[k] < min[k]) min[k] = c[k];
+            if (tree->num_chunks == 0 || c[k] > max[k]) max[k] = c[k];
+        }
+        tree->num_chunks++;
+    }
+    int64_t span = 1;
+    for (int k = 0; k < 3; k++) {
+        if ((int64_t)max[k] - min[k] + 1 > span) {
+            span = (int64_t)max[k] - min[k] + 1;
+        }
+    }
+    while ((1LL << (2 * tree->depth)) < span * RAXEL_VOXEL_CHUNK_SIZE) {
+        tree->depth++;
+    }
+    raxel_tree64_node_t root = __raxel_tree64_empty_node();
+    int result = 0;
+    if (tree->depth > RAXEL_TREE64_MAX_DEPTH) {
+        RAXEL_CORE_LOG_ERROR("Chunks span %lld chunks, more than a 64-tree of depth %d holds\n", (long long)span, RAXEL_TREE64_MAX_DEPTH);
+        tree->depth = 3;
+        tree->num_chunks = 0;
+        result = -1;
+    } else if (tree->num_chunks > 0) {
+        for (int k = 0; k < 3; k++) {
+            tree->origin[k] = min[k] * RAXEL_VOXEL_CHUNK_SIZE;
+        }
+
+        // --- Every chunk is 2x2x2 level 2 cells ---
+        __raxel_tree64_cell_t *cells = raxel_malloc(tree->allocator, tree->num_chunks * 8 * sizeof(__raxel_tree64_cell_t));
+        raxel_size_t num_cells = 0;
+        for (raxel_size_t i = 0; i < n; i++) {
+            if (raxel_voxel_chunk_is_empty(chunks[i].chunk)) {
+                continue;
+            }
+            uint32_t cx = (uint32_t)(chunks[i].x - min[0]) * 2;
+            uint32_t cy = (uint32_t)(chunks[i].y - min[1]) * 2;
+            uint32_t cz = (uint32_t)(chunks[i].z - min[2]) * 2;
+            for (uint32_t octant = 0; octant < 8; octant++) {
+                cells[num_cells].key = __raxel_tree64_cell_key(cx + (octant & 1), cy + ((octant >> 1) & 1), cz + (octant >> 2), tree->depth);
+                cells[num_cells].chunk = chunks[i].chunk;
+                cells[num_cells].octant = octant;
+                num_cells++;
+            }
+        }
+        qsort(cells, num_cells, sizeof(__raxel_tree64_cell_t), __raxel_tree64_cell_compare);
+        __raxel_tree64_emit(tree, cells, 0, num_cells, tree->depth, &root);
+        raxel_free(tree->allocator, cells);
+    }
+    tree->root = __raxel_tree64_alloc(tree, RAXEL_TREE64_NODE_WORDS);
+    __raxel_tree64_write(tree, tree->root, &root);
+    return result;
+}
+
+// =============================================================================
+// 3. Edits
+// =============================================================================
+
+// Pool words of a subtree, the node itself excluded.
+static raxel_size_t __raxel_tree64_subtree_words(const raxel_tree64_t *tree, const raxel_tree64_node_t *node) {
+    uint32_t n = (uint32_t)__builtin_popcountll(__raxel_tree64_mask(node));
+    if (node->kind == RAXEL_TREE64_NODE_SOLID) {
+        return 0;
+    }
+    if (node->kind == RAXEL_TREE64_NODE_VOXELS) {
+        return n;
+    }
+    raxel_size_t words = n * RAXEL_TREE64_NODE_WORDS;
+    for (uint32_t i = 0; i < n; i++) {
+        raxel_tree64_node_t child = __raxel_tree64_read(tree, node->first + i * RAXEL_TREE64_NODE_WORDS);
+        words += __raxel_tree64_subtree_words(tree, &child);
+    }
+    return words;
+}
+
+// Unpacks the children of an interior or solid node into children[64], indexed by child, and
+// counts the old children block as garbage. Solid nodes are split into solid children.
+static uint64_t __raxel_tree64_unpack(raxel_tree64_t *tree, const raxel_tree64_node_t *node, raxel_tree64_node_t *children) {
+    uint64_t mask = __raxel_tree64_mask(node);
+    uint32_t rank = 0;
+    for (uint64_t m = mask; m; m &= m - 1) {
+        uint32_t i = (uint32_t)__builtin_ctzll(m);
+        if (node->kind == RAXEL_TREE64_NODE_SOLID) {
+            __raxel_tree64_set_mask(&children[i], ~0ULL);
+            children[i].kind = RAXEL_TREE64_NODE_SOLID;
+            children[i].first = node->first;
+        } else {
+            children[i] = __raxel_tree64_read(tree, node->first + rank * RAXEL_TREE64_NODE_WORDS);
+        }
+        rank++;
+    }
+    if (node->kind == RAXEL_TREE64_NODE_INTERIOR) {
+        tree->garbage += rank * RAXEL_TREE64_NODE_WORDS;
+    }
+    return mask;
+}
+
+// Rewrites a node at level >= 3 with the 8 cells of the chunk at relative voxel coordinates rel
+// replaced. Only the nodes on the way down are copied. Returns 0 if the node ends up empty.
+static int __raxel_tree64_replace_chunk(raxel_tree64_t *tree, raxel_tree64_node_t *node, uint32_t level, const uint32_t rel[3],
+                                        const raxel_tree64_node_t *cells, uint32_t cell_mask, int *existed) {
+    raxel_tree64_node_t children[64];
+    uint64_t mask = __raxel_tree64_unpack(tree, node, children);
+    if (level == 3) {
+        for (uint32_t octant = 0; octant < 8; octant++) {
+            uint32_t child = RAXEL_TREE64_CHILD_INDEX(((rel[0] >> 4) & 3) + (octant & 1),
+                                                      ((rel[1] >> 4) & 3) + ((octant >> 1) & 1),
+                                                      ((rel[2] >> 4) & 3) + (octant >> 2));
+            if (mask & (1ULL << child)) {
+                *existed = 1;
+                tree->garbage += __raxel_tree64_subtree_words(tree, &children[child]);
+            }
+            if (cell_mask & (1u << octant)) {
+                children[child] = cells[octant];
+                mask |= 1ULL << child;
+            } else {
+                mask &= ~(1ULL << child);
+            }
+        }
+    } else {
+        uint32_t shift = 2 * (level - 1);
+        uint32_t child = RAXEL_TREE64_CHILD_INDEX((rel[0] >> shift) & 3, (rel[1] >> shift) & 3, (rel[2] >> shift) & 3);
+        if (!(mask & (1ULL << child))) {
+            children[child] = __raxel_tree64_empty_node();
+        }
+        if (__raxel_tree64_replace_chunk(tree, &children[child], level - 1, rel, cells, cell_mask, existed)) {
+            mask |= 1ULL << child;
+        } else {
+            mask &= ~(1ULL << child);
+        }
+    }
+
+    // pack the children back in mask order
+    uint32_t n = 0;
+    for (uint64_t m = mask; m; m &= m - 1) {
+        children[n++] = children[__builtin_ctzll(m)];
+    }
+    if (!__raxel_tree64_finish(tree, mask, children, node)) {
+        *node = __raxel_tree64_empty_node();
+        return 0;
+    }
+    return 1;
+}
+
+int raxel_tree64_set_chunk(raxel_tree64_t *tree, raxel_coord_t x, raxel_coord_t y, raxel_coord_t z, const raxel_voxel_chunk_t *chunk) {
+    int64_t size = 1LL << (2 * tree->depth);
+    raxel_coord_t c[3] = {x, y, z};
+    uint32_t rel[3];
+    for (int k = 0; k < 3; k++) {
+        int64_t r = (int64_t)c[k] * RAXEL_VOXEL_CHUNK_SIZE - tree->origin[k];
+        if (r < 0 || r + RAXEL_VOXEL_CHUNK_SIZE > size) {
+            return -1;
+        }
+        rel[k] = (uint32_t)r;
+    }
+
+    raxel_tree64_node_t cells[8];
+    uint32_t cell_mask = 0;
+    for (uint32_t octant = 0; octant < 8; octant++) {
+        if (__raxel_tree64_make_cell(tree, chunk, octant, &cells[octant])) {
+            cell_mask |= 1u << octant;
+        }
+    }
+    raxel_tree64_node_t root = __raxel_tree64_read(tree, tree->root);
+    int existed = 0;
+    __raxel_tree64_replace_chunk(tree, &root, tree->depth, rel, cells, cell_mask, &existed);
+    tree->root = __raxel_tree64_alloc(tree, RAXEL_TREE64_NODE_WORDS);
+    __raxel_tree64_write(tree, tree->root, &root);
+    tree->garbage += RAXEL_TREE64_NODE_WORDS;  // the old root
+    tree->num_chunks += (cell_mask != 0) - existed;
+    return 0;
+}
+
+// =============================================================================
+// 4. Queries
+// =============================================================================
+
+raxel_material_handle_t raxel_tree64_get(const raxel_tree64_t *tree, raxel_coord_t x, raxel_coord_t y, raxel_coord_t z) {
+    int64_t size = 1LL << (2 * tree->depth);
+    raxel_coord_t c[3] = {x, y, z};
+    uint32_t rel[3];
+    for (int k = 0; k < 3; k++) {
+        int64_t r = (int64_t)c[k] - tree->origin[k];
+        if (r < 0 || r >= size) {
+            return 0;
+        }
+        rel[k] = (uint32_t)r;
+    }
+    raxel_tree64_node_t node = __raxel_tree64_read(tree, tree->root);
+    for (uint32_t level = tree->depth;; level--) {
+        uint32_t shift = 2 * (level - 1);
+        uint32_t child = RAXEL_TREE64_CHILD_INDEX((rel[0] >> shift) & 3, (rel[1] >> shift) & 3, (rel[2] >> shift) & 3);
+        uint64_t mask = __raxel_tree64_mask(&node);
+        if (!(mask & (1ULL << child))) {
+            return 0;
+        }
+        if (node.kind == RAXEL_TREE64_NODE_SOLID) {
+            return node.first;
+        }
+        uint32_t rank = __raxel_tree64_rank(mask, child);
+        if (node.kind == RAXEL_TREE64_NODE_VOXELS) {
+            return tree->pool[node.first + rank];
+        }
+        node = __raxel_tree64_read(tree, node.first + rank * RAXEL_TREE64_NODE_WORDS);
+    }
+}
+
+// The ray walks the voxel grid relative to the tree origin. At every position it descends as far
+// as the tree goes; if that ends in an empty child cell, the ray jumps to where it leaves that
+// cell and resumes from the lowest node containing both cells, found from the highest bit in
+// which the old and new voxel coordinates differ.
+int raxel_tree64_raycast(const raxel_tree64_t *tree, const float origin[3], const float direction[3], float max_t, raxel_tree64_hit_t *hit) {
+    int32_t size = 1 << (2 * tree->depth);
+    float ro[3], inv[3];
+    for (int k = 0; k < 3; k++) {
+        ro[k] = origin[k] - (float)tree->origin[k];
+        inv[k] = direction[k] != 0.0f ? 1.0f / direction[k] : INFINITY;
+    }
+
+    // --- Enter the root ---
+    float t_enter = -INFINITY;
+    float t_leave = INFINITY;
+    int axis = -1;
+    for (int k = 0; k < 3; k++) {
+        if (direction[k] == 0.0f) {
+            if (ro[k] < 0.0f || ro[k] >= (float)size) {
+                return 0;
+            }
+            continue;
+        }
+        float t0 = (0.0f - ro[k]) * inv[k];
+        float t1 = ((float)size - ro[k]) * inv[k];
+        float near = fminf(t0, t1);
+        float far = fmaxf(t0, t1);
+        if (near > t_enter) {
+            t_enter = near;
+            axis = k;
+        }
+        t_leave = fminf(t_leave, far);
+    }
+    if (t_enter <= 0.0f) {
+        t_enter = 0.0f;
+        axis = -1;  // starts inside, no face was crossed
+    }
+    if (t_leave < t_enter || t_enter > max_t) {
+        return 0;
+    }
+    int32_t ip[3];
+    for (int k = 0; k < 3; k++) {
+        float p = ro[k] + direction[k] * t_enter;
+        ip[k] = (int32_t)floorf(p);
+        ip[k] = ip[k] < 0 ? 0 : (ip[k] >= size ? size - 1 : ip[k]);
+    }
+    if (axis >= 0) {
+        ip[axis] = direction[axis] > 0.0f ? 0 : size - 1;
+    }
+
+    // --- Walk ---
+    uint32_t stack[RAXEL_TREE64_MAX_DEPTH + 1];
+    uint32_t level = tree->depth;
+    stack[level] = tree->root;
+    float t = t_enter;
+    for (uint32_t step = 0; step < RAXEL_TREE64_MAX_STEPS; step++) {
+        raxel_tree64_node_t node = __raxel_tree64_read(tree, stack[level]);
+        uint32_t shift;
+        for (;;) {
+            shift = 2 * (level - 1);
+            uint32_t child = RAXEL_TREE64_CHILD_INDEX((ip[0] >> shift) & 3, (ip[1] >> shift) & 3, (ip[2] >> shift) & 3);
+            uint64_t mask = __raxel_tree64_mask(&node);
+            if (!(mask & (1ULL << child))) {
+                break;
+            }
+            uint32_t rank = __raxel_tree64_rank(mask, child);
+            if (node.kind != RAXEL_TREE64_NODE_INTERIOR) {
+                hit->t = t;
+                hit->material = node.kind == RAXEL_TREE64_NODE_SOLID ? node.first : tree->pool[node.first + rank];
+                for (int k = 0; k < 3; k++) {
+                    hit->voxel[k] = tree->origin[k] + ip[k];
+                    hit->normal[k] = (k == axis) ? (direction[k] > 0.0f ? -1.0f : 1.0f) : 0.0f;
+                }
+                hit->steps = step;
+                return 1;
+            }
+            stack[--level] = node.first + rank * RAXEL_TREE64_NODE_WORDS;
+            node = __raxel_tree64_read(tree, stack[level]);
+        }
+
+        // --- Skip the empty child cell ---
+        int32_t cell_size = 1 << shift;
+        int32_t cell_min[3];
+        float t_exit = INFINITY;
+        for (int k = 0; k < 3; k++) {
+            cell_min[k] = ip[k] & ~(cell_size - 1);
+            if (direction[k] == 0.0f) {
+                continue;
+            }
+            float bound = (float)(direction[k] > 0.0f ? cell_min[k] + cell_size : cell_min[k]);
+            float tk = (bound - ro[k]) * inv[k];
+            if (tk < t_exit) {
+                t_exit = tk;
+                axis = k;
+            }
+        }
+        t = t_exit;
+        if (t > max_t) {
+            return 0;
+        }
+        int32_t next[3];
+        for (int k = 0; k < 3; k++) {
+            if (k == axis) {
+                next[k] = direction[k] > 0.0f ? cell_min[k] + cell_size : cell_min[k] - 1;
+                continue;
+            }
+            // the ray only leaves through the exit face, whatever rounding says
+            next[k] = (int32_t)floorf(ro[k] + direction[k] * t);
+            next[k] = next[k] < cell_min[k] ? cell_min[k] : (next[k] >= cell_min[k] + cell_size ? cell_min[k] + cell_size - 1 : next[k]);
+        }
+        if (next[axis] < 0 || next[axis] >= size) {
+            return 0;
+        }
+        uint32_t diff = (uint32_t)((ip[0] ^ next[0]) | (ip[1] ^ next[1]) | (ip[2] ^ next[2]));
+        level = (uint32_t)(31 - __builtin_clz(diff)) / 2 + 1;
+        ip[0] = next[0];
+        ip[1] = next[1];
+        ip[2] = next[2];
+    }
+    return 0;
+}
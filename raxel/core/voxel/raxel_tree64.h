@@ -0,0 +1,103 @@
+#ifndef __RAXEL_TREE64_H__
+#define __RAXEL_TREE64_H__
+
+#include <raxel/core/util.h>               // for raxel_allocator_t, raxel_list, etc.
+#include <raxel/core/voxel/raxel_chunk.h>  // for raxel_voxel_chunk_t, raxel_coord_t
+#include <stdint.h>
+
+// A sparse 64-tree: every node splits its cube into 4x4x4 children and keeps a 64-bit mask of the
+// ones that are not empty. A node at level l spans 4^l voxels per axis, so level 1 nodes are 4^3
+// voxel bricks and the root sits at level depth. Chunks (32^3) hold 2x2x2 level 2 nodes.
+//
+// Nodes and leaf materials share one flat pool of 32-bit words. The children of a node are stored
+// next to each other, in mask order, so the child for mask bit i is found by counting the set bits
+// below i. The pool is append only: an edit writes new copies of the nodes on the path to the root
+// and leaves the old ones behind as garbage, which means a copy of the pool can be brought up to
+// date by appending the new words. raxel_tree64_build writes a compact pool from scratch.
+//
+// The same layout is read by the shader (raxel/assets/shaders/voxel.comp), keep them in sync.
+
+#define RAXEL_TREE64_MAX_DEPTH 10  // 4^10 voxels, or 32768 chunks, per axis
+#define RAXEL_TREE64_MAX_STEPS 1024  // empty cells a ray may skip before it gives up
+#define RAXEL_TREE64_NODE_WORDS 4
+#define RAXEL_TREE64_CHILD_INDEX(x, y, z) ((x) | ((y) << 2) | ((z) << 4))
+
+typedef enum raxel_tree64_node_kind {
+    RAXEL_TREE64_NODE_INTERIOR = 0,  // children are nodes, at first + RAXEL_TREE64_NODE_WORDS * rank
+    RAXEL_TREE64_NODE_VOXELS,        // level 1 only: children are voxels, materials at first + rank
+    RAXEL_TREE64_NODE_SOLID,         // every child in the mask is completely filled with material first
+} raxel_tree64_node_kind_t;
+
+typedef struct raxel_tree64_node {
+    uint32_t mask[2];  // child i is present if bit i % 32 of mask[i / 32] is set
+    uint32_t first;    // see raxel_tree64_node_kind_t
+    uint32_t kind;
+} raxel_tree64_node_t;
+
+typedef struct raxel_tree64 {
+    raxel_list(uint32_t) pool;  // nodes and leaf materials
+    raxel_coord_t origin[3];    // world voxel coordinates of the root's min corner, a multiple of the chunk size
+    uint32_t depth;             // level of the root, at least 3
+    uint32_t root;              // pool offset of the root node
+    uint32_t generation;        // bumped by every build, i.e. whenever the pool was not only appended to
+    raxel_size_t garbage;       // pool words no longer reachable from the root
+    raxel_size_t num_chunks;    // chunks with voxels in the tree
+    raxel_allocator_t *allocator;
+} raxel_tree64_t;
+
+// A chunk to build the tree from, in chunk coordinates.
+typedef struct raxel_tree64_chunk_ref {
+    raxel_coord_t x;
+    raxel_coord_t y;
+    raxel_coord_t z;
+    const raxel_voxel_chunk_t *chunk;
+} raxel_tree64_chunk_ref_t;
+
+typedef struct raxel_tree64_hit {
+    float t;                            // distance along the ray to the voxel's entry point
+    raxel_coord_t voxel[3];             // world coordinates of the voxel
+    float normal[3];                    // of the face the ray entered through
+    raxel_material_handle_t material;
+    uint32_t steps;                     // empty cells skipped before the hit
+} raxel_tree64_hit_t;
+
+/**
+ * Initialize an empty tree.
+ */
+void raxel_tree64_init(raxel_tree64_t *tree, raxel_allocator_t *allocator);
+void raxel_tree64_release(raxel_tree64_t *tree);
+
+/**
+ * Rebuild the tree from a set of chunks into a compact pool. The root is fitted around them.
+ *
+ * @return 0 on success, -1 if the chunks span more than RAXEL_TREE64_MAX_DEPTH allows; the
+ *         tree is left empty then.
+ */
+int raxel_tree64_build(raxel_tree64_t *tree, const raxel_tree64_chunk_ref_t *chunks, raxel_size_t n);
+
+/**
+ * Replace the voxels of one chunk, or remove it when chunk is NULL or empty. Only the path from
+ * the chunk to the root is rewritten.
+ *
+ * @return 0 on success, -1 if the chunk lies outside the root; rebuild the tree then.
+ */
+int raxel_tree64_set_chunk(raxel_tree64_t *tree, raxel_coord_t x, raxel_coord_t y, raxel_coord_t z, const raxel_voxel_chunk_t *chunk);
+
+/**
+ * Material of a voxel in world coordinates, 0 if it is empty or outside the tree.
+ */
+raxel_material_handle_t raxel_tree64_get(const raxel_tree64_t *tree, raxel_coord_t x, raxel_coord_t y, raxel_coord_t z);
+
+/**
+ * Cast a ray through the tree, the same traversal the shader does. Empty cells are skipped at
+ * the level of the largest empty node around them.
+ *
+ * @return 1 and fills hit if a voxel was hit within max_t, 0 otherwise.
+ */
+int raxel_tree64_raycast(const raxel_tree64_t *tree, const float origin[3], const float direction[3], float max_t, raxel_tree64_hit_t *hit);
+
+static inline raxel_size_t raxel_tree64_pool_size(const raxel_tree64_t *tree) {
+    return tree->pool ? raxel_list_size(tree->pool) : 0;
+}
+
+#endif  // __RAXEL_TREE64_H__
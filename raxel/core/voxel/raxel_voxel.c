@@ -3,27 +3,158 @@
 #include "raxel_voxel.h"
 
 #include <math.h>
+#include <stdio.h>
 #include <raxel/core/graphics/passes/compute_pass.h>
 #include <stdlib.h>
 #include <string.h>
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#endif
+
+// =============================================================================
+// 0. Chunk Index Keys
+// =============================================================================
+
+// Chunk coordinates are packed 21 bits per axis into a single 64-bit key, which covers
+// +/- 2^20 chunks along every axis.
+static inline uint64_t __raxel_voxel_chunk_key(raxel_coord_t x, raxel_coord_t y, raxel_coord_t z) {
+    const uint64_t mask = (1ULL << 21) - 1;
+    return ((uint64_t)(uint32_t)x & mask) |
+           (((uint64_t)(uint32_t)y & mask) << 21) |
+           (((uint64_t)(uint32_t)z & mask) << 42);
+}
+
+// splitmix64 finalizer -- the packed keys are highly regular, so they need a proper mix
+// before being reduced modulo the bucket count.
+static uint64_t __raxel_voxel_chunk_key_hash(const void *key, raxel_size_t key_size) {
+    (void)key_size;
+    uint64_t h = *(const uint64_t *)key;
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+    return h;
+}
+
+static int __raxel_voxel_chunk_key_equals(const void *a, const void *b, raxel_size_t key_size) {
+    (void)key_size;
+    return *(const uint64_t *)a == *(const uint64_t *)b;
+}
+
+// Region paging lives in section 9.
+static raxel_voxel_chunk_handle_t __raxel_voxel_world_page_in_chunk(raxel_voxel_world_t *world, raxel_coord_t x, raxel_coord_t y, raxel_coord_t z);
+static void __raxel_voxel_world_close_regions(raxel_voxel_world_t *world);
+static void __raxel_voxel_world_page_in(raxel_voxel_world_t *world, const vec3 camera_position, float view_distance);
+static void __raxel_voxel_world_page_out(raxel_voxel_world_t *world, const vec3 camera_position, float view_distance);
+
+// The chunk BVH cache lives in section 7.
+static void __raxel_voxel_world_release_chunk_bvh(raxel_voxel_world_t *world, raxel_voxel_chunk_handle_t handle);
+static void __raxel_voxel_world_release_bvh_builders(raxel_voxel_world_t *world);
 
 // =============================================================================
 // 1. Voxel World Creation / Destruction and Materials
 // =============================================================================
 
+// Forget what is resident on the GPU, e.g. after the world buffer was (re)created. The slot list
+// is resized to the given chunk budget.
+static void __raxel_voxel_gpu_mirror_reset(raxel_voxel_gpu_mirror_t *mirror, raxel_size_t chunk_budget) {
+    raxel_voxel_gpu_slot_t unused = {
+        .chunk = RAXEL_VOXEL_CHUNK_HANDLE_INVALID,
+        .revision = 0,
+        .last_used = 0,
+        .loaded = 0,
+    };
+    raxel_list_size(mirror->slots) = 0;
+    for (raxel_size_t s = 0; s < chunk_budget; s++) {
+        raxel_list_push_back(mirror->slots, unused);
+    }
+    mirror->num_slots = 0;
+    for (raxel_size_t i = 0; i < raxel_list_size(mirror->slot_of_chunk); i++) {
+        mirror->slot_of_chunk[i] = RAXEL_VOXEL_GPU_SLOT_NONE;
+    }
+    // no room for the top level makes the next sync lay the BVH out anew
+    mirror->bvh_top_nodes = 0;
+    mirror->bvh_end = 0;
+    mirror->version = 0;
+    mirror->tree_generation = 0;
+    mirror->tree_words = 0;
+}
+
+void raxel_voxel_gpu_mirror_init(raxel_voxel_gpu_mirror_t *mirror, raxel_sb_buffer_t *buffer, raxel_allocator_t *allocator) {
+    mirror->buffer = buffer;
+    mirror->slots = raxel_list_create_reserve(raxel_voxel_gpu_slot_t, allocator, RAXEL_VOXEL_DEFAULT_CHUNK_BUDGET);
+    mirror->slot_of_chunk = raxel_list_create_reserve(uint32_t, allocator, RAXEL_VOXEL_DEFAULT_CHUNK_BUDGET);
+    mirror->bvh_of_chunk = raxel_list_create_reserve(raxel_voxel_gpu_bvh_range_t, allocator, RAXEL_VOXEL_DEFAULT_CHUNK_BUDGET);
+    mirror->bvh_top_nodes = 0;
+    mirror->bvh_end = 0;
+    mirror->num_slots = 0;
+    mirror->version = 0;
+    mirror->tree_generation = 0;
+    mirror->tree_words = 0;
+}
+
+void raxel_voxel_gpu_mirror_release(raxel_voxel_gpu_mirror_t *mirror) {
+    raxel_list_destroy(mirror->slots);
+    raxel_list_destroy(mirror->slot_of_chunk);
+    raxel_list_destroy(mirror->bvh_of_chunk);
+    mirror->buffer = NULL;
+}
+
 raxel_voxel_world_t *raxel_voxel_world_create(raxel_allocator_t *allocator) {
     raxel_voxel_world_t *world = raxel_malloc(allocator, sizeof(raxel_voxel_world_t));
     world->allocator = allocator;
     // Create dynamic lists for chunks, chunk meta, and materials.
-    world->chunks = raxel_list_create_reserve(raxel_voxel_chunk_t, allocator, RAXEL_MAX_LOADED_CHUNKS);
-    world->chunk_meta = raxel_list_create_reserve(raxel_voxel_chunk_meta_t, allocator, RAXEL_MAX_LOADED_CHUNKS);
+    world->chunks = raxel_list_create_reserve(raxel_voxel_chunk_handle_t, allocator, RAXEL_VOXEL_DEFAULT_CHUNK_BUDGET);
+    world->chunk_pool = raxel_voxel_chunk_pool_create(allocator);
+    world->chunk_meta = raxel_list_create_reserve(raxel_voxel_chunk_meta_t, allocator, RAXEL_VOXEL_DEFAULT_CHUNK_BUDGET);
+    world->chunk_index = raxel_hashtable_create_custom(uint64_t, raxel_size_t, allocator, RAXEL_VOXEL_DEFAULT_CHUNK_BUDGET * 2,
+                                                       __raxel_voxel_chunk_key_hash, __raxel_voxel_chunk_key_equals);
     world->__num_loaded_chunks = 0;
     world->materials = raxel_list_create_reserve(raxel_voxel_material_t, allocator, 16);
     world->prev_update_options = (raxel_voxel_world_update_options_t){0};
+    world->__prev_num_chunks = 0;
+    world->__prev_chunk_budget = 0;
+    world->backend = RAXEL_VOXEL_BACKEND_BVH;
+    world->chunk_budget = RAXEL_VOXEL_DEFAULT_CHUNK_BUDGET;
+    world->tree_memory_budget = RAXEL_VOXEL_DEFAULT_TREE_MEMORY_BUDGET;
+    world->bvh_build_method = RAXEL_BVH_BUILD_SAH;
+    world->bvh_node_budget = RAXEL_VOXEL_DEFAULT_BVH_NODE_BUDGET;
+    world->bvh_width = RAXEL_WIDE_BVH_MAX_WIDTH;
+    world->bvh_build_threads = 0;
+    world->residency_hysteresis = RAXEL_VOXEL_DEFAULT_RESIDENCY_HYSTERESIS;
+    world->__resident_chunks = raxel_list_create_reserve(raxel_voxel_chunk_handle_t, allocator, RAXEL_VOXEL_DEFAULT_CHUNK_BUDGET);
+    world->__resident_revisions = raxel_list_create_reserve(uint32_t, allocator, RAXEL_VOXEL_DEFAULT_CHUNK_BUDGET);
+    world->__resident_meta = raxel_list_create_reserve(raxel_voxel_chunk_meta_t, allocator, RAXEL_VOXEL_DEFAULT_CHUNK_BUDGET);
+    world->__resident_backend = RAXEL_VOXEL_BACKEND_BVH;
+    // mirrors start at version 0, so the first staging always writes the (possibly empty) world
+    world->__residency_version = 1;
+    world->__bvh = NULL;
+    world->__wide_bvh = NULL;
+    world->__bvh_instances = raxel_list_create_reserve(raxel_voxel_bvh_instance_t, allocator, RAXEL_VOXEL_DEFAULT_CHUNK_BUDGET);
+    world->__chunk_bvhs = raxel_list_create_reserve(raxel_voxel_chunk_bvh_t, allocator, RAXEL_VOXEL_DEFAULT_CHUNK_BUDGET);
+    world->__chunk_bvh_leaf_size = MAX_LEAF_SIZE_BVH;
+    world->__bvh_build_pool = NULL;
+    world->__bvh_builders = NULL;
+    raxel_tree64_init(&world->__tree, allocator);
+    world->__update_count = 0;
+    raxel_voxel_gpu_mirror_init(&world->__gpu[0], NULL, allocator);
+    raxel_voxel_gpu_mirror_init(&world->__gpu[1], NULL, allocator);
+    world->__gpu_front = 0;
+    world->__stream = NULL;
+    raxel_mutex_init(&world->__lock);
+    world->__region_directory = NULL;
+    world->__regions = raxel_list_create_reserve(raxel_voxel_world_region_t, allocator, 8);
+    world->__region_index = raxel_hashtable_create_custom(uint64_t, raxel_size_t, allocator, 16,
+                                                          __raxel_voxel_chunk_key_hash, __raxel_voxel_chunk_key_equals);
+    world->__stored_revisions = raxel_list_create_reserve(uint32_t, allocator, RAXEL_VOXEL_DEFAULT_CHUNK_BUDGET);
     return world;
 }
 
 void raxel_voxel_world_destroy(raxel_voxel_world_t *world) {
+    raxel_voxel_world_stop_streaming(world);
     // Destroy each material’s string.
     for (raxel_size_t i = 0; i < raxel_list_size(world->materials); i++) {
         raxel_voxel_material_t *mat = &world->materials[i];
@@ -32,6 +163,32 @@ void raxel_voxel_world_destroy(raxel_voxel_world_t *world) {
     raxel_list_destroy(world->materials);
     raxel_list_destroy(world->chunk_meta);
     raxel_list_destroy(world->chunks);
+    raxel_list_destroy(world->__resident_chunks);
+    raxel_list_destroy(world->__resident_revisions);
+    raxel_list_destroy(world->__resident_meta);
+    raxel_bvh_accel_destroy(world->__bvh, world->allocator);
+    raxel_wide_bvh_destroy(world->__wide_bvh, world->allocator);
+    raxel_list_destroy(world->__bvh_instances);
+    for (raxel_size_t h = 0; h < raxel_list_size(world->__chunk_bvhs); h++) {
+        __raxel_voxel_world_release_chunk_bvh(world, (raxel_voxel_chunk_handle_t)h);
+        if (world->__chunk_bvhs[h].voxels) {
+            raxel_list_destroy(world->__chunk_bvhs[h].voxels);
+            raxel_list_destroy(world->__chunk_bvhs[h].edits);
+        }
+    }
+    raxel_list_destroy(world->__chunk_bvhs);
+    raxel_thread_pool_destroy(world->__bvh_build_pool);
+    __raxel_voxel_world_release_bvh_builders(world);
+    raxel_tree64_release(&world->__tree);
+    raxel_voxel_gpu_mirror_release(&world->__gpu[0]);
+    raxel_voxel_gpu_mirror_release(&world->__gpu[1]);
+    raxel_mutex_destroy(&world->__lock);
+    __raxel_voxel_world_close_regions(world);
+    raxel_list_destroy(world->__regions);
+    raxel_hashtable_destroy(world->__region_index);
+    raxel_list_destroy(world->__stored_revisions);
+    raxel_voxel_chunk_pool_destroy(world->chunk_pool);
+    raxel_hashtable_destroy(world->chunk_index);
     raxel_free(world->allocator, world);
 }
 
@@ -56,28 +213,79 @@ raxel_material_handle_t raxel_voxel_world_get_material_handle(raxel_voxel_world_
 // 2. Chunk Access and Helper Functions
 // =============================================================================
 
+static inline raxel_voxel_chunk_t *__raxel_voxel_world_chunk_at(raxel_voxel_world_t *world, raxel_size_t i) {
+    return raxel_voxel_chunk_pool_get(world->chunk_pool, world->chunks[i]);
+}
+
 static raxel_voxel_chunk_t *__raxel_voxel_world_create_chunk(raxel_voxel_world_t *world,
                                                                raxel_coord_t x,
                                                                raxel_coord_t y,
                                                                raxel_coord_t z) {
-    raxel_voxel_chunk_meta_t meta = { x, y, z, RAXEL_VOXEL_CHUNK_STATE_COUNT };
+    raxel_voxel_chunk_handle_t handle = raxel_voxel_chunk_pool_alloc(world->chunk_pool);
+    if (handle == RAXEL_VOXEL_CHUNK_HANDLE_INVALID) {
+        return NULL;
+    }
+    raxel_voxel_chunk_meta_t meta = { x, y, z, RAXEL_VOXEL_CHUNK_STATE_DEFAULT };
     raxel_list_push_back(world->chunk_meta, meta);
-    raxel_voxel_chunk_t chunk;
-    raxel_list_push_back(world->chunks, chunk);
-    raxel_voxel_chunk_t *new_chunk = &world->chunks[raxel_list_size(world->chunks) - 1];
-    memset(new_chunk, 0, sizeof(raxel_voxel_chunk_t));
-    return new_chunk;
+    raxel_list_push_back(world->chunks, handle);
+    raxel_size_t index = raxel_list_size(world->chunks) - 1;
+    uint64_t key = __raxel_voxel_chunk_key(x, y, z);
+    raxel_hashtable_insert(world->chunk_index, &key, &index);
+    while (raxel_list_size(world->__stored_revisions) <= handle) {
+        raxel_list_push_back(world->__stored_revisions, RAXEL_VOXEL_REVISION_UNSTORED);
+    }
+    world->__stored_revisions[handle] = RAXEL_VOXEL_REVISION_UNSTORED;
+    return raxel_voxel_chunk_pool_get(world->chunk_pool, handle);
+}
+
+// Frees the chunk at index i. The last chunk takes its place in the lists, so only chunks
+// after the loaded ones may be removed.
+static void __raxel_voxel_world_remove_chunk(raxel_voxel_world_t *world, raxel_size_t i) {
+    raxel_voxel_chunk_meta_t *meta = &world->chunk_meta[i];
+    uint64_t key = __raxel_voxel_chunk_key(meta->x, meta->y, meta->z);
+    raxel_hashtable_remove(world->chunk_index, &key);
+    __raxel_voxel_world_release_chunk_bvh(world, world->chunks[i]);
+    raxel_voxel_chunk_pool_free(world->chunk_pool, world->chunks[i]);
+
+    raxel_size_t last = raxel_list_size(world->chunks) - 1;
+    if (i != last) {
+        world->chunk_meta[i] = world->chunk_meta[last];
+        world->chunks[i] = world->chunks[last];
+        uint64_t moved_key = __raxel_voxel_chunk_key(world->chunk_meta[i].x, world->chunk_meta[i].y, world->chunk_meta[i].z);
+        raxel_hashtable_remove(world->chunk_index, &moved_key);
+        raxel_hashtable_insert(world->chunk_index, &moved_key, &i);
+    }
+    raxel_list_size(world->chunk_meta) = last;
+    raxel_list_size(world->chunks) = last;
 }
 
+// Reorders two chunks in the world's lists. Only the metadata and pool handles move, the
+// voxel payloads stay where they are in the pool.
 static void __raxel_voxel_world_swap_chunks(raxel_voxel_world_t *world,
                                             raxel_size_t i,
                                             raxel_size_t j) {
     raxel_voxel_chunk_meta_t tmp_meta = world->chunk_meta[i];
     world->chunk_meta[i] = world->chunk_meta[j];
     world->chunk_meta[j] = tmp_meta;
-    raxel_voxel_chunk_t tmp_chunk = world->chunks[i];
+    raxel_voxel_chunk_handle_t tmp_handle = world->chunks[i];
     world->chunks[i] = world->chunks[j];
-    world->chunks[j] = tmp_chunk;
+    world->chunks[j] = tmp_handle;
+
+    // keep the index pointing at the new positions
+    raxel_voxel_chunk_meta_t *meta_i = &world->chunk_meta[i];
+    raxel_voxel_chunk_meta_t *meta_j = &world->chunk_meta[j];
+    uint64_t key_i = __raxel_voxel_chunk_key(meta_i->x, meta_i->y, meta_i->z);
+    uint64_t key_j = __raxel_voxel_chunk_key(meta_j->x, meta_j->y, meta_j->z);
+    raxel_hashtable_remove(world->chunk_index, &key_i);
+    raxel_hashtable_remove(world->chunk_index, &key_j);
+    raxel_hashtable_insert(world->chunk_index, &key_i, &i);
+    raxel_hashtable_insert(world->chunk_index, &key_j, &j);
+}
+
+// Floor division of a world coordinate by the chunk size.
+static inline raxel_coord_t __raxel_voxel_world_to_chunk_coord(raxel_coord_t c) {
+    return (c >= 0) ? (c / RAXEL_VOXEL_CHUNK_SIZE)
+                    : ((c - RAXEL_VOXEL_CHUNK_SIZE + 1) / RAXEL_VOXEL_CHUNK_SIZE);
 }
 
 static void __raxel_voxel_world_from_world_to_chunk_coords(raxel_voxel_world_t *world,
@@ -87,45 +295,90 @@ static void __raxel_voxel_world_from_world_to_chunk_coords(raxel_voxel_world_t *
                                                            raxel_coord_t *chunk_x,
                                                            raxel_coord_t *chunk_y,
                                                            raxel_coord_t *chunk_z) {
-    *chunk_x = (x >= 0) ? (x / RAXEL_VOXEL_CHUNK_SIZE)
-                        : ((x - RAXEL_VOXEL_CHUNK_SIZE + 1) / RAXEL_VOXEL_CHUNK_SIZE);
-    *chunk_y = (y >= 0) ? (y / RAXEL_VOXEL_CHUNK_SIZE)
-                        : ((y - RAXEL_VOXEL_CHUNK_SIZE + 1) / RAXEL_VOXEL_CHUNK_SIZE);
-    *chunk_z = (z >= 0) ? (z / RAXEL_VOXEL_CHUNK_SIZE)
-                        : ((z - RAXEL_VOXEL_CHUNK_SIZE + 1) / RAXEL_VOXEL_CHUNK_SIZE);
-}
-
-static raxel_size_t __raxel_voxel_world_from_world_to_index(raxel_voxel_world_t *world,
-                                                            raxel_coord_t x,
-                                                            raxel_coord_t y,
-                                                            raxel_coord_t z) {
-    raxel_coord_t chunk_x, chunk_y, chunk_z;
-    __raxel_voxel_world_from_world_to_chunk_coords(world, x, y, z, &chunk_x, &chunk_y, &chunk_z);
-    raxel_voxel_chunk_t *chunk = raxel_voxel_world_get_chunk(world, chunk_x, chunk_y, chunk_z);
-    if (!chunk) {
-        return 0;
-    }
+    *chunk_x = __raxel_voxel_world_to_chunk_coord(x);
+    *chunk_y = __raxel_voxel_world_to_chunk_coord(y);
+    *chunk_z = __raxel_voxel_world_to_chunk_coord(z);
+}
+
+// Returns the flat index of a world-space voxel inside the chunk at (chunk_x, chunk_y, chunk_z).
+static inline raxel_size_t __raxel_voxel_world_local_index(raxel_coord_t x,
+                                                           raxel_coord_t y,
+                                                           raxel_coord_t z,
+                                                           raxel_coord_t chunk_x,
+                                                           raxel_coord_t chunk_y,
+                                                           raxel_coord_t chunk_z) {
     raxel_coord_t local_x = x - (chunk_x * RAXEL_VOXEL_CHUNK_SIZE);
     raxel_coord_t local_y = y - (chunk_y * RAXEL_VOXEL_CHUNK_SIZE);
     raxel_coord_t local_z = z - (chunk_z * RAXEL_VOXEL_CHUNK_SIZE);
-    local_x = ((local_x % RAXEL_VOXEL_CHUNK_SIZE) + RAXEL_VOXEL_CHUNK_SIZE) % RAXEL_VOXEL_CHUNK_SIZE;
-    local_y = ((local_y % RAXEL_VOXEL_CHUNK_SIZE) + RAXEL_VOXEL_CHUNK_SIZE) % RAXEL_VOXEL_CHUNK_SIZE;
-    local_z = ((local_z % RAXEL_VOXEL_CHUNK_SIZE) + RAXEL_VOXEL_CHUNK_SIZE) % RAXEL_VOXEL_CHUNK_SIZE;
     return local_x + local_y * RAXEL_VOXEL_CHUNK_SIZE +
            local_z * RAXEL_VOXEL_CHUNK_SIZE * RAXEL_VOXEL_CHUNK_SIZE;
 }
 
+// Distance from the camera (in chunks) to the centre of a chunk.
+static inline float __raxel_voxel_world_chunk_distance(const float cam[3], raxel_coord_t x, raxel_coord_t y, raxel_coord_t z) {
+    float dx = (float)x + 0.5f - cam[0];
+    float dy = (float)y + 0.5f - cam[1];
+    float dz = (float)z + 0.5f - cam[2];
+    return sqrtf(dx * dx + dy * dy + dz * dz);
+}
+
+// The lookups below do not lock, the public functions around them do. Chunks that are only on
+// disk are paged in.
+static raxel_voxel_chunk_handle_t __raxel_voxel_world_find_chunk_handle(raxel_voxel_world_t *world,
+                                                                      raxel_coord_t x,
+                                                                      raxel_coord_t y,
+                                                                      raxel_coord_t z) {
+    uint64_t key = __raxel_voxel_chunk_key(x, y, z);
+    raxel_size_t index;
+    if (!raxel_hashtable_get(world->chunk_index, &key, &index)) {
+        // not in RAM, but it may be on disk
+        return __raxel_voxel_world_page_in_chunk(world, x, y, z);
+    }
+    return world->chunks[index];
+}
+
+static raxel_voxel_chunk_t *__raxel_voxel_world_find_chunk(raxel_voxel_world_t *world,
+                                                           raxel_coord_t x,
+                                                           raxel_coord_t y,
+                                                           raxel_coord_t z) {
+    raxel_voxel_chunk_handle_t handle = __raxel_voxel_world_find_chunk_handle(world, x, y, z);
+    if (handle == RAXEL_VOXEL_CHUNK_HANDLE_INVALID) {
+        return NULL;
+    }
+    return raxel_voxel_chunk_pool_get(world->chunk_pool, handle);
+}
+
+// Only a streaming world has a second thread touching the chunks, so only then is the lock taken.
+void raxel_voxel_world_lock(raxel_voxel_world_t *world) {
+    if (world->__stream) {
+        raxel_mutex_lock(&world->__lock);
+    }
+}
+
+void raxel_voxel_world_unlock(raxel_voxel_world_t *world) {
+    if (world->__stream) {
+        raxel_mutex_unlock(&world->__lock);
+    }
+}
+
 raxel_voxel_chunk_t *raxel_voxel_world_get_chunk(raxel_voxel_world_t *world,
                                                  raxel_coord_t x,
                                                  raxel_coord_t y,
                                                  raxel_coord_t z) {
-    for (raxel_size_t i = 0; i < raxel_list_size(world->chunk_meta); i++) {
-        raxel_voxel_chunk_meta_t *meta = &world->chunk_meta[i];
-        if (meta->x == x && meta->y == y && meta->z == z) {
-            return &world->chunks[i];
-        }
-    }
-    return NULL;
+    raxel_voxel_world_lock(world);
+    raxel_voxel_chunk_t *chunk = __raxel_voxel_world_find_chunk(world, x, y, z);
+    raxel_voxel_world_unlock(world);
+    return chunk;
+}
+
+raxel_voxel_chunk_handle_t raxel_voxel_world_get_chunk_handle(raxel_voxel_world_t *world,
+                                                              raxel_coord_t x,
+                                                              raxel_coord_t y,
+                                                              raxel_coord_t z) {
+    raxel_voxel_world_lock(world);
+    raxel_voxel_chunk_handle_t handle = __raxel_voxel_world_find_chunk_handle(world, x, y, z);
+    raxel_voxel_world_unlock(world);
+    return handle;
 }
 
 raxel_voxel_t raxel_voxel_world_get_voxel(raxel_voxel_world_t *world,
@@ -134,13 +387,42 @@ raxel_voxel_t raxel_voxel_world_get_voxel(raxel_voxel_world_t *world,
                                           raxel_coord_t z) {
     raxel_coord_t chunk_x, chunk_y, chunk_z;
     __raxel_voxel_world_from_world_to_chunk_coords(world, x, y, z, &chunk_x, &chunk_y, &chunk_z);
-    raxel_voxel_chunk_t *chunk = raxel_voxel_world_get_chunk(world, chunk_x, chunk_y, chunk_z);
+    raxel_voxel_t voxel = {0};
+    raxel_voxel_world_lock(world);
+    raxel_voxel_chunk_t *chunk = __raxel_voxel_world_find_chunk(world, chunk_x, chunk_y, chunk_z);
+    if (chunk) {
+        raxel_size_t index = __raxel_voxel_world_local_index(x, y, z, chunk_x, chunk_y, chunk_z);
+        voxel = raxel_voxel_chunk_get(chunk, index);
+    }
+    raxel_voxel_world_unlock(world);
+    return voxel;
+}
+
+static raxel_voxel_chunk_t *__raxel_voxel_world_get_or_create_chunk(raxel_voxel_world_t *world,
+                                                                     raxel_coord_t chunk_x,
+                                                                     raxel_coord_t chunk_y,
+                                                                     raxel_coord_t chunk_z) {
+    raxel_voxel_chunk_t *chunk = __raxel_voxel_world_find_chunk(world, chunk_x, chunk_y, chunk_z);
     if (!chunk) {
-        raxel_voxel_t empty = {0};
-        return empty;
+        chunk = __raxel_voxel_world_create_chunk(world, chunk_x, chunk_y, chunk_z);
+        if (!chunk) {
+            RAXEL_CORE_FATAL_ERROR("Failed to create chunk at (%d, %d, %d)\n", chunk_x, chunk_y, chunk_z);
+        }
+    }
+    return chunk;
+}
+
+// The chunk an edit writes voxel into. Where there is no chunk every voxel is empty already, so
+// empty voxels never create one: NULL is returned and the edit skips the chunk.
+static raxel_voxel_chunk_t *__raxel_voxel_world_chunk_to_edit(raxel_voxel_world_t *world,
+                                                              raxel_coord_t chunk_x,
+                                                              raxel_coord_t chunk_y,
+                                                              raxel_coord_t chunk_z,
+                                                              raxel_voxel_t voxel) {
+    if (voxel.material == 0) {
+        return __raxel_voxel_world_find_chunk(world, chunk_x, chunk_y, chunk_z);
     }
-    raxel_size_t index = __raxel_voxel_world_from_world_to_index(world, x, y, z);
-    return chunk->voxels[index];
+    return __raxel_voxel_world_get_or_create_chunk(world, chunk_x, chunk_y, chunk_z);
 }
 
 void raxel_voxel_world_place_voxel(raxel_voxel_world_t *world,
@@ -150,28 +432,332 @@ void raxel_voxel_world_place_voxel(raxel_voxel_world_t *world,
                                    raxel_voxel_t voxel) {
     raxel_coord_t chunk_x, chunk_y, chunk_z;
     __raxel_voxel_world_from_world_to_chunk_coords(world, x, y, z, &chunk_x, &chunk_y, &chunk_z);
-    raxel_voxel_chunk_t *chunk = raxel_voxel_world_get_chunk(world, chunk_x, chunk_y, chunk_z);
-    if (!chunk) {
-        chunk = __raxel_voxel_world_create_chunk(world, chunk_x, chunk_y, chunk_z);
-        if (!chunk) {
-            RAXEL_CORE_FATAL_ERROR("Failed to create chunk at (%d, %d, %d)\n", chunk_x, chunk_y, chunk_z);
+    raxel_voxel_world_lock(world);
+    raxel_voxel_chunk_t *chunk = __raxel_voxel_world_chunk_to_edit(world, chunk_x, chunk_y, chunk_z, voxel);
+    if (chunk) {
+        raxel_size_t index = __raxel_voxel_world_local_index(x, y, z, chunk_x, chunk_y, chunk_z);
+        raxel_voxel_chunk_set(chunk, index, voxel);
+    }
+    raxel_voxel_world_unlock(world);
+}
+
+// --- Batched edits ---
+// These split the edit into chunks once, then write whole x-rows, which are contiguous in a chunk.
+
+// Fills local voxels [x0, x1] of row (y, z) in a chunk.
+static inline void __raxel_voxel_chunk_fill_row(raxel_voxel_chunk_t *chunk,
+                                                raxel_coord_t x0,
+                                                raxel_coord_t x1,
+                                                raxel_coord_t y,
+                                                raxel_coord_t z,
+                                                raxel_voxel_t voxel) {
+    raxel_size_t start = x0 + y * RAXEL_VOXEL_CHUNK_SIZE + z * RAXEL_VOXEL_CHUNK_SIZE * RAXEL_VOXEL_CHUNK_SIZE;
+    raxel_voxel_chunk_fill_span(chunk, start, x1 - x0 + 1, voxel);
+}
+
+// Integer square root, so sphere rows match the x*x + y*y + z*z <= r*r test exactly.
+static inline int64_t __raxel_isqrt(int64_t n) {
+    if (n <= 0) return 0;
+    int64_t r = (int64_t)sqrt((double)n);
+    while (r * r > n) r--;
+    while ((r + 1) * (r + 1) <= n) r++;
+    return r;
+}
+
+void raxel_voxel_world_fill_box(raxel_voxel_world_t *world,
+                                raxel_coord_t min_x,
+                                raxel_coord_t min_y,
+                                raxel_coord_t min_z,
+                                raxel_coord_t max_x,
+                                raxel_coord_t max_y,
+                                raxel_coord_t max_z,
+                                raxel_voxel_t voxel) {
+    if (min_x > max_x || min_y > max_y || min_z > max_z) {
+        return;
+    }
+    raxel_coord_t cmin_x, cmin_y, cmin_z, cmax_x, cmax_y, cmax_z;
+    __raxel_voxel_world_from_world_to_chunk_coords(world, min_x, min_y, min_z, &cmin_x, &cmin_y, &cmin_z);
+    __raxel_voxel_world_from_world_to_chunk_coords(world, max_x, max_y, max_z, &cmax_x, &cmax_y, &cmax_z);
+
+    raxel_voxel_world_lock(world);
+
+    for (raxel_coord_t cz = cmin_z; cz <= cmax_z; cz++) {
+        for (raxel_coord_t cy = cmin_y; cy <= cmax_y; cy++) {
+            for (raxel_coord_t cx = cmin_x; cx <= cmax_x; cx++) {
+                raxel_voxel_chunk_t *chunk = __raxel_voxel_world_chunk_to_edit(world, cx, cy, cz, voxel);
+                if (!chunk) {
+                    continue;
+                }
+                raxel_coord_t ox = cx * RAXEL_VOXEL_CHUNK_SIZE;
+                raxel_coord_t oy = cy * RAXEL_VOXEL_CHUNK_SIZE;
+                raxel_coord_t oz = cz * RAXEL_VOXEL_CHUNK_SIZE;
+                // clamp the box to this chunk, in local coordinates
+                raxel_coord_t lx0 = (min_x > ox) ? min_x - ox : 0;
+                raxel_coord_t ly0 = (min_y > oy) ? min_y - oy : 0;
+                raxel_coord_t lz0 = (min_z > oz) ? min_z - oz : 0;
+                raxel_coord_t lx1 = (max_x < ox + RAXEL_VOXEL_CHUNK_SIZE - 1) ? max_x - ox : RAXEL_VOXEL_CHUNK_SIZE - 1;
+                raxel_coord_t ly1 = (max_y < oy + RAXEL_VOXEL_CHUNK_SIZE - 1) ? max_y - oy : RAXEL_VOXEL_CHUNK_SIZE - 1;
+                raxel_coord_t lz1 = (max_z < oz + RAXEL_VOXEL_CHUNK_SIZE - 1) ? max_z - oz : RAXEL_VOXEL_CHUNK_SIZE - 1;
+                if (lx0 == 0 && ly0 == 0 && lz0 == 0 &&
+                    lx1 == RAXEL_VOXEL_CHUNK_SIZE - 1 && ly1 == RAXEL_VOXEL_CHUNK_SIZE - 1 && lz1 == RAXEL_VOXEL_CHUNK_SIZE - 1) {
+                    // fully covered chunks collapse to a single uniform value
+                    raxel_voxel_chunk_fill(chunk, voxel);
+                    continue;
+                }
+                for (raxel_coord_t lz = lz0; lz <= lz1; lz++) {
+                    for (raxel_coord_t ly = ly0; ly <= ly1; ly++) {
+                        __raxel_voxel_chunk_fill_row(chunk, lx0, lx1, ly, lz, voxel);
+                    }
+                }
+            }
+        }
+    }
+    raxel_voxel_world_unlock(world);
+}
+
+void raxel_voxel_world_fill_sphere(raxel_voxel_world_t *world,
+                                   raxel_coord_t center_x,
+                                   raxel_coord_t center_y,
+                                   raxel_coord_t center_z,
+                                   raxel_coord_t radius,
+                                   raxel_voxel_t voxel) {
+    if (radius < 0) {
+        return;
+    }
+    int64_t r2 = (int64_t)radius * radius;
+    raxel_coord_t cmin_x, cmin_y, cmin_z, cmax_x, cmax_y, cmax_z;
+    __raxel_voxel_world_from_world_to_chunk_coords(world, center_x - radius, center_y - radius, center_z - radius,
+                                                   &cmin_x, &cmin_y, &cmin_z);
+    __raxel_voxel_world_from_world_to_chunk_coords(world, center_x + radius, center_y + radius, center_z + radius,
+                                                   &cmax_x, &cmax_y, &cmax_z);
+
+    raxel_voxel_world_lock(world);
+    for (raxel_coord_t cz = cmin_z; cz <= cmax_z; cz++) {
+        for (raxel_coord_t cy = cmin_y; cy <= cmax_y; cy++) {
+            for (raxel_coord_t cx = cmin_x; cx <= cmax_x; cx++) {
+                raxel_coord_t ox = cx * RAXEL_VOXEL_CHUNK_SIZE;
+                raxel_coord_t oy = cy * RAXEL_VOXEL_CHUNK_SIZE;
+                raxel_coord_t oz = cz * RAXEL_VOXEL_CHUNK_SIZE;
+                // the chunk is looked up lazily, so chunks that only touch the bounding box stay absent
+                raxel_voxel_chunk_t *chunk = NULL;
+                int looked_up = 0;
+                for (raxel_coord_t lz = 0; lz < RAXEL_VOXEL_CHUNK_SIZE; lz++) {
+                    int64_t dz = (int64_t)(oz + lz) - center_z;
+                    if (dz * dz > r2) continue;
+                    for (raxel_coord_t ly = 0; ly < RAXEL_VOXEL_CHUNK_SIZE; ly++) {
+                        int64_t dy = (int64_t)(oy + ly) - center_y;
+                        int64_t rem = r2 - dz * dz - dy * dy;
+                        if (rem < 0) continue;
+                        raxel_coord_t dx = (raxel_coord_t)__raxel_isqrt(rem);
+                        raxel_coord_t x0 = center_x - dx - ox;
+                        raxel_coord_t x1 = center_x + dx - ox;
+                        if (x1 < 0 || x0 >= RAXEL_VOXEL_CHUNK_SIZE) continue;
+                        if (x0 < 0) x0 = 0;
+                        if (x1 >= RAXEL_VOXEL_CHUNK_SIZE) x1 = RAXEL_VOXEL_CHUNK_SIZE - 1;
+                        if (!looked_up) {
+                            chunk = __raxel_voxel_world_chunk_to_edit(world, cx, cy, cz, voxel);
+                            looked_up = 1;
+                        }
+                        if (chunk) {
+                            __raxel_voxel_chunk_fill_row(chunk, x0, x1, ly, lz, voxel);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    raxel_voxel_world_unlock(world);
+}
+
+void raxel_voxel_world_place_voxels(raxel_voxel_world_t *world,
+                                    const raxel_coord_t *coords,
+                                    const raxel_voxel_t *voxels,
+                                    raxel_size_t n) {
+    // Edits tend to be spatially coherent, so remember the last chunk and only hit the index on a change.
+    raxel_voxel_chunk_t *chunk = NULL;
+    raxel_coord_t chunk_x = 0, chunk_y = 0, chunk_z = 0;
+    raxel_voxel_world_lock(world);
+    for (raxel_size_t i = 0; i < n; i++) {
+        raxel_coord_t x = coords[i * 3 + 0];
+        raxel_coord_t y = coords[i * 3 + 1];
+        raxel_coord_t z = coords[i * 3 + 2];
+        raxel_coord_t cx, cy, cz;
+        __raxel_voxel_world_from_world_to_chunk_coords(world, x, y, z, &cx, &cy, &cz);
+        if (!chunk || cx != chunk_x || cy != chunk_y || cz != chunk_z) {
+            chunk = __raxel_voxel_world_chunk_to_edit(world, cx, cy, cz, voxels[i]);
+            chunk_x = cx;
+            chunk_y = cy;
+            chunk_z = cz;
+        }
+        if (chunk) {
+            raxel_voxel_chunk_set(chunk, __raxel_voxel_world_local_index(x, y, z, cx, cy, cz), voxels[i]);
+        }
+    }
+    raxel_voxel_world_unlock(world);
+}
+
+// --- Raycasts ---
+// The ray walks cells: a missing or empty chunk is one cell, so is a zero occupancy word of a chunk
+// (two x-rows of one z layer), and any other voxel is a cell of its own. From each empty cell the
+// ray jumps straight to the neighbour it leaves through, like the 64-tree raycast does.
+
+// The chunk a ray is in, remembered so the index is only hit when the ray crosses into another one.
+typedef struct __raxel_voxel_raycast_chunk {
+    const raxel_voxel_chunk_t *chunk;  // NULL for a chunk that does not exist
+    raxel_coord_t coord[3];
+    int valid;
+} __raxel_voxel_raycast_chunk_t;
+
+static int __raxel_voxel_world_raycast_locked(raxel_voxel_world_t *world,
+                                              __raxel_voxel_raycast_chunk_t *cache,
+                                              const float origin[3],
+                                              const float direction[3],
+                                              float max_t,
+                                              raxel_voxel_raycast_hit_t *hit) {
+    memset(hit, 0, sizeof(*hit));
+    float inv_direction[3];
+    raxel_coord_t voxel[3];
+    for (int k = 0; k < 3; k++) {
+        inv_direction[k] = 1.0f / direction[k];
+        voxel[k] = (raxel_coord_t)floorf(origin[k]);
+    }
+    float t = 0.0f;
+    int axis = -1;  // the axis of the face the ray entered the current cell through
+    while (t <= max_t) {
+        raxel_coord_t chunk_coord[3];
+        __raxel_voxel_world_from_world_to_chunk_coords(world, voxel[0], voxel[1], voxel[2], &chunk_coord[0], &chunk_coord[1], &chunk_coord[2]);
+        if (!cache->valid || memcmp(cache->coord, chunk_coord, sizeof(chunk_coord)) != 0) {
+            cache->chunk = __raxel_voxel_world_find_chunk(world, chunk_coord[0], chunk_coord[1], chunk_coord[2]);
+            memcpy(cache->coord, chunk_coord, sizeof(chunk_coord));
+            cache->valid = 1;
+        }
+
+        // the empty cell the voxel is in: its min corner and size per axis
+        raxel_coord_t cell_min[3], cell_size[3];
+        const raxel_voxel_chunk_t *chunk = cache->chunk;
+        if (!chunk || raxel_voxel_chunk_is_empty(chunk)) {
+            for (int k = 0; k < 3; k++) {
+                cell_min[k] = chunk_coord[k] * RAXEL_VOXEL_CHUNK_SIZE;
+                cell_size[k] = RAXEL_VOXEL_CHUNK_SIZE;
+            }
+        } else {
+            raxel_size_t index = __raxel_voxel_world_local_index(voxel[0], voxel[1], voxel[2], chunk_coord[0], chunk_coord[1], chunk_coord[2]);
+            uint64_t word = raxel_voxel_chunk_occupancy_word(chunk, index >> 6);
+            if ((word >> (index & 63)) & 1) {
+                hit->t = t;
+                memcpy(hit->voxel, voxel, sizeof(voxel));
+                if (axis >= 0) {
+                    hit->normal[axis] = direction[axis] > 0.0f ? -1 : 1;
+                }
+                hit->material = raxel_voxel_chunk_get(chunk, index).material;
+                return 1;
+            }
+            if (word == 0) {
+                // RAXEL_VOXEL_CHUNK_SIZE * RAXEL_VOXEL_CHUNK_SIZE is a multiple of 64, so a word never spans z layers
+                cell_min[0] = chunk_coord[0] * RAXEL_VOXEL_CHUNK_SIZE;
+                cell_size[0] = RAXEL_VOXEL_CHUNK_SIZE;
+                cell_size[1] = 64 / RAXEL_VOXEL_CHUNK_SIZE;
+                cell_min[1] = voxel[1] & ~(cell_size[1] - 1);
+                cell_min[2] = voxel[2];
+                cell_size[2] = 1;
+            } else {
+                for (int k = 0; k < 3; k++) {
+                    cell_min[k] = voxel[k];
+                    cell_size[k] = 1;
+                }
+            }
         }
+
+        // leave the cell through the nearest of its far faces
+        float t_exit = INFINITY;
+        for (int k = 0; k < 3; k++) {
+            if (direction[k] == 0.0f) {
+                continue;
+            }
+            float bound = (float)(direction[k] > 0.0f ? cell_min[k] + cell_size[k] : cell_min[k]);
+            float tk = (bound - origin[k]) * inv_direction[k];
+            if (tk < t_exit) {
+                t_exit = tk;
+                axis = k;
+            }
+        }
+        if (axis < 0 || !(t_exit <= max_t)) {
+            return 0;
+        }
+        // never step back, even where rounding puts the exit a hair before the entry
+        t = fmaxf(t, t_exit);
+        for (int k = 0; k < 3; k++) {
+            raxel_coord_t v = (raxel_coord_t)floorf(origin[k] + direction[k] * t);
+            voxel[k] = v < cell_min[k] ? cell_min[k] : (v > cell_min[k] + cell_size[k] - 1 ? cell_min[k] + cell_size[k] - 1 : v);
+        }
+        voxel[axis] = direction[axis] > 0.0f ? cell_min[axis] + cell_size[axis] : cell_min[axis] - 1;
+    }
+    return 0;
+}
+
+int raxel_voxel_world_raycast(raxel_voxel_world_t *world, const float origin[3], const float direction[3], float max_t, raxel_voxel_raycast_hit_t *hit) {
+    __raxel_voxel_raycast_chunk_t cache = {0};
+    raxel_voxel_world_lock(world);
+    int found = __raxel_voxel_world_raycast_locked(world, &cache, origin, direction, max_t, hit);
+    raxel_voxel_world_unlock(world);
+    return found;
+}
+
+raxel_size_t raxel_voxel_world_raycast_batch(raxel_voxel_world_t *world,
+                                             const float *origins,
+                                             const float *directions,
+                                             float max_t,
+                                             raxel_size_t n,
+                                             raxel_voxel_raycast_hit_t *hits) {
+    __raxel_voxel_raycast_chunk_t cache = {0};
+    raxel_size_t n_hits = 0;
+    raxel_voxel_world_lock(world);
+    for (raxel_size_t i = 0; i < n; i++) {
+        n_hits += (raxel_size_t)__raxel_voxel_world_raycast_locked(world, &cache, &origins[i * 3], &directions[i * 3], max_t, &hits[i]);
     }
-    raxel_size_t index = __raxel_voxel_world_from_world_to_index(world, x, y, z);
-    chunk->voxels[index] = voxel;
+    raxel_voxel_world_unlock(world);
+    return n_hits;
 }
 
 // =============================================================================
 // 3. Voxel World Storage Buffer Functions
 // =============================================================================
 
+// Start from an empty GPU world; from here on only changed ranges are uploaded.
+static void __raxel_voxel_world_clear_gpu_buffer(raxel_voxel_world_t *world, raxel_sb_buffer_t *buffer, raxel_pipeline_t *pipeline) {
+    __raxel_voxel_world_gpu_t *gpu_world = buffer->data;
+    memset(gpu_world, 0, sizeof(__raxel_voxel_world_gpu_t));
+    gpu_world->chunk_budget = (uint32_t)world->chunk_budget;
+    gpu_world->backend = world->backend;
+    raxel_sb_buffer_mark_dirty(buffer, 0, sizeof(__raxel_voxel_world_gpu_t));
+    raxel_sb_buffer_flush(buffer, pipeline);
+}
+
+raxel_size_t raxel_voxel_world_gpu_size(const raxel_voxel_world_t *world) {
+    if (world->backend == RAXEL_VOXEL_BACKEND_TREE64) {
+        return sizeof(__raxel_voxel_world_gpu_t) + world->tree_memory_budget;
+    }
+    return __raxel_voxel_world_gpu_size(world->chunk_budget, world->bvh_node_budget);
+}
+
 void raxel_voxel_world_set_sb(raxel_voxel_world_t *world,
                               raxel_compute_shader_t *compute_shader,
                               raxel_pipeline_t *pipeline) {
+    raxel_voxel_world_stop_streaming(world);
+
     raxel_sb_buffer_desc_t sb_desc = RAXEL_SB_DESC(
-        (raxel_sb_entry_t){ .name = "voxel_world", .offset = 0, .size = sizeof(__raxel_voxel_world_gpu_t) }
+        (raxel_sb_entry_t){ .name = "voxel_world", .offset = 0, .size = (uint32_t)raxel_voxel_world_gpu_size(world) }
     );
+    // the shader reads the front buffer while the worker stages the back one
     raxel_compute_shader_set_sb(compute_shader, pipeline, &sb_desc);
+    raxel_sb_buffer_t *front = compute_shader->sb_buffer;
+    raxel_sb_buffer_t *back = raxel_sb_buffer_create(&pipeline->resources.allocator,
+                                                     &sb_desc,
+                                                     pipeline->resources.device,
+                                                     pipeline->resources.device_physical);
+    __raxel_voxel_world_clear_gpu_buffer(world, front, pipeline);
+    __raxel_voxel_world_clear_gpu_buffer(world, back, pipeline);
+    raxel_voxel_world_start_streaming(world, front, back);
 }
 
 // =============================================================================
@@ -196,6 +782,148 @@ static inline raxel_bvh_bounds_t __raxel_bounds3f_union(const raxel_bvh_bounds_t
     return ret;
 }
 
+// Slab test of a ray against a box, clipped to [0, t_max]. t_near is where the ray enters it.
+// Plain compares rather than fminf and fmaxf, which are slower and would treat a NaN slab (a ray
+// in a face's plane) differently from the packet version below.
+static inline int __raxel_bounds3f_intersect(const raxel_bvh_bounds_t *b, const float origin[3], const float inv_direction[3], float t_max, float *t_near) {
+    float t0 = 0.0f;
+    float t1 = t_max;
+    for (int k = 0; k < 3; k++) {
+        float a = (b->min[k] - origin[k]) * inv_direction[k];
+        float c = (b->max[k] - origin[k]) * inv_direction[k];
+        float lo = a < c ? a : c;
+        float hi = a > c ? a : c;
+        t0 = lo > t0 ? lo : t0;
+        t1 = hi < t1 ? hi : t1;
+    }
+    *t_near = t0;
+    return t0 <= t1;
+}
+
+// --- Ray packets ---
+
+// Packet slab tests run on as many rays at once as the target has float lanes. The min and max
+// return their second operand for a NaN, like __raxel_bounds3f_intersect, which keeps a NaN slab
+// from winning over the interval so far.
+#if defined(__AVX__)
+#define __RAXEL_BVH_LANES 8
+typedef __m256 __raxel_bvh_lanes_t;
+#define __raxel_bvh_lanes_load(p) _mm256_loadu_ps(p)
+#define __raxel_bvh_lanes_store(p, a) _mm256_storeu_ps(p, a)
+#define __raxel_bvh_lanes_set1(x) _mm256_set1_ps(x)
+#define __raxel_bvh_lanes_sub(a, b) _mm256_sub_ps(a, b)
+#define __raxel_bvh_lanes_mul(a, b) _mm256_mul_ps(a, b)
+#define __raxel_bvh_lanes_min(a, b) _mm256_min_ps(a, b)
+#define __raxel_bvh_lanes_max(a, b) _mm256_max_ps(a, b)
+#define __raxel_bvh_lanes_le(a, b) ((uint32_t)_mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_LE_OQ)))
+#elif defined(__SSE__) || defined(_M_X64)
+#define __RAXEL_BVH_LANES 4
+typedef __m128 __raxel_bvh_lanes_t;
+#define __raxel_bvh_lanes_load(p) _mm_loadu_ps(p)
+#define __raxel_bvh_lanes_store(p, a) _mm_storeu_ps(p, a)
+#define __raxel_bvh_lanes_set1(x) _mm_set1_ps(x)
+#define __raxel_bvh_lanes_sub(a, b) _mm_sub_ps(a, b)
+#define __raxel_bvh_lanes_mul(a, b) _mm_mul_ps(a, b)
+#define __raxel_bvh_lanes_min(a, b) _mm_min_ps(a, b)
+#define __raxel_bvh_lanes_max(a, b) _mm_max_ps(a, b)
+#define __raxel_bvh_lanes_le(a, b) ((uint32_t)_mm_movemask_ps(_mm_cmple_ps(a, b)))
+#else
+#define __RAXEL_BVH_LANES 1
+typedef float __raxel_bvh_lanes_t;
+#define __raxel_bvh_lanes_load(p) (*(p))
+#define __raxel_bvh_lanes_store(p, a) (*(p) = (a))
+#define __raxel_bvh_lanes_set1(x) (x)
+#define __raxel_bvh_lanes_sub(a, b) ((a) - (b))
+#define __raxel_bvh_lanes_mul(a, b) ((a) * (b))
+#define __raxel_bvh_lanes_min(a, b) ((a) < (b) ? (a) : (b))
+#define __raxel_bvh_lanes_max(a, b) ((a) > (b) ? (a) : (b))
+#define __raxel_bvh_lanes_le(a, b) ((uint32_t)((a) <= (b)))
+#endif
+
+// A ray packet as the traversal walks it. Rays past n_rays are padded to whole lane groups with
+// rays that never enter anything.
+typedef struct __raxel_bvh_packet {
+    float origin[3][RAXEL_BVH_PACKET_MAX_RAYS];
+    float inv_direction[3][RAXEL_BVH_PACKET_MAX_RAYS];
+    float t_best[RAXEL_BVH_PACKET_MAX_RAYS];  // the nearest hit so far, max_t until there is one
+    float t_near[RAXEL_BVH_PACKET_MAX_RAYS];  // where the last slab test entered the box
+    int n_groups;
+} __raxel_bvh_packet_t;
+
+// Returns the mask of the packet's rays.
+static uint32_t __raxel_bvh_packet_init(__raxel_bvh_packet_t *packet, const raxel_bvh_ray_packet_t *rays) {
+    int n = rays->n_rays < 0 ? 0 : (rays->n_rays > RAXEL_BVH_PACKET_MAX_RAYS ? RAXEL_BVH_PACKET_MAX_RAYS : rays->n_rays);
+    for (int i = 0; i < RAXEL_BVH_PACKET_MAX_RAYS; i++) {
+        for (int k = 0; k < 3; k++) {
+            packet->origin[k][i] = i < n ? rays->origin[k][i] : 0.0f;
+            packet->inv_direction[k][i] = i < n ? 1.0f / rays->direction[k][i] : 0.0f;
+        }
+        packet->t_best[i] = i < n ? rays->max_t[i] : -1.0f;
+    }
+    packet->n_groups = (n + __RAXEL_BVH_LANES - 1) / __RAXEL_BVH_LANES;
+    return (uint32_t)((1ull << n) - 1u);
+}
+
+// __raxel_bounds3f_intersect for the given rays of a packet, each clipped to its t_best. Returns
+// the rays that enter the box; t_near holds where they do.
+static inline uint32_t __raxel_bvh_packet_intersect(__raxel_bvh_packet_t *packet, const raxel_bvh_bounds_t *b, uint32_t rays) {
+    const uint32_t group = (1u << __RAXEL_BVH_LANES) - 1u;
+    uint32_t entered = 0;
+    for (int g = 0; g < packet->n_groups; g++) {
+        int lane = g * __RAXEL_BVH_LANES;
+        if (!((rays >> lane) & group)) {
+            continue;
+        }
+        __raxel_bvh_lanes_t t0 = __raxel_bvh_lanes_set1(0.0f);
+        __raxel_bvh_lanes_t t1 = __raxel_bvh_lanes_load(&packet->t_best[lane]);
+        for (int k = 0; k < 3; k++) {
+            __raxel_bvh_lanes_t origin = __raxel_bvh_lanes_load(&packet->origin[k][lane]);
+            __raxel_bvh_lanes_t inv_direction = __raxel_bvh_lanes_load(&packet->inv_direction[k][lane]);
+            __raxel_bvh_lanes_t a = __raxel_bvh_lanes_mul(__raxel_bvh_lanes_sub(__raxel_bvh_lanes_set1(b->min[k]), origin), inv_direction);
+            __raxel_bvh_lanes_t c = __raxel_bvh_lanes_mul(__raxel_bvh_lanes_sub(__raxel_bvh_lanes_set1(b->max[k]), origin), inv_direction);
+            t0 = __raxel_bvh_lanes_max(__raxel_bvh_lanes_min(a, c), t0);
+            t1 = __raxel_bvh_lanes_min(__raxel_bvh_lanes_max(a, c), t1);
+        }
+        __raxel_bvh_lanes_store(&packet->t_near[lane], t0);
+        entered |= __raxel_bvh_lanes_le(t0, t1) << lane;
+    }
+    return entered & rays;
+}
+
+typedef void (*__raxel_bvh_packet_leaf_fn)(void *ctx, const raxel_linear_bvh_node_t *leaf, __raxel_bvh_packet_t *packet, uint32_t rays);
+
+// Walks a binary BVH with the given rays of a packet. A node is visited by the rays that enter its
+// box before their nearest hit so far, and a leaf hands those rays to leaf, which lowers their
+// t_best. The near child goes first, as the first of the rays sees it.
+static void __raxel_bvh_packet_traverse(const raxel_linear_bvh_node_t *nodes, __raxel_bvh_packet_t *packet, uint32_t rays,
+                                        __raxel_bvh_packet_leaf_fn leaf, void *ctx) {
+    int stack[64];
+    uint32_t stack_rays[64];
+    int stack_size = 0;
+    stack[stack_size] = 0;
+    stack_rays[stack_size++] = rays;
+    while (stack_size > 0) {
+        stack_size--;
+        int index = stack[stack_size];
+        const raxel_linear_bvh_node_t *node = &nodes[index];
+        uint32_t entered = __raxel_bvh_packet_intersect(packet, &node->bounds, stack_rays[stack_size]);
+        if (!entered) {
+            continue;
+        }
+        if (node->n_primitives > 0) {
+            leaf(ctx, node, packet, entered);
+        } else if (stack_size + 2 <= 64) {
+            int first = index + 1;
+            int second = node->second_child_offset;
+            int near_first = packet->inv_direction[node->axis][__builtin_ctz(entered)] >= 0.0f;
+            stack[stack_size] = near_first ? second : first;
+            stack_rays[stack_size++] = entered;
+            stack[stack_size] = near_first ? first : second;
+            stack_rays[stack_size++] = entered;
+        }
+    }
+}
+
 static inline void __raxel_bounds3f_centroid(const raxel_bvh_bounds_t *b, vec3 out_centroid) {
     out_centroid[0] = 0.5f * (b->min[0] + b->max[0]);
     out_centroid[1] = 0.5f * (b->min[1] + b->max[1]);
@@ -203,209 +931,984 @@ static inline void __raxel_bounds3f_centroid(const raxel_bvh_bounds_t *b, vec3 o
 }
 
 // =============================================================================
-// 5. BVH Build (Temporary Tree) with Node Limit
+// 5. BVH Build
 // =============================================================================
 
-// Create a new BVH build node.
-static __raxel_bvh_build_node_t *__raxel_bvh_build_node_create(raxel_allocator_t *allocator) {
-    __raxel_bvh_build_node_t *node = (__raxel_bvh_build_node_t *)raxel_malloc(allocator, sizeof(__raxel_bvh_build_node_t));
-    node->children[0] = node->children[1] = NULL;
-    node->n_primitives = 0;
-    node->first_prim_offset = -1;
-    node->split_axis = 0;
-    node->bounds = __raxel_bounds3f_empty();
-    return node;
+// Ranges below this many primitives are never split further across threads.
+#define __RAXEL_BVH_PARALLEL_GRAIN 4096
+
+typedef struct __raxel_bvh_bin {
+    raxel_bvh_bounds_t bounds;
+    int count;
+} __raxel_bvh_bin_t;
+
+// A subtree left to a worker of a parallel build. A subtree over m primitives has at most
+// 2 * m - 1 nodes, so the task writes its nodes at twice its start in the build's node array,
+// where they cannot meet another task's.
+typedef struct __raxel_bvh_build_task {
+    int start;
+    int end;
+    int top;      // the top node standing in for the subtree
+    int n_nodes;  // set by the task
+} __raxel_bvh_build_task_t;
+
+// A node above the subtree tasks of a parallel build.
+typedef struct __raxel_bvh_top_node {
+    raxel_linear_bvh_node_t node;  // second_child_offset is left for the assembly
+    int children[2];               // top nodes
+    int task_start;                // the subtree task's start if the node stands in for one, else -1
+    int task_nodes;
+} __raxel_bvh_top_node_t;
+
+// Everything the recursive build shares. Centroids are computed once up front and indexed by
+// primitive, like primitive_bounds. Nodes are emitted depth first into nodes, which has room for
+// the 2 * n - 1 nodes a build can have. A parallel build splits the top of the tree on the calling
+// thread, gathering the bounds and bins of every node from num_parts slices of its range at once,
+// and queues the ranges below task_size as tasks; those touch disjoint parts of
+// primitive_indices and nodes, so they are built concurrently with no further synchronisation.
+typedef struct __raxel_bvh_build_ctx {
+    raxel_bvh_bounds_t *primitive_bounds;
+    vec3 *centroids;
+    int *primitive_indices;
+    raxel_linear_bvh_node_t *nodes;
+    uint64_t *lbvh_keys;                                // LBVH: the sort keys and the sort's buffer
+    int *lbvh_ints;                                     // LBVH: prefixes, links and the link stack
+    __raxel_bvh_build_node_t *tree;                     // LBVH with treelets: the nodes while refining
+    int max_leaf_size;
+    raxel_bvh_build_method_t method;
+    raxel_bvh_build_scratch_t *scratch;
+    raxel_thread_pool_t *pool;                          // NULL for a serial build
+    int task_size;
+    int num_parts;
+    raxel_bvh_bounds_t *part_bounds;                    // per slice: bounds, centroid bounds
+    __raxel_bvh_bin_t (*part_bins)[3][RAXEL_BVH_SAH_BINS];  // per slice: bins of every axis
+    int part_start;                                     // the range the slices split
+    int part_end;
+    const raxel_bvh_bounds_t *part_centroid_bounds;     // the range's centroid bounds, for binning
+} __raxel_bvh_build_ctx_t;
+
+static inline float __raxel_bounds3f_surface_area(const raxel_bvh_bounds_t *b) {
+    float dx = b->max[0] - b->min[0];
+    float dy = b->max[1] - b->min[1];
+    float dz = b->max[2] - b->min[2];
+    if (dx < 0.0f || dy < 0.0f || dz < 0.0f) {
+        return 0.0f;
+    }
+    return 2.0f * (dx * dy + dy * dz + dz * dx);
+}
+
+// Reorders indices[start, end) so that the primitive at k has the k-th smallest centroid along
+// axis, with no larger centroid before it and no smaller one after it (quickselect).
+static void __raxel_bvh_select(__raxel_bvh_build_ctx_t *ctx, int axis, int start, int end, int k) {
+    int *indices = ctx->primitive_indices;
+    int lo = start;
+    int hi = end - 1;
+    while (lo < hi) {
+        float pivot = ctx->centroids[indices[lo + (hi - lo) / 2]][axis];
+        int i = lo;
+        int j = hi;
+        while (i <= j) {
+            while (ctx->centroids[indices[i]][axis] < pivot) i++;
+            while (ctx->centroids[indices[j]][axis] > pivot) j--;
+            if (i <= j) {
+                int tmp = indices[i];
+                indices[i] = indices[j];
+                indices[j] = tmp;
+                i++;
+                j--;
+            }
+        }
+        if (k <= j) {
+            hi = j;
+        } else if (k >= i) {
+            lo = i;
+        } else {
+            return;
+        }
+    }
 }
 
-// Recursively free the BVH build tree.
-static void __raxel_bvh_build_tree_free(__raxel_bvh_build_node_t *node, raxel_allocator_t *allocator) {
-    if (!node) return;
-    __raxel_bvh_build_tree_free(node->children[0], allocator);
-    __raxel_bvh_build_tree_free(node->children[1], allocator);
-    raxel_free(allocator, node);
+static inline int __raxel_bvh_bin_index(float centroid, float min, float scale) {
+    int b = (int)((centroid - min) * scale);
+    return b < 0 ? 0 : (b >= RAXEL_BVH_SAH_BINS ? RAXEL_BVH_SAH_BINS - 1 : b);
 }
 
-// Build the BVH with a limit on the maximum number of nodes.
-static __raxel_bvh_build_node_t *__build_raxel_bvh_limited(raxel_bvh_bounds_t *primitive_bounds,
-                                                           int *primitive_indices,
-                                                           int start,
-                                                           int end,
-                                                           int max_leaf_size,
-                                                           int *node_counter,
-                                                           raxel_allocator_t *allocator) {
-    __raxel_bvh_build_node_t *node = __raxel_bvh_build_node_create(allocator);
+// Bounds and centroid bounds of the primitives in indices[start, end).
+static void __raxel_bvh_range_bounds(__raxel_bvh_build_ctx_t *ctx, int start, int end,
+                                     raxel_bvh_bounds_t *out_bounds, raxel_bvh_bounds_t *out_centroid_bounds) {
     raxel_bvh_bounds_t bounds = __raxel_bounds3f_empty();
+    raxel_bvh_bounds_t centroid_bounds = __raxel_bounds3f_empty();
     for (int i = start; i < end; i++) {
-        bounds = __raxel_bounds3f_union(&bounds, &primitive_bounds[primitive_indices[i]]);
+        int prim = ctx->primitive_indices[i];
+        bounds = __raxel_bounds3f_union(&bounds, &ctx->primitive_bounds[prim]);
+        for (int k = 0; k < 3; k++) {
+            centroid_bounds.min[k] = fminf(centroid_bounds.min[k], ctx->centroids[prim][k]);
+            centroid_bounds.max[k] = fmaxf(centroid_bounds.max[k], ctx->centroids[prim][k]);
+        }
     }
-    node->bounds = bounds;
-    int n_primitives = end - start;
-    // Force leaf if too few primitives or adding children would exceed max nodes.
-    if (n_primitives <= max_leaf_size || (*node_counter + 2 > RAXEL_BVH_MAX_NODES)) {
-        node->n_primitives = n_primitives;
-        node->first_prim_offset = start;
-        return node;
-    } else {
-        raxel_bvh_bounds_t centroid_bounds = __raxel_bounds3f_empty();
-        for (int i = start; i < end; i++) {
-            vec3 centroid;
-            __raxel_bounds3f_centroid(&primitive_bounds[primitive_indices[i]], centroid);
-            raxel_bvh_bounds_t tmp;
-            glm_vec3_copy(centroid, tmp.min);
-            glm_vec3_copy(centroid, tmp.max);
-            centroid_bounds = __raxel_bounds3f_union(&centroid_bounds, &tmp);
-        }
-        vec3 extent;
-        extent[0] = centroid_bounds.max[0] - centroid_bounds.min[0];
-        extent[1] = centroid_bounds.max[1] - centroid_bounds.min[1];
-        extent[2] = centroid_bounds.max[2] - centroid_bounds.min[2];
-        int axis = 0;
-        if (extent[1] > extent[0]) axis = 1;
-        if (extent[2] > ((axis == 0) ? extent[0] : extent[1])) axis = 2;
-        node->split_axis = axis;
-        int mid = (start + end) / 2;
-        
-        // not a part of the C99 standard, but works in GCC
-        int cmp(const void *a, const void *b) {
-            int ia = *(const int *)a;
-            int ib = *(const int *)b;
-            vec3 ca, cb;
-            __raxel_bounds3f_centroid(&primitive_bounds[ia], ca);
-            __raxel_bounds3f_centroid(&primitive_bounds[ib], cb);
-            float diff = (axis == 0 ? ca[0] - cb[0] : axis == 1 ? ca[1] - cb[1] : ca[2] - cb[2]);
-            return (diff < 0) ? -1 : (diff > 0) ? 1 : 0;
-        }
-
-        qsort(primitive_indices + start, n_primitives, sizeof(int), cmp);
-        *node_counter += 2;
-        node->children[0] = __build_raxel_bvh_limited(primitive_bounds, primitive_indices,
-                                                      start, mid, max_leaf_size, node_counter, allocator);
-        node->children[1] = __build_raxel_bvh_limited(primitive_bounds, primitive_indices,
-                                                      mid, end, max_leaf_size, node_counter, allocator);
-        return node;
-    }
-}
-
-static int __count_raxel_bvh_nodes(__raxel_bvh_build_node_t *node) {
-    if (!node) return 0;
-    if (node->n_primitives > 0)
-        return 1;
-    return 1 + __count_raxel_bvh_nodes(node->children[0]) + __count_raxel_bvh_nodes(node->children[1]);
+    *out_bounds = bounds;
+    *out_centroid_bounds = centroid_bounds;
 }
 
-static int __flatten_bvh_tree(__raxel_bvh_build_node_t *node, int *offset, raxel_linear_bvh_node_t *nodes) {
-    int my_offset = (*offset);
-    raxel_linear_bvh_node_t *linear_node = &nodes[my_offset];
-    (*offset)++;
-    linear_node->bounds = node->bounds;
-    if (node->n_primitives > 0) {
-        linear_node->primitives_offset = node->first_prim_offset;
-        linear_node->n_primitives = (uint16_t)node->n_primitives;
-    } else {
-        linear_node->axis = (uint8_t)node->split_axis;
-        linear_node->n_primitives = 0;
-        __flatten_bvh_tree(node->children[0], offset, nodes);
-        linear_node->second_child_offset = __flatten_bvh_tree(node->children[1], offset, nodes);
+// Sorts the primitives in indices[start, end) into RAXEL_BVH_SAH_BINS bins per axis. Axes along
+// which the centroids do not spread are left empty.
+static void __raxel_bvh_bin_range(__raxel_bvh_build_ctx_t *ctx, const raxel_bvh_bounds_t *centroid_bounds, int start, int end,
+                                  __raxel_bvh_bin_t bins[3][RAXEL_BVH_SAH_BINS]) {
+    float scale[3];
+    for (int axis = 0; axis < 3; axis++) {
+        float extent = centroid_bounds->max[axis] - centroid_bounds->min[axis];
+        scale[axis] = extent > 0.0f ? (float)RAXEL_BVH_SAH_BINS / extent : 0.0f;
+        for (int b = 0; b < RAXEL_BVH_SAH_BINS; b++) {
+            bins[axis][b].bounds = __raxel_bounds3f_empty();
+            bins[axis][b].count = 0;
+        }
+    }
+    for (int i = start; i < end; i++) {
+        int prim = ctx->primitive_indices[i];
+        for (int axis = 0; axis < 3; axis++) {
+            if (scale[axis] == 0.0f) {
+                continue;
+            }
+            int b = __raxel_bvh_bin_index(ctx->centroids[prim][axis], centroid_bounds->min[axis], scale[axis]);
+            bins[axis][b].bounds = __raxel_bounds3f_union(&bins[axis][b].bounds, &ctx->primitive_bounds[prim]);
+            bins[axis][b].count++;
+        }
     }
-    return my_offset;
 }
 
-static void __print_bvh_build_structure(__raxel_bvh_build_node_t *node, int depth) {
-    for (int i = 0; i < depth; i++) {
-        printf("  ");
+// Picks the cheapest of the RAXEL_BVH_SAH_BINS - 1 bin boundaries on every axis by the surface
+// area heuristic and partitions indices[start, end) around it in place. Returns the index of
+// the first primitive on the right, or -1 if the centroids cannot be told apart.
+static int __raxel_bvh_split_sah(__raxel_bvh_build_ctx_t *ctx, const raxel_bvh_bounds_t *centroid_bounds,
+                                 __raxel_bvh_bin_t bins[3][RAXEL_BVH_SAH_BINS], int start, int end, int *out_axis) {
+    float best_cost = INFINITY;
+    int best_axis = -1;
+    int best_split = 0;
+    for (int axis = 0; axis < 3; axis++) {
+        if (centroid_bounds->max[axis] - centroid_bounds->min[axis] <= 0.0f) {
+            continue;
+        }
+
+        // sweep from the right to get the area and count right of every boundary, then from
+        // the left to evaluate count * area on both sides
+        float right_area[RAXEL_BVH_SAH_BINS];
+        int right_count[RAXEL_BVH_SAH_BINS];
+        raxel_bvh_bounds_t right = __raxel_bounds3f_empty();
+        int count = 0;
+        for (int b = RAXEL_BVH_SAH_BINS - 1; b > 0; b--) {
+            right = __raxel_bounds3f_union(&right, &bins[axis][b].bounds);
+            count += bins[axis][b].count;
+            right_area[b] = __raxel_bounds3f_surface_area(&right);
+            right_count[b] = count;
+        }
+        raxel_bvh_bounds_t left = __raxel_bounds3f_empty();
+        count = 0;
+        for (int b = 0; b < RAXEL_BVH_SAH_BINS - 1; b++) {
+            left = __raxel_bounds3f_union(&left, &bins[axis][b].bounds);
+            count += bins[axis][b].count;
+            if (count == 0 || right_count[b + 1] == 0) {
+                continue;
+            }
+            float cost = (float)count * __raxel_bounds3f_surface_area(&left) + (float)right_count[b + 1] * right_area[b + 1];
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_axis = axis;
+                best_split = b;
+            }
+        }
     }
-    if (node->n_primitives > 0) {
-        printf("Leaf: %d primitives\n", node->n_primitives);
-    } else {
-        printf("Interior: Axis %d\n", node->split_axis);
-        __print_bvh_build_structure(node->children[0], depth + 1);
-        __print_bvh_build_structure(node->children[1], depth + 1);
+    if (best_axis < 0) {
+        return -1;
     }
+
+    float min = centroid_bounds->min[best_axis];
+    float scale = (float)RAXEL_BVH_SAH_BINS / (centroid_bounds->max[best_axis] - min);
+    int *indices = ctx->primitive_indices;
+    int i = start;
+    int j = end - 1;
+    while (i <= j) {
+        if (__raxel_bvh_bin_index(ctx->centroids[indices[i]][best_axis], min, scale) <= best_split) {
+            i++;
+        } else {
+            int tmp = indices[i];
+            indices[i] = indices[j];
+            indices[j] = tmp;
+            j--;
+        }
+    }
+    *out_axis = best_axis;
+    return i;
 }
 
-// =============================================================================
-// 6. Public BVH Accelerator API
-// =============================================================================
+// Splits indices[start, end) at the median of the widest centroid axis; with all centroids equal
+// this just halves the range. Returns the index of the first primitive on the right.
+static int __raxel_bvh_split_median(__raxel_bvh_build_ctx_t *ctx, const raxel_bvh_bounds_t *centroid_bounds, int start, int end, int *out_axis) {
+    vec3 extent;
+    glm_vec3_sub((float *)centroid_bounds->max, (float *)centroid_bounds->min, extent);
+    int axis = 0;
+    if (extent[1] > extent[0]) axis = 1;
+    if (extent[2] > extent[axis]) axis = 2;
+    int mid = (start + end) / 2;
+    __raxel_bvh_select(ctx, axis, start, end, mid);
+    *out_axis = axis;
+    return mid;
+}
 
-raxel_bvh_accel_t *raxel_bvh_accel_build(raxel_bvh_bounds_t *primitive_bounds,
-                                          int *primitive_indices,
-                                          int n,
-                                          int max_leaf_size,
-                                          raxel_allocator_t *allocator) {
-    raxel_bvh_accel_t *bvh = (raxel_bvh_accel_t *)raxel_malloc(allocator, sizeof(raxel_bvh_accel_t));
-    bvh->max_leaf_size = max_leaf_size;
-    int node_counter = 1;
-    __raxel_bvh_build_node_t *root = __build_raxel_bvh_limited(primitive_bounds, primitive_indices, 0, n, max_leaf_size, &node_counter, allocator);
-    // __print_bvh_build_structure(root, 0); // DO NOT DO THIS
-    bvh->n_nodes = __count_raxel_bvh_nodes(root);
-    RAXEL_CORE_LOG("Built BVH with %d nodes\n", bvh->n_nodes);
-    int offset = 0;
-    __flatten_bvh_tree(root, &offset, bvh->nodes);
-    __raxel_bvh_build_tree_free(root, allocator);
-    return bvh;
+// Serial SAH split, binning on the stack of this call rather than the recursion's.
+static int __raxel_bvh_split_sah_serial(__raxel_bvh_build_ctx_t *ctx, const raxel_bvh_bounds_t *centroid_bounds, int start, int end, int *out_axis) {
+    __raxel_bvh_bin_t bins[3][RAXEL_BVH_SAH_BINS];
+    __raxel_bvh_bin_range(ctx, centroid_bounds, start, end, bins);
+    return __raxel_bvh_split_sah(ctx, centroid_bounds, bins, start, end, out_axis);
 }
 
-void raxel_bvh_accel_destroy(raxel_bvh_accel_t *bvh, raxel_allocator_t *allocator) {
-    if (!bvh) return;
-    raxel_free(allocator, bvh);
+static inline void __raxel_bvh_make_leaf(raxel_linear_bvh_node_t *node, int start, int end) {
+    node->primitives_offset = start;
+    node->n_primitives = (uint32_t)(end - start);
+    node->axis = 0;
 }
 
-raxel_bvh_accel_t *raxel_bvh_accel_build_from_voxel_world(raxel_voxel_world_t *world, int max_leaf_size, raxel_allocator_t *allocator) {
-    int total_prims = 0;
-    for (size_t i = 0; i < world->__num_loaded_chunks; i++) {
-        raxel_voxel_chunk_t *chunk = &world->chunks[i];
-        raxel_voxel_chunk_meta_t meta = world->chunk_meta[i];
-        vec3 chunk_origin = { (float)meta.x, (float)meta.y, (float)meta.z };
-        glm_vec3_scale(chunk_origin, (float)RAXEL_VOXEL_CHUNK_SIZE, chunk_origin);
-        for (int j = 0; j < RAXEL_VOXEL_CHUNK_SIZE * RAXEL_VOXEL_CHUNK_SIZE * RAXEL_VOXEL_CHUNK_SIZE; j++) {
-            if (chunk->voxels[j].material != 0) {
-                total_prims++;
-            }
-        }
+// Split until every leaf holds at most max_leaf_size primitives, emitting the subtree depth first
+// at nodes[*n_nodes]. Interior nodes point at their second child relative to nodes.
+static void __build_raxel_bvh_limited(__raxel_bvh_build_ctx_t *ctx, raxel_linear_bvh_node_t *nodes, int *n_nodes, int start, int end) {
+    int offset = (*n_nodes)++;
+    raxel_linear_bvh_node_t *node = &nodes[offset];
+    raxel_bvh_bounds_t centroid_bounds;
+    __raxel_bvh_range_bounds(ctx, start, end, &node->bounds, &centroid_bounds);
+    int n_primitives = end - start;
+    if (n_primitives <= ctx->max_leaf_size) {
+        __raxel_bvh_make_leaf(node, start, end);
+        return;
     }
-    if (total_prims == 0)
-        return NULL;
-
-    raxel_bvh_bounds_t *prim_bounds = (raxel_bvh_bounds_t *)raxel_malloc(allocator, total_prims * sizeof(raxel_bvh_bounds_t));
-    int *prim_indices = (int *)raxel_malloc(allocator, total_prims * sizeof(int));
 
-    int index = 0;
-    for (size_t i = 0; i < world->__num_loaded_chunks; i++) {
-        raxel_voxel_chunk_meta_t meta = world->chunk_meta[i];
-        raxel_voxel_chunk_t *chunk = &world->chunks[i];
-        vec3 chunk_origin = { (float)meta.x, (float)meta.y, (float)meta.z };
-        glm_vec3_scale(chunk_origin, (float)RAXEL_VOXEL_CHUNK_SIZE, chunk_origin);
-        for (int j = 0; j < RAXEL_VOXEL_CHUNK_SIZE * RAXEL_VOXEL_CHUNK_SIZE * RAXEL_VOXEL_CHUNK_SIZE; j++) {
-            if (chunk->voxels[j].material == 0)
-                continue;
-            int lx = j % RAXEL_VOXEL_CHUNK_SIZE;
-            int ly = (j / RAXEL_VOXEL_CHUNK_SIZE) % RAXEL_VOXEL_CHUNK_SIZE;
-            int lz = j / (RAXEL_VOXEL_CHUNK_SIZE * RAXEL_VOXEL_CHUNK_SIZE);
-            float min_pt[3];
-            min_pt[0] = chunk_origin[0] + (float)lx;
-            min_pt[1] = chunk_origin[1] + (float)ly;
-            min_pt[2] = chunk_origin[2] + (float)lz;
-            float max_pt[3];
-            max_pt[0] = min_pt[0] + 1.0f;
-            max_pt[1] = min_pt[1] + 1.0f;
-            max_pt[2] = min_pt[2] + 1.0f;
-            prim_bounds[index].min[0] = min_pt[0];
-            prim_bounds[index].min[1] = min_pt[1];
-            prim_bounds[index].min[2] = min_pt[2];
-            prim_bounds[index].max[0] = max_pt[0];
-            prim_bounds[index].max[1] = max_pt[1];
-            prim_bounds[index].max[2] = max_pt[2];
-            prim_indices[index] = index;
-            index++;
-        }
+    int axis = 0;
+    int mid = -1;
+    if (ctx->method == RAXEL_BVH_BUILD_SAH) {
+        mid = __raxel_bvh_split_sah_serial(ctx, &centroid_bounds, start, end, &axis);
     }
-
-    RAXEL_CORE_LOG("Building BVH with %d primitives\n", total_prims);
-    
-    raxel_bvh_accel_t *bvh = raxel_bvh_accel_build(prim_bounds, prim_indices, total_prims, max_leaf_size, allocator);
-    raxel_free(allocator, prim_bounds);
-    raxel_free(allocator, prim_indices);
-    return bvh;
+    if (mid < 0) {
+        mid = __raxel_bvh_split_median(ctx, &centroid_bounds, start, end, &axis);
+    }
+    node->axis = (uint32_t)axis;
+    node->n_primitives = 0;
+    __build_raxel_bvh_limited(ctx, nodes, n_nodes, start, mid);
+    node->second_child_offset = *n_nodes;
+    __build_raxel_bvh_limited(ctx, nodes, n_nodes, mid, end);
+}
+
+// --- Parallel build ---
+
+static inline int __raxel_bvh_part_start(__raxel_bvh_build_ctx_t *ctx, int part) {
+    return ctx->part_start + (int)((int64_t)(ctx->part_end - ctx->part_start) * part / ctx->num_parts);
+}
+
+static void __raxel_bvh_centroids_task(void *arg, int part) {
+    __raxel_bvh_build_ctx_t *ctx = arg;
+    for (int i = __raxel_bvh_part_start(ctx, part); i < __raxel_bvh_part_start(ctx, part + 1); i++) {
+        __raxel_bounds3f_centroid(&ctx->primitive_bounds[i], ctx->centroids[i]);
+    }
+}
+
+static void __raxel_bvh_bounds_task(void *arg, int part) {
+    __raxel_bvh_build_ctx_t *ctx = arg;
+    __raxel_bvh_range_bounds(ctx, __raxel_bvh_part_start(ctx, part), __raxel_bvh_part_start(ctx, part + 1),
+                             &ctx->part_bounds[2 * part], &ctx->part_bounds[2 * part + 1]);
+}
+
+static void __raxel_bvh_bins_task(void *arg, int part) {
+    __raxel_bvh_build_ctx_t *ctx = arg;
+    __raxel_bvh_bin_range(ctx, ctx->part_centroid_bounds, __raxel_bvh_part_start(ctx, part), __raxel_bvh_part_start(ctx, part + 1),
+                          ctx->part_bins[part]);
+}
+
+static void __raxel_bvh_subtree_task(void *arg, int task) {
+    __raxel_bvh_build_ctx_t *ctx = arg;
+    __raxel_bvh_build_task_t *t = &ctx->scratch->tasks[task];
+    t->n_nodes = 0;
+    __build_raxel_bvh_limited(ctx, ctx->nodes + 2 * t->start, &t->n_nodes, t->start, t->end);
+}
+
+// Largest subtree first, so the long tasks do not end up last on one thread.
+static int __raxel_bvh_task_compare(const void *a, const void *b) {
+    const __raxel_bvh_build_task_t *ta = a;
+    const __raxel_bvh_build_task_t *tb = b;
+    return (tb->end - tb->start) - (ta->end - ta->start);
+}
+
+// The top of a parallel build. Makes the same splits __build_raxel_bvh_limited would, since
+// bounds and bin counts do not depend on the order they are gathered in, so the finished tree
+// is identical to a serial build's. Returns the index of the range's top node; children come
+// before their parent.
+static int __build_raxel_bvh_top(__raxel_bvh_build_ctx_t *ctx, int start, int end) {
+    raxel_bvh_build_scratch_t *scratch = ctx->scratch;
+    __raxel_bvh_top_node_t top = { .children = { -1, -1 }, .task_start = -1, .task_nodes = 0 };
+    int n_primitives = end - start;
+    if (n_primitives <= ctx->task_size) {
+        __raxel_bvh_build_task_t task = { .start = start, .end = end, .top = (int)raxel_list_size(scratch->top), .n_nodes = 0 };
+        raxel_list_push_back(scratch->tasks, task);
+        top.task_start = start;
+        raxel_list_push_back(scratch->top, top);
+        return task.top;
+    }
+    raxel_linear_bvh_node_t *node = &top.node;
+    node->bounds = __raxel_bounds3f_empty();
+    ctx->part_start = start;
+    ctx->part_end = end;
+    raxel_thread_pool_run(ctx->pool, ctx->num_parts, __raxel_bvh_bounds_task, ctx);
+    raxel_bvh_bounds_t centroid_bounds = __raxel_bounds3f_empty();
+    for (int p = 0; p < ctx->num_parts; p++) {
+        node->bounds = __raxel_bounds3f_union(&node->bounds, &ctx->part_bounds[2 * p]);
+        centroid_bounds = __raxel_bounds3f_union(&centroid_bounds, &ctx->part_bounds[2 * p + 1]);
+    }
+    if (n_primitives <= ctx->max_leaf_size) {
+        __raxel_bvh_make_leaf(node, start, end);
+        raxel_list_push_back(scratch->top, top);
+        return (int)raxel_list_size(scratch->top) - 1;
+    }
+
+    int axis = 0;
+    int mid = -1;
+    if (ctx->method == RAXEL_BVH_BUILD_SAH) {
+        ctx->part_centroid_bounds = &centroid_bounds;
+        raxel_thread_pool_run(ctx->pool, ctx->num_parts, __raxel_bvh_bins_task, ctx);
+        __raxel_bvh_bin_t (*bins)[RAXEL_BVH_SAH_BINS] = ctx->part_bins[0];
+        for (int p = 1; p < ctx->num_parts; p++) {
+            for (int k = 0; k < 3; k++) {
+                for (int b = 0; b < RAXEL_BVH_SAH_BINS; b++) {
+                    bins[k][b].bounds = __raxel_bounds3f_union(&bins[k][b].bounds, &ctx->part_bins[p][k][b].bounds);
+                    bins[k][b].count += ctx->part_bins[p][k][b].count;
+                }
+            }
+        }
+        mid = __raxel_bvh_split_sah(ctx, &centroid_bounds, bins, start, end, &axis);
+    }
+    if (mid < 0) {
+        mid = __raxel_bvh_split_median(ctx, &centroid_bounds, start, end, &axis);
+    }
+    node->axis = (uint32_t)axis;
+    node->n_primitives = 0;
+    top.children[0] = __build_raxel_bvh_top(ctx, start, mid);
+    top.children[1] = __build_raxel_bvh_top(ctx, mid, end);
+    raxel_list_push_back(scratch->top, top);
+    return (int)raxel_list_size(scratch->top) - 1;
+}
+
+// Emits the finished tree of a parallel build depth first from a top node, copying in the task
+// subtrees whole and moving their child offsets along.
+static void __raxel_bvh_assemble(__raxel_bvh_build_ctx_t *ctx, int top, raxel_linear_bvh_node_t *out, int *n_nodes) {
+    const __raxel_bvh_top_node_t *t = &ctx->scratch->top[top];
+    if (t->task_start >= 0) {
+        int base = *n_nodes;
+        memcpy(out + base, ctx->nodes + 2 * t->task_start, t->task_nodes * sizeof(raxel_linear_bvh_node_t));
+        for (int i = base; i < base + t->task_nodes; i++) {
+            if (out[i].n_primitives == 0) {
+                out[i].second_child_offset += base;
+            }
+        }
+        *n_nodes += t->task_nodes;
+        return;
+    }
+    int offset = (*n_nodes)++;
+    out[offset] = t->node;
+    if (t->node.n_primitives == 0) {
+        __raxel_bvh_assemble(ctx, t->children[0], out, n_nodes);
+        out[offset].second_child_offset = *n_nodes;
+        __raxel_bvh_assemble(ctx, t->children[1], out, n_nodes);
+    }
+}
+
+// --- Linear BVH ---
+
+// Spreads the low 10 bits of v out to every third bit.
+static inline uint32_t __raxel_bvh_morton_expand(uint32_t v) {
+    v &= 0x3ffu;
+    v = (v | (v << 16)) & 0x030000ffu;
+    v = (v | (v << 8)) & 0x0300f00fu;
+    v = (v | (v << 4)) & 0x030c30c3u;
+    v = (v | (v << 2)) & 0x09249249u;
+    return v;
+}
+
+// The sorted primitives of an LBVH build. Key i is the primitive's 30-bit Morton code above its
+// position i, so all keys are distinct and in order. Between positions i and i + 1 the keys share
+// prefix[i] leading bits; a range splits where its shortest prefix is, i.e. at its highest
+// differing bit, which is unique within the range. The splits form a Cartesian tree over prefix
+// (every split is the minimum of its range), so left[i] and right[i] give the splits of the two
+// halves at i, or -1 for a single primitive, and the whole tree takes one stack pass.
+typedef struct __raxel_lbvh {
+    uint64_t *keys;
+    int *prefix;
+    int *left;
+    int *right;
+} __raxel_lbvh_t;
+
+// Sorts indices[0, n) by Morton code, three stable passes of 10 bits each.
+static void __raxel_lbvh_sort(__raxel_bvh_build_ctx_t *ctx, int n, const raxel_bvh_bounds_t *centroid_bounds, uint64_t *keys, uint64_t *scratch) {
+    // one scale for all axes keeps the cells cubes, so flat scenes are split like tall ones
+    float extent = 0.0f;
+    for (int k = 0; k < 3; k++) {
+        extent = fmaxf(extent, centroid_bounds->max[k] - centroid_bounds->min[k]);
+    }
+    float scale = extent > 0.0f ? 1023.0f / extent : 0.0f;
+    for (int i = 0; i < n; i++) {
+        int prim = ctx->primitive_indices[i];
+        uint32_t code = 0;
+        for (int k = 0; k < 3; k++) {
+            uint32_t q = (uint32_t)((ctx->centroids[prim][k] - centroid_bounds->min[k]) * scale + 0.5f);
+            code |= __raxel_bvh_morton_expand(q > 1023u ? 1023u : q) << k;
+        }
+        keys[i] = ((uint64_t)code << 32) | (uint32_t)prim;
+    }
+    for (int shift = 32; shift < 62; shift += 10) {
+        int offsets[1024] = {0};
+        for (int i = 0; i < n; i++) {
+            offsets[(keys[i] >> shift) & 0x3ff]++;
+        }
+        if (offsets[(keys[0] >> shift) & 0x3ff] == n) {
+            continue;  // every key has the same digit, common for the high bits of small grids
+        }
+        int sum = 0;
+        for (int d = 0; d < 1024; d++) {
+            int count = offsets[d];
+            offsets[d] = sum;
+            sum += count;
+        }
+        for (int i = 0; i < n; i++) {
+            scratch[offsets[(keys[i] >> shift) & 0x3ff]++] = keys[i];
+        }
+        memcpy(keys, scratch, n * sizeof(uint64_t));
+    }
+    for (int i = 0; i < n; i++) {
+        ctx->primitive_indices[i] = (int)(uint32_t)keys[i];
+        keys[i] = (keys[i] & 0xffffffff00000000ull) | (uint32_t)i;
+    }
+}
+
+// Links the splits into their Cartesian tree; returns the split of the whole range.
+static int __raxel_lbvh_link(__raxel_lbvh_t *lbvh, int n, int *stack) {
+    int stack_size = 0;
+    for (int i = 0; i + 1 < n; i++) {
+        lbvh->prefix[i] = __builtin_clzll(lbvh->keys[i] ^ lbvh->keys[i + 1]);
+        lbvh->left[i] = lbvh->right[i] = -1;
+        int last = -1;
+        while (stack_size > 0 && lbvh->prefix[stack[stack_size - 1]] > lbvh->prefix[i]) {
+            last = stack[--stack_size];
+        }
+        lbvh->left[i] = last;
+        if (stack_size > 0) {
+            lbvh->right[stack[stack_size - 1]] = i;
+        }
+        stack[stack_size++] = i;
+    }
+    return stack_size > 0 ? stack[0] : -1;
+}
+
+// Emits the subtree over indices[start, end) depth first at ctx->nodes[*n_nodes].
+static void __build_raxel_lbvh(__raxel_bvh_build_ctx_t *ctx, __raxel_lbvh_t *lbvh, int *n_nodes, int start, int end, int split) {
+    int offset = (*n_nodes)++;
+    raxel_linear_bvh_node_t *node = &ctx->nodes[offset];
+    if (end - start <= ctx->max_leaf_size) {
+        node->bounds = __raxel_bounds3f_empty();
+        for (int i = start; i < end; i++) {
+            node->bounds = __raxel_bounds3f_union(&node->bounds, &ctx->primitive_bounds[ctx->primitive_indices[i]]);
+        }
+        __raxel_bvh_make_leaf(node, start, end);
+        return;
+    }
+    // the differing bit of the Morton code is the axis the halves are apart on, the left half
+    // below; ties broken by position say nothing, any axis will do
+    int bit = 63 - lbvh->prefix[split];
+    node->axis = bit >= 32 ? (uint32_t)((bit - 32) % 3) : 0;
+    node->n_primitives = 0;
+    int mid = split + 1;
+    __build_raxel_lbvh(ctx, lbvh, n_nodes, start, mid, lbvh->left[split]);
+    node->second_child_offset = *n_nodes;
+    __build_raxel_lbvh(ctx, lbvh, n_nodes, mid, end, lbvh->right[split]);
+    node->bounds = __raxel_bounds3f_union(&ctx->nodes[offset + 1].bounds, &ctx->nodes[node->second_child_offset].bounds);
+}
+
+// --- Treelet refinement ---
+
+// Traversal cost relative to one primitive test; the same ratio the SAH split uses.
+static inline float __raxel_bvh_leaf_cost(const __raxel_bvh_build_node_t *node) {
+    return __raxel_bounds3f_surface_area(&node->bounds) * (float)node->n_primitives;
+}
+
+// Orders the children of an interior node low side first along the axis their centres are
+// furthest apart on, which is what the near-child-first traversals expect.
+static void __raxel_bvh_orient(__raxel_bvh_build_node_t *node) {
+    vec3 c0, c1;
+    __raxel_bounds3f_centroid(&node->children[0]->bounds, c0);
+    __raxel_bounds3f_centroid(&node->children[1]->bounds, c1);
+    int axis = 0;
+    for (int k = 1; k < 3; k++) {
+        if (fabsf(c1[k] - c0[k]) > fabsf(c1[axis] - c0[axis])) {
+            axis = k;
+        }
+    }
+    node->split_axis = axis;
+    if (c1[axis] < c0[axis]) {
+        __raxel_bvh_build_node_t *tmp = node->children[0];
+        node->children[0] = node->children[1];
+        node->children[1] = tmp;
+    }
+}
+
+typedef struct __raxel_bvh_treelet {
+    __raxel_bvh_build_node_t *leaves[RAXEL_BVH_TREELET_LEAVES];
+    __raxel_bvh_build_node_t *interior[RAXEL_BVH_TREELET_LEAVES - 1];
+    float cost[1 << RAXEL_BVH_TREELET_LEAVES];
+    raxel_bvh_bounds_t bounds[1 << RAXEL_BVH_TREELET_LEAVES];
+    uint8_t split[1 << RAXEL_BVH_TREELET_LEAVES];  // the left part of a subset's best partition
+    int n_interior_used;
+} __raxel_bvh_treelet_t;
+
+// Rebuilds the subset of treelet leaves as a subtree along the best partitions, reusing the
+// treelet's interior nodes.
+static __raxel_bvh_build_node_t *__raxel_bvh_treelet_emit(__raxel_bvh_treelet_t *treelet, int subset) {
+    if ((subset & (subset - 1)) == 0) {
+        return treelet->leaves[__builtin_ctz(subset)];
+    }
+    __raxel_bvh_build_node_t *node = treelet->interior[treelet->n_interior_used++];
+    node->children[0] = __raxel_bvh_treelet_emit(treelet, treelet->split[subset]);
+    node->children[1] = __raxel_bvh_treelet_emit(treelet, subset & ~treelet->split[subset]);
+    node->bounds = treelet->bounds[subset];
+    node->cost = treelet->cost[subset];
+    __raxel_bvh_orient(node);
+    return node;
+}
+
+// Rearranges the treelet grown from an interior node, by repeatedly opening its largest interior
+// leaf, into its cheapest topology, found by dynamic programming over all subsets of its leaves.
+// The subtrees below the treelet must have their costs set.
+static void __raxel_bvh_refine_treelet(__raxel_bvh_build_node_t *node) {
+    node->cost = __raxel_bounds3f_surface_area(&node->bounds) + node->children[0]->cost + node->children[1]->cost;
+    __raxel_bvh_treelet_t treelet;
+    int n_leaves = 2;
+    int n_interior = 1;
+    treelet.leaves[0] = node->children[0];
+    treelet.leaves[1] = node->children[1];
+    treelet.interior[0] = node;
+    while (n_leaves < RAXEL_BVH_TREELET_LEAVES) {
+        int largest = -1;
+        float largest_area = -1.0f;
+        for (int i = 0; i < n_leaves; i++) {
+            float area = __raxel_bounds3f_surface_area(&treelet.leaves[i]->bounds);
+            if (treelet.leaves[i]->n_primitives == 0 && area > largest_area) {
+                largest = i;
+                largest_area = area;
+            }
+        }
+        if (largest < 0) {
+            break;
+        }
+        __raxel_bvh_build_node_t *opened = treelet.leaves[largest];
+        treelet.interior[n_interior++] = opened;
+        treelet.leaves[largest] = opened->children[0];
+        treelet.leaves[n_leaves++] = opened->children[1];
+    }
+    if (n_leaves < 3) {
+        return;
+    }
+
+    int full = (1 << n_leaves) - 1;
+    for (int subset = 1; subset <= full; subset++) {
+        int lowest = subset & -subset;
+        if (subset == lowest) {
+            treelet.bounds[subset] = treelet.leaves[__builtin_ctz(subset)]->bounds;
+            treelet.cost[subset] = treelet.leaves[__builtin_ctz(subset)]->cost;
+            continue;
+        }
+        treelet.bounds[subset] = __raxel_bounds3f_union(&treelet.bounds[lowest], &treelet.bounds[subset & ~lowest]);
+        // every partition once: the left part always holds the lowest leaf
+        float best = INFINITY;
+        int rest = subset & ~lowest;
+        for (int part = (rest - 1) & rest;; part = (part - 1) & rest) {
+            int left = part | lowest;
+            float cost = treelet.cost[left] + treelet.cost[subset & ~left];
+            if (cost < best) {
+                best = cost;
+                treelet.split[subset] = (uint8_t)left;
+            }
+            if (part == 0) {
+                break;
+            }
+        }
+        treelet.cost[subset] = __raxel_bounds3f_surface_area(&treelet.bounds[subset]) + best;
+    }
+    if (treelet.cost[full] < node->cost * 0.9999f) {
+        treelet.n_interior_used = 0;
+        __raxel_bvh_treelet_emit(&treelet, full);
+    }
+}
+
+// Refines every treelet of the subtree, bottom up.
+static void __raxel_bvh_refine_treelets(__raxel_bvh_build_node_t *node) {
+    if (node->n_primitives > 0) {
+        node->cost = __raxel_bvh_leaf_cost(node);
+        return;
+    }
+    __raxel_bvh_refine_treelets(node->children[0]);
+    __raxel_bvh_refine_treelets(node->children[1]);
+    __raxel_bvh_refine_treelet(node);
+}
+
+static int __flatten_bvh_tree(__raxel_bvh_build_node_t *node, int *offset, raxel_linear_bvh_node_t *nodes);
+
+// Builds over indices[0, n) with the Morton codes of the centroids, see RAXEL_BVH_BUILD_LBVH.
+// Returns the node count.
+static int __build_raxel_lbvh_tree(__raxel_bvh_build_ctx_t *ctx, int n) {
+    raxel_bvh_bounds_t bounds, centroid_bounds;
+    __raxel_bvh_range_bounds(ctx, 0, n, &bounds, &centroid_bounds);
+    __raxel_lbvh_t lbvh;
+    lbvh.keys = ctx->lbvh_keys;
+    lbvh.prefix = ctx->lbvh_ints;
+    lbvh.left = lbvh.prefix + (n + 1);
+    lbvh.right = lbvh.left + (n + 1);
+    __raxel_lbvh_sort(ctx, n, &centroid_bounds, lbvh.keys, lbvh.keys + (n + 1));
+    int split = __raxel_lbvh_link(&lbvh, n, lbvh.right + (n + 1));
+    int n_nodes = 0;
+    __build_raxel_lbvh(ctx, &lbvh, &n_nodes, 0, n, split);
+    if (ctx->method != RAXEL_BVH_BUILD_LBVH_TREELETS) {
+        return n_nodes;
+    }
+
+    // refinement moves subtrees around, which needs them linked by pointer for a while
+    __raxel_bvh_build_node_t *tree = ctx->tree;
+    for (int i = 0; i < n_nodes; i++) {
+        const raxel_linear_bvh_node_t *node = &ctx->nodes[i];
+        tree[i] = (__raxel_bvh_build_node_t){
+            .bounds = node->bounds,
+            .first_prim_offset = node->n_primitives > 0 ? node->primitives_offset : -1,
+            .n_primitives = (int)node->n_primitives,
+            .split_axis = (int)node->axis,
+            .cost = 0.0f,
+            .children = { NULL, NULL },
+        };
+        if (node->n_primitives == 0) {
+            tree[i].children[0] = &tree[i + 1];
+            tree[i].children[1] = &tree[node->second_child_offset];
+        }
+    }
+    __raxel_bvh_refine_treelets(&tree[0]);
+    int offset = 0;
+    __flatten_bvh_tree(&tree[0], &offset, ctx->nodes);
+    return n_nodes;
+}
+
+static int __flatten_bvh_tree(__raxel_bvh_build_node_t *node, int *offset, raxel_linear_bvh_node_t *nodes) {
+    int my_offset = (*offset);
+    raxel_linear_bvh_node_t *linear_node = &nodes[my_offset];
+    (*offset)++;
+    linear_node->bounds = node->bounds;
+    if (node->n_primitives > 0) {
+        linear_node->primitives_offset = node->first_prim_offset;
+        linear_node->n_primitives = (uint32_t)node->n_primitives;
+        linear_node->axis = 0;
+    } else {
+        linear_node->axis = (uint32_t)node->split_axis;
+        linear_node->n_primitives = 0;
+        __flatten_bvh_tree(node->children[0], offset, nodes);
+        linear_node->second_child_offset = __flatten_bvh_tree(node->children[1], offset, nodes);
+    }
+    return my_offset;
+}
+
+// =============================================================================
+// 6. Public BVH Accelerator API
+// =============================================================================
+
+raxel_bvh_accel_t *raxel_bvh_accel_build(raxel_bvh_bounds_t *primitive_bounds,
+                                          int *primitive_indices,
+                                          int n,
+                                          int max_leaf_size,
+                                          raxel_allocator_t *allocator) {
+    return raxel_bvh_accel_build_with_method(primitive_bounds, primitive_indices, n, max_leaf_size, RAXEL_BVH_BUILD_SAH, allocator);
+}
+
+raxel_bvh_accel_t *raxel_bvh_accel_build_with_method(raxel_bvh_bounds_t *primitive_bounds,
+                                                     int *primitive_indices,
+                                                     int n,
+                                                     int max_leaf_size,
+                                                     raxel_bvh_build_method_t method,
+                                                     raxel_allocator_t *allocator) {
+    return raxel_bvh_accel_build_parallel(primitive_bounds, primitive_indices, n, max_leaf_size, method, NULL, allocator);
+}
+
+raxel_bvh_accel_t *raxel_bvh_accel_build_parallel(raxel_bvh_bounds_t *primitive_bounds,
+                                                  int *primitive_indices,
+                                                  int n,
+                                                  int max_leaf_size,
+                                                  raxel_bvh_build_method_t method,
+                                                  raxel_thread_pool_t *pool,
+                                                  raxel_allocator_t *allocator) {
+    raxel_bvh_accel_t *bvh = raxel_bvh_accel_create(allocator);
+    raxel_bvh_build_scratch_t scratch;
+    raxel_bvh_build_scratch_init(&scratch, allocator);
+    raxel_bvh_accel_rebuild(bvh, primitive_bounds, primitive_indices, n, max_leaf_size, method, pool, &scratch);
+    raxel_bvh_build_scratch_release(&scratch);
+    return bvh;
+}
+
+void raxel_bvh_build_scratch_init(raxel_bvh_build_scratch_t *scratch, raxel_allocator_t *allocator) {
+    scratch->allocator = allocator;
+    scratch->arena = NULL;
+    scratch->tasks = raxel_list_create_reserve(__raxel_bvh_build_task_t, allocator, 16);
+    scratch->top = raxel_list_create_reserve(__raxel_bvh_top_node_t, allocator, 16);
+}
+
+void raxel_bvh_build_scratch_release(raxel_bvh_build_scratch_t *scratch) {
+    if (scratch->arena) {
+        raxel_arena_allocator_destroy(scratch->arena);
+        scratch->arena = NULL;
+    }
+    raxel_list_destroy(scratch->tasks);
+    raxel_list_destroy(scratch->top);
+}
+
+// Arena blocks are rounded up to 16 bytes, which keeps every array in the arena aligned.
+static inline raxel_size_t __raxel_bvh_scratch_bytes(raxel_size_t count, raxel_size_t stride) {
+    return (count * stride + 15) & ~(raxel_size_t)15;
+}
+
+static inline void *__raxel_bvh_scratch_take(raxel_bvh_build_scratch_t *scratch, raxel_size_t count, raxel_size_t stride) {
+    return raxel_malloc(scratch->arena, __raxel_bvh_scratch_bytes(count, stride));
+}
+
+// Empties the arena for a build taking size bytes. A smaller arena is replaced by one at least
+// twice its size, so builds of slowly growing inputs do not replace it every time.
+static void __raxel_bvh_scratch_reset(raxel_bvh_build_scratch_t *scratch, raxel_size_t size) {
+    raxel_size_t capacity = scratch->arena ? ((raxel_arena_ctx_t *)scratch->arena->ctx)->size : 0;
+    if (capacity < size) {
+        if (scratch->arena) {
+            raxel_arena_allocator_destroy(scratch->arena);
+        }
+        scratch->arena = raxel_arena_allocator(size > 2 * capacity ? size : 2 * capacity);
+    }
+    raxel_arena_allocator_reset(scratch->arena);
+}
+
+raxel_bvh_accel_t *raxel_bvh_accel_create(raxel_allocator_t *allocator) {
+    raxel_bvh_accel_t *bvh = (raxel_bvh_accel_t *)raxel_malloc(allocator, sizeof(raxel_bvh_accel_t));
+    bvh->nodes = raxel_list_create_reserve(raxel_linear_bvh_node_t, allocator, 1);
+    bvh->n_nodes = 0;
+    bvh->max_leaf_size = 0;
+    return bvh;
+}
+
+static void __raxel_bvh_reserve_nodes(raxel_bvh_accel_t *bvh, int n_nodes) {
+    if ((raxel_size_t)n_nodes > raxel_list_capacity(bvh->nodes)) {
+        raxel_list_size(bvh->nodes) = 0;  // nothing worth copying
+        raxel_list_resize(bvh->nodes, (raxel_size_t)n_nodes);
+    }
+}
+
+void raxel_bvh_accel_rebuild(raxel_bvh_accel_t *bvh,
+                             raxel_bvh_bounds_t *primitive_bounds,
+                             int *primitive_indices,
+                             int n,
+                             int max_leaf_size,
+                             raxel_bvh_build_method_t method,
+                             raxel_thread_pool_t *pool,
+                             raxel_bvh_build_scratch_t *scratch) {
+    bvh->max_leaf_size = max_leaf_size;
+    bvh->n_nodes = 0;
+    raxel_list_size(bvh->nodes) = 0;
+    if (n <= 0) {
+        return;
+    }
+    int lbvh = method == RAXEL_BVH_BUILD_LBVH || method == RAXEL_BVH_BUILD_LBVH_TREELETS;
+    // below a few grains the threads would mostly wait on each other, and an LBVH build is
+    // linear enough that the calling thread keeps up
+    int num_threads = pool ? raxel_thread_pool_size(pool) : 1;
+    int parallel = !lbvh && num_threads > 1 && n >= 2 * __RAXEL_BVH_PARALLEL_GRAIN;
+    int num_parts = parallel ? num_threads : 0;
+    raxel_size_t max_nodes = 2 * (raxel_size_t)n;
+    raxel_size_t scratch_size = __raxel_bvh_scratch_bytes(n + 1, sizeof(vec3)) +
+                                __raxel_bvh_scratch_bytes(max_nodes, sizeof(raxel_linear_bvh_node_t));
+    if (lbvh) {
+        scratch_size += __raxel_bvh_scratch_bytes(2 * (n + 1), sizeof(uint64_t)) + __raxel_bvh_scratch_bytes(4 * (n + 1), sizeof(int));
+    }
+    if (method == RAXEL_BVH_BUILD_LBVH_TREELETS) {
+        scratch_size += __raxel_bvh_scratch_bytes(max_nodes, sizeof(__raxel_bvh_build_node_t));
+    }
+    if (parallel) {
+        scratch_size += __raxel_bvh_scratch_bytes(2 * num_parts, sizeof(raxel_bvh_bounds_t)) +
+                        __raxel_bvh_scratch_bytes(num_parts, sizeof(__raxel_bvh_bin_t[3][RAXEL_BVH_SAH_BINS]));
+    }
+    __raxel_bvh_scratch_reset(scratch, scratch_size);
+
+    __raxel_bvh_build_ctx_t ctx = {
+        .primitive_bounds = primitive_bounds,
+        .centroids = __raxel_bvh_scratch_take(scratch, n + 1, sizeof(vec3)),
+        .primitive_indices = primitive_indices,
+        .nodes = __raxel_bvh_scratch_take(scratch, max_nodes, sizeof(raxel_linear_bvh_node_t)),
+        .max_leaf_size = max_leaf_size,
+        .method = method,
+        .scratch = scratch,
+    };
+    int n_nodes = 0;
+    if (lbvh) {
+        ctx.lbvh_keys = __raxel_bvh_scratch_take(scratch, 2 * (n + 1), sizeof(uint64_t));
+        ctx.lbvh_ints = __raxel_bvh_scratch_take(scratch, 4 * (n + 1), sizeof(int));
+        if (method == RAXEL_BVH_BUILD_LBVH_TREELETS) {
+            ctx.tree = __raxel_bvh_scratch_take(scratch, max_nodes, sizeof(__raxel_bvh_build_node_t));
+        }
+        for (int i = 0; i < n; i++) {
+            __raxel_bounds3f_centroid(&primitive_bounds[i], ctx.centroids[i]);
+        }
+        n_nodes = __build_raxel_lbvh_tree(&ctx, n);
+    } else if (parallel) {
+        ctx.pool = pool;
+        // a few tasks per thread even out the uneven subtrees SAH splits produce
+        ctx.task_size = n / (4 * num_threads);
+        if (ctx.task_size < __RAXEL_BVH_PARALLEL_GRAIN) {
+            ctx.task_size = __RAXEL_BVH_PARALLEL_GRAIN;
+        }
+        raxel_list_size(scratch->tasks) = 0;
+        raxel_list_size(scratch->top) = 0;
+        ctx.num_parts = num_parts;
+        ctx.part_bounds = __raxel_bvh_scratch_take(scratch, 2 * num_parts, sizeof(raxel_bvh_bounds_t));
+        ctx.part_bins = __raxel_bvh_scratch_take(scratch, num_parts, sizeof(*ctx.part_bins));
+        ctx.part_start = 0;
+        ctx.part_end = n;
+        raxel_thread_pool_run(pool, ctx.num_parts, __raxel_bvh_centroids_task, &ctx);
+        int root = __build_raxel_bvh_top(&ctx, 0, n);
+        raxel_size_t num_tasks = raxel_list_size(scratch->tasks);
+        qsort(scratch->tasks, num_tasks, sizeof(__raxel_bvh_build_task_t), __raxel_bvh_task_compare);
+        raxel_thread_pool_run(pool, (int)num_tasks, __raxel_bvh_subtree_task, &ctx);
+        int total = (int)(raxel_list_size(scratch->top) - num_tasks);
+        for (raxel_size_t t = 0; t < num_tasks; t++) {
+            scratch->top[scratch->tasks[t].top].task_nodes = scratch->tasks[t].n_nodes;
+            total += scratch->tasks[t].n_nodes;
+        }
+        // the subtrees lie apart in the node array, the assembly writes the tree straight into bvh
+        __raxel_bvh_reserve_nodes(bvh, total);
+        __raxel_bvh_assemble(&ctx, root, bvh->nodes, &n_nodes);
+    } else {
+        for (int i = 0; i < n; i++) {
+            __raxel_bounds3f_centroid(&primitive_bounds[i], ctx.centroids[i]);
+        }
+        __build_raxel_bvh_limited(&ctx, ctx.nodes, &n_nodes, 0, n);
+    }
+    if (!parallel) {
+        __raxel_bvh_reserve_nodes(bvh, n_nodes);
+        memcpy(bvh->nodes, ctx.nodes, n_nodes * sizeof(raxel_linear_bvh_node_t));
+    }
+    bvh->n_nodes = n_nodes;
+    raxel_list_size(bvh->nodes) = (raxel_size_t)n_nodes;
+}
+
+void raxel_bvh_accel_destroy(raxel_bvh_accel_t *bvh, raxel_allocator_t *allocator) {
+    if (!bvh) return;
+    raxel_list_destroy(bvh->nodes);
+    raxel_free(allocator, bvh);
+}
+
+// Recomputes interior bounds from their children. Children follow their parent in the depth-first
+// array, so one backwards pass sees both children of a node before the node.
+static void __raxel_bvh_refit_interior(raxel_bvh_accel_t *bvh) {
+    for (int i = bvh->n_nodes - 1; i >= 0; i--) {
+        raxel_linear_bvh_node_t *node = &bvh->nodes[i];
+        if (node->n_primitives == 0) {
+            node->bounds = __raxel_bounds3f_union(&bvh->nodes[i + 1].bounds, &bvh->nodes[node->second_child_offset].bounds);
+        }
+    }
+}
+
+void raxel_bvh_accel_refit(raxel_bvh_accel_t *bvh, const raxel_bvh_bounds_t *primitive_bounds, const int *primitive_indices) {
+    for (int i = 0; i < bvh->n_nodes; i++) {
+        raxel_linear_bvh_node_t *node = &bvh->nodes[i];
+        if (node->n_primitives == 0) {
+            continue;
+        }
+        node->bounds = __raxel_bounds3f_empty();
+        for (uint32_t p = 0; p < node->n_primitives; p++) {
+            node->bounds = __raxel_bounds3f_union(&node->bounds, &primitive_bounds[primitive_indices[node->primitives_offset + p]]);
+        }
+    }
+    __raxel_bvh_refit_interior(bvh);
+}
+
+// Surface area cost of a ray through the root: the root-relative area of every node, times the
+// primitive count for leaves. Only comparable between trees over roughly the same primitives.
+static float __raxel_bvh_sah_cost(const raxel_bvh_accel_t *bvh) {
+    float root_area = __raxel_bounds3f_surface_area(&bvh->nodes[0].bounds);
+    if (root_area <= 0.0f) {
+        return 0.0f;
+    }
+    float cost = 0.0f;
+    for (int i = 0; i < bvh->n_nodes; i++) {
+        const raxel_linear_bvh_node_t *node = &bvh->nodes[i];
+        cost += __raxel_bounds3f_surface_area(&node->bounds) * (node->n_primitives > 0 ? (float)node->n_primitives : 1.0f);
+    }
+    return cost / root_area;
+}
+
+// One primitive per box of same-material voxels of the loaded chunks (see
+// raxel_voxel_chunk_merge_boxes), in world coordinates. Returns the primitive count; the arrays
+// are left NULL when there are no primitives.
+static int __raxel_voxel_world_gather_primitives(raxel_voxel_world_t *world,
+                                                 raxel_bvh_bounds_t **out_bounds,
+                                                 int **out_indices,
+                                                 raxel_allocator_t *allocator) {
+    *out_bounds = NULL;
+    *out_indices = NULL;
+    // the per-chunk solid counts bound the box count without touching any voxel
+    int max_prims = 0;
+    uint32_t max_chunk_prims = 0;
+    for (size_t i = 0; i < world->__num_loaded_chunks; i++) {
+        uint32_t solid_count = __raxel_voxel_world_chunk_at(world, i)->solid_count;
+        max_prims += (int)solid_count;
+        max_chunk_prims = solid_count > max_chunk_prims ? solid_count : max_chunk_prims;
+    }
+    if (max_prims == 0)
+        return 0;
+
+    raxel_bvh_bounds_t *prim_bounds = (raxel_bvh_bounds_t *)raxel_malloc(allocator, max_prims * sizeof(raxel_bvh_bounds_t));
+    int *prim_indices = (int *)raxel_malloc(allocator, max_prims * sizeof(int));
+    raxel_voxel_t *scratch = (raxel_voxel_t *)raxel_malloc(allocator, RAXEL_VOXEL_CHUNK_VOLUME * sizeof(raxel_voxel_t));
+    raxel_voxel_chunk_box_t *boxes = (raxel_voxel_chunk_box_t *)raxel_malloc(allocator, max_chunk_prims * sizeof(raxel_voxel_chunk_box_t));
+
+    int index = 0;
+    for (size_t i = 0; i < world->__num_loaded_chunks; i++) {
+        raxel_voxel_chunk_t *chunk = __raxel_voxel_world_chunk_at(world, i);
+        if (raxel_voxel_chunk_is_empty(chunk)) {
+            continue;
+        }
+        raxel_voxel_chunk_meta_t meta = world->chunk_meta[i];
+        vec3 chunk_origin = { (float)meta.x, (float)meta.y, (float)meta.z };
+        glm_vec3_scale(chunk_origin, (float)RAXEL_VOXEL_CHUNK_SIZE, chunk_origin);
+        raxel_size_t num_boxes = raxel_voxel_chunk_merge_boxes(chunk, scratch, boxes);
+        for (raxel_size_t b = 0; b < num_boxes; b++) {
+            for (int k = 0; k < 3; k++) {
+                prim_bounds[index].min[k] = chunk_origin[k] + (float)boxes[b].min[k];
+                prim_bounds[index].max[k] = chunk_origin[k] + (float)boxes[b].max[k];
+            }
+            prim_indices[index] = index;
+            index++;
+        }
+    }
+    raxel_free(allocator, scratch);
+    raxel_free(allocator, boxes);
+    *out_bounds = prim_bounds;
+    *out_indices = prim_indices;
+    return index;
+}
+
+raxel_bvh_accel_t *raxel_bvh_accel_build_from_voxel_world(raxel_voxel_world_t *world, int max_leaf_size, raxel_allocator_t *allocator) {
+    raxel_bvh_bounds_t *prim_bounds;
+    int *prim_indices;
+    int total_prims = __raxel_voxel_world_gather_primitives(world, &prim_bounds, &prim_indices, allocator);
+    if (total_prims == 0)
+        return NULL;
+
+    RAXEL_CORE_LOG("Building BVH with %d merged boxes\n", total_prims);
+    
+    raxel_bvh_accel_t *bvh = raxel_bvh_accel_build_with_method(prim_bounds, prim_indices, total_prims, max_leaf_size,
+                                                               world->bvh_build_method, allocator);
+    raxel_free(allocator, prim_bounds);
+    raxel_free(allocator, prim_indices);
+    return bvh;
 }
 
 void raxel_bvh_accel_print(raxel_bvh_accel_t *bvh) {
@@ -419,21 +1922,1281 @@ void raxel_bvh_accel_print(raxel_bvh_accel_t *bvh) {
                node->bounds.min[0], node->bounds.min[1], node->bounds.min[2],
                node->bounds.max[0], node->bounds.max[1], node->bounds.max[2]);
         if (node->n_primitives > 0) {
-            printf("    Leaf Node: %d primitives starting at %d\n", node->n_primitives, node->primitives_offset);
-        } else {
-            printf("    Interior Node: Split Axis %d, Second Child Offset %d\n", node->axis, node->second_child_offset);
+            printf("    Leaf Node: %d primitives starting at %d\n", node->n_primitives, node->primitives_offset);
+        } else {
+            printf("    Interior Node: Split Axis %d, Second Child Offset %d\n", node->axis, node->second_child_offset);
+        }
+    }
+}
+
+// --- Ray queries ---
+
+// Closest hit, counting the nodes it visits and the primitives it tests along the way.
+static inline int __raxel_bvh_intersect_counted(const raxel_bvh_accel_t *bvh,
+                                                const raxel_bvh_bounds_t *primitive_bounds,
+                                                const int *primitive_indices,
+                                                const float origin[3],
+                                                const float direction[3],
+                                                float max_t,
+                                                raxel_bvh_hit_t *hit,
+                                                int *node_visits,
+                                                int *primitive_tests) {
+    hit->t = max_t;
+    hit->primitive = -1;
+    if (bvh->n_nodes == 0) {
+        return 0;
+    }
+    float inv_direction[3] = { 1.0f / direction[0], 1.0f / direction[1], 1.0f / direction[2] };
+    int stack[64];
+    int stack_size = 0;
+    stack[stack_size++] = 0;
+    while (stack_size > 0) {
+        int index = stack[--stack_size];
+        const raxel_linear_bvh_node_t *node = &bvh->nodes[index];
+        float t;
+        (*node_visits)++;
+        if (!__raxel_bounds3f_intersect(&node->bounds, origin, inv_direction, hit->t, &t)) {
+            continue;
+        }
+        if (node->n_primitives > 0) {
+            *primitive_tests += (int)node->n_primitives;
+            for (uint32_t p = 0; p < node->n_primitives; p++) {
+                int primitive = primitive_indices[node->primitives_offset + p];
+                if (__raxel_bounds3f_intersect(&primitive_bounds[primitive], origin, inv_direction, hit->t, &t) &&
+                    (t < hit->t || hit->primitive < 0)) {
+                    hit->t = t;
+                    hit->primitive = primitive;
+                }
+            }
+        } else if (stack_size + 2 <= 64) {
+            // near child on top
+            int first = index + 1;
+            int second = node->second_child_offset;
+            int near_first = inv_direction[node->axis] >= 0.0f;
+            stack[stack_size++] = near_first ? second : first;
+            stack[stack_size++] = near_first ? first : second;
+        }
+    }
+    return hit->primitive >= 0;
+}
+
+int raxel_bvh_accel_intersect(const raxel_bvh_accel_t *bvh,
+                              const raxel_bvh_bounds_t *primitive_bounds,
+                              const int *primitive_indices,
+                              const float origin[3],
+                              const float direction[3],
+                              float max_t,
+                              raxel_bvh_hit_t *hit) {
+    int node_visits = 0;
+    int primitive_tests = 0;
+    return __raxel_bvh_intersect_counted(bvh, primitive_bounds, primitive_indices, origin, direction, max_t, hit,
+                                         &node_visits, &primitive_tests);
+}
+
+typedef struct __raxel_bvh_packet_hits {
+    const raxel_bvh_bounds_t *primitive_bounds;
+    const int *primitive_indices;
+    raxel_bvh_hit_t *hits;
+    uint32_t found;
+} __raxel_bvh_packet_hits_t;
+
+static void __raxel_bvh_packet_primitive_leaf(void *ctx, const raxel_linear_bvh_node_t *leaf, __raxel_bvh_packet_t *packet, uint32_t rays) {
+    __raxel_bvh_packet_hits_t *hits = ctx;
+    for (uint32_t p = 0; p < leaf->n_primitives; p++) {
+        int primitive = hits->primitive_indices[leaf->primitives_offset + p];
+        for (uint32_t entered = __raxel_bvh_packet_intersect(packet, &hits->primitive_bounds[primitive], rays); entered; entered &= entered - 1) {
+            int i = __builtin_ctz(entered);
+            if (packet->t_near[i] < packet->t_best[i] || !(hits->found & (1u << i))) {
+                packet->t_best[i] = packet->t_near[i];
+                hits->hits[i].primitive = primitive;
+                hits->found |= 1u << i;
+            }
+        }
+    }
+}
+
+uint32_t raxel_bvh_accel_intersect_packet(const raxel_bvh_accel_t *bvh,
+                                          const raxel_bvh_bounds_t *primitive_bounds,
+                                          const int *primitive_indices,
+                                          const raxel_bvh_ray_packet_t *packet,
+                                          raxel_bvh_hit_t *hits) {
+    __raxel_bvh_packet_t rays;
+    uint32_t mask = __raxel_bvh_packet_init(&rays, packet);
+    __raxel_bvh_packet_hits_t ctx = { .primitive_bounds = primitive_bounds, .primitive_indices = primitive_indices, .hits = hits, .found = 0 };
+    for (uint32_t i = 0; mask >> i; i++) {
+        hits[i].primitive = -1;
+    }
+    if (bvh->n_nodes > 0 && mask) {
+        __raxel_bvh_packet_traverse(bvh->nodes, &rays, mask, __raxel_bvh_packet_primitive_leaf, &ctx);
+    }
+    for (uint32_t i = 0; mask >> i; i++) {
+        hits[i].t = rays.t_best[i];
+    }
+    return ctx.found;
+}
+
+int raxel_voxel_gpu_chunk_dda(const raxel_voxel_gpu_chunk_t *chunk,
+                              const float origin[3],
+                              const float direction[3],
+                              const float box_min[3],
+                              const float box_max[3],
+                              float max_t,
+                              raxel_voxel_dda_hit_t *hit) {
+    // clip the ray to the box and the box to the chunk
+    float t_enter = 0.0f;
+    float t_exit = max_t;
+    int32_t lo[3], hi[3];
+    for (int k = 0; k < 3; k++) {
+        float bmin = box_min[k] > 0.0f ? box_min[k] : 0.0f;
+        float bmax = box_max[k] < (float)RAXEL_VOXEL_CHUNK_SIZE ? box_max[k] : (float)RAXEL_VOXEL_CHUNK_SIZE;
+        lo[k] = (int32_t)floorf(bmin);
+        hi[k] = (int32_t)ceilf(bmax) - 1;
+        if (hi[k] < lo[k]) {
+            return 0;
+        }
+        if (direction[k] == 0.0f) {
+            if (origin[k] < bmin || origin[k] > bmax) {
+                return 0;
+            }
+            continue;
+        }
+        float t0 = (bmin - origin[k]) / direction[k];
+        float t1 = (bmax - origin[k]) / direction[k];
+        t_enter = fmaxf(t_enter, fminf(t0, t1));
+        t_exit = fminf(t_exit, fmaxf(t0, t1));
+    }
+    if (t_enter > t_exit) {
+        return 0;
+    }
+
+    // the voxel the ray enters the box in, and the face it enters that voxel through
+    int32_t ip[3], step[3];
+    float t_next[3], t_delta[3];
+    float t = 0.0f;
+    int axis = -1;
+    for (int k = 0; k < 3; k++) {
+        int32_t v = (int32_t)floorf(origin[k] + direction[k] * t_enter);
+        ip[k] = v < lo[k] ? lo[k] : (v > hi[k] ? hi[k] : v);
+        if (direction[k] == 0.0f) {
+            step[k] = 0;
+            t_next[k] = INFINITY;
+            t_delta[k] = INFINITY;
+            continue;
+        }
+        step[k] = direction[k] > 0.0f ? 1 : -1;
+        t_delta[k] = fabsf(1.0f / direction[k]);
+        t_next[k] = ((float)(ip[k] + (step[k] > 0)) - origin[k]) / direction[k];
+        float t_near = ((float)(ip[k] + (step[k] < 0)) - origin[k]) / direction[k];
+        if (t_near > t) {
+            t = t_near;
+            axis = k;
+        }
+    }
+
+    // a ray crosses at most one voxel per axis step, so this ends within the chunk
+    for (int i = 0; i < 3 * RAXEL_VOXEL_CHUNK_SIZE + 1; i++) {
+        raxel_material_handle_t material =
+            chunk->voxels[ip[0] + ip[1] * RAXEL_VOXEL_CHUNK_SIZE + ip[2] * RAXEL_VOXEL_CHUNK_SIZE * RAXEL_VOXEL_CHUNK_SIZE].material;
+        if (material != 0) {
+            hit->t = t;
+            hit->material = material;
+            for (int k = 0; k < 3; k++) {
+                hit->voxel[k] = ip[k];
+                hit->normal[k] = k == axis ? (float)-step[k] : 0.0f;
+            }
+            return 1;
+        }
+        axis = t_next[0] < t_next[1] ? (t_next[0] < t_next[2] ? 0 : 2) : (t_next[1] < t_next[2] ? 1 : 2);
+        t = t_next[axis];
+        ip[axis] += step[axis];
+        if (t > t_exit || ip[axis] < lo[axis] || ip[axis] > hi[axis]) {
+            return 0;
+        }
+        t_next[axis] += t_delta[axis];
+    }
+    return 0;
+}
+
+// --- Wide BVH ---
+
+raxel_wide_bvh_t *raxel_wide_bvh_create(raxel_allocator_t *allocator) {
+    raxel_wide_bvh_t *wide = (raxel_wide_bvh_t *)raxel_malloc(allocator, sizeof(raxel_wide_bvh_t));
+    wide->nodes = raxel_list_create_reserve(raxel_wide_bvh_node_t, allocator, 1);
+    wide->n_nodes = 0;
+    wide->width = 0;
+    return wide;
+}
+
+void raxel_wide_bvh_destroy(raxel_wide_bvh_t *wide, raxel_allocator_t *allocator) {
+    if (!wide) return;
+    raxel_list_destroy(wide->nodes);
+    raxel_free(allocator, wide);
+}
+
+void raxel_wide_bvh_child_bounds(const raxel_wide_bvh_node_t *node, int child, raxel_bvh_bounds_t *out) {
+    for (int k = 0; k < 3; k++) {
+        float step = ldexpf(1.0f, (int)node->exponent[k] - 127);
+        out->min[k] = node->origin[k] + (float)node->q_min[k][child] * step;
+        out->max[k] = node->origin[k] + (float)node->q_max[k][child] * step;
+    }
+}
+
+// Sets up the grid of a wide node over its box: the smallest power of two step that covers the box
+// in 255 steps, so the last grid line is never short of the box's max.
+static void __raxel_wide_bvh_set_grid(raxel_wide_bvh_node_t *node, const raxel_bvh_bounds_t *bounds) {
+    for (int k = 0; k < 3; k++) {
+        int e = 0;
+        frexpf((bounds->max[k] - bounds->min[k]) / 254.0f, &e);
+        e = e < -126 ? -126 : (e > 127 ? 127 : e);
+        node->origin[k] = bounds->min[k];
+        node->exponent[k] = (uint8_t)(e + 127);
+    }
+}
+
+// Quantizes a child's box on the node's grid, rounding outwards.
+static void __raxel_wide_bvh_quantize(raxel_wide_bvh_node_t *node, int child, const raxel_bvh_bounds_t *bounds) {
+    for (int k = 0; k < 3; k++) {
+        float step = ldexpf(1.0f, (int)node->exponent[k] - 127);
+        int lo = (int)floorf((bounds->min[k] - node->origin[k]) / step);
+        int hi = (int)ceilf((bounds->max[k] - node->origin[k]) / step);
+        lo = lo < 0 ? 0 : (lo > 255 ? 255 : lo);
+        hi = hi < 0 ? 0 : (hi > 255 ? 255 : hi);
+        // the division rounds, the decoded planes must not
+        while (lo > 0 && node->origin[k] + (float)lo * step > bounds->min[k]) lo--;
+        while (hi < 255 && node->origin[k] + (float)hi * step < bounds->max[k]) hi++;
+        node->q_min[k][child] = (uint8_t)lo;
+        node->q_max[k][child] = (uint8_t)hi;
+    }
+}
+
+// Emits the wide node standing in for the binary subtree at index, and the wide nodes below it,
+// depth first. Returns the wide node's index.
+static int __raxel_wide_bvh_emit(raxel_wide_bvh_t *wide, const raxel_bvh_accel_t *bvh, int index) {
+    const raxel_linear_bvh_node_t *nodes = bvh->nodes;
+    int children[RAXEL_WIDE_BVH_MAX_WIDTH];
+    int n = 0;
+    if (nodes[index].n_primitives > 0) {
+        children[n++] = index;  // a root leaf becomes the only child of the root
+    } else {
+        children[n++] = index + 1;
+        children[n++] = nodes[index].second_child_offset;
+    }
+    // open the largest interior child until the node is full, keeping the children in tree order
+    while (n < wide->width) {
+        int open = -1;
+        float open_area = -1.0f;
+        for (int c = 0; c < n; c++) {
+            float area = __raxel_bounds3f_surface_area(&nodes[children[c]].bounds);
+            if (nodes[children[c]].n_primitives == 0 && area > open_area) {
+                open = c;
+                open_area = area;
+            }
+        }
+        if (open < 0) {
+            break;
+        }
+        int opened = children[open];
+        memmove(&children[open + 2], &children[open + 1], (n - open - 1) * sizeof(int));
+        children[open] = opened + 1;
+        children[open + 1] = nodes[opened].second_child_offset;
+        n++;
+    }
+
+    int offset = wide->n_nodes++;
+    raxel_wide_bvh_node_t node;
+    memset(&node, 0, sizeof(node));
+    __raxel_wide_bvh_set_grid(&node, &nodes[index].bounds);
+    node.n_children = (uint8_t)n;
+    raxel_list_push_back(wide->nodes, node);
+    for (int c = 0; c < n; c++) {
+        const raxel_linear_bvh_node_t *child = &nodes[children[c]];
+        __raxel_wide_bvh_quantize(&wide->nodes[offset], c, &child->bounds);
+        if (child->n_primitives > 0) {
+            wide->nodes[offset].children[c] = RAXEL_WIDE_BVH_LEAF | (uint32_t)child->primitives_offset;
+            wide->nodes[offset].n_primitives[c] = (uint16_t)child->n_primitives;
+        } else {
+            // the list may move while the child is emitted
+            uint32_t emitted = (uint32_t)__raxel_wide_bvh_emit(wide, bvh, children[c]);
+            wide->nodes[offset].children[c] = emitted;
+        }
+    }
+    return offset;
+}
+
+static inline int __raxel_wide_bvh_clamp_width(int width) {
+    return width < 2 ? 2 : (width > RAXEL_WIDE_BVH_MAX_WIDTH ? RAXEL_WIDE_BVH_MAX_WIDTH : width);
+}
+
+void raxel_wide_bvh_collapse(raxel_wide_bvh_t *wide, const raxel_bvh_accel_t *bvh, int width) {
+    wide->width = __raxel_wide_bvh_clamp_width(width);
+    wide->n_nodes = 0;
+    raxel_list_size(wide->nodes) = 0;
+    if (bvh->n_nodes > 0) {
+        __raxel_wide_bvh_emit(wide, bvh, 0);
+    }
+}
+
+// --- Quality stats ---
+
+typedef struct __raxel_bvh_stats_walk {
+    raxel_bvh_stats_t *stats;
+    float root_area;         // of the root of the whole tree, every node's area is taken relative to it
+    int target_leaf_size;
+    double overlap_area;     // summed over interior nodes
+    double interior_area;
+    int *instance_depths;    // if set, leaves hold instances: their depths go here instead of into the leaf stats
+} __raxel_bvh_stats_walk_t;
+
+static void __raxel_bvh_stats_walk(__raxel_bvh_stats_walk_t *walk, const raxel_linear_bvh_node_t *nodes, int index, int depth) {
+    const raxel_linear_bvh_node_t *node = &nodes[index];
+    raxel_bvh_stats_t *stats = walk->stats;
+    float area = __raxel_bounds3f_surface_area(&node->bounds);
+    stats->n_nodes++;
+    if (node->n_primitives > 0 && walk->instance_depths) {
+        stats->sah_cost += area / walk->root_area;
+        for (uint32_t p = 0; p < node->n_primitives; p++) {
+            walk->instance_depths[node->primitives_offset + p] = depth + 1;
+        }
+        return;
+    }
+    if (node->n_primitives > 0) {
+        int bin = 0;
+        while (bin < RAXEL_BVH_STATS_LEAF_SIZE_BINS - 1 && (1u << bin) < node->n_primitives) {
+            bin++;
+        }
+        stats->sah_cost += area / walk->root_area * (float)node->n_primitives;
+        stats->n_leaves++;
+        stats->n_primitives += (int)node->n_primitives;
+        stats->n_forced_leaves += (int)node->n_primitives > walk->target_leaf_size;
+        stats->depth_histogram[depth < RAXEL_BVH_STATS_MAX_DEPTH ? depth : RAXEL_BVH_STATS_MAX_DEPTH - 1]++;
+        stats->leaf_size_histogram[bin]++;
+        stats->max_depth = depth > stats->max_depth ? depth : stats->max_depth;
+        return;
+    }
+    const raxel_bvh_bounds_t *first = &nodes[index + 1].bounds;
+    const raxel_bvh_bounds_t *second = &nodes[node->second_child_offset].bounds;
+    raxel_bvh_bounds_t overlap;
+    for (int k = 0; k < 3; k++) {
+        overlap.min[k] = first->min[k] > second->min[k] ? first->min[k] : second->min[k];
+        overlap.max[k] = first->max[k] < second->max[k] ? first->max[k] : second->max[k];
+    }
+    stats->sah_cost += area / walk->root_area;
+    walk->overlap_area += __raxel_bounds3f_surface_area(&overlap);
+    walk->interior_area += area;
+    __raxel_bvh_stats_walk(walk, nodes, index + 1, depth + 1);
+    __raxel_bvh_stats_walk(walk, nodes, node->second_child_offset, depth + 1);
+}
+
+static void __raxel_bvh_stats_finish(__raxel_bvh_stats_walk_t *walk) {
+    walk->stats->overlap_ratio = walk->interior_area > 0.0 ? (float)(walk->overlap_area / walk->interior_area) : 0.0f;
+}
+
+void raxel_bvh_accel_stats(const raxel_bvh_accel_t *bvh, int target_leaf_size, raxel_bvh_stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+    if (bvh->n_nodes == 0) {
+        return;
+    }
+    __raxel_bvh_stats_walk_t walk = {
+        .stats = stats,
+        .root_area = __raxel_bounds3f_surface_area(&bvh->nodes[0].bounds),
+        .target_leaf_size = target_leaf_size > 0 ? target_leaf_size : bvh->max_leaf_size,
+    };
+    if (walk.root_area <= 0.0f) {
+        walk.root_area = 1.0f;
+    }
+    __raxel_bvh_stats_walk(&walk, bvh->nodes, 0, 0);
+    __raxel_bvh_stats_finish(&walk);
+    stats->memory_bytes = (raxel_size_t)bvh->n_nodes * sizeof(raxel_linear_bvh_node_t) + (raxel_size_t)stats->n_primitives * sizeof(int);
+}
+
+void raxel_bvh_stats_print(const raxel_bvh_stats_t *stats) {
+    printf("BVH Stats:\n");
+    printf("  SAH Cost: %.2f\n", stats->sah_cost);
+    printf("  Overlap Ratio: %.3f\n", stats->overlap_ratio);
+    printf("  Nodes: %d, Leaves: %d, Primitives: %d\n", stats->n_nodes, stats->n_leaves, stats->n_primitives);
+    printf("  Forced Leaves: %d\n", stats->n_forced_leaves);
+    printf("  Memory: %zu bytes, GPU: %zu bytes\n", (size_t)stats->memory_bytes, (size_t)stats->gpu_bytes);
+    printf("  Leaves per Depth (max %d):", stats->max_depth);
+    for (int d = 0; d <= stats->max_depth && d < RAXEL_BVH_STATS_MAX_DEPTH; d++) {
+        printf(" %d", stats->depth_histogram[d]);
+    }
+    printf("\n  Leaves per Size:");
+    for (int b = 0; b < RAXEL_BVH_STATS_LEAF_SIZE_BINS; b++) {
+        if (stats->leaf_size_histogram[b] > 0) {
+            printf(" <=%u: %d", 1u << b, stats->leaf_size_histogram[b]);
+        }
+    }
+    printf("\n");
+}
+
+static int __raxel_bvh_compare_int(const void *a, const void *b) {
+    int x = *(const int *)a;
+    int y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+void raxel_bvh_accel_trace_cost(const raxel_bvh_accel_t *bvh,
+                                const raxel_bvh_bounds_t *primitive_bounds,
+                                const int *primitive_indices,
+                                int n_rays,
+                                uint32_t seed,
+                                raxel_allocator_t *allocator,
+                                raxel_bvh_trace_cost_t *cost) {
+    memset(cost, 0, sizeof(*cost));
+    if (bvh->n_nodes == 0 || n_rays <= 0) {
+        return;
+    }
+    const raxel_bvh_bounds_t *root = &bvh->nodes[0].bounds;
+    vec3 center, extent;
+    for (int k = 0; k < 3; k++) {
+        center[k] = 0.5f * (root->min[k] + root->max[k]);
+        extent[k] = root->max[k] - root->min[k];
+    }
+    float radius = glm_vec3_norm(extent);
+    int *visits = raxel_malloc(allocator, (raxel_size_t)n_rays * sizeof(int));
+    double total_visits = 0.0;
+    double total_tests = 0.0;
+    for (int r = 0; r < n_rays; r++) {
+        // an LCG rather than rand() so the ray set is the same on every platform
+        float u[5];
+        for (int k = 0; k < 5; k++) {
+            seed = seed * 1664525u + 1013904223u;
+            u[k] = (float)(seed >> 8) / (float)(1u << 24);
+        }
+        float z = 2.0f * u[0] - 1.0f;
+        float phi = 6.2831853f * u[1];
+        float s = sqrtf(1.0f - z * z);
+        float origin[3] = { center[0] + radius * s * cosf(phi), center[1] + radius * z, center[2] + radius * s * sinf(phi) };
+        float direction[3];
+        for (int k = 0; k < 3; k++) {
+            direction[k] = center[k] + (u[2 + k] - 0.5f) * 0.5f * extent[k] - origin[k];
+        }
+        raxel_bvh_hit_t hit;
+        int node_visits = 0;
+        int primitive_tests = 0;
+        cost->n_hits += __raxel_bvh_intersect_counted(bvh, primitive_bounds, primitive_indices, origin, direction, 1e30f, &hit,
+                                                      &node_visits, &primitive_tests);
+        visits[r] = node_visits;
+        total_visits += node_visits;
+        total_tests += primitive_tests;
+    }
+    qsort(visits, (size_t)n_rays, sizeof(int), __raxel_bvh_compare_int);
+    cost->n_rays = n_rays;
+    cost->mean_node_visits = (float)(total_visits / n_rays);
+    cost->mean_primitive_tests = (float)(total_tests / n_rays);
+    cost->p99_node_visits = visits[(int)((int64_t)(n_rays - 1) * 99 / 100)];
+    cost->max_node_visits = visits[n_rays - 1];
+    raxel_free(allocator, visits);
+}
+
+// =============================================================================
+// 7. Voxel World Update and Buffer Dispatch
+// =============================================================================
+
+// --- Residency ---
+
+typedef struct __raxel_voxel_residency_candidate {
+    float priority;       // distance to the camera in chunks, minus the hysteresis for loaded chunks
+    raxel_size_t index;   // index into the world's chunk lists
+} __raxel_voxel_residency_candidate_t;
+
+// Max-heap on priority, so the root is the worst of the best chunks found so far.
+static void __raxel_voxel_residency_sift_down(__raxel_voxel_residency_candidate_t *heap, raxel_size_t n, raxel_size_t i) {
+    for (;;) {
+        raxel_size_t largest = i;
+        raxel_size_t l = 2 * i + 1;
+        raxel_size_t r = 2 * i + 2;
+        if (l < n && heap[l].priority > heap[largest].priority) largest = l;
+        if (r < n && heap[r].priority > heap[largest].priority) largest = r;
+        if (largest == i) {
+            return;
+        }
+        __raxel_voxel_residency_candidate_t tmp = heap[i];
+        heap[i] = heap[largest];
+        heap[largest] = tmp;
+        i = largest;
+    }
+}
+
+static void __raxel_voxel_residency_sift_up(__raxel_voxel_residency_candidate_t *heap, raxel_size_t i) {
+    while (i > 0) {
+        raxel_size_t parent = (i - 1) / 2;
+        if (heap[parent].priority >= heap[i].priority) {
+            return;
+        }
+        __raxel_voxel_residency_candidate_t tmp = heap[i];
+        heap[i] = heap[parent];
+        heap[parent] = tmp;
+        i = parent;
+    }
+}
+
+static int __raxel_voxel_residency_compare_index(const void *a, const void *b) {
+    raxel_size_t ia = ((const __raxel_voxel_residency_candidate_t *)a)->index;
+    raxel_size_t ib = ((const __raxel_voxel_residency_candidate_t *)b)->index;
+    return (ia > ib) - (ia < ib);
+}
+
+// Picks the chunk_budget nearest chunks around the camera and moves them to the front of the
+// world's lists. A bounded max-heap keeps this O(n log budget).
+static void __raxel_voxel_world_select_loaded(raxel_voxel_world_t *world, const vec3 camera_position, float view_distance) {
+    raxel_size_t budget = world->chunk_budget;
+    float hysteresis = world->residency_hysteresis;
+    float cam[3];
+    for (int k = 0; k < 3; k++) {
+        cam[k] = camera_position[k] / (float)RAXEL_VOXEL_CHUNK_SIZE;
+    }
+
+    raxel_size_t num_chunks = raxel_list_size(world->chunk_meta);
+    __raxel_voxel_residency_candidate_t *heap = raxel_malloc(world->allocator, (budget + 1) * sizeof(__raxel_voxel_residency_candidate_t));
+    raxel_size_t heap_size = 0;
+    for (raxel_size_t i = 0; i < num_chunks && budget > 0; i++) {
+        raxel_voxel_chunk_handle_t handle = world->chunks[i];
+        // empty chunks look the same to the shader whether they are loaded or not
+        if (raxel_voxel_chunk_is_empty(raxel_voxel_chunk_pool_get(world->chunk_pool, handle))) {
+            continue;
+        }
+        raxel_voxel_chunk_meta_t *meta = &world->chunk_meta[i];
+        float dx = (float)meta->x + 0.5f - cam[0];
+        float dy = (float)meta->y + 0.5f - cam[1];
+        float dz = (float)meta->z + 0.5f - cam[2];
+        float dist = sqrtf(dx * dx + dy * dy + dz * dz);
+        float bonus = (i < world->__num_loaded_chunks) ? hysteresis : 0.0f;  // the loaded chunks are at the front
+        if (dist >= view_distance + bonus) {
+            continue;
+        }
+        __raxel_voxel_residency_candidate_t candidate = { dist - bonus, i };
+        if (heap_size < budget) {
+            heap[heap_size] = candidate;
+            __raxel_voxel_residency_sift_up(heap, heap_size++);
+        } else if (candidate.priority < heap[0].priority) {
+            heap[0] = candidate;
+            __raxel_voxel_residency_sift_down(heap, heap_size, 0);
+        }
+    }
+
+    // moving the winners to the front in index order never displaces a winner that is still to come
+    qsort(heap, heap_size, sizeof(__raxel_voxel_residency_candidate_t), __raxel_voxel_residency_compare_index);
+    for (raxel_size_t k = 0; k < heap_size; k++) {
+        if (heap[k].index != k) {
+            __raxel_voxel_world_swap_chunks(world, k, heap[k].index);
+        }
+    }
+    world->__num_loaded_chunks = heap_size;
+    raxel_free(world->allocator, heap);
+}
+
+// Whether a chunk handle is part of the loaded set, found through the slot's GPU meta.
+static int __raxel_voxel_world_slot_is_loaded(raxel_voxel_world_t *world, const raxel_voxel_chunk_meta_t *meta, raxel_voxel_chunk_handle_t handle) {
+    uint64_t key = __raxel_voxel_chunk_key(meta->x, meta->y, meta->z);
+    raxel_size_t index;
+    if (!raxel_hashtable_get(world->chunk_index, &key, &index)) {
+        return 0;
+    }
+    return index < world->__num_loaded_chunks && world->chunks[index] == handle;
+}
+
+typedef struct __raxel_voxel_eviction_candidate {
+    uint32_t last_used;
+    uint32_t slot;
+} __raxel_voxel_eviction_candidate_t;
+
+static int __raxel_voxel_eviction_compare(const void *a, const void *b) {
+    uint32_t la = ((const __raxel_voxel_eviction_candidate_t *)a)->last_used;
+    uint32_t lb = ((const __raxel_voxel_eviction_candidate_t *)b)->last_used;
+    return (la > lb) - (la < lb);
+}
+
+#define __RAXEL_GPU_WORLD_MARK(buffer, gpu_world, field) \
+    raxel_sb_buffer_mark_dirty((buffer), (char *)&(gpu_world)->field - (char *)(gpu_world), sizeof((gpu_world)->field))
+
+// --- 64-tree ---
+
+typedef struct __raxel_voxel_tree_candidate {
+    float distance;
+    raxel_tree64_chunk_ref_t ref;
+} __raxel_voxel_tree_candidate_t;
+
+static int __raxel_voxel_tree_candidate_compare(const void *a, const void *b) {
+    float da = ((const __raxel_voxel_tree_candidate_t *)a)->distance;
+    float db = ((const __raxel_voxel_tree_candidate_t *)b)->distance;
+    return (da > db) - (da < db);
+}
+
+// Builds the tree over the loaded set. While it does not fit the memory budget, the farthest
+// eighth of the chunks is left out and the tree built again.
+static void __raxel_voxel_world_build_tree(raxel_voxel_world_t *world, const vec3 camera_position) {
+    raxel_size_t n = world->__num_loaded_chunks;
+    float cam[3];
+    for (int k = 0; k < 3; k++) {
+        cam[k] = camera_position[k] / (float)RAXEL_VOXEL_CHUNK_SIZE;
+    }
+    __raxel_voxel_tree_candidate_t *candidates = raxel_malloc(world->allocator, (n + 1) * sizeof(__raxel_voxel_tree_candidate_t));
+    raxel_tree64_chunk_ref_t *refs = raxel_malloc(world->allocator, (n + 1) * sizeof(raxel_tree64_chunk_ref_t));
+    for (raxel_size_t i = 0; i < n; i++) {
+        raxel_voxel_chunk_meta_t *meta = &world->chunk_meta[i];
+        candidates[i].distance = __raxel_voxel_world_chunk_distance(cam, meta->x, meta->y, meta->z);
+        candidates[i].ref = (raxel_tree64_chunk_ref_t){meta->x, meta->y, meta->z, __raxel_voxel_world_chunk_at(world, i)};
+        refs[i] = candidates[i].ref;
+    }
+    raxel_size_t budget_words = world->tree_memory_budget / sizeof(uint32_t);
+    raxel_tree64_build(&world->__tree, refs, n);
+    if (raxel_tree64_pool_size(&world->__tree) > budget_words) {
+        qsort(candidates, n, sizeof(__raxel_voxel_tree_candidate_t), __raxel_voxel_tree_candidate_compare);
+        raxel_size_t kept = n;
+        while (raxel_tree64_pool_size(&world->__tree) > budget_words && kept > 0) {
+            kept -= (kept + 7) / 8;
+            for (raxel_size_t i = 0; i < kept; i++) {
+                refs[i] = candidates[i].ref;
+            }
+            raxel_tree64_build(&world->__tree, refs, kept);
+        }
+        RAXEL_CORE_LOG_ERROR("64-tree of %zu chunks exceeds the %zu byte budget, left out the %zu farthest\n",
+                             n, world->tree_memory_budget, n - kept);
+    }
+    raxel_free(world->allocator, candidates);
+    raxel_free(world->allocator, refs);
+}
+
+// Brings the tree to the loaded set. Chunks that left it are removed and new or edited chunks
+// are rewritten, each of which only appends to the pool; the tree is rebuilt instead when much
+// of the set changed, the pool is mostly garbage or it outgrew the budget. Runs under the world
+// lock, before the resident lists are updated.
+static void __raxel_voxel_world_update_tree(raxel_voxel_world_t *world, const vec3 camera_position) {
+    raxel_tree64_t *tree = &world->__tree;
+    raxel_size_t num_resident = raxel_list_size(world->__resident_chunks);
+    int rebuild = world->__resident_backend != RAXEL_VOXEL_BACKEND_TREE64;
+
+    if (!rebuild) {
+        // revision each handle was resident with, UNSTORED if it was not
+        raxel_size_t num_handles = world->chunk_pool->num_handles;
+        uint32_t *resident_revision = raxel_malloc(world->allocator, (num_handles + 1) * sizeof(uint32_t));
+        for (raxel_size_t h = 0; h < num_handles; h++) {
+            resident_revision[h] = RAXEL_VOXEL_REVISION_UNSTORED;
+        }
+        for (raxel_size_t i = 0; i < num_resident; i++) {
+            resident_revision[world->__resident_chunks[i]] = world->__resident_revisions[i];
+        }
+        raxel_size_t num_changed = 0;
+        for (raxel_size_t i = 0; i < world->__num_loaded_chunks; i++) {
+            num_changed += resident_revision[world->chunks[i]] != __raxel_voxel_world_chunk_at(world, i)->revision;
+        }
+        rebuild = num_changed * 4 > world->__num_loaded_chunks + 4;
+
+        for (raxel_size_t i = 0; i < num_resident && !rebuild; i++) {
+            raxel_voxel_chunk_meta_t *meta = &world->__resident_meta[i];
+            uint64_t key = __raxel_voxel_chunk_key(meta->x, meta->y, meta->z);
+            raxel_size_t index;
+            if (!raxel_hashtable_get(world->chunk_index, &key, &index) || index >= world->__num_loaded_chunks) {
+                rebuild = raxel_tree64_set_chunk(tree, meta->x, meta->y, meta->z, NULL) != 0;
+            }
+        }
+        for (raxel_size_t i = 0; i < world->__num_loaded_chunks && !rebuild; i++) {
+            raxel_voxel_chunk_t *chunk = __raxel_voxel_world_chunk_at(world, i);
+            if (resident_revision[world->chunks[i]] != chunk->revision) {
+                raxel_voxel_chunk_meta_t *meta = &world->chunk_meta[i];
+                rebuild = raxel_tree64_set_chunk(tree, meta->x, meta->y, meta->z, chunk) != 0;
+            }
+        }
+        raxel_free(world->allocator, resident_revision);
+    }
+
+    raxel_size_t pool_size = raxel_tree64_pool_size(tree);
+    if (rebuild || tree->garbage * 2 > pool_size || pool_size * sizeof(uint32_t) > world->tree_memory_budget) {
+        __raxel_voxel_world_build_tree(world, camera_position);
+    }
+}
+
+// --- Two-level BVH ---
+
+// The unit box of a voxel in chunk-local coordinates, from its flat index.
+static inline void __raxel_voxel_chunk_voxel_bounds(int i, raxel_bvh_bounds_t *box) {
+    box->min[0] = (float)(i % RAXEL_VOXEL_CHUNK_SIZE);
+    box->min[1] = (float)((i / RAXEL_VOXEL_CHUNK_SIZE) % RAXEL_VOXEL_CHUNK_SIZE);
+    box->min[2] = (float)(i / (RAXEL_VOXEL_CHUNK_SIZE * RAXEL_VOXEL_CHUNK_SIZE));
+    glm_vec3_adds(box->min, 1.0f, box->max);
+}
+
+static void __raxel_voxel_world_release_chunk_bvh(raxel_voxel_world_t *world, raxel_voxel_chunk_handle_t handle) {
+    if (handle >= raxel_list_size(world->__chunk_bvhs)) {
+        return;
+    }
+    raxel_voxel_chunk_bvh_t *chunk_bvh = &world->__chunk_bvhs[handle];
+    raxel_bvh_accel_destroy(chunk_bvh->bvh, world->allocator);
+    raxel_wide_bvh_destroy(chunk_bvh->wide, world->allocator);
+    chunk_bvh->bvh = NULL;
+    chunk_bvh->wide = NULL;
+    if (chunk_bvh->voxels) {
+        raxel_list_size(chunk_bvh->voxels) = 0;
+        raxel_list_size(chunk_bvh->edits) = 0;
+    }
+    chunk_bvh->revision = RAXEL_VOXEL_REVISION_UNSTORED;
+}
+
+// Lists the voxels added to or removed from the chunk since its BVH was last brought up to date
+// in the entry's edits. Returns 0, with no edits listed, if there are too many to patch in.
+static int __raxel_voxel_world_diff_chunk_voxels(raxel_voxel_chunk_bvh_t *chunk_bvh, const raxel_voxel_chunk_t *chunk) {
+    uint64_t built[RAXEL_VOXEL_CHUNK_OCCUPANCY_WORDS] = {0};
+    for (raxel_size_t k = 0; k < raxel_list_size(chunk_bvh->voxels); k++) {
+        built[chunk_bvh->voxels[k] >> 6] |= 1ull << (chunk_bvh->voxels[k] & 63);
+    }
+    raxel_list_size(chunk_bvh->edits) = 0;
+    for (raxel_size_t w = 0; w < RAXEL_VOXEL_CHUNK_OCCUPANCY_WORDS; w++) {
+        uint64_t now = raxel_voxel_chunk_occupancy_word(chunk, w);
+        uint64_t changed = now ^ built[w];
+        while (changed) {
+            int bit = __builtin_ctzll(changed);
+            changed &= changed - 1;
+            if (raxel_list_size(chunk_bvh->edits) == RAXEL_BVH_PATCH_MAX_EDITS) {
+                raxel_list_size(chunk_bvh->edits) = 0;
+                return 0;
+            }
+            uint16_t edit = (uint16_t)(w * 64 + bit) | ((now >> bit) & 1 ? 0 : RAXEL_VOXEL_CHUNK_BVH_REMOVED);
+            raxel_list_push_back(chunk_bvh->edits, edit);
+        }
+    }
+    return 1;
+}
+
+// Brings a chunk's cache entry up to the chunk if the chunk changed since: a few changed voxels
+// are listed as edits to patch in, otherwise all solid voxels are copied for a rebuild. Returns 1
+// if the BVH has to be patched or rebuilt. Called with the world lock held.
+static int __raxel_voxel_world_collect_chunk_voxels(raxel_voxel_world_t *world, raxel_voxel_chunk_handle_t handle) {
+    raxel_voxel_chunk_bvh_t unbuilt = { .bvh = NULL, .wide = NULL, .voxels = NULL, .edits = NULL, .revision = RAXEL_VOXEL_REVISION_UNSTORED };
+    while (raxel_list_size(world->__chunk_bvhs) <= handle) {
+        raxel_list_push_back(world->__chunk_bvhs, unbuilt);
+    }
+    raxel_voxel_chunk_bvh_t *chunk_bvh = &world->__chunk_bvhs[handle];
+    raxel_voxel_chunk_t *chunk = raxel_voxel_chunk_pool_get(world->chunk_pool, handle);
+    if (chunk_bvh->revision == chunk->revision) {
+        return chunk_bvh->bvh && (chunk_bvh->bvh->max_leaf_size != world->__chunk_bvh_leaf_size ||
+                                  chunk_bvh->wide->width != __raxel_wide_bvh_clamp_width(world->bvh_width));
+    }
+    chunk_bvh->revision = chunk->revision;
+    if (!chunk_bvh->voxels) {
+        chunk_bvh->voxels = raxel_list_create_reserve(uint16_t, world->allocator, chunk->solid_count + 1);
+        chunk_bvh->edits = raxel_list_create_reserve(uint16_t, world->allocator, RAXEL_BVH_PATCH_MAX_EDITS);
+    }
+    if (chunk_bvh->bvh && chunk_bvh->bvh->max_leaf_size == world->__chunk_bvh_leaf_size &&
+        __raxel_voxel_world_diff_chunk_voxels(chunk_bvh, chunk)) {
+        // an edit that only changed materials leaves the BVH as it is
+        return raxel_list_size(chunk_bvh->edits) > 0;
+    }
+    raxel_list_size(chunk_bvh->edits) = 0;
+    raxel_list_size(chunk_bvh->voxels) = 0;
+    for (raxel_size_t i = raxel_voxel_chunk_next_solid(chunk, 0); i < RAXEL_VOXEL_CHUNK_VOLUME; i = raxel_voxel_chunk_next_solid(chunk, i + 1)) {
+        raxel_list_push_back(chunk_bvh->voxels, (uint16_t)i);
+    }
+    return 1;
+}
+
+// Takes a voxel out of the voxel list. With patch_tree set, its leaf loses it and the leaves after
+// it shift down; returns 0 if the tree can no longer be patched (the leaf emptied, or the voxel
+// was not there).
+static int __raxel_voxel_chunk_bvh_remove(raxel_voxel_chunk_bvh_t *chunk_bvh, int voxel, int patch_tree) {
+    raxel_size_t n = raxel_list_size(chunk_bvh->voxels);
+    raxel_size_t p = 0;
+    while (p < n && chunk_bvh->voxels[p] != voxel) {
+        p++;
+    }
+    if (p == n) {
+        return 0;
+    }
+    memmove(&chunk_bvh->voxels[p], &chunk_bvh->voxels[p + 1], (n - p - 1) * sizeof(uint16_t));
+    raxel_list_size(chunk_bvh->voxels) = n - 1;
+    if (!patch_tree) {
+        return 0;
+    }
+    int patched = 1;
+    raxel_bvh_accel_t *bvh = chunk_bvh->bvh;
+    for (int i = 0; i < bvh->n_nodes; i++) {
+        raxel_linear_bvh_node_t *node = &bvh->nodes[i];
+        if (node->n_primitives == 0) {
+            continue;
+        }
+        if (node->primitives_offset > (int32_t)p) {
+            node->primitives_offset--;
+        } else if (node->primitives_offset + (int32_t)node->n_primitives > (int32_t)p) {
+            patched = --node->n_primitives > 0;
+        }
+    }
+    return patched;
+}
+
+// Adds a voxel to the voxel list. With patch_tree set, it goes to the end of the leaf whose bounds
+// grow the least on the way down, and the leaves after it shift up; returns 0 if the tree can no
+// longer be patched (the leaf grew past twice the leaf size).
+static int __raxel_voxel_chunk_bvh_insert(raxel_voxel_chunk_bvh_t *chunk_bvh, int voxel, int patch_tree) {
+    if (!patch_tree) {
+        raxel_list_push_back(chunk_bvh->voxels, (uint16_t)voxel);
+        return 0;
+    }
+    raxel_bvh_accel_t *bvh = chunk_bvh->bvh;
+    raxel_bvh_bounds_t box;
+    __raxel_voxel_chunk_voxel_bounds(voxel, &box);
+    int index = 0;
+    for (;;) {
+        raxel_linear_bvh_node_t *node = &bvh->nodes[index];
+        node->bounds = __raxel_bounds3f_union(&node->bounds, &box);
+        if (node->n_primitives > 0) {
+            break;
+        }
+        int children[2] = { index + 1, node->second_child_offset };
+        float growth[2];
+        for (int c = 0; c < 2; c++) {
+            raxel_bvh_bounds_t grown = __raxel_bounds3f_union(&bvh->nodes[children[c]].bounds, &box);
+            growth[c] = __raxel_bounds3f_surface_area(&grown) - __raxel_bounds3f_surface_area(&bvh->nodes[children[c]].bounds);
+        }
+        index = growth[1] < growth[0] ? children[1] : children[0];
+    }
+    raxel_linear_bvh_node_t *leaf = &bvh->nodes[index];
+    int32_t p = leaf->primitives_offset + (int32_t)leaf->n_primitives;
+    raxel_list_push_back(chunk_bvh->voxels, (uint16_t)0);
+    raxel_size_t n = raxel_list_size(chunk_bvh->voxels);
+    memmove(&chunk_bvh->voxels[p + 1], &chunk_bvh->voxels[p], (n - 1 - (raxel_size_t)p) * sizeof(uint16_t));
+    chunk_bvh->voxels[p] = (uint16_t)voxel;
+    for (int i = 0; i < bvh->n_nodes; i++) {
+        if (bvh->nodes[i].n_primitives > 0 && bvh->nodes[i].primitives_offset >= p) {
+            bvh->nodes[i].primitives_offset++;
+        }
+    }
+    leaf->n_primitives++;
+    return leaf->n_primitives <= 2 * (uint32_t)bvh->max_leaf_size;
+}
+
+// Applies the listed edits to a chunk's BVH in place and refits it. The voxel list takes the edits
+// either way. Returns 0 if the tree has to be rebuilt: an edit could not be patched in, or the
+// cost grew past RAXEL_BVH_PATCH_COST_LIMIT times that of the last build.
+static int __raxel_voxel_world_patch_chunk_bvh(raxel_voxel_chunk_bvh_t *chunk_bvh) {
+    raxel_bvh_accel_t *bvh = chunk_bvh->bvh;
+    raxel_size_t num_edits = raxel_list_size(chunk_bvh->edits);
+    int patched = 1;
+    for (raxel_size_t e = 0; e < num_edits; e++) {
+        int voxel = chunk_bvh->edits[e] & ~RAXEL_VOXEL_CHUNK_BVH_REMOVED;
+        if (chunk_bvh->edits[e] & RAXEL_VOXEL_CHUNK_BVH_REMOVED) {
+            patched = __raxel_voxel_chunk_bvh_remove(chunk_bvh, voxel, patched);
+        } else {
+            patched = __raxel_voxel_chunk_bvh_insert(chunk_bvh, voxel, patched);
+        }
+    }
+    raxel_list_size(chunk_bvh->edits) = 0;
+    if (!patched) {
+        return 0;
+    }
+    for (int i = 0; i < bvh->n_nodes; i++) {
+        raxel_linear_bvh_node_t *node = &bvh->nodes[i];
+        if (node->n_primitives == 0) {
+            continue;
+        }
+        node->bounds = __raxel_bounds3f_empty();
+        for (uint32_t p = 0; p < node->n_primitives; p++) {
+            raxel_bvh_bounds_t box;
+            __raxel_voxel_chunk_voxel_bounds(chunk_bvh->voxels[node->primitives_offset + p], &box);
+            node->bounds = __raxel_bounds3f_union(&node->bounds, &box);
+        }
+    }
+    __raxel_bvh_refit_interior(bvh);
+    if (__raxel_bvh_sah_cost(bvh) > chunk_bvh->built_cost * RAXEL_BVH_PATCH_COST_LIMIT) {
+        return 0;
+    }
+    chunk_bvh->patched_edits += (uint32_t)num_edits;
+    return 1;
+}
+
+// What a thread building world BVHs keeps from one build to the next, so that rebuilding them
+// allocates nothing once its buffers have grown to the largest chunk.
+typedef struct __raxel_voxel_bvh_builder {
+    raxel_bvh_build_scratch_t scratch;
+    raxel_list(raxel_bvh_bounds_t) primitive_bounds;
+    raxel_list(int) primitive_indices;
+} __raxel_voxel_bvh_builder_t;
+
+// Makes sure there are at least count builders. The first one also builds the top level.
+static void __raxel_voxel_world_reserve_bvh_builders(raxel_voxel_world_t *world, int count) {
+    if (!world->__bvh_builders) {
+        world->__bvh_builders = raxel_list_create_reserve(__raxel_voxel_bvh_builder_t, world->allocator, count);
+    }
+    while ((int)raxel_list_size(world->__bvh_builders) < count) {
+        __raxel_voxel_bvh_builder_t builder;
+        raxel_bvh_build_scratch_init(&builder.scratch, world->allocator);
+        builder.primitive_bounds = raxel_list_create_reserve(raxel_bvh_bounds_t, world->allocator, RAXEL_VOXEL_CHUNK_SIZE);
+        builder.primitive_indices = raxel_list_create_reserve(int, world->allocator, RAXEL_VOXEL_CHUNK_SIZE);
+        raxel_list_push_back(world->__bvh_builders, builder);
+    }
+}
+
+static void __raxel_voxel_world_release_bvh_builders(raxel_voxel_world_t *world) {
+    if (!world->__bvh_builders) {
+        return;
+    }
+    for (raxel_size_t i = 0; i < raxel_list_size(world->__bvh_builders); i++) {
+        __raxel_voxel_bvh_builder_t *builder = &world->__bvh_builders[i];
+        raxel_bvh_build_scratch_release(&builder->scratch);
+        raxel_list_destroy(builder->primitive_bounds);
+        raxel_list_destroy(builder->primitive_indices);
+    }
+    raxel_list_destroy(world->__bvh_builders);
+    world->__bvh_builders = NULL;
+}
+
+// Grows the builder's primitive arrays to hold n primitives.
+static void __raxel_voxel_bvh_builder_reserve(__raxel_voxel_bvh_builder_t *builder, raxel_size_t n) {
+    if (n > raxel_list_capacity(builder->primitive_bounds)) {
+        raxel_list_resize(builder->primitive_bounds, n);
+        raxel_list_resize(builder->primitive_indices, n);
+    }
+}
+
+// Brings a chunk's BVH up to its cache entry: patches the listed edits in if there are any, and
+// otherwise, or if that fails, rebuilds it in place over the voxel list in chunk-local coordinates
+// and puts the list in leaf order. The wide BVH is collapsed from it afterwards.
+static void __raxel_voxel_world_build_chunk_bvh(raxel_voxel_world_t *world, raxel_voxel_chunk_bvh_t *chunk_bvh, int max_leaf_size,
+                                                __raxel_voxel_bvh_builder_t *builder) {
+    if (chunk_bvh->bvh && chunk_bvh->bvh->max_leaf_size == max_leaf_size && raxel_list_size(chunk_bvh->edits) > 0 &&
+        __raxel_voxel_world_patch_chunk_bvh(chunk_bvh)) {
+        return;
+    }
+    chunk_bvh->patched_edits = 0;
+    int n = chunk_bvh->voxels ? (int)raxel_list_size(chunk_bvh->voxels) : 0;
+    if (n == 0) {
+        raxel_bvh_accel_destroy(chunk_bvh->bvh, world->allocator);
+        raxel_wide_bvh_destroy(chunk_bvh->wide, world->allocator);
+        chunk_bvh->bvh = NULL;
+        chunk_bvh->wide = NULL;
+        return;
+    }
+    __raxel_voxel_bvh_builder_reserve(builder, (raxel_size_t)n);
+    raxel_bvh_bounds_t *prim_bounds = builder->primitive_bounds;
+    int *prim_indices = builder->primitive_indices;
+    for (int k = 0; k < n; k++) {
+        __raxel_voxel_chunk_voxel_bounds(chunk_bvh->voxels[k], &prim_bounds[k]);
+        prim_indices[k] = k;
+    }
+    if (!chunk_bvh->bvh) {
+        chunk_bvh->bvh = raxel_bvh_accel_create(world->allocator);
+    }
+    raxel_bvh_accel_rebuild(chunk_bvh->bvh, prim_bounds, prim_indices, n, max_leaf_size, world->bvh_build_method, NULL, &builder->scratch);
+    chunk_bvh->built_cost = __raxel_bvh_sah_cost(chunk_bvh->bvh);
+    // the bounds are no longer needed, so they hold the reordered list meanwhile
+    uint16_t *leaf_order = (uint16_t *)prim_bounds;
+    for (int k = 0; k < n; k++) {
+        leaf_order[k] = chunk_bvh->voxels[prim_indices[k]];
+    }
+    memcpy(chunk_bvh->voxels, leaf_order, n * sizeof(uint16_t));
+}
+
+// Rebuilds the top-level BVH over the chunk BVHs of the resident set, one chunk per leaf.
+static void __raxel_voxel_world_build_top_bvh(raxel_voxel_world_t *world) {
+    raxel_list_size(world->__bvh_instances) = 0;
+    raxel_size_t num_resident = raxel_list_size(world->__resident_chunks);
+    __raxel_voxel_world_reserve_bvh_builders(world, 1);
+    __raxel_voxel_bvh_builder_t *builder = &world->__bvh_builders[0];
+    __raxel_voxel_bvh_builder_reserve(builder, num_resident + 1);
+    raxel_bvh_bounds_t *prim_bounds = builder->primitive_bounds;
+    int *prim_indices = builder->primitive_indices;
+    int n = 0;
+    for (raxel_size_t i = 0; i < num_resident; i++) {
+        raxel_voxel_chunk_bvh_t *chunk_bvh = &world->__chunk_bvhs[world->__resident_chunks[i]];
+        if (!chunk_bvh->bvh) {
+            continue;
+        }
+        raxel_voxel_bvh_instance_t instance = {
+            .chunk = world->__resident_chunks[i],
+            .origin = { world->__resident_meta[i].x * RAXEL_VOXEL_CHUNK_SIZE,
+                        world->__resident_meta[i].y * RAXEL_VOXEL_CHUNK_SIZE,
+                        world->__resident_meta[i].z * RAXEL_VOXEL_CHUNK_SIZE },
+        };
+        for (int k = 0; k < 3; k++) {
+            prim_bounds[n].min[k] = chunk_bvh->bvh->nodes[0].bounds.min[k] + (float)instance.origin[k];
+            prim_bounds[n].max[k] = chunk_bvh->bvh->nodes[0].bounds.max[k] + (float)instance.origin[k];
+        }
+        prim_indices[n] = n;
+        raxel_list_push_back(world->__bvh_instances, instance);
+        n++;
+    }
+    if (n == 0) {
+        raxel_bvh_accel_destroy(world->__bvh, world->allocator);
+        raxel_wide_bvh_destroy(world->__wide_bvh, world->allocator);
+        world->__bvh = NULL;
+        world->__wide_bvh = NULL;
+        return;
+    }
+    if (!world->__bvh) {
+        world->__bvh = raxel_bvh_accel_create(world->allocator);
+        world->__wide_bvh = raxel_wide_bvh_create(world->allocator);
+    }
+    raxel_bvh_accel_rebuild(world->__bvh, prim_bounds, prim_indices, n, 1, world->bvh_build_method, NULL, &builder->scratch);
+    // put the instances in leaf order, so a leaf's primitives_offset is its instance; an instance
+    // is smaller than the bounds, which are no longer needed and hold the old order meanwhile
+    raxel_voxel_bvh_instance_t *unordered = (raxel_voxel_bvh_instance_t *)prim_bounds;
+    memcpy(unordered, world->__bvh_instances, n * sizeof(raxel_voxel_bvh_instance_t));
+    for (int k = 0; k < n; k++) {
+        world->__bvh_instances[k] = unordered[prim_indices[k]];
+    }
+    raxel_wide_bvh_collapse(world->__wide_bvh, world->__bvh, world->bvh_width);
+}
+
+typedef struct __raxel_voxel_chunk_bvh_job {
+    raxel_voxel_world_t *world;
+    const raxel_voxel_chunk_handle_t *handles;
+    raxel_size_t num_handles;
+    raxel_size_t next;  // the next handle to take
+} __raxel_voxel_chunk_bvh_job_t;
+
+// One task per build thread, taking chunks until none are left, so every task can keep the
+// builder of its index to itself.
+static void __raxel_voxel_world_build_chunk_bvh_task(void *arg, int task) {
+    __raxel_voxel_chunk_bvh_job_t *job = arg;
+    raxel_voxel_world_t *world = job->world;
+    __raxel_voxel_bvh_builder_t *builder = &world->__bvh_builders[task];
+    for (;;) {
+        raxel_size_t i = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED);
+        if (i >= job->num_handles) {
+            return;
+        }
+        raxel_voxel_chunk_bvh_t *chunk_bvh = &world->__chunk_bvhs[job->handles[i]];
+        __raxel_voxel_world_build_chunk_bvh(world, chunk_bvh, world->__chunk_bvh_leaf_size, builder);
+        if (chunk_bvh->bvh) {
+            if (!chunk_bvh->wide) {
+                chunk_bvh->wide = raxel_wide_bvh_create(world->allocator);
+            }
+            raxel_wide_bvh_collapse(chunk_bvh->wide, chunk_bvh->bvh, world->bvh_width);
+            chunk_bvh->generation++;
+        }
+    }
+}
+
+// Rebuilds the BVHs of the given chunks on the build pool. Each chunk is built by one task, which
+// only touches its own cache entry, and __chunk_bvhs does not grow while they run.
+static void __raxel_voxel_world_build_chunk_bvhs(raxel_voxel_world_t *world, const raxel_voxel_chunk_handle_t *handles, raxel_size_t num_handles) {
+    int num_threads = world->bvh_build_threads > 0 ? world->bvh_build_threads : raxel_thread_hardware_concurrency();
+    if (num_handles > 1 && num_threads > 1 &&
+        (!world->__bvh_build_pool || raxel_thread_pool_size(world->__bvh_build_pool) != num_threads)) {
+        raxel_thread_pool_destroy(world->__bvh_build_pool);
+        world->__bvh_build_pool = raxel_thread_pool_create(num_threads - 1, world->allocator);
+        if (!world->__bvh_build_pool) {
+            RAXEL_CORE_LOG_ERROR("Failed to start %d BVH build threads, building on the staging thread\n", num_threads - 1);
+        }
+    }
+    __raxel_voxel_chunk_bvh_job_t job = { .world = world, .handles = handles, .num_handles = num_handles, .next = 0 };
+    if (num_handles > 1 && num_threads > 1 && world->__bvh_build_pool) {
+        int num_tasks = num_handles < (raxel_size_t)num_threads ? (int)num_handles : num_threads;
+        __raxel_voxel_world_reserve_bvh_builders(world, num_tasks);
+        raxel_thread_pool_run(world->__bvh_build_pool, num_tasks, __raxel_voxel_world_build_chunk_bvh_task, &job);
+        return;
+    }
+    __raxel_voxel_world_reserve_bvh_builders(world, 1);
+    __raxel_voxel_world_build_chunk_bvh_task(&job, 0);
+}
+
+// The wide nodes the GPU buffer needs for the BVH of the loaded set.
+static raxel_size_t __raxel_voxel_world_bvh_total_nodes(raxel_voxel_world_t *world) {
+    if (!world->__bvh) {
+        return 0;
+    }
+    raxel_size_t total = (raxel_size_t)world->__wide_bvh->n_nodes;
+    for (raxel_size_t i = 0; i < raxel_list_size(world->__bvh_instances); i++) {
+        total += (raxel_size_t)world->__chunk_bvhs[world->__bvh_instances[i].chunk].wide->n_nodes;
+    }
+    return total;
+}
+
+// Closest voxel of one chunk BVH, in chunk-local coordinates. Only hits nearer than *t_best count.
+static int __raxel_voxel_chunk_bvh_raycast(const raxel_voxel_chunk_bvh_t *chunk_bvh,
+                                           const float origin[3],
+                                           const float direction[3],
+                                           const float inv_direction[3],
+                                           float *t_best,
+                                           int *voxel) {
+    const raxel_linear_bvh_node_t *nodes = chunk_bvh->bvh->nodes;
+    int found = 0;
+    int stack[64];
+    int stack_size = 0;
+    stack[stack_size++] = 0;
+    while (stack_size > 0) {
+        int index = stack[--stack_size];
+        const raxel_linear_bvh_node_t *node = &nodes[index];
+        float t;
+        if (!__raxel_bounds3f_intersect(&node->bounds, origin, inv_direction, *t_best, &t)) {
+            continue;
+        }
+        if (node->n_primitives > 0) {
+            for (uint32_t p = 0; p < node->n_primitives; p++) {
+                int i = chunk_bvh->voxels[node->primitives_offset + p];
+                raxel_bvh_bounds_t box;
+                __raxel_voxel_chunk_voxel_bounds(i, &box);
+                if (__raxel_bounds3f_intersect(&box, origin, inv_direction, *t_best, &t) && (t < *t_best || !found)) {
+                    *t_best = t;
+                    *voxel = i;
+                    found = 1;
+                }
+            }
+        } else if (stack_size + 2 <= 64) {
+            // near child on top
+            int first = index + 1;
+            int second = node->second_child_offset;
+            int near_first = direction[node->axis] >= 0.0f;
+            stack[stack_size++] = near_first ? second : first;
+            stack[stack_size++] = near_first ? first : second;
         }
     }
+    return found;
 }
 
-// =============================================================================
-// 7. Voxel World Update and Buffer Dispatch
-// =============================================================================
+int raxel_voxel_world_bvh_raycast(raxel_voxel_world_t *world, const float origin[3], const float direction[3], float max_t, raxel_voxel_bvh_hit_t *hit) {
+    raxel_bvh_accel_t *bvh = world->__bvh;
+    if (!bvh) {
+        return 0;
+    }
+    float inv_direction[3] = { 1.0f / direction[0], 1.0f / direction[1], 1.0f / direction[2] };
+    float t_best = max_t;
+    int found = 0;
+    int stack[64];
+    int stack_size = 0;
+    stack[stack_size++] = 0;
+    while (stack_size > 0) {
+        int index = stack[--stack_size];
+        const raxel_linear_bvh_node_t *node = &bvh->nodes[index];
+        float t;
+        if (!__raxel_bounds3f_intersect(&node->bounds, origin, inv_direction, t_best, &t)) {
+            continue;
+        }
+        if (node->n_primitives > 0) {
+            const raxel_voxel_bvh_instance_t *instance = &world->__bvh_instances[node->primitives_offset];
+            float local_origin[3];
+            for (int k = 0; k < 3; k++) {
+                local_origin[k] = origin[k] - (float)instance->origin[k];
+            }
+            int voxel;
+            if (__raxel_voxel_chunk_bvh_raycast(&world->__chunk_bvhs[instance->chunk], local_origin, direction, inv_direction, &t_best, &voxel)) {
+                found = 1;
+                hit->voxel[0] = instance->origin[0] + voxel % RAXEL_VOXEL_CHUNK_SIZE;
+                hit->voxel[1] = instance->origin[1] + (voxel / RAXEL_VOXEL_CHUNK_SIZE) % RAXEL_VOXEL_CHUNK_SIZE;
+                hit->voxel[2] = instance->origin[2] + voxel / (RAXEL_VOXEL_CHUNK_SIZE * RAXEL_VOXEL_CHUNK_SIZE);
+            }
+        } else if (stack_size + 2 <= 64) {
+            int first = index + 1;
+            int second = node->second_child_offset;
+            int near_first = direction[node->axis] >= 0.0f;
+            stack[stack_size++] = near_first ? second : first;
+            stack[stack_size++] = near_first ? first : second;
+        }
+    }
+    if (!found) {
+        return 0;
+    }
+    hit->t = t_best;
+    hit->material = raxel_voxel_world_get_voxel(world, hit->voxel[0], hit->voxel[1], hit->voxel[2]).material;
+    return 1;
+}
 
-void raxel_voxel_world_update(raxel_voxel_world_t *world,
-                              raxel_voxel_world_update_options_t *options,
-                              raxel_compute_shader_t *compute_shader,
-                              raxel_pipeline_t *pipeline) {
+typedef struct __raxel_voxel_packet_raycast {
+    raxel_voxel_world_t *world;
+    raxel_voxel_bvh_hit_t *hits;
+    uint32_t found;
+    // the chunk being walked
+    const raxel_voxel_chunk_bvh_t *chunk_bvh;
+    int voxel[RAXEL_BVH_PACKET_MAX_RAYS];
+    uint32_t chunk_found;
+} __raxel_voxel_packet_raycast_t;
+
+// A chunk BVH leaf, __raxel_voxel_chunk_bvh_raycast's inner loop for the rays of a packet.
+static void __raxel_voxel_packet_voxel_leaf(void *ctx, const raxel_linear_bvh_node_t *leaf, __raxel_bvh_packet_t *packet, uint32_t rays) {
+    __raxel_voxel_packet_raycast_t *raycast = ctx;
+    for (uint32_t p = 0; p < leaf->n_primitives; p++) {
+        int voxel = raycast->chunk_bvh->voxels[leaf->primitives_offset + p];
+        raxel_bvh_bounds_t box;
+        __raxel_voxel_chunk_voxel_bounds(voxel, &box);
+        for (uint32_t entered = __raxel_bvh_packet_intersect(packet, &box, rays); entered; entered &= entered - 1) {
+            int i = __builtin_ctz(entered);
+            if (packet->t_near[i] < packet->t_best[i] || !(raycast->chunk_found & (1u << i))) {
+                packet->t_best[i] = packet->t_near[i];
+                raycast->voxel[i] = voxel;
+                raycast->chunk_found |= 1u << i;
+            }
+        }
+    }
+}
+
+// A top-level leaf: walks the instance's chunk BVH with the rays moved into chunk-local coordinates.
+static void __raxel_voxel_packet_instance_leaf(void *ctx, const raxel_linear_bvh_node_t *leaf, __raxel_bvh_packet_t *packet, uint32_t rays) {
+    __raxel_voxel_packet_raycast_t *raycast = ctx;
+    const raxel_voxel_bvh_instance_t *instance = &raycast->world->__bvh_instances[leaf->primitives_offset];
+    __raxel_bvh_packet_t local = *packet;
+    for (int k = 0; k < 3; k++) {
+        for (int i = 0; i < RAXEL_BVH_PACKET_MAX_RAYS; i++) {
+            local.origin[k][i] -= (float)instance->origin[k];
+        }
+    }
+    raycast->chunk_bvh = &raycast->world->__chunk_bvhs[instance->chunk];
+    raycast->chunk_found = 0;
+    __raxel_bvh_packet_traverse(raycast->chunk_bvh->bvh->nodes, &local, rays, __raxel_voxel_packet_voxel_leaf, raycast);
+    for (uint32_t found = raycast->chunk_found; found; found &= found - 1) {
+        int i = __builtin_ctz(found);
+        int voxel = raycast->voxel[i];
+        packet->t_best[i] = local.t_best[i];
+        raycast->hits[i].voxel[0] = instance->origin[0] + voxel % RAXEL_VOXEL_CHUNK_SIZE;
+        raycast->hits[i].voxel[1] = instance->origin[1] + (voxel / RAXEL_VOXEL_CHUNK_SIZE) % RAXEL_VOXEL_CHUNK_SIZE;
+        raycast->hits[i].voxel[2] = instance->origin[2] + voxel / (RAXEL_VOXEL_CHUNK_SIZE * RAXEL_VOXEL_CHUNK_SIZE);
+    }
+    raycast->found |= raycast->chunk_found;
+}
+
+uint32_t raxel_voxel_world_bvh_raycast_packet(raxel_voxel_world_t *world, const raxel_bvh_ray_packet_t *packet, raxel_voxel_bvh_hit_t *hits) {
+    if (!world->__bvh) {
+        return 0;
+    }
+    __raxel_bvh_packet_t rays;
+    uint32_t mask = __raxel_bvh_packet_init(&rays, packet);
+    __raxel_voxel_packet_raycast_t raycast = { .world = world, .hits = hits, .found = 0 };
+    if (mask) {
+        __raxel_bvh_packet_traverse(world->__bvh->nodes, &rays, mask, __raxel_voxel_packet_instance_leaf, &raycast);
+    }
+    for (uint32_t found = raycast.found; found; found &= found - 1) {
+        int i = __builtin_ctz(found);
+        hits[i].t = rays.t_best[i];
+        hits[i].material = raxel_voxel_world_get_voxel(world, hits[i].voxel[0], hits[i].voxel[1], hits[i].voxel[2]).material;
+    }
+    return raycast.found;
+}
+
+void raxel_voxel_world_bvh_stats(raxel_voxel_world_t *world, raxel_bvh_stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+    raxel_bvh_accel_t *bvh = world->__bvh;
+    if (!bvh || bvh->n_nodes == 0) {
+        return;
+    }
+    raxel_size_t n_instances = raxel_list_size(world->__bvh_instances);
+    int *instance_depths = raxel_malloc(world->allocator, (n_instances > 0 ? n_instances : 1) * sizeof(int));
+    __raxel_bvh_stats_walk_t walk = {
+        .stats = stats,
+        .root_area = __raxel_bounds3f_surface_area(&bvh->nodes[0].bounds),
+        .target_leaf_size = MAX_LEAF_SIZE_BVH,
+        .instance_depths = instance_depths,
+    };
+    if (walk.root_area <= 0.0f) {
+        walk.root_area = 1.0f;
+    }
+    __raxel_bvh_stats_walk(&walk, bvh->nodes, 0, 0);
+    stats->memory_bytes = (raxel_size_t)bvh->n_nodes * sizeof(raxel_linear_bvh_node_t) + n_instances * sizeof(raxel_voxel_bvh_instance_t);
+    stats->gpu_bytes = (raxel_size_t)world->__wide_bvh->n_nodes * sizeof(raxel_wide_bvh_node_t);
+    // the chunk BVHs are in chunk-local coordinates, which moves their boxes but keeps their areas
+    walk.instance_depths = NULL;
+    for (raxel_size_t i = 0; i < n_instances; i++) {
+        const raxel_voxel_chunk_bvh_t *chunk_bvh = &world->__chunk_bvhs[world->__bvh_instances[i].chunk];
+        __raxel_bvh_stats_walk(&walk, chunk_bvh->bvh->nodes, 0, instance_depths[i]);
+        stats->memory_bytes += (raxel_size_t)chunk_bvh->bvh->n_nodes * sizeof(raxel_linear_bvh_node_t) +
+                               raxel_list_size(chunk_bvh->voxels) * sizeof(uint16_t);
+        stats->gpu_bytes += (raxel_size_t)chunk_bvh->wide->n_nodes * sizeof(raxel_wide_bvh_node_t);
+    }
+    __raxel_bvh_stats_finish(&walk);
+    raxel_free(world->allocator, instance_depths);
+}
+
+// Reselects the loaded set if needed, and rebuilds the BVH if the loaded set or a loaded chunk
+// changed since the last call. The world lock is held for everything but the BVH build, which
+// the 64-tree backend does not need.
+static void __raxel_voxel_world_refresh_residency(raxel_voxel_world_t *world, raxel_voxel_world_update_options_t *options) {
     raxel_coord_t cam_chunk_x, cam_chunk_y, cam_chunk_z;
     __raxel_voxel_world_from_world_to_chunk_coords(world,
                                                    options->camera_position[0],
@@ -448,70 +3211,735 @@ void raxel_voxel_world_update(raxel_voxel_world_t *world,
                                                    world->prev_update_options.camera_position[2],
                                                    &prev_cam_chunk_x, &prev_cam_chunk_y, &prev_cam_chunk_z);
 
+    raxel_voxel_world_lock(world);
+
+    // the loaded set only changes when the camera crosses a chunk or new chunks appear, and
+    // chunks are only paged in or out when it may change
+    raxel_size_t num_chunks = raxel_list_size(world->chunks);
+    if (cam_chunk_x != prev_cam_chunk_x ||
+        cam_chunk_y != prev_cam_chunk_y ||
+        cam_chunk_z != prev_cam_chunk_z ||
+        options->view_distance != world->prev_update_options.view_distance ||
+        num_chunks != world->__prev_num_chunks ||
+        world->chunk_budget != world->__prev_chunk_budget) {
+        __raxel_voxel_world_page_in(world, options->camera_position, options->view_distance);
+        __raxel_voxel_world_select_loaded(world, options->camera_position, options->view_distance);
+        __raxel_voxel_world_page_out(world, options->camera_position, options->view_distance);
+        world->__prev_num_chunks = raxel_list_size(world->chunks);
+        world->__prev_chunk_budget = world->chunk_budget;
+    }
     world->prev_update_options = *options;
 
-    if (cam_chunk_x == prev_cam_chunk_x &&
-        cam_chunk_y == prev_cam_chunk_y &&
-        cam_chunk_z == prev_cam_chunk_z) {
+    int changed = raxel_list_size(world->__resident_chunks) != world->__num_loaded_chunks ||
+                  world->__resident_backend != world->backend;
+    for (raxel_size_t i = 0; i < world->__num_loaded_chunks && !changed; i++) {
+        changed = world->__resident_chunks[i] != world->chunks[i] ||
+                  world->__resident_revisions[i] != __raxel_voxel_world_chunk_at(world, i)->revision;
+    }
+    if (!changed) {
+        raxel_voxel_world_unlock(world);
+        return;
+    }
+    if (world->backend == RAXEL_VOXEL_BACKEND_TREE64) {
+        __raxel_voxel_world_update_tree(world, options->camera_position);
+    }
+    raxel_list_size(world->__resident_chunks) = 0;
+    raxel_list_size(world->__resident_revisions) = 0;
+    raxel_list_size(world->__resident_meta) = 0;
+    for (raxel_size_t i = 0; i < world->__num_loaded_chunks; i++) {
+        raxel_list_push_back(world->__resident_chunks, world->chunks[i]);
+        raxel_list_push_back(world->__resident_revisions, __raxel_voxel_world_chunk_at(world, i)->revision);
+        raxel_list_push_back(world->__resident_meta, world->chunk_meta[i]);
+    }
+    world->__resident_backend = world->backend;
+    world->__residency_version++;
+    if (world->backend == RAXEL_VOXEL_BACKEND_TREE64) {
+        raxel_voxel_world_unlock(world);
+        raxel_bvh_accel_destroy(world->__bvh, world->allocator);
+        raxel_wide_bvh_destroy(world->__wide_bvh, world->allocator);
+        world->__bvh = NULL;
+        world->__wide_bvh = NULL;
+        raxel_list_size(world->__bvh_instances) = 0;
         return;
     }
+    raxel_size_t num_resident = raxel_list_size(world->__resident_chunks);
+    raxel_voxel_chunk_handle_t *stale = raxel_malloc(world->allocator, (num_resident + 1) * sizeof(raxel_voxel_chunk_handle_t));
+    raxel_size_t num_stale = 0;
+    for (raxel_size_t i = 0; i < num_resident; i++) {
+        if (__raxel_voxel_world_collect_chunk_voxels(world, world->__resident_chunks[i])) {
+            stale[num_stale++] = world->__resident_chunks[i];
+        }
+    }
+    raxel_voxel_world_unlock(world);
 
-    raxel_size_t num_chunks = raxel_list_size(world->chunk_meta);
-    raxel_size_t num_loaded_chunks = 0;
-    for (raxel_size_t i = 0; i < num_chunks; i++) {
-        raxel_voxel_chunk_meta_t *meta = &world->chunk_meta[i];
-        raxel_coord_t dx = meta->x - cam_chunk_x;
-        raxel_coord_t dy = meta->y - cam_chunk_y;
-        raxel_coord_t dz = meta->z - cam_chunk_z;
-        float dist = sqrtf(dx * dx + dy * dy + dz * dz);
-        if (dist < options->view_distance) {
-            if (num_loaded_chunks != i) {
-                __raxel_voxel_world_swap_chunks(world, num_loaded_chunks, i);
+    // --- Patch or rebuild the BVHs of new and edited chunks, then the top level, edits may go on meanwhile ---
+    __raxel_voxel_world_build_chunk_bvhs(world, stale, num_stale);
+    raxel_size_t num_rebuilt = num_stale;
+    __raxel_voxel_world_build_top_bvh(world);
+    // the GPU buffer holds bvh_node_budget wide nodes; coarser leaves are slower but still exact
+    raxel_size_t total_nodes = __raxel_voxel_world_bvh_total_nodes(world);
+    while (total_nodes > world->bvh_node_budget && world->__chunk_bvh_leaf_size < RAXEL_VOXEL_CHUNK_VOLUME) {
+        world->__chunk_bvh_leaf_size *= 2;
+        RAXEL_CORE_LOG("BVH has %zu nodes, more than the budget of %zu, rebuilding with up to %d voxels per leaf\n",
+                       total_nodes, world->bvh_node_budget, world->__chunk_bvh_leaf_size);
+        // every chunk BVH is rebuilt, reuse the handle array for them
+        num_stale = 0;
+        for (raxel_size_t i = 0; i < raxel_list_size(world->__bvh_instances); i++) {
+            stale[num_stale++] = world->__bvh_instances[i].chunk;
+        }
+        __raxel_voxel_world_build_chunk_bvhs(world, stale, num_stale);
+        __raxel_voxel_world_build_top_bvh(world);
+        total_nodes = __raxel_voxel_world_bvh_total_nodes(world);
+    }
+    raxel_free(world->allocator, stale);
+    RAXEL_CORE_LOG("Built BVH over %zu chunks, %zu of them updated, %zu nodes\n",
+                   raxel_list_size(world->__bvh_instances), num_rebuilt, total_nodes);
+}
+
+// Brings a buffer to the current 64-tree. The pool is append only between builds, so only the
+// words past the ones the buffer holds are copied. Only the staging thread touches the tree.
+static raxel_size_t __raxel_voxel_gpu_mirror_sync_tree(raxel_voxel_world_t *world, raxel_voxel_gpu_mirror_t *mirror) {
+    raxel_sb_buffer_t *buffer = mirror->buffer;
+    __raxel_voxel_world_gpu_t *gpu_world = buffer->data;
+    raxel_tree64_t *tree = &world->__tree;
+    raxel_size_t pool_size = raxel_tree64_pool_size(tree);
+    if (mirror->tree_generation != tree->generation || mirror->tree_words > pool_size) {
+        mirror->tree_generation = tree->generation;
+        mirror->tree_words = 0;
+    }
+    raxel_size_t num_written = pool_size - mirror->tree_words;
+    uint32_t *pool = (uint32_t *)gpu_world->chunks;
+    memcpy(pool + mirror->tree_words, tree->pool + mirror->tree_words, num_written * sizeof(uint32_t));
+    raxel_sb_buffer_mark_dirty(buffer, (char *)(pool + mirror->tree_words) - (char *)gpu_world, num_written * sizeof(uint32_t));
+    mirror->tree_words = pool_size;
+
+    for (int k = 0; k < 3; k++) {
+        gpu_world->tree.origin[k] = tree->origin[k];
+    }
+    gpu_world->tree.depth = tree->depth;
+    gpu_world->tree.root = tree->root;
+    gpu_world->tree.pool_offset = (uint32_t)(((char *)pool - (char *)gpu_world) / sizeof(uint32_t));
+    gpu_world->tree.pool_size = (uint32_t)pool_size;
+    __RAXEL_GPU_WORLD_MARK(buffer, gpu_world, tree);
+    // the chunk slots and the BVH are not used
+    gpu_world->num_loaded_chunks = 0;
+    gpu_world->bvh.n_nodes = 0;
+    __RAXEL_GPU_WORLD_MARK(buffer, gpu_world, num_loaded_chunks);
+    __RAXEL_GPU_WORLD_MARK(buffer, gpu_world, bvh.n_nodes);
+
+    mirror->version = world->__residency_version;
+    RAXEL_CORE_LOG("Staged %zu of %zu 64-tree words for %zu chunks\n", num_written, pool_size, tree->num_chunks);
+    return num_written;
+}
+
+// Gives the chunk BVH of every instance a range of the buffer's nodes and copies the ones the
+// buffer does not hold yet. A chunk BVH copied before stays where it is; a changed one is copied
+// over its old range if it fits and past the last range otherwise. Returns 0 if there is no room
+// past the last range.
+static int __raxel_voxel_gpu_mirror_place_chunk_bvhs(raxel_voxel_world_t *world, raxel_voxel_gpu_mirror_t *mirror,
+                                                     raxel_wide_bvh_node_t *nodes, raxel_size_t capacity) {
+    for (raxel_size_t i = 0; i < raxel_list_size(world->__bvh_instances); i++) {
+        raxel_voxel_chunk_handle_t handle = world->__bvh_instances[i].chunk;
+        raxel_wide_bvh_t *chunk_bvh = world->__chunk_bvhs[handle].wide;
+        uint32_t generation = world->__chunk_bvhs[handle].generation;
+        raxel_voxel_gpu_bvh_range_t *range = &mirror->bvh_of_chunk[handle];
+        if (range->n_nodes > 0 && range->generation == generation) {
+            continue;
+        }
+        if (range->n_nodes < (uint32_t)chunk_bvh->n_nodes) {
+            if (mirror->bvh_end + (raxel_size_t)chunk_bvh->n_nodes > capacity) {
+                return 0;
             }
-            num_loaded_chunks++;
+            range->first_node = (uint32_t)mirror->bvh_end;
+            range->n_nodes = (uint32_t)chunk_bvh->n_nodes;
+            mirror->bvh_end += (raxel_size_t)chunk_bvh->n_nodes;
+        }
+        range->generation = generation;
+        memcpy(nodes + range->first_node, chunk_bvh->nodes, chunk_bvh->n_nodes * sizeof(raxel_wide_bvh_node_t));
+        raxel_sb_buffer_mark_dirty(mirror->buffer, (char *)(nodes + range->first_node) - (char *)mirror->buffer->data,
+                                   chunk_bvh->n_nodes * sizeof(raxel_wide_bvh_node_t));
+    }
+    return 1;
+}
+
+// Brings a buffer to the current residency version: chunks that left the loaded set are marked
+// cached, chunks new to the buffer or edited since are decoded into a slot, and the BVH is copied.
+// The world lock is held per chunk, so edits wait for at most one chunk decode.
+static raxel_size_t __raxel_voxel_gpu_mirror_sync(raxel_voxel_world_t *world, raxel_voxel_gpu_mirror_t *mirror) {
+    if (mirror->version == world->__residency_version) {
+        return 0;
+    }
+    raxel_sb_buffer_t *buffer = mirror->buffer;
+    __raxel_voxel_world_gpu_t *gpu_world = buffer->data;
+    if (gpu_world->backend != (uint32_t)world->backend) {
+        // the other backend used the slot area differently
+        __raxel_voxel_gpu_mirror_reset(mirror, world->chunk_budget);
+        gpu_world->backend = world->backend;
+        __RAXEL_GPU_WORLD_MARK(buffer, gpu_world, backend);
+    }
+    if (world->backend == RAXEL_VOXEL_BACKEND_TREE64) {
+        return __raxel_voxel_gpu_mirror_sync_tree(world, mirror);
+    }
+    if (raxel_list_size(mirror->slots) != world->chunk_budget || gpu_world->chunk_budget != world->chunk_budget) {
+        // the BVH nodes follow the slots, so the buffer must know their count
+        __raxel_voxel_gpu_mirror_reset(mirror, world->chunk_budget);
+        gpu_world->chunk_budget = (uint32_t)world->chunk_budget;
+        __RAXEL_GPU_WORLD_MARK(buffer, gpu_world, chunk_budget);
+    }
+    uint32_t now = ++world->__update_count;
+
+    raxel_voxel_world_lock(world);
+    raxel_voxel_gpu_bvh_range_t no_range = { .first_node = 0, .n_nodes = 0, .generation = 0 };
+    while (raxel_list_size(mirror->slot_of_chunk) < world->chunk_pool->num_handles) {
+        raxel_list_push_back(mirror->slot_of_chunk, RAXEL_VOXEL_GPU_SLOT_NONE);
+        raxel_list_push_back(mirror->bvh_of_chunk, no_range);
+    }
+
+    // --- Chunks that left the loaded set stay cached in their slot ---
+    raxel_voxel_gpu_slot_t *slots = mirror->slots;
+    for (raxel_size_t s = 0; s < mirror->num_slots; s++) {
+        if (!slots[s].loaded || __raxel_voxel_world_slot_is_loaded(world, &gpu_world->chunks[s].meta, slots[s].chunk)) {
+            continue;
         }
-        if (num_loaded_chunks >= RAXEL_MAX_LOADED_CHUNKS) {
+        slots[s].loaded = 0;
+        slots[s].last_used = now;
+        gpu_world->chunks[s].meta.state = RAXEL_VOXEL_CHUNK_STATE_CACHED;
+        __RAXEL_GPU_WORLD_MARK(buffer, gpu_world, chunks[s].meta);
+    }
+    raxel_voxel_world_unlock(world);
+
+    // --- Cached slots, least recently used first, are given to chunks without a slot ---
+    raxel_size_t num_resident = raxel_list_size(world->__resident_chunks);
+    __raxel_voxel_eviction_candidate_t *victims = NULL;
+    raxel_size_t num_victims = 0;
+    raxel_size_t next_victim = 0;
+    for (raxel_size_t i = 0; i < num_resident; i++) {
+        if (mirror->slot_of_chunk[world->__resident_chunks[i]] == RAXEL_VOXEL_GPU_SLOT_NONE &&
+            mirror->num_slots == world->chunk_budget) {
+            victims = raxel_malloc(world->allocator, world->chunk_budget * sizeof(__raxel_voxel_eviction_candidate_t));
+            for (raxel_size_t s = 0; s < mirror->num_slots; s++) {
+                if (!slots[s].loaded) {
+                    victims[num_victims].last_used = slots[s].last_used;
+                    victims[num_victims].slot = (uint32_t)s;
+                    num_victims++;
+                }
+            }
+            qsort(victims, num_victims, sizeof(__raxel_voxel_eviction_candidate_t), __raxel_voxel_eviction_compare);
             break;
         }
     }
-    world->__num_loaded_chunks = num_loaded_chunks;
 
-    // --- Build the BVH from the currently loaded chunks ---
-    int max_leaf_size_bvh = MAX_LEAF_SIZE_BVH;
-    raxel_bvh_accel_t *bvh = raxel_bvh_accel_build_from_voxel_world(world, max_leaf_size_bvh, world->allocator);
+    // --- Write chunks that are new to their slot or were edited, leaving the others in place ---
+    // The resident set is in the order of the world's lists, which only the staging thread reorders.
+    raxel_size_t num_written = 0;
+    int consistent = 1;
+    for (raxel_size_t i = 0; i < num_resident; i++) {
+        raxel_voxel_chunk_handle_t handle = world->__resident_chunks[i];
+        uint32_t s = mirror->slot_of_chunk[handle];
+        int stale = 0;
+        if (s == RAXEL_VOXEL_GPU_SLOT_NONE) {
+            if (mirror->num_slots < world->chunk_budget) {
+                s = (uint32_t)mirror->num_slots++;
+            } else {
+                // the selection never loads more than chunk_budget chunks, so a cached slot is left
+                s = victims[next_victim++].slot;
+                mirror->slot_of_chunk[slots[s].chunk] = RAXEL_VOXEL_GPU_SLOT_NONE;
+            }
+            slots[s].chunk = handle;
+            slots[s].loaded = 0;
+            mirror->slot_of_chunk[handle] = s;
+            stale = 1;
+        }
+        slots[s].last_used = now;
 
-    // Update GPU world buffer with voxel data and BVH.
-    __raxel_voxel_world_gpu_t *gpu_world = compute_shader->sb_buffer->data;
-    gpu_world->num_loaded_chunks = world->__num_loaded_chunks;
-    for (raxel_size_t i = 0; i < world->__num_loaded_chunks; i++) {
-        gpu_world->chunk_meta[i] = world->chunk_meta[i];
-        memccpy(&gpu_world->chunks[i], &world->chunks[i], 1, sizeof(raxel_voxel_chunk_t));
+        raxel_voxel_world_lock(world);
+        raxel_voxel_chunk_t *chunk = raxel_voxel_chunk_pool_get(world->chunk_pool, handle);
+        if (!slots[s].loaded) {
+            slots[s].loaded = 1;
+            gpu_world->chunks[s].meta = world->chunk_meta[i];
+            gpu_world->chunks[s].meta.state = RAXEL_VOXEL_CHUNK_STATE_DEFAULT;
+            __RAXEL_GPU_WORLD_MARK(buffer, gpu_world, chunks[s].meta);
+        }
+        if (stale || slots[s].revision != chunk->revision) {
+            slots[s].revision = chunk->revision;
+            raxel_voxel_chunk_decode(chunk, gpu_world->chunks[s].voxels);
+            __RAXEL_GPU_WORLD_MARK(buffer, gpu_world, chunks[s].voxels);
+            num_written++;
+        }
+        raxel_voxel_world_unlock(world);
+        // a chunk edited after the BVH was gathered does not match it
+        consistent &= slots[s].revision == world->__resident_revisions[i];
+    }
+    if (victims) {
+        raxel_free(world->allocator, victims);
+    }
 
-        // print out the number of non-empty voxels in each chunk
-        int num_voxels = 0;
-        for (int j = 0; j < RAXEL_VOXEL_CHUNK_SIZE * RAXEL_VOXEL_CHUNK_SIZE * RAXEL_VOXEL_CHUNK_SIZE; j++) {
-            if (world->chunks[i].voxels[j].material != 0) {
-                num_voxels++;
+    if (gpu_world->num_loaded_chunks != mirror->num_slots) {
+        gpu_world->num_loaded_chunks = (uint32_t)mirror->num_slots;
+        __RAXEL_GPU_WORLD_MARK(buffer, gpu_world, num_loaded_chunks);
+    }
+
+    // --- Copy the wide BVH of the loaded set: the top level, then the chunk BVHs that are new or changed ---
+    raxel_wide_bvh_t *bvh = world->__bvh ? world->__wide_bvh : NULL;
+    __raxel_voxel_bvh_instance_gpu_t *instances = __raxel_voxel_world_gpu_bvh_instances(gpu_world);
+    raxel_wide_bvh_node_t *nodes = __raxel_voxel_world_gpu_bvh_nodes(gpu_world);
+    raxel_size_t num_instances = bvh ? raxel_list_size(world->__bvh_instances) : 0;
+    raxel_size_t total_nodes = __raxel_voxel_world_bvh_total_nodes(world);
+    raxel_size_t nodes_start = (raxel_size_t)((char *)nodes - (char *)gpu_world);
+    raxel_size_t capacity = buffer->data_size > nodes_start ? (buffer->data_size - nodes_start) / sizeof(raxel_wide_bvh_node_t) : 0;
+    gpu_world->bvh.n_nodes = 0;
+    gpu_world->bvh.n_total_nodes = 0;
+    gpu_world->bvh.n_instances = 0;
+    if (total_nodes > capacity) {
+        RAXEL_CORE_LOG_ERROR("BVH of %zu nodes does not fit the voxel world buffer\n", total_nodes);
+    } else if (bvh) {
+        if ((raxel_size_t)bvh->n_nodes > mirror->bvh_top_nodes || !__raxel_voxel_gpu_mirror_place_chunk_bvhs(world, mirror, nodes, capacity)) {
+            // the top level outgrew its room, or the ranges changed chunk BVHs left behind filled the
+            // nodes up: lay them out anew, with some room for the top level to grow as chunks come and go
+            for (raxel_size_t h = 0; h < raxel_list_size(mirror->bvh_of_chunk); h++) {
+                mirror->bvh_of_chunk[h].n_nodes = 0;
+            }
+            raxel_size_t chunk_nodes = total_nodes - (raxel_size_t)bvh->n_nodes;
+            raxel_size_t top_nodes = (raxel_size_t)bvh->n_nodes * 3 / 2 + 1;
+            mirror->bvh_top_nodes = top_nodes + chunk_nodes <= capacity ? top_nodes : capacity - chunk_nodes;
+            mirror->bvh_end = mirror->bvh_top_nodes;
+            __raxel_voxel_gpu_mirror_place_chunk_bvhs(world, mirror, nodes, capacity);
+        }
+        memcpy(nodes, bvh->nodes, bvh->n_nodes * sizeof(raxel_wide_bvh_node_t));
+        raxel_sb_buffer_mark_dirty(buffer, nodes_start, bvh->n_nodes * sizeof(raxel_wide_bvh_node_t));
+        for (raxel_size_t i = 0; i < num_instances; i++) {
+            raxel_voxel_bvh_instance_t *instance = &world->__bvh_instances[i];
+            for (int k = 0; k < 3; k++) {
+                instances[i].origin[k] = (float)instance->origin[k];
             }
+            instances[i].first_node = mirror->bvh_of_chunk[instance->chunk].first_node;
+            instances[i].n_nodes = (uint32_t)world->__chunk_bvhs[instance->chunk].wide->n_nodes;
+            instances[i].slot = mirror->slot_of_chunk[instance->chunk];
         }
+        raxel_sb_buffer_mark_dirty(buffer, (char *)instances - (char *)gpu_world, num_instances * sizeof(__raxel_voxel_bvh_instance_gpu_t));
+        gpu_world->bvh.n_nodes = (uint32_t)bvh->n_nodes;
+        gpu_world->bvh.n_total_nodes = (uint32_t)total_nodes;
+        gpu_world->bvh.n_instances = (uint32_t)num_instances;
+        gpu_world->bvh.max_leaf_size = world->__chunk_bvh_leaf_size;
+    }
+    gpu_world->bvh.node_offset = (uint32_t)(((char *)nodes - (char *)gpu_world) / sizeof(uint32_t));
+    gpu_world->bvh.instance_offset = (uint32_t)(((char *)instances - (char *)gpu_world) / sizeof(uint32_t));
+    __RAXEL_GPU_WORLD_MARK(buffer, gpu_world, bvh);
+
+    // an inconsistent buffer is left at version 0, so the next call rewrites it
+    mirror->version = consistent ? world->__residency_version : 0;
+
+    RAXEL_CORE_LOG("Staged %zu of %zu loaded chunks, %d BVH nodes\n",
+                   num_written, num_resident, gpu_world->bvh.n_nodes);
+    return num_written;
+}
 
-        RAXEL_CORE_LOG("Chunk %d: %d non-empty voxels\n", i, num_voxels);
+raxel_size_t raxel_voxel_world_stage_upload(raxel_voxel_world_t *world,
+                                            raxel_voxel_world_update_options_t *options,
+                                            raxel_voxel_gpu_mirror_t *mirror) {
+    if (mirror->buffer->data_size < raxel_voxel_world_gpu_size(world)) {
+        RAXEL_CORE_LOG_ERROR("Voxel world buffer is smaller than the backend and budgets need, recreate it with raxel_voxel_world_set_sb\n");
+        return 0;
     }
+    __raxel_voxel_world_refresh_residency(world, options);
+    return __raxel_voxel_gpu_mirror_sync(world, mirror);
+}
 
-    if (!bvh) {
-        RAXEL_CORE_LOG("No primitives to build BVH!\n");
-        raxel_sb_buffer_update(compute_shader->sb_buffer, pipeline);
+void raxel_voxel_world_update(raxel_voxel_world_t *world,
+                              raxel_voxel_world_update_options_t *options,
+                              raxel_compute_shader_t *compute_shader,
+                              raxel_pipeline_t *pipeline) {
+    if (world->__stream) {
+        // the previous frame has finished (the compute pass waits for its dispatch), so rebinding is safe
+        raxel_sb_buffer_t *front = raxel_voxel_world_stream_update(world, options);
+        if (front) {
+            raxel_compute_shader_bind_sb(compute_shader, pipeline, front);
+        }
+        return;
+    }
+    raxel_voxel_gpu_mirror_t *mirror = &world->__gpu[world->__gpu_front];
+    if (!mirror->buffer) {
+        RAXEL_CORE_LOG_ERROR("Voxel world has no GPU buffer, call raxel_voxel_world_set_sb first\n");
+        return;
+    }
+    raxel_voxel_world_stage_upload(world, options, mirror);
+    raxel_size_t bytes = raxel_sb_buffer_flush(mirror->buffer, pipeline);
+    if (bytes > 0) {
+        RAXEL_CORE_LOG("Uploaded %zu of %zu bytes of the voxel world\n", bytes, mirror->buffer->data_size);
+    }
+}
+
+// =============================================================================
+// 8. Streaming Worker
+// =============================================================================
+
+// The render thread and the worker meet only under the stream mutex, and only to hand over the
+// camera and the finished back buffer; the staging itself runs without it. While back_ready is
+// set the worker idles, so the render thread can swap the buffers without racing it.
+typedef struct raxel_voxel_stream {
+    raxel_thread_t thread;
+    raxel_mutex_t mutex;
+    raxel_cond_t cond;
+    raxel_voxel_world_update_options_t options;  // latest camera from the render thread
+    int pending;                                 // options arrived since the worker last staged
+    int back_ready;                              // the back buffer holds a newer complete snapshot
+    int stop;
+} raxel_voxel_stream_t;
+
+static void *__raxel_voxel_stream_main(void *arg) {
+    raxel_voxel_world_t *world = arg;
+    raxel_voxel_stream_t *stream = world->__stream;
+    raxel_mutex_lock(&stream->mutex);
+    for (;;) {
+        while (!stream->stop && (stream->back_ready || !stream->pending)) {
+            raxel_cond_wait(&stream->cond, &stream->mutex);
+        }
+        if (stream->stop) {
+            break;
+        }
+        raxel_voxel_world_update_options_t options = stream->options;
+        stream->pending = 0;
+        raxel_voxel_gpu_mirror_t *front = &world->__gpu[world->__gpu_front];
+        raxel_voxel_gpu_mirror_t *back = &world->__gpu[world->__gpu_front ^ 1];
+        raxel_mutex_unlock(&stream->mutex);
+
+        // the back buffer is not bound, so it can be written and flushed while frames render
+        raxel_voxel_world_stage_upload(world, &options, back);
+        raxel_sb_buffer_flush(back->buffer, NULL);
+
+        raxel_mutex_lock(&stream->mutex);
+        if (back->version == 0) {
+            stream->pending = 1;  // an edit raced the snapshot, stage again
+        } else if (back->version != front->version) {
+            stream->back_ready = 1;
+        }
+    }
+    raxel_mutex_unlock(&stream->mutex);
+    return NULL;
+}
+
+void raxel_voxel_world_start_streaming(raxel_voxel_world_t *world, raxel_sb_buffer_t *front, raxel_sb_buffer_t *back) {
+    raxel_voxel_world_stop_streaming(world);
+    world->__gpu_front = 0;
+    world->__gpu[0].buffer = front;
+    world->__gpu[1].buffer = back;
+    __raxel_voxel_gpu_mirror_reset(&world->__gpu[0], world->chunk_budget);
+    __raxel_voxel_gpu_mirror_reset(&world->__gpu[1], world->chunk_budget);
+
+    raxel_voxel_stream_t *stream = raxel_malloc(world->allocator, sizeof(raxel_voxel_stream_t));
+    raxel_mutex_init(&stream->mutex);
+    raxel_cond_init(&stream->cond);
+    stream->options = world->prev_update_options;
+    stream->pending = 0;
+    stream->back_ready = 0;
+    stream->stop = 0;
+    // set before the worker exists, so from here on every world access takes the lock
+    world->__stream = stream;
+    if (raxel_thread_create(&stream->thread, __raxel_voxel_stream_main, world) != 0) {
+        RAXEL_CORE_LOG_ERROR("Failed to start the voxel streaming worker, staging on the render thread\n");
+        world->__stream = NULL;
+        raxel_cond_destroy(&stream->cond);
+        raxel_mutex_destroy(&stream->mutex);
+        raxel_free(world->allocator, stream);
+    }
+}
+
+void raxel_voxel_world_stop_streaming(raxel_voxel_world_t *world) {
+    raxel_voxel_stream_t *stream = world->__stream;
+    if (!stream) {
+        return;
+    }
+    raxel_mutex_lock(&stream->mutex);
+    stream->stop = 1;
+    raxel_cond_signal(&stream->cond);
+    raxel_mutex_unlock(&stream->mutex);
+    raxel_thread_join(stream->thread);
+
+    world->__stream = NULL;
+    raxel_cond_destroy(&stream->cond);
+    raxel_mutex_destroy(&stream->mutex);
+    raxel_free(world->allocator, stream);
+}
+
+raxel_sb_buffer_t *raxel_voxel_world_stream_update(raxel_voxel_world_t *world, raxel_voxel_world_update_options_t *options) {
+    raxel_voxel_stream_t *stream = world->__stream;
+    if (!stream) {
+        return NULL;
+    }
+    raxel_sb_buffer_t *swapped = NULL;
+    raxel_mutex_lock(&stream->mutex);
+    stream->options = *options;
+    stream->pending = 1;
+    if (stream->back_ready) {
+        world->__gpu_front ^= 1;
+        stream->back_ready = 0;
+        swapped = world->__gpu[world->__gpu_front].buffer;
+    }
+    raxel_cond_signal(&stream->cond);
+    raxel_mutex_unlock(&stream->mutex);
+    return swapped;
+}
+
+// =============================================================================
+// 9. Region Paging
+// =============================================================================
+
+// Returns a malloc'ed "<directory>/r.<x>.<y>.<z>.rxr".
+static char *__raxel_voxel_world_region_path(raxel_voxel_world_t *world, raxel_coord_t rx, raxel_coord_t ry, raxel_coord_t rz) {
+    char name[64];
+    raxel_region_file_name(name, sizeof(name), rx, ry, rz);
+    raxel_size_t size = strlen(world->__region_directory) + 1 + strlen(name) + 1;
+    char *path = raxel_malloc(world->allocator, size);
+    snprintf(path, size, "%s/%s", world->__region_directory, name);
+    return path;
+}
+
+static raxel_voxel_world_region_t *__raxel_voxel_world_find_region(raxel_voxel_world_t *world, raxel_coord_t rx, raxel_coord_t ry, raxel_coord_t rz) {
+    uint64_t key = __raxel_voxel_chunk_key(rx, ry, rz);
+    raxel_size_t index;
+    if (!raxel_hashtable_get(world->__region_index, &key, &index)) {
+        return NULL;
+    }
+    return &world->__regions[index];
+}
+
+// (Re)maps a region file, e.g. after it was written.
+static raxel_voxel_world_region_t *__raxel_voxel_world_map_region(raxel_voxel_world_t *world, raxel_coord_t rx, raxel_coord_t ry, raxel_coord_t rz) {
+    raxel_voxel_world_region_t *region = __raxel_voxel_world_find_region(world, rx, ry, rz);
+    if (!region) {
+        raxel_voxel_world_region_t new_region = { rx, ry, rz, { { NULL, 0 }, NULL } };
+        raxel_list_push_back(world->__regions, new_region);
+        raxel_size_t index = raxel_list_size(world->__regions) - 1;
+        uint64_t key = __raxel_voxel_chunk_key(rx, ry, rz);
+        raxel_hashtable_insert(world->__region_index, &key, &index);
+        region = &world->__regions[index];
+    } else if (region->file.header) {
+        raxel_region_close(&region->file);
+    }
+    char *path = __raxel_voxel_world_region_path(world, rx, ry, rz);
+    raxel_region_open(&region->file, path);
+    raxel_free(world->allocator, path);
+    return region;
+}
+
+static void __raxel_voxel_world_close_regions(raxel_voxel_world_t *world) {
+    for (raxel_size_t r = 0; r < raxel_list_size(world->__regions); r++) {
+        if (world->__regions[r].file.header) {
+            raxel_region_close(&world->__regions[r].file);
+        }
+    }
+    raxel_list_size(world->__regions) = 0;
+    if (world->__region_directory) {
+        raxel_free(world->allocator, world->__region_directory);
+        world->__region_directory = NULL;
+    }
+}
+
+// Reads a chunk from its region file into RAM. Returns RAXEL_VOXEL_CHUNK_HANDLE_INVALID if the
+// world has no such chunk on disk either.
+static raxel_voxel_chunk_handle_t __raxel_voxel_world_page_in_chunk(raxel_voxel_world_t *world, raxel_coord_t x, raxel_coord_t y, raxel_coord_t z) {
+    if (!world->__region_directory) {
+        return RAXEL_VOXEL_CHUNK_HANDLE_INVALID;
+    }
+    raxel_voxel_world_region_t *region = __raxel_voxel_world_find_region(world, raxel_region_coord(x), raxel_region_coord(y), raxel_region_coord(z));
+    raxel_size_t entry = raxel_region_entry_index(x, y, z);
+    if (!region || !region->file.header || !raxel_region_has_chunk(&region->file, entry)) {
+        return RAXEL_VOXEL_CHUNK_HANDLE_INVALID;
+    }
+    raxel_voxel_chunk_t *chunk = __raxel_voxel_world_create_chunk(world, x, y, z);
+    if (!chunk) {
+        RAXEL_CORE_FATAL_ERROR("Failed to create chunk at (%d, %d, %d)\n", x, y, z);
+    }
+    raxel_voxel_chunk_handle_t handle = world->chunks[raxel_list_size(world->chunks) - 1];
+    if (raxel_region_read_chunk(&region->file, entry, chunk) != 0) {
+        // keep the empty chunk, it is not marked as stored, so saving replaces the bad blob
+        RAXEL_CORE_LOG_ERROR("Chunk (%d, %d, %d) is corrupt in its region file\n", x, y, z);
+        return handle;
+    }
+    world->__stored_revisions[handle] = chunk->revision;
+    return handle;
+}
+
+// Drops unloaded chunks that are unchanged since they were stored and well out of range; they
+// can always be read again. Runs after the loaded-set selection.
+static void __raxel_voxel_world_page_out(raxel_voxel_world_t *world, const vec3 camera_position, float view_distance) {
+    if (!world->__region_directory) {
+        return;
+    }
+    float cam[3];
+    for (int k = 0; k < 3; k++) {
+        cam[k] = camera_position[k] / (float)RAXEL_VOXEL_CHUNK_SIZE;
+    }
+    float page_out_distance = view_distance + world->residency_hysteresis + RAXEL_VOXEL_PAGE_OUT_MARGIN;
+    // walking backwards, the chunk moved into a removed slot has been looked at already
+    for (raxel_size_t i = raxel_list_size(world->chunks); i-- > world->__num_loaded_chunks;) {
+        raxel_voxel_chunk_handle_t handle = world->chunks[i];
+        if (world->__stored_revisions[handle] != raxel_voxel_chunk_pool_get(world->chunk_pool, handle)->revision) {
+            continue;
+        }
+        raxel_voxel_chunk_meta_t *meta = &world->chunk_meta[i];
+        if (__raxel_voxel_world_chunk_distance(cam, meta->x, meta->y, meta->z) > page_out_distance) {
+            __raxel_voxel_world_remove_chunk(world, i);
+        }
+    }
+}
+
+// Pages in every stored chunk the loaded-set selection could pick. Runs before the selection.
+static void __raxel_voxel_world_page_in(raxel_voxel_world_t *world, const vec3 camera_position, float view_distance) {
+    if (!world->__region_directory) {
         return;
     }
+    float cam[3];
+    for (int k = 0; k < 3; k++) {
+        cam[k] = camera_position[k] / (float)RAXEL_VOXEL_CHUNK_SIZE;
+    }
+    float page_in_distance = view_distance + world->residency_hysteresis;
+
+    // --- Read the chunks in range, skipping regions that are out of range as a whole ---
+    const float region_radius = 0.8660254f * RAXEL_REGION_SIZE;  // half the diagonal
+    for (raxel_size_t r = 0; r < raxel_list_size(world->__regions); r++) {
+        raxel_voxel_world_region_t *region = &world->__regions[r];
+        if (!region->file.header) {
+            continue;
+        }
+        raxel_coord_t ox = region->x * RAXEL_REGION_SIZE;
+        raxel_coord_t oy = region->y * RAXEL_REGION_SIZE;
+        raxel_coord_t oz = region->z * RAXEL_REGION_SIZE;
+        float dx = (float)ox + 0.5f * RAXEL_REGION_SIZE - cam[0];
+        float dy = (float)oy + 0.5f * RAXEL_REGION_SIZE - cam[1];
+        float dz = (float)oz + 0.5f * RAXEL_REGION_SIZE - cam[2];
+        if (sqrtf(dx * dx + dy * dy + dz * dz) - region_radius >= page_in_distance) {
+            continue;
+        }
+        for (raxel_size_t e = 0; e < RAXEL_REGION_CHUNKS; e++) {
+            if (!raxel_region_has_chunk(&region->file, e)) {
+                continue;
+            }
+            raxel_coord_t x = ox + (raxel_coord_t)(e % RAXEL_REGION_SIZE);
+            raxel_coord_t y = oy + (raxel_coord_t)((e / RAXEL_REGION_SIZE) % RAXEL_REGION_SIZE);
+            raxel_coord_t z = oz + (raxel_coord_t)(e / (RAXEL_REGION_SIZE * RAXEL_REGION_SIZE));
+            if (__raxel_voxel_world_chunk_distance(cam, x, y, z) >= page_in_distance) {
+                continue;
+            }
+            uint64_t key = __raxel_voxel_chunk_key(x, y, z);
+            raxel_size_t index;
+            if (!raxel_hashtable_get(world->chunk_index, &key, &index)) {
+                __raxel_voxel_world_page_in_chunk(world, x, y, z);
+            }
+        }
+    }
+}
+
+int raxel_voxel_world_open_regions(raxel_voxel_world_t *world, const char *directory) {
+    if (!raxel_file_is_directory(directory)) {
+        RAXEL_CORE_LOG_ERROR("Region directory %s does not exist\n", directory);
+        return -1;
+    }
+    raxel_voxel_world_lock(world);
+    __raxel_voxel_world_close_regions(world);
+    raxel_size_t length = strlen(directory);
+    world->__region_directory = raxel_malloc(world->allocator, length + 1);
+    memcpy(world->__region_directory, directory, length + 1);
+
+    // only the headers are mapped here, chunks are read when they are needed
+    raxel_list(raxel_string_t) names = raxel_file_list_directory(directory, world->allocator);
+    for (raxel_size_t i = 0; i < raxel_list_size(names); i++) {
+        raxel_coord_t rx, ry, rz;
+        if (raxel_region_parse_file_name(raxel_string_data(&names[i]), &rx, &ry, &rz)) {
+            __raxel_voxel_world_map_region(world, rx, ry, rz);
+        }
+        raxel_string_destroy(&names[i]);
+    }
+    raxel_list_destroy(names);
+    world->__prev_num_chunks = (raxel_size_t)-1;  // page around the camera on the next update
+    raxel_voxel_world_unlock(world);
+    return 0;
+}
+
+typedef struct __raxel_voxel_region_coords {
+    raxel_coord_t x;
+    raxel_coord_t y;
+    raxel_coord_t z;
+} __raxel_voxel_region_coords_t;
+
+int raxel_voxel_world_save(raxel_voxel_world_t *world) {
+    if (!world->__region_directory) {
+        RAXEL_CORE_LOG_ERROR("Voxel world has no region directory, call raxel_voxel_world_open_regions first\n");
+        return -1;
+    }
+    raxel_voxel_world_lock(world);
+
+    // --- Find the regions with changed chunks ---
+    raxel_hashtable_t *dirty = raxel_hashtable_create_custom(uint64_t, raxel_size_t, world->allocator, 16,
+                                                            __raxel_voxel_chunk_key_hash, __raxel_voxel_chunk_key_equals);
+    raxel_list(__raxel_voxel_region_coords_t) dirty_regions = raxel_list_create_reserve(__raxel_voxel_region_coords_t, world->allocator, 8);
+    raxel_size_t num_chunks = raxel_list_size(world->chunks);
+    for (raxel_size_t i = 0; i < num_chunks; i++) {
+        raxel_voxel_chunk_handle_t handle = world->chunks[i];
+        if (world->__stored_revisions[handle] == raxel_voxel_chunk_pool_get(world->chunk_pool, handle)->revision) {
+            continue;
+        }
+        __raxel_voxel_region_coords_t region = {
+            raxel_region_coord(world->chunk_meta[i].x),
+            raxel_region_coord(world->chunk_meta[i].y),
+            raxel_region_coord(world->chunk_meta[i].z),
+        };
+        uint64_t key = __raxel_voxel_chunk_key(region.x, region.y, region.z);
+        raxel_size_t index = raxel_list_size(dirty_regions);
+        if (!raxel_hashtable_get(dirty, &key, &index)) {
+            raxel_hashtable_insert(dirty, &key, &index);
+            raxel_list_push_back(dirty_regions, region);
+        }
+    }
 
-    RAXEL_CORE_LOG("Copying BVH to GPU world buffer, size: %d\n", sizeof(raxel_bvh_accel_t));
-    memcpy(&gpu_world->bvh, bvh, sizeof(raxel_bvh_accel_t));
-    // Optional: print BVH structure for debugging.
-    RAXEL_CORE_LOG("Dispatching updated chunks and BVH!\n");
-    RAXEL_CORE_LOG("Num Loaded Chunks: %d\n", world->__num_loaded_chunks);
-    RAXEL_CORE_LOG("Num BVH Nodes: %d\n", bvh->n_nodes);
-    RAXEL_CORE_LOG("Data Size: %d\n", sizeof(__raxel_voxel_world_gpu_t));
-    // raxel_bvh_accel_print(bvh);
-    raxel_sb_buffer_update(compute_shader->sb_buffer, pipeline);
-    raxel_bvh_accel_destroy(bvh, world->allocator);
+    // --- Collect each of them from RAM and the old file, and write it ---
+    int result = 0;
+    raxel_region_writer_t writer;
+    uint8_t *in_ram = raxel_malloc(world->allocator, RAXEL_REGION_CHUNKS);
+    for (raxel_size_t r = 0; r < raxel_list_size(dirty_regions); r++) {
+        __raxel_voxel_region_coords_t region_coords = dirty_regions[r];
+        raxel_region_writer_init(&writer, world->allocator);
+        memset(in_ram, 0, RAXEL_REGION_CHUNKS);
+        for (raxel_size_t i = 0; i < num_chunks; i++) {
+            raxel_voxel_chunk_meta_t *meta = &world->chunk_meta[i];
+            if (raxel_region_coord(meta->x) != region_coords.x ||
+                raxel_region_coord(meta->y) != region_coords.y ||
+                raxel_region_coord(meta->z) != region_coords.z) {
+                continue;
+            }
+            raxel_size_t entry = raxel_region_entry_index(meta->x, meta->y, meta->z);
+            raxel_region_writer_add_chunk(&writer, entry, raxel_voxel_chunk_pool_get(world->chunk_pool, world->chunks[i]));
+            in_ram[entry] = 1;
+        }
+        raxel_voxel_world_region_t *old = __raxel_voxel_world_find_region(world, region_coords.x, region_coords.y, region_coords.z);
+        if (old && old->file.header) {
+            for (raxel_size_t e = 0; e < RAXEL_REGION_CHUNKS; e++) {
+                if (!in_ram[e]) {
+                    raxel_region_writer_copy_chunk(&writer, e, &old->file);
+                }
+            }
+        }
+        char *path = __raxel_voxel_world_region_path(world, region_coords.x, region_coords.y, region_coords.z);
+        if (raxel_region_writer_save(&writer, path) != 0) {
+            RAXEL_CORE_LOG_ERROR("Failed to write region file %s\n", path);
+            result = -1;
+        } else {
+            __raxel_voxel_world_map_region(world, region_coords.x, region_coords.y, region_coords.z);
+            for (raxel_size_t i = 0; i < num_chunks; i++) {
+                raxel_voxel_chunk_meta_t *meta = &world->chunk_meta[i];
+                if (raxel_region_coord(meta->x) == region_coords.x &&
+                    raxel_region_coord(meta->y) == region_coords.y &&
+                    raxel_region_coord(meta->z) == region_coords.z) {
+                    world->__stored_revisions[world->chunks[i]] = raxel_voxel_chunk_pool_get(world->chunk_pool, world->chunks[i])->revision;
+                }
+            }
+        }
+        raxel_free(world->allocator, path);
+        raxel_region_writer_release(&writer);
+    }
+    raxel_free(world->allocator, in_ram);
+    raxel_list_destroy(dirty_regions);
+    raxel_hashtable_destroy(dirty);
+    raxel_voxel_world_unlock(world);
+    return result;
 }
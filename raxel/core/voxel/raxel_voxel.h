@@ -2,40 +2,25 @@
 #define __RAXEL_VOXEL_H__
 
 #include <cglm/cglm.h>
+#include <raxel/core/assets/raxel_region.h>           // for raxel_region_t
 #include <raxel/core/graphics.h>                      // for raxel_compute_shader_t, raxel_pipeline_t
 #include <raxel/core/graphics/passes/compute_pass.h>  // for raxel_compute_shader_t
+#include <raxel/core/voxel/raxel_chunk.h>              // for raxel_voxel_chunk_t, raxel_voxel_chunk_pool_t
+#include <raxel/core/voxel/raxel_tree64.h>             // for raxel_tree64_t
 #include <raxel/core/util.h>                          // for raxel_allocator_t, raxel_string_t, etc.
+#include <stddef.h>
 #include <stdint.h>
 
-typedef uint32_t raxel_material_handle_t;
-typedef int32_t raxel_coord_t;
-
-typedef struct raxel_voxel {
-    raxel_material_handle_t material;
-} raxel_voxel_t;
-
-#define RAXEL_VOXEL_CHUNK_SIZE 32
-#define RAXEL_MAX_LOADED_CHUNKS 32
-#define RAXEL_BVH_MAX_NODES 1024
+#define RAXEL_VOXEL_DEFAULT_CHUNK_BUDGET 32
+#define RAXEL_VOXEL_DEFAULT_RESIDENCY_HYSTERESIS 1.0f
+#define RAXEL_VOXEL_PAGE_OUT_MARGIN 2.0f  // chunks beyond the paging distance before a chunk is dropped from RAM
+#define RAXEL_VOXEL_DEFAULT_TREE_MEMORY_BUDGET (16u << 20)
+#define RAXEL_VOXEL_DEFAULT_BVH_NODE_BUDGET (1u << 15)
 #define MAX_LEAF_SIZE_BVH 32
-
-typedef enum raxel_voxel_chunk_state {
-    RAXEL_VOXEL_CHUNK_STATE_COUNT = 0,  // not used atm
-} raxel_voxel_chunk_state_t;
-
-typedef struct raxel_voxel_chunk_meta {
-    // defines the bottom-left corner of the chunk
-    raxel_coord_t x;
-    raxel_coord_t y;
-    raxel_coord_t z;
-    raxel_voxel_chunk_state_t state;
-} raxel_voxel_chunk_meta_t;
-
-typedef struct raxel_voxel_chunk {
-    // all of these voxel's coordinates are relative to the chunk's bottom-left corner, and implicitly
-    // stored in the index of the array
-    raxel_voxel_t voxels[RAXEL_VOXEL_CHUNK_SIZE * RAXEL_VOXEL_CHUNK_SIZE * RAXEL_VOXEL_CHUNK_SIZE];
-} raxel_voxel_chunk_t;
+#define RAXEL_BVH_SAH_BINS 16
+#define RAXEL_BVH_TREELET_LEAVES 7
+#define RAXEL_BVH_PATCH_MAX_EDITS 64      // voxel edits a chunk BVH takes in place before it is rebuilt instead
+#define RAXEL_BVH_PATCH_COST_LIMIT 1.25f  // patched chunk BVHs are rebuilt past this multiple of their built SAH cost
 
 typedef struct raxel_voxel_material_attributes {
     vec4 color;
@@ -53,13 +38,156 @@ typedef struct raxel_voxel_world_update_options {
     vec3 camera_direction;
 } raxel_voxel_world_update_options_t;
 
+// How the GPU world finds voxels. The BVH backend uploads every loaded chunk densely into a slot
+// and builds a BVH over the solid voxels. The 64-tree backend uploads one sparse tree over all
+// loaded chunks instead (see raxel_tree64_t), so memory follows the voxels rather than the chunk
+// count and a budget of thousands of chunks fits in tree_memory_budget bytes.
+typedef enum raxel_voxel_backend {
+    RAXEL_VOXEL_BACKEND_BVH = 0,
+    RAXEL_VOXEL_BACKEND_TREE64,
+} raxel_voxel_backend_t;
+
+// How raxel_bvh_accel_build splits a node. MEDIAN halves the primitives along the widest centroid
+// axis; SAH picks the split with the lowest surface area cost out of RAXEL_BVH_SAH_BINS bins per
+// axis, which takes a little longer to build and gives noticeably cheaper traversal.
+// LBVH sorts the primitives along a Morton curve over their centroids (10 bits per axis, exact
+// for voxels spanning up to 1024 per axis) and splits where the codes first differ. That is a few
+// linear passes and builds several times faster than SAH, for trees a bit costlier to traverse.
+// LBVH_TREELETS then rearranges every treelet of up to RAXEL_BVH_TREELET_LEAVES subtrees into the
+// topology with the lowest surface area cost; the leaves stay as the Morton splits made them.
+typedef enum raxel_bvh_build_method {
+    RAXEL_BVH_BUILD_SAH = 0,
+    RAXEL_BVH_BUILD_MEDIAN,
+    RAXEL_BVH_BUILD_LBVH,
+    RAXEL_BVH_BUILD_LBVH_TREELETS,
+} raxel_bvh_build_method_t;
+
+// The world BVH has two levels. Every chunk with voxels has its own BVH over its solid voxels, in
+// chunk-local voxel coordinates so it does not depend on where the chunk is. It is built when the
+// chunk is first loaded and kept until the chunk is dropped from RAM. A few edited voxels are
+// patched into it in place (see RAXEL_BVH_PATCH_MAX_EDITS); larger edits, and patches that let
+// its cost grow past RAXEL_BVH_PATCH_COST_LIMIT, rebuild it. Above them sits a small BVH with one
+// leaf per resident chunk, rebuilt whenever the loaded set changes.
+typedef struct raxel_voxel_chunk_bvh {
+    struct raxel_bvh_accel_t *bvh;  // NULL if the chunk has no voxels
+    struct raxel_wide_bvh *wide;    // bvh collapsed for the GPU, NULL with it
+    raxel_list(uint16_t) voxels;    // flat indices of the solid voxels in leaf order, leaves index into this
+    raxel_list(uint16_t) edits;     // voxels to patch in, RAXEL_VOXEL_CHUNK_BVH_REMOVED marks removed ones
+    uint32_t revision;              // chunk revision it is up to date with, RAXEL_VOXEL_REVISION_UNSTORED if none
+    uint32_t patched_edits;         // edits patched in since the last full build
+    uint32_t generation;            // bumped whenever wide changes, so a GPU copy can tell it is stale
+    float built_cost;               // SAH cost of the last full build
+} raxel_voxel_chunk_bvh_t;
+
+#define RAXEL_VOXEL_CHUNK_BVH_REMOVED 0x8000u
+
+// A leaf of the top-level BVH.
+typedef struct raxel_voxel_bvh_instance {
+    raxel_voxel_chunk_handle_t chunk;
+    raxel_coord_t origin[3];  // world voxel coordinates of the chunk's min corner
+} raxel_voxel_bvh_instance_t;
+
+typedef struct raxel_voxel_bvh_hit {
+    float t;                  // distance along the ray to the voxel's entry point
+    raxel_coord_t voxel[3];   // world coordinates of the voxel
+    raxel_material_handle_t material;
+} raxel_voxel_bvh_hit_t;
+
+// One chunk slot of the GPU world buffer. A chunk keeps its slot while it is loaded, and after it
+// is unloaded the slot keeps it cached until the slot is the least recently used one and is needed
+// for another chunk. Coming back into view therefore costs nothing while the chunk is still cached.
+typedef struct raxel_voxel_gpu_slot {
+    raxel_voxel_chunk_handle_t chunk;  // RAXEL_VOXEL_CHUNK_HANDLE_INVALID when the slot was never used
+    uint32_t revision;                 // chunk revision the slot was last written with
+    uint32_t last_used;                // last update that had the chunk loaded
+    uint32_t loaded;                   // 0 when the chunk is only cached
+} raxel_voxel_gpu_slot_t;
+
+#define RAXEL_VOXEL_GPU_SLOT_NONE UINT32_MAX
+
+// Where a chunk's wide BVH sits among the nodes of a GPU world buffer. The range stays put while
+// the chunk BVH is unchanged, so only new and changed chunk BVHs are copied on a residency change.
+typedef struct raxel_voxel_gpu_bvh_range {
+    uint32_t first_node;  // node index of the chunk BVH's root
+    uint32_t n_nodes;     // nodes the range holds, 0 if the chunk has none
+    uint32_t generation;  // chunk BVH generation the range was last written with
+} raxel_voxel_gpu_bvh_range_t;
+
+// One GPU world buffer and the bookkeeping of which chunk sits in which of its slots. The world
+// keeps two of these, so one can be staged while the other is bound.
+typedef struct raxel_voxel_gpu_mirror {
+    raxel_sb_buffer_t *buffer;                  // the buffer's data is the CPU-side copy of the GPU world
+    raxel_list(raxel_voxel_gpu_slot_t) slots;   // chunk_budget slots
+    raxel_size_t num_slots;                     // slots written so far
+    raxel_list(uint32_t) slot_of_chunk;         // chunk handle -> slot, or RAXEL_VOXEL_GPU_SLOT_NONE
+    raxel_list(raxel_voxel_gpu_bvh_range_t) bvh_of_chunk;  // chunk handle -> its chunk BVH's nodes
+    raxel_size_t bvh_top_nodes;                 // nodes kept for the top level, the chunk BVHs follow
+    raxel_size_t bvh_end;                       // the next chunk BVH range starts here
+    uint32_t version;                           // residency version the buffer holds, 0 if none
+    uint32_t tree_generation;                   // 64-tree backend: generation of the pool the buffer holds
+    raxel_size_t tree_words;                    // 64-tree backend: pool words the buffer holds
+} raxel_voxel_gpu_mirror_t;
+
+void raxel_voxel_gpu_mirror_init(raxel_voxel_gpu_mirror_t *mirror, raxel_sb_buffer_t *buffer, raxel_allocator_t *allocator);
+void raxel_voxel_gpu_mirror_release(raxel_voxel_gpu_mirror_t *mirror);
+
+// A region file backing part of the world.
+typedef struct raxel_voxel_world_region {
+    raxel_coord_t x;
+    raxel_coord_t y;
+    raxel_coord_t z;
+    raxel_region_t file;  // file.header is NULL if the file could not be mapped
+} raxel_voxel_world_region_t;
+
+#define RAXEL_VOXEL_REVISION_UNSTORED UINT32_MAX
+
 typedef struct raxel_voxel_world {
-    raxel_list(raxel_voxel_chunk_meta_t) chunk_meta;  // index of chunk in chunks
-    raxel_list(raxel_voxel_chunk_t) chunks;           // the first __num_loaded_chunks are loaded
-    raxel_size_t __num_loaded_chunks;                 // between 0 and RAXEL_MAX_LOADED_CHUNKS
+    raxel_list(raxel_voxel_chunk_meta_t) chunk_meta;   // index of chunk in chunks
+    raxel_list(raxel_voxel_chunk_handle_t) chunks;     // pool handles, the first __num_loaded_chunks are loaded
+    raxel_voxel_chunk_pool_t *chunk_pool;              // owns the chunk payloads
+    raxel_hashtable_t *chunk_index;                    // packed chunk coords -> index into chunks
+    raxel_size_t __num_loaded_chunks;                  // between 0 and chunk_budget
     raxel_allocator_t *allocator;
     raxel_list(raxel_voxel_material_t) materials;
     raxel_voxel_world_update_options_t prev_update_options;
+    raxel_size_t __prev_num_chunks;                    // chunk count at the last loaded-set selection
+    raxel_size_t __prev_chunk_budget;                  // chunk budget at the last loaded-set selection
+
+    // GPU residency, see raxel_voxel_world_stage_upload
+    raxel_voxel_backend_t backend;                     // read by raxel_voxel_world_set_sb
+    raxel_size_t chunk_budget;                         // loaded chunks; BVH backend: GPU chunk slots, read by raxel_voxel_world_set_sb
+    raxel_size_t tree_memory_budget;                   // 64-tree backend: bytes for the tree, read by raxel_voxel_world_set_sb
+    raxel_bvh_build_method_t bvh_build_method;         // BVH backend: how the world BVH is built
+    raxel_size_t bvh_node_budget;                      // BVH backend: GPU BVH nodes of both levels, read by raxel_voxel_world_set_sb
+    int32_t bvh_width;                                 // BVH backend: children per GPU BVH node, 2 to RAXEL_WIDE_BVH_MAX_WIDTH
+    int32_t bvh_build_threads;                         // BVH backend: threads building chunk BVHs, 0 for one per processor
+    float residency_hysteresis;                        // chunks a loaded chunk may fall behind before it is unloaded
+    raxel_list(raxel_voxel_chunk_handle_t) __resident_chunks;  // the loaded set __bvh was built for
+    raxel_list(uint32_t) __resident_revisions;         // revisions of __resident_chunks at that point
+    raxel_list(raxel_voxel_chunk_meta_t) __resident_meta;  // coordinates of __resident_chunks
+    raxel_voxel_backend_t __resident_backend;          // backend the resident set was last prepared for
+    uint32_t __residency_version;                      // bumped whenever the loaded set or a loaded chunk changes
+    struct raxel_bvh_accel_t *__bvh;                   // top-level BVH over the loaded set, NULL if it has no voxels
+    struct raxel_wide_bvh *__wide_bvh;                 // __bvh collapsed for the GPU, NULL with it
+    raxel_list(raxel_voxel_bvh_instance_t) __bvh_instances;  // leaves of __bvh, a leaf's primitives_offset indexes this
+    raxel_list(raxel_voxel_chunk_bvh_t) __chunk_bvhs;  // chunk handle -> the chunk's BVH
+    int32_t __chunk_bvh_leaf_size;                     // grows while the BVH does not fit bvh_node_budget
+    raxel_thread_pool_t *__bvh_build_pool;             // bvh_build_threads - 1 workers, NULL until the first build
+    raxel_list(struct __raxel_voxel_bvh_builder) __bvh_builders;  // one per build thread, kept between builds
+    raxel_tree64_t __tree;                             // 64-tree over the loaded set
+    uint32_t __update_count;                           // clock for the slots' last_used
+
+    // GPU world buffers, see raxel_voxel_world_set_sb
+    raxel_voxel_gpu_mirror_t __gpu[2];                 // __gpu[__gpu_front] is bound, the other one is staged
+    uint32_t __gpu_front;
+    struct raxel_voxel_stream *__stream;               // background worker, NULL when staging on the calling thread
+    raxel_mutex_t __lock;                              // guards chunks and the chunk lists while streaming
+
+    // region files, see raxel_voxel_world_open_regions
+    char *__region_directory;                          // NULL while the world is not backed by files
+    raxel_list(raxel_voxel_world_region_t) __regions;
+    raxel_hashtable_t *__region_index;                 // packed region coords -> index into __regions
+    raxel_list(uint32_t) __stored_revisions;           // chunk handle -> revision on disk, or RAXEL_VOXEL_REVISION_UNSTORED
 } raxel_voxel_world_t;
 
 raxel_voxel_world_t *raxel_voxel_world_create(raxel_allocator_t *allocator);
@@ -68,13 +196,139 @@ void raxel_voxel_world_add_material(raxel_voxel_world_t *world, raxel_string_t n
 raxel_material_handle_t raxel_voxel_world_get_material_handle(raxel_voxel_world_t *world, raxel_string_t name);
 
 raxel_voxel_chunk_t *raxel_voxel_world_get_chunk(raxel_voxel_world_t *world, raxel_coord_t x, raxel_coord_t y, raxel_coord_t z);
+raxel_voxel_chunk_handle_t raxel_voxel_world_get_chunk_handle(raxel_voxel_world_t *world, raxel_coord_t x, raxel_coord_t y, raxel_coord_t z);
 raxel_voxel_t raxel_voxel_world_get_voxel(raxel_voxel_world_t *world, raxel_coord_t x, raxel_coord_t y, raxel_coord_t z);
 void raxel_voxel_world_place_voxel(raxel_voxel_world_t *world, raxel_coord_t x, raxel_coord_t y, raxel_coord_t z, raxel_voxel_t voxel);
 
+// Batched edits. Boxes are inclusive on both ends, and the sphere contains every voxel
+// with (x - cx)^2 + (y - cy)^2 + (z - cz)^2 <= radius^2.
+void raxel_voxel_world_fill_box(raxel_voxel_world_t *world,
+                                raxel_coord_t min_x, raxel_coord_t min_y, raxel_coord_t min_z,
+                                raxel_coord_t max_x, raxel_coord_t max_y, raxel_coord_t max_z,
+                                raxel_voxel_t voxel);
+void raxel_voxel_world_fill_sphere(raxel_voxel_world_t *world,
+                                   raxel_coord_t center_x, raxel_coord_t center_y, raxel_coord_t center_z,
+                                   raxel_coord_t radius, raxel_voxel_t voxel);
+// coords holds n packed (x, y, z) triples.
+void raxel_voxel_world_place_voxels(raxel_voxel_world_t *world, const raxel_coord_t *coords, const raxel_voxel_t *voxels, raxel_size_t n);
+
+typedef struct raxel_voxel_raycast_hit {
+    float t;                           // along the ray to where it enters the voxel, 0 if it starts inside
+    raxel_coord_t voxel[3];            // world coordinates of the voxel
+    int32_t normal[3];                 // the face the ray entered through, zero if it starts inside
+    raxel_material_handle_t material;  // 0 if the ray hit nothing
+} raxel_voxel_raycast_hit_t;
+
+/**
+ * Cast a ray through the chunks in RAM (paging in the ones it crosses that are only on disk) and
+ * find the first solid voxel, e.g. for picking. Works on the world itself, whatever is loaded on the
+ * GPU. The ray steps over empty and missing chunks a chunk at a time, and inside a chunk over the
+ * voxel pairs of x-rows its occupancy mask marks empty, so the walk takes about as many steps as
+ * there are such regions along the ray, not voxels.
+ *
+ * @param max_t How far to look, in units of direction. Keep it finite: the walk goes on over
+ *              missing chunks until it gets there.
+ * @return 1 and fills hit if a voxel was hit within max_t, 0 otherwise.
+ */
+int raxel_voxel_world_raycast(raxel_voxel_world_t *world, const float origin[3], const float direction[3], float max_t, raxel_voxel_raycast_hit_t *hit);
+
+/**
+ * raxel_voxel_world_raycast for n rays, taking the world lock once and reusing chunk lookups from
+ * one ray to the next, so rays that start close together cost little more than their steps.
+ * origins and directions hold n packed (x, y, z) triples; a ray that misses gets material 0.
+ *
+ * @return The number of rays that hit.
+ */
+raxel_size_t raxel_voxel_world_raycast_batch(raxel_voxel_world_t *world,
+                                             const float *origins,
+                                             const float *directions,
+                                             float max_t,
+                                             raxel_size_t n,
+                                             raxel_voxel_raycast_hit_t *hits);
+
+/**
+ * Back the world with the region files in a directory (which must exist). Chunks are not read up
+ * front: a chunk is paged in when a world function touches it, or when it comes within the view
+ * distance during staging. Chunks that are unchanged since they were read or saved are dropped from
+ * RAM again once they are RAXEL_VOXEL_PAGE_OUT_MARGIN chunks beyond that, so do not hold on to
+ * chunk pointers across updates.
+ *
+ * @return 0 on success, -1 if the directory could not be read.
+ */
+int raxel_voxel_world_open_regions(raxel_voxel_world_t *world, const char *directory);
+
+/**
+ * Write every region that holds a chunk changed since it was read or last saved. Chunks of those
+ * regions that are not in RAM are carried over from the old file.
+ *
+ * @return 0 on success, -1 if the world has no region directory or a file could not be written.
+ */
+int raxel_voxel_world_save(raxel_voxel_world_t *world);
+
+/**
+ * While a world streams, the worker reads chunks concurrently, so every world function takes the
+ * world lock. Hold it yourself around direct access to a chunk (e.g. through
+ * raxel_voxel_world_get_chunk), but do not call other world functions while holding it. Both are
+ * no-ops while the world does not stream.
+ */
+void raxel_voxel_world_lock(raxel_voxel_world_t *world);
+void raxel_voxel_world_unlock(raxel_voxel_world_t *world);
+
+/**
+ * Bring the GPU world up to date for the camera. Call between frames.
+ *
+ * While the world streams this only hands the camera to the worker and never waits for it; when
+ * the worker has finished a new snapshot, the compute shader is rebound to that buffer. Otherwise
+ * it stages into the bound buffer and flushes it (raxel_voxel_world_stage_upload followed by
+ * raxel_sb_buffer_flush).
+ */
 void raxel_voxel_world_update(raxel_voxel_world_t *world, raxel_voxel_world_update_options_t *options, raxel_compute_shader_t *compute_shader, raxel_pipeline_t *pipeline);
 
+/**
+ * Select the loaded chunks for the camera and write what changed into the CPU-side copy of a GPU
+ * world buffer, marking the written ranges dirty.
+ *
+ * The loaded set is the chunk_budget non-empty chunks nearest to the camera within the view
+ * distance. Chunks that are already loaded count as residency_hysteresis chunks closer (and may
+ * be that much beyond the view distance), so chunks near the edge do not flicker in and out.
+ * Only chunks that are not cached in a slot yet, or were edited since, are decoded; the BVH is
+ * rebuilt only when the loaded set or a loaded chunk changed.
+ *
+ * With the 64-tree backend, chunks that enter, leave or change are rewritten in the tree and only
+ * the words appended to its pool are written. If the tree outgrows tree_memory_budget it is
+ * rebuilt, without the farthest chunks if it still does not fit.
+ *
+ * @return The number of chunks written, or with the 64-tree backend the number of pool words.
+ */
+raxel_size_t raxel_voxel_world_stage_upload(raxel_voxel_world_t *world, raxel_voxel_world_update_options_t *options, raxel_voxel_gpu_mirror_t *mirror);
+
+/**
+ * Create the two GPU world buffers, sized by raxel_voxel_world_gpu_size, bind the first one and
+ * start streaming into them. Set the backend and budgets before calling this.
+ */
 void raxel_voxel_world_set_sb(raxel_voxel_world_t *world, raxel_compute_shader_t *compute_shader, raxel_pipeline_t *pipeline);
 
+/**
+ * Start a worker thread that does chunk selection, the BVH build and staging for the world.
+ * The worker stages a complete snapshot into the back buffer while the front buffer is in use,
+ * and raxel_voxel_world_stream_update hands the finished snapshot over. Both buffers must be
+ * raxel_voxel_world_gpu_size bytes; the world does not take ownership of them.
+ */
+void raxel_voxel_world_start_streaming(raxel_voxel_world_t *world, raxel_sb_buffer_t *front, raxel_sb_buffer_t *back);
+
+/**
+ * Stop and join the worker. Later updates stage on the calling thread into the front buffer.
+ */
+void raxel_voxel_world_stop_streaming(raxel_voxel_world_t *world);
+
+/**
+ * Give the worker the latest camera. Never blocks on the worker's progress.
+ *
+ * @return The buffer holding a newly finished snapshot, which is now the front buffer and should
+ *         be bound before the next frame, or NULL if the front buffer did not change.
+ */
+raxel_sb_buffer_t *raxel_voxel_world_stream_update(raxel_voxel_world_t *world, raxel_voxel_world_update_options_t *options);
+
 typedef struct raxel_bvh_bounds {
     vec3 min;
     vec3 max;
@@ -85,9 +339,12 @@ typedef struct __raxel_bvh_build_node {
     int first_prim_offset;  // valid for leaf nodes
     int n_primitives;       // >0 for leaf, 0 for interior
     int split_axis;         // splitting axis: 0=x, 1=y, 2=z
+    float cost;             // surface area cost of the subtree, only kept while refining treelets
     struct __raxel_bvh_build_node *children[2];
 } __raxel_bvh_build_node_t;
 
+// A node of a binary BVH as the builders emit it. The GPU reads the wide nodes collapsed from
+// these instead, see raxel_wide_bvh_node_t.
 typedef struct raxel_linear_bvh_node_t {
     raxel_bvh_bounds_t bounds;
     union {
@@ -99,30 +356,351 @@ typedef struct raxel_linear_bvh_node_t {
 } raxel_linear_bvh_node_t;
 
 typedef struct raxel_bvh_accel_t {
-    raxel_linear_bvh_node_t nodes[RAXEL_BVH_MAX_NODES];  // linear array of nodes
-    int32_t n_nodes;                                         // total number of nodes
-    int32_t max_leaf_size;                                   // maximum primitives per leaf
+    raxel_list(raxel_linear_bvh_node_t) nodes;  // depth first, a node's first child follows it
+    int32_t n_nodes;                            // total number of nodes
+    int32_t max_leaf_size;                      // maximum primitives per leaf
 } raxel_bvh_accel_t;
 
+// Working memory of BVH builds, kept from one build to the next: an arena that every build resets
+// and that is only replaced when a build needs more than it holds, so rebuilding a BVH over no
+// more primitives than before allocates nothing. Holds one build at a time.
+typedef struct raxel_bvh_build_scratch {
+    raxel_allocator_t *allocator;                      // for the lists; the arena has its own memory
+    raxel_allocator_t *arena;                          // raxel_arena_allocator, NULL until the first build
+    raxel_list(struct __raxel_bvh_build_task) tasks;   // parallel builds: the subtrees left to the pool
+    raxel_list(struct __raxel_bvh_top_node) top;       // parallel builds: the nodes above them
+} raxel_bvh_build_scratch_t;
+
+void raxel_bvh_build_scratch_init(raxel_bvh_build_scratch_t *scratch, raxel_allocator_t *allocator);
+void raxel_bvh_build_scratch_release(raxel_bvh_build_scratch_t *scratch);
+
 raxel_bvh_accel_t *raxel_bvh_accel_build(raxel_bvh_bounds_t *primitive_bounds,
                                          int *primitive_indices,
                                          int n,
                                          int max_leaf_size,
                                          raxel_allocator_t *allocator);
 
+/**
+ * Like raxel_bvh_accel_build (which uses RAXEL_BVH_BUILD_SAH), with an explicit split method.
+ * primitive_indices is reordered in place so that every leaf refers to a contiguous range of it.
+ */
+raxel_bvh_accel_t *raxel_bvh_accel_build_with_method(raxel_bvh_bounds_t *primitive_bounds,
+                                                     int *primitive_indices,
+                                                     int n,
+                                                     int max_leaf_size,
+                                                     raxel_bvh_build_method_t method,
+                                                     raxel_allocator_t *allocator);
+
+/**
+ * Like raxel_bvh_accel_build_with_method, on the threads of pool (NULL builds on the calling
+ * thread). The top levels are split on the calling thread with the bounds and SAH bins gathered
+ * by the pool, then the subtrees below are built as independent tasks. The result is identical to
+ * a serial build.
+ */
+raxel_bvh_accel_t *raxel_bvh_accel_build_parallel(raxel_bvh_bounds_t *primitive_bounds,
+                                                  int *primitive_indices,
+                                                  int n,
+                                                  int max_leaf_size,
+                                                  raxel_bvh_build_method_t method,
+                                                  raxel_thread_pool_t *pool,
+                                                  raxel_allocator_t *allocator);
+
+// An empty BVH to rebuild into.
+raxel_bvh_accel_t *raxel_bvh_accel_create(raxel_allocator_t *allocator);
+
+/**
+ * Rebuild bvh in place over new primitives, like raxel_bvh_accel_build_parallel. Nodes are written
+ * depth first straight into bvh's node list, which only ever grows, and everything else the build
+ * needs comes from scratch, so a rebuild that fits both allocates nothing.
+ */
+void raxel_bvh_accel_rebuild(raxel_bvh_accel_t *bvh,
+                             raxel_bvh_bounds_t *primitive_bounds,
+                             int *primitive_indices,
+                             int n,
+                             int max_leaf_size,
+                             raxel_bvh_build_method_t method,
+                             raxel_thread_pool_t *pool,
+                             raxel_bvh_build_scratch_t *scratch);
+
 void raxel_bvh_accel_destroy(raxel_bvh_accel_t *bvh, raxel_allocator_t *allocator);
 
+/**
+ * Recompute every node's bounds after primitives moved, bottom up, keeping the topology. The
+ * primitive_bounds and primitive_indices are the ones the BVH was built with (the latter as the
+ * build reordered it). Cheap enough per frame, but the tree gets worse the further the
+ * primitives move from where they were at the build.
+ */
+void raxel_bvh_accel_refit(raxel_bvh_accel_t *bvh, const raxel_bvh_bounds_t *primitive_bounds, const int *primitive_indices);
+
+/**
+ * Build one BVH over the loaded chunks of a world. Its primitives are not single voxels but the
+ * boxes of same-material voxels raxel_voxel_chunk_merge_boxes covers each chunk with.
+ */
 raxel_bvh_accel_t *raxel_bvh_accel_build_from_voxel_world(raxel_voxel_world_t *world,
                                                           int max_leaf_size,
                                                           raxel_allocator_t *allocator);
                                                           
 void raxel_bvh_accel_print(raxel_bvh_accel_t *bvh);
 
+#define RAXEL_BVH_STATS_MAX_DEPTH 64       // leaves deeper than this are counted in the last depth bin
+#define RAXEL_BVH_STATS_LEAF_SIZE_BINS 16  // bin b counts leaves of 2^(b-1)+1 to 2^b primitives, bin 0 single ones
+
+// Tree quality in numbers that can be compared between builds, unlike a raxel_bvh_accel_print dump.
+typedef struct raxel_bvh_stats {
+    float sah_cost;       // expected node visits plus primitive tests of a random ray through the root
+    float overlap_ratio;  // area where siblings overlap over the area of their parents, 0 for disjoint children
+    int n_nodes;
+    int n_leaves;
+    int n_primitives;
+    int max_depth;
+    int n_forced_leaves;  // leaves over the target leaf size, which only a node cap makes
+    int depth_histogram[RAXEL_BVH_STATS_MAX_DEPTH];  // leaves per depth, the root is at depth 0
+    int leaf_size_histogram[RAXEL_BVH_STATS_LEAF_SIZE_BINS];
+    raxel_size_t memory_bytes;  // nodes and primitive indices on the CPU
+    raxel_size_t gpu_bytes;     // wide nodes uploaded for the tree, 0 for a tree that is not uploaded
+} raxel_bvh_stats_t;
+
+/**
+ * Measure a BVH. A leaf counts as forced if it holds more than target_leaf_size primitives, which
+ * the builders only do when a cap on the node count made them coarsen the tree.
+ *
+ * @param target_leaf_size The leaf size asked for before any cap, <= 0 for the tree's max_leaf_size.
+ */
+void raxel_bvh_accel_stats(const raxel_bvh_accel_t *bvh, int target_leaf_size, raxel_bvh_stats_t *stats);
+
+void raxel_bvh_stats_print(const raxel_bvh_stats_t *stats);
+
+typedef struct raxel_bvh_trace_cost {
+    int n_rays;
+    int n_hits;
+    float mean_node_visits;
+    float mean_primitive_tests;
+    int p99_node_visits;  // 99 in 100 rays visit at most this many nodes
+    int max_node_visits;
+} raxel_bvh_trace_cost_t;
+
+/**
+ * Cast a fixed set of rays with raxel_bvh_accel_intersect and count the work they take. The rays
+ * start on a sphere around the tree and aim at random points of its central half, so the same
+ * seed and ray count give the same rays for any tree over the same scene, which makes the numbers
+ * fit for catching tree quality regressions.
+ */
+void raxel_bvh_accel_trace_cost(const raxel_bvh_accel_t *bvh,
+                                const raxel_bvh_bounds_t *primitive_bounds,
+                                const int *primitive_indices,
+                                int n_rays,
+                                uint32_t seed,
+                                raxel_allocator_t *allocator,
+                                raxel_bvh_trace_cost_t *cost);
+
+#define RAXEL_BVH_PACKET_MAX_RAYS 16
+
+typedef struct raxel_bvh_hit {
+    float t;            // distance along the ray to the primitive's entry point
+    int32_t primitive;  // index into the primitive bounds the BVH was built over, -1 if none was hit
+} raxel_bvh_hit_t;
+
+// Up to RAXEL_BVH_PACKET_MAX_RAYS rays, as a structure of arrays so one slab test covers as many
+// rays as the CPU has float lanes. Rays that start close together and point the same way, like
+// the rays of a screen tile, share the most nodes.
+typedef struct raxel_bvh_ray_packet {
+    float origin[3][RAXEL_BVH_PACKET_MAX_RAYS];
+    float direction[3][RAXEL_BVH_PACKET_MAX_RAYS];
+    float max_t[RAXEL_BVH_PACKET_MAX_RAYS];
+    int32_t n_rays;
+} raxel_bvh_ray_packet_t;
+
+/**
+ * Cast a ray against a BVH, down to the primitive boxes it was built over.
+ *
+ * @param primitive_bounds The bounds the BVH was built over.
+ * @param primitive_indices The indices as the build left them, in leaf order.
+ * @return 1 and fills hit with the nearest primitive entered within max_t, 0 otherwise.
+ */
+int raxel_bvh_accel_intersect(const raxel_bvh_accel_t *bvh,
+                              const raxel_bvh_bounds_t *primitive_bounds,
+                              const int *primitive_indices,
+                              const float origin[3],
+                              const float direction[3],
+                              float max_t,
+                              raxel_bvh_hit_t *hit);
+
+/**
+ * Cast a packet of rays against a BVH with SIMD slab tests: 8 rays per test with AVX, 4 with SSE,
+ * and one at a time on other targets. Finds the same hits as raxel_bvh_accel_intersect.
+ *
+ * @return A mask with bit i set if ray i hit; hits[i] is filled for every ray.
+ */
+uint32_t raxel_bvh_accel_intersect_packet(const raxel_bvh_accel_t *bvh,
+                                          const raxel_bvh_bounds_t *primitive_bounds,
+                                          const int *primitive_indices,
+                                          const raxel_bvh_ray_packet_t *packet,
+                                          raxel_bvh_hit_t *hits);
+
+#define RAXEL_WIDE_BVH_MAX_WIDTH 8
+#define RAXEL_WIDE_BVH_LEAF 0x80000000u  // set in a child word when the child is a leaf
+
+// A node of a wide BVH with up to RAXEL_WIDE_BVH_MAX_WIDTH children. The children's boxes are
+// quantized to 8 bits per plane on a grid over the node's own box: the grid starts at origin and
+// one step along axis k is 2^(exponent[k] - 127), the float whose exponent bits are exponent[k].
+// Quantized boxes are rounded outwards, so they always contain the child.
+// This is the GPU's node format: the shader reads it as RAXEL_WIDE_BVH_NODE_WORDS tightly packed
+// 32-bit words, bytes little endian, see wideBVHNode in raxel/assets/shaders/voxel.comp.
+typedef struct raxel_wide_bvh_node {
+    float origin[3];
+    uint8_t exponent[3];
+    uint8_t n_children;
+    uint32_t children[RAXEL_WIDE_BVH_MAX_WIDTH];       // interior: node index, leaf: RAXEL_WIDE_BVH_LEAF | first primitive
+    uint16_t n_primitives[RAXEL_WIDE_BVH_MAX_WIDTH];   // of leaf children, 0 for interior ones
+    uint8_t q_min[3][RAXEL_WIDE_BVH_MAX_WIDTH];        // per axis, per child
+    uint8_t q_max[3][RAXEL_WIDE_BVH_MAX_WIDTH];
+} raxel_wide_bvh_node_t;
+
+#define RAXEL_WIDE_BVH_NODE_WORDS (sizeof(raxel_wide_bvh_node_t) / sizeof(uint32_t))
+
+// The words wideBVHNode reads: 0-2 origin, 3 exponents and child count, 4-11 children,
+// 12-15 primitive counts, 16-27 quantized bounds.
+_Static_assert(sizeof(raxel_wide_bvh_node_t) == 28 * 4, "raxel_wide_bvh_node_t must be RAXEL_WIDE_BVH_NODE_WORDS in voxel.comp");
+_Static_assert(offsetof(raxel_wide_bvh_node_t, exponent) == 3 * 4, "wide BVH node header is word 3");
+_Static_assert(offsetof(raxel_wide_bvh_node_t, children) == 4 * 4, "wide BVH node children start at word 4");
+_Static_assert(offsetof(raxel_wide_bvh_node_t, n_primitives) == 12 * 4, "wide BVH node primitive counts start at word 12");
+_Static_assert(offsetof(raxel_wide_bvh_node_t, q_min) == 16 * 4, "wide BVH node bounds start at word 16");
+_Static_assert(offsetof(raxel_wide_bvh_node_t, q_max) == 22 * 4, "wide BVH node q_max starts at word 22");
+
+typedef struct raxel_wide_bvh {
+    raxel_list(raxel_wide_bvh_node_t) nodes;  // depth first from the root, only ever grows
+    int32_t n_nodes;
+    int32_t width;                            // most children of a node
+} raxel_wide_bvh_t;
+
+raxel_wide_bvh_t *raxel_wide_bvh_create(raxel_allocator_t *allocator);
+void raxel_wide_bvh_destroy(raxel_wide_bvh_t *wide, raxel_allocator_t *allocator);
+
+/**
+ * Collapse a binary BVH into wide nodes of up to width (2 to RAXEL_WIDE_BVH_MAX_WIDTH) children,
+ * replacing what wide held. Every wide node opens the binary interior node with the largest surface
+ * among its children until it has width of them, so about two in three binary levels disappear.
+ * Leaves keep their primitive ranges, which must hold fewer than 2^16 primitives.
+ */
+void raxel_wide_bvh_collapse(raxel_wide_bvh_t *wide, const raxel_bvh_accel_t *bvh, int width);
+
+// The box a wide node stores for one of its children, as the GPU decodes it.
+void raxel_wide_bvh_child_bounds(const raxel_wide_bvh_node_t *node, int child, raxel_bvh_bounds_t *out);
+
+/**
+ * Cast a ray against the world BVH of the last staged loaded set, down through the top level into
+ * the chunk BVHs and their voxels. Call it from the thread that stages the world.
+ *
+ * @return 1 and fills hit if a voxel was hit within max_t, 0 otherwise.
+ */
+int raxel_voxel_world_bvh_raycast(raxel_voxel_world_t *world, const float origin[3], const float direction[3], float max_t, raxel_voxel_bvh_hit_t *hit);
+
+/**
+ * raxel_voxel_world_bvh_raycast for a packet of rays, walking both BVH levels with SIMD slab tests.
+ *
+ * @return A mask with bit i set if ray i hit a voxel within its max_t; hits[i] is filled for those.
+ */
+uint32_t raxel_voxel_world_bvh_raycast_packet(raxel_voxel_world_t *world, const raxel_bvh_ray_packet_t *packet, raxel_voxel_bvh_hit_t *hits);
+
+/**
+ * raxel_bvh_accel_stats for the world BVH of the last staged loaded set, both levels counted as
+ * one tree: chunk BVH roots sit one level below the top-level leaf of their chunk, and the voxels
+ * are the primitives. Leaves over MAX_LEAF_SIZE_BVH voxels count as forced, they come from
+ * coarsening the chunk BVHs to fit bvh_node_budget. Call it from the thread that stages the world.
+ */
+void raxel_voxel_world_bvh_stats(raxel_voxel_world_t *world, raxel_bvh_stats_t *stats);
+
+// The GPU reads chunks uncompressed, so loaded chunks are decoded into this layout on upload.
+typedef struct raxel_voxel_gpu_chunk {
+    raxel_voxel_chunk_meta_t meta;
+    raxel_voxel_t voxels[RAXEL_VOXEL_CHUNK_VOLUME];
+} raxel_voxel_gpu_chunk_t;
+
+typedef struct raxel_voxel_dda_hit {
+    float t;                  // distance along the ray to the voxel's entry point
+    int32_t voxel[3];         // chunk-local coordinates of the voxel
+    float normal[3];          // of the face the ray entered through, 0 if it starts inside the voxel
+    raxel_material_handle_t material;
+} raxel_voxel_dda_hit_t;
+
+/**
+ * Step a ray voxel by voxel (Amanatides and Woo) through the part of a decoded chunk inside a box,
+ * in chunk-local coordinates. The shader does the same in the chunk BVH leaves it enters, see
+ * chunkDDA in raxel/assets/shaders/voxel.comp; keep the two in sync.
+ *
+ * @param box_min, box_max The box to walk, clipped to the chunk. It need not be voxel aligned.
+ * @return 1 and fills hit with the first solid voxel within max_t, 0 otherwise.
+ */
+int raxel_voxel_gpu_chunk_dda(const raxel_voxel_gpu_chunk_t *chunk,
+                              const float origin[3],
+                              const float direction[3],
+                              const float box_min[3],
+                              const float box_max[3],
+                              float max_t,
+                              raxel_voxel_dda_hit_t *hit);
+
+// Where the 64-tree sits in the GPU world buffer. Offsets are in 32-bit words.
+typedef struct __raxel_voxel_tree_gpu {
+    int32_t origin[3];
+    uint32_t depth;
+    uint32_t root;         // of the root node, from the start of the pool
+    uint32_t pool_offset;  // of the pool, from the start of the buffer
+    uint32_t pool_size;
+    uint32_t __pad;
+} __raxel_voxel_tree_gpu_t;
+
+// Where the BVH sits in the GPU world buffer. After the chunk slots come chunk_budget instances,
+// then the wide nodes: the top-level nodes first, then the BVH of every instance at its first_node.
+// Chunk BVHs keep their place between uploads, so there can be unused nodes between them.
+typedef struct __raxel_voxel_bvh_gpu {
+    uint32_t n_nodes;          // top-level nodes
+    uint32_t n_total_nodes;    // of both levels
+    uint32_t n_instances;
+    int32_t max_leaf_size;     // of the chunk BVHs
+    uint32_t node_offset;      // of the first node from the start of the buffer, in 32-bit words
+    uint32_t instance_offset;  // of the first instance from the start of the buffer, in 32-bit words
+    uint32_t __pad[2];
+} __raxel_voxel_bvh_gpu_t;
+
+// A top-level leaf points at one of these through its primitives_offset.
+typedef struct __raxel_voxel_bvh_instance_gpu {
+    float origin[3];      // the chunk BVH's nodes are relative to this
+    uint32_t first_node;  // index of the chunk BVH's root; its child node indices are relative to it
+    uint32_t n_nodes;
+    uint32_t slot;        // chunk slot with the chunk's voxels
+} __raxel_voxel_bvh_instance_gpu_t;
+
+_Static_assert(sizeof(__raxel_voxel_bvh_instance_gpu_t) == 6 * 4, "must be RAXEL_BVH_INSTANCE_WORDS in voxel.comp");
+
+// The chunk slots are the shader's runtime-sized array, so the buffer grows with the budget, and
+// the BVH instances and nodes follow them. The 64-tree backend puts the tree's pool where the slots would be.
 typedef struct __raxel_voxel_world_gpu {
-    raxel_bvh_accel_t bvh;
-    raxel_voxel_chunk_meta_t chunk_meta[RAXEL_MAX_LOADED_CHUNKS];
-    raxel_voxel_chunk_t chunks[RAXEL_MAX_LOADED_CHUNKS];
-    uint32_t num_loaded_chunks;
+    uint32_t num_loaded_chunks;  // slots the shader looks at
+    uint32_t chunk_budget;       // slots allocated
+    uint32_t backend;            // raxel_voxel_backend_t the buffer was written for
+    uint32_t __pad;
+    __raxel_voxel_tree_gpu_t tree;
+    __raxel_voxel_bvh_gpu_t bvh;
+    raxel_voxel_gpu_chunk_t chunks[];
 } __raxel_voxel_world_gpu_t;
 
+static inline raxel_size_t __raxel_voxel_world_gpu_size(raxel_size_t chunk_budget, raxel_size_t bvh_node_budget) {
+    return sizeof(__raxel_voxel_world_gpu_t) +
+           chunk_budget * (sizeof(raxel_voxel_gpu_chunk_t) + sizeof(__raxel_voxel_bvh_instance_gpu_t)) +
+           bvh_node_budget * sizeof(raxel_wide_bvh_node_t);
+}
+
+static inline __raxel_voxel_bvh_instance_gpu_t *__raxel_voxel_world_gpu_bvh_instances(__raxel_voxel_world_gpu_t *gpu_world) {
+    return (__raxel_voxel_bvh_instance_gpu_t *)&gpu_world->chunks[gpu_world->chunk_budget];
+}
+
+static inline raxel_wide_bvh_node_t *__raxel_voxel_world_gpu_bvh_nodes(__raxel_voxel_world_gpu_t *gpu_world) {
+    return (raxel_wide_bvh_node_t *)&__raxel_voxel_world_gpu_bvh_instances(gpu_world)[gpu_world->chunk_budget];
+}
+
+/**
+ * Bytes of a GPU world buffer for the world's backend and budgets.
+ */
+raxel_size_t raxel_voxel_world_gpu_size(const raxel_voxel_world_t *world);
+
 #endif  // __RAXEL_VOXEL_H__
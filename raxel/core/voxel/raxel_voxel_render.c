@@ -0,0 +1,583 @@
+// raxel_voxel_render.c
+
+#include "raxel_voxel_render.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// Constants of voxel.comp.
+#define __RAXEL_RENDER_BVH_STACK_SIZE 64
+#define __RAXEL_RENDER_MAX_DISTANCE 1000.0f
+#define __RAXEL_RENDER_MAX_PRIM_OFFSET 256.0f
+#define __RAXEL_RENDER_MAX_PRIMS_PER_LEAF 32.0f
+#define __RAXEL_RENDER_BVH_INSTANCE_WORDS 6u
+#define __RAXEL_RENDER_WORLD_WORDS(gpu_world) ((const uint32_t *)(gpu_world))
+
+// =============================================================================
+// 0. Images
+// =============================================================================
+
+void raxel_voxel_image_init(raxel_voxel_image_t *image, int32_t width, int32_t height, raxel_allocator_t *allocator) {
+    image->width = width;
+    image->height = height;
+    image->allocator = allocator;
+    image->pixels = raxel_malloc(allocator, (raxel_size_t)width * height * 4 * sizeof(float));
+    memset(image->pixels, 0, (raxel_size_t)width * height * 4 * sizeof(float));
+}
+
+void raxel_voxel_image_release(raxel_voxel_image_t *image) {
+    raxel_free(image->allocator, image->pixels);
+    image->pixels = NULL;
+}
+
+int raxel_voxel_image_write_ppm(const raxel_voxel_image_t *image, const char *path) {
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        RAXEL_CORE_LOG_ERROR("Could not open %s for writing\n", path);
+        return -1;
+    }
+    fprintf(file, "P6\n%d %d\n255\n", image->width, image->height);
+    uint8_t *row = raxel_malloc(image->allocator, (raxel_size_t)image->width * 3);
+    int ok = 1;
+    for (int32_t y = 0; y < image->height && ok; y++) {
+        const float *pixel = &image->pixels[(raxel_size_t)y * image->width * 4];
+        for (int32_t x = 0; x < image->width; x++) {
+            for (int c = 0; c < 3; c++) {
+                float v = pixel[x * 4 + c];
+                v = v > 0.0f ? (v < 1.0f ? v : 1.0f) : 0.0f;  // NaN goes to 0 as well
+                row[x * 3 + c] = (uint8_t)(v * 255.0f + 0.5f);
+            }
+        }
+        ok = fwrite(row, 1, (size_t)image->width * 3, file) == (size_t)image->width * 3;
+    }
+    raxel_free(image->allocator, row);
+    ok = fclose(file) == 0 && ok;
+    return ok ? 0 : -1;
+}
+
+int raxel_voxel_image_write_pfm(const raxel_voxel_image_t *image, const char *path) {
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        RAXEL_CORE_LOG_ERROR("Could not open %s for writing\n", path);
+        return -1;
+    }
+    // a negative scale means little endian; the rows go bottom to top so viewers show row 0 on top
+    fprintf(file, "PF\n%d %d\n-1.0\n", image->width, image->height);
+    float *row = raxel_malloc(image->allocator, (raxel_size_t)image->width * 3 * sizeof(float));
+    int ok = 1;
+    for (int32_t y = image->height - 1; y >= 0 && ok; y--) {
+        const float *pixel = &image->pixels[(raxel_size_t)y * image->width * 4];
+        for (int32_t x = 0; x < image->width; x++) {
+            memcpy(&row[x * 3], &pixel[x * 4], 3 * sizeof(float));
+        }
+        ok = fwrite(row, sizeof(float) * 3, (size_t)image->width, file) == (size_t)image->width;
+    }
+    raxel_free(image->allocator, row);
+    ok = fclose(file) == 0 && ok;
+    return ok ? 0 : -1;
+}
+
+// =============================================================================
+// 1. BVH Traversal (traverseBVH and friends in voxel.comp)
+// =============================================================================
+
+typedef struct __raxel_render_wide_node {
+    uint32_t base;  // first word of the node
+    float origin[3];
+    float scale[3];
+    uint32_t n_children;
+    uint32_t quantized[12];
+} __raxel_render_wide_node_t;
+
+typedef struct __raxel_render_instance {
+    float origin[3];
+    int32_t first_node;
+    int32_t n_nodes;
+    uint32_t slot;
+} __raxel_render_instance_t;
+
+static inline float __raxel_render_bits_to_float(uint32_t bits) {
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+static int __raxel_render_intersect_aabb(const float ro[3], const float inv_rd[3], const float bmin[3], const float bmax[3],
+                                         float *tmin, float *tmax) {
+    *tmin = -INFINITY;
+    *tmax = INFINITY;
+    for (int k = 0; k < 3; k++) {
+        float t0 = (bmin[k] - ro[k]) * inv_rd[k];
+        float t1 = (bmax[k] - ro[k]) * inv_rd[k];
+        *tmin = fmaxf(*tmin, fminf(t0, t1));
+        *tmax = fminf(*tmax, fmaxf(t0, t1));
+    }
+    return *tmax >= fmaxf(*tmin, 0.0f);
+}
+
+static __raxel_render_wide_node_t __raxel_render_wide_node(const __raxel_voxel_world_gpu_t *gpu_world, int32_t index) {
+    const uint32_t *words = __RAXEL_RENDER_WORLD_WORDS(gpu_world);
+    __raxel_render_wide_node_t node;
+    node.base = gpu_world->bvh.node_offset + (uint32_t)index * RAXEL_WIDE_BVH_NODE_WORDS;
+    uint32_t header = words[node.base + 3];
+    for (int k = 0; k < 3; k++) {
+        node.origin[k] = __raxel_render_bits_to_float(words[node.base + k]);
+        // the biased exponent e stands for 2^(e - 127), which is the float with exponent bits e
+        node.scale[k] = __raxel_render_bits_to_float(((header >> (8 * k)) & 0xffu) << 23);
+    }
+    node.n_children = header >> 24;
+    memcpy(node.quantized, &words[node.base + 16], sizeof(node.quantized));
+    return node;
+}
+
+static inline uint32_t __raxel_render_wide_child(const __raxel_voxel_world_gpu_t *gpu_world, const __raxel_render_wide_node_t *node, uint32_t child) {
+    return __RAXEL_RENDER_WORLD_WORDS(gpu_world)[node->base + 4 + child];
+}
+
+static inline uint32_t __raxel_render_wide_primitives(const __raxel_voxel_world_gpu_t *gpu_world, const __raxel_render_wide_node_t *node, uint32_t child) {
+    return (__RAXEL_RENDER_WORLD_WORDS(gpu_world)[node->base + 12 + child / 2] >> (16 * (child % 2))) & 0xffffu;
+}
+
+static void __raxel_render_wide_child_bounds(const __raxel_render_wide_node_t *node, uint32_t child, float bmin[3], float bmax[3]) {
+    uint32_t word = child / 4;
+    uint32_t shift = 8 * (child % 4);
+    for (int k = 0; k < 3; k++) {
+        uint32_t q_min = (node->quantized[word + 2 * k] >> shift) & 0xffu;
+        uint32_t q_max = (node->quantized[word + 6 + 2 * k] >> shift) & 0xffu;
+        bmin[k] = node->origin[k] + (float)q_min * node->scale[k];
+        bmax[k] = node->origin[k] + (float)q_max * node->scale[k];
+    }
+}
+
+// The children entered before t_max, sorted near to far, see intersectWideBVHNode.
+static int __raxel_render_intersect_wide_node(const __raxel_render_wide_node_t *node, const float ro[3], const float inv_rd[3], float t_max,
+                                              uint32_t order[RAXEL_WIDE_BVH_MAX_WIDTH], float t_near[RAXEL_WIDE_BVH_MAX_WIDTH]) {
+    int n_hit = 0;
+    for (uint32_t i = 0; i < node->n_children && i < RAXEL_WIDE_BVH_MAX_WIDTH; i++) {
+        float bmin[3], bmax[3], tmin, tmax;
+        __raxel_render_wide_child_bounds(node, i, bmin, bmax);
+        if (!__raxel_render_intersect_aabb(ro, inv_rd, bmin, bmax, &tmin, &tmax) || tmin >= t_max) {
+            continue;
+        }
+        int j = n_hit++;
+        while (j > 0 && t_near[j - 1] > tmin) {
+            order[j] = order[j - 1];
+            t_near[j] = t_near[j - 1];
+            j--;
+        }
+        order[j] = i;
+        t_near[j] = tmin;
+    }
+    return n_hit;
+}
+
+static __raxel_render_instance_t __raxel_render_instance(const __raxel_voxel_world_gpu_t *gpu_world, int32_t index) {
+    const uint32_t *words = __RAXEL_RENDER_WORLD_WORDS(gpu_world);
+    uint32_t base = gpu_world->bvh.instance_offset + (uint32_t)index * __RAXEL_RENDER_BVH_INSTANCE_WORDS;
+    __raxel_render_instance_t instance;
+    for (int k = 0; k < 3; k++) {
+        instance.origin[k] = __raxel_render_bits_to_float(words[base + k]);
+    }
+    instance.first_node = (int32_t)words[base + 3];
+    instance.n_nodes = (int32_t)words[base + 4];
+    instance.slot = words[base + 5];
+    return instance;
+}
+
+// Nearest voxel of one chunk closer than t_hit, found by walking the voxels of every leaf the ray
+// enters, see traverseChunkBVH.
+static void __raxel_render_traverse_chunk_bvh(const __raxel_voxel_world_gpu_t *gpu_world, const float ro[3], const float rd[3], const float inv_rd[3],
+                                              const __raxel_render_instance_t *instance, float *t_hit, int32_t *leaf_id, float normal[3]) {
+    int32_t stack[__RAXEL_RENDER_BVH_STACK_SIZE];
+    float stack_t[__RAXEL_RENDER_BVH_STACK_SIZE];
+    int stack_ptr = 0;
+    stack[stack_ptr] = 0;
+    stack_t[stack_ptr++] = 0.0f;
+    while (stack_ptr > 0) {
+        stack_ptr--;
+        int32_t local_index = stack[stack_ptr];
+        if (stack_t[stack_ptr] >= *t_hit || local_index < 0 || local_index >= instance->n_nodes) {
+            continue;
+        }
+        __raxel_render_wide_node_t node = __raxel_render_wide_node(gpu_world, instance->first_node + local_index);
+        uint32_t order[RAXEL_WIDE_BVH_MAX_WIDTH];
+        float t_near[RAXEL_WIDE_BVH_MAX_WIDTH];
+        int n_hit = __raxel_render_intersect_wide_node(&node, ro, inv_rd, *t_hit, order, t_near);
+        for (int j = n_hit - 1; j >= 0; j--) {
+            uint32_t child = __raxel_render_wide_child(gpu_world, &node, order[j]);
+            if (child & RAXEL_WIDE_BVH_LEAF) {
+                float bmin[3], bmax[3];
+                raxel_voxel_dda_hit_t hit;
+                __raxel_render_wide_child_bounds(&node, order[j], bmin, bmax);
+                if (t_near[j] < *t_hit && raxel_voxel_gpu_chunk_dda(&gpu_world->chunks[instance->slot], ro, rd, bmin, bmax, *t_hit, &hit) &&
+                    hit.t < *t_hit) {
+                    *t_hit = hit.t;
+                    *leaf_id = (instance->first_node + local_index) * RAXEL_WIDE_BVH_MAX_WIDTH + (int32_t)order[j];
+                    memcpy(normal, hit.normal, sizeof(hit.normal));
+                }
+            } else if (stack_ptr < __RAXEL_RENDER_BVH_STACK_SIZE) {
+                stack[stack_ptr] = (int32_t)child;
+                stack_t[stack_ptr++] = t_near[j];
+            }
+        }
+    }
+}
+
+static int __raxel_render_traverse_bvh(const __raxel_voxel_world_gpu_t *gpu_world, const float ro[3], const float rd[3],
+                                       float *t_hit, int32_t *leaf_id, float normal[3]) {
+    float inv_rd[3] = { 1.0f / rd[0], 1.0f / rd[1], 1.0f / rd[2] };
+    int32_t stack[__RAXEL_RENDER_BVH_STACK_SIZE];
+    float stack_t[__RAXEL_RENDER_BVH_STACK_SIZE];
+    int stack_ptr = 0;
+    stack[stack_ptr] = 0;
+    stack_t[stack_ptr++] = 0.0f;
+    *t_hit = 1e30f;
+    *leaf_id = -1;
+    while (stack_ptr > 0) {
+        stack_ptr--;
+        int32_t node_index = stack[stack_ptr];
+        if (stack_t[stack_ptr] >= *t_hit || node_index < 0 || node_index >= (int32_t)gpu_world->bvh.n_nodes) {
+            continue;
+        }
+        __raxel_render_wide_node_t node = __raxel_render_wide_node(gpu_world, node_index);
+        uint32_t order[RAXEL_WIDE_BVH_MAX_WIDTH];
+        float t_near[RAXEL_WIDE_BVH_MAX_WIDTH];
+        int n_hit = __raxel_render_intersect_wide_node(&node, ro, inv_rd, *t_hit, order, t_near);
+        for (int j = 0; j < n_hit; j++) {
+            uint32_t child = __raxel_render_wide_child(gpu_world, &node, order[j]);
+            if ((child & RAXEL_WIDE_BVH_LEAF) && t_near[j] < *t_hit) {
+                __raxel_render_instance_t instance = __raxel_render_instance(gpu_world, (int32_t)(child & ~RAXEL_WIDE_BVH_LEAF));
+                float local_ro[3] = { ro[0] - instance.origin[0], ro[1] - instance.origin[1], ro[2] - instance.origin[2] };
+                __raxel_render_traverse_chunk_bvh(gpu_world, local_ro, rd, inv_rd, &instance, t_hit, leaf_id, normal);
+            }
+        }
+        for (int j = n_hit - 1; j >= 0; j--) {
+            uint32_t child = __raxel_render_wide_child(gpu_world, &node, order[j]);
+            if (!(child & RAXEL_WIDE_BVH_LEAF) && stack_ptr < __RAXEL_RENDER_BVH_STACK_SIZE) {
+                stack[stack_ptr] = (int32_t)child;
+                stack_t[stack_ptr++] = t_near[j];
+            }
+        }
+    }
+    return *leaf_id >= 0;
+}
+
+// =============================================================================
+// 2. 64-Tree Traversal (traverseTree64 in voxel.comp)
+// =============================================================================
+
+static inline raxel_tree64_node_t __raxel_render_tree64_node(const __raxel_voxel_world_gpu_t *gpu_world, uint32_t offset) {
+    raxel_tree64_node_t node;
+    memcpy(&node, &__RAXEL_RENDER_WORLD_WORDS(gpu_world)[gpu_world->tree.pool_offset + offset], sizeof(node));
+    return node;
+}
+
+static int __raxel_render_traverse_tree64(const __raxel_voxel_world_gpu_t *gpu_world, const float origin[3], const float rd[3],
+                                          float *t_hit, float normal[3], uint32_t *material, int32_t *steps) {
+    const uint32_t *words = __RAXEL_RENDER_WORLD_WORDS(gpu_world);
+    *t_hit = 0.0f;
+    normal[0] = normal[1] = normal[2] = 0.0f;
+    *material = 0;
+    *steps = 0;
+    int32_t size = 1 << (2 * (int32_t)gpu_world->tree.depth);
+    float ro[3], inv_rd[3];
+    for (int k = 0; k < 3; k++) {
+        ro[k] = origin[k] - (float)gpu_world->tree.origin[k];
+        inv_rd[k] = 1.0f / rd[k];
+    }
+
+    // Enter the root.
+    float t_enter = -1e30f;
+    float t_leave = 1e30f;
+    int axis = -1;
+    for (int k = 0; k < 3; k++) {
+        if (rd[k] == 0.0f) {
+            if (ro[k] < 0.0f || ro[k] >= (float)size) {
+                return 0;
+            }
+            continue;
+        }
+        float t0 = (0.0f - ro[k]) * inv_rd[k];
+        float t1 = ((float)size - ro[k]) * inv_rd[k];
+        if (fminf(t0, t1) > t_enter) {
+            t_enter = fminf(t0, t1);
+            axis = k;
+        }
+        t_leave = fminf(t_leave, fmaxf(t0, t1));
+    }
+    if (t_enter <= 0.0f) {
+        t_enter = 0.0f;
+        axis = -1;
+    }
+    if (t_leave < t_enter || t_enter > __RAXEL_RENDER_MAX_DISTANCE) {
+        return 0;
+    }
+    int32_t ip[3];
+    for (int k = 0; k < 3; k++) {
+        ip[k] = (int32_t)floorf(ro[k] + rd[k] * t_enter);
+        ip[k] = ip[k] < 0 ? 0 : (ip[k] > size - 1 ? size - 1 : ip[k]);
+    }
+    if (axis >= 0) {
+        ip[axis] = rd[axis] > 0.0f ? 0 : size - 1;
+    }
+
+    // Walk.
+    uint32_t stack[RAXEL_TREE64_MAX_DEPTH + 1];
+    int32_t level = (int32_t)gpu_world->tree.depth;
+    stack[level] = gpu_world->tree.root;
+    float t = t_enter;
+    for (int32_t step = 0; step < RAXEL_TREE64_MAX_STEPS; step++) {
+        *steps = step;
+        raxel_tree64_node_t node = __raxel_render_tree64_node(gpu_world, stack[level]);
+        int32_t shift = 0;
+        for (int d = 0; d < RAXEL_TREE64_MAX_DEPTH; d++) {
+            shift = 2 * (level - 1);
+            uint32_t child = RAXEL_TREE64_CHILD_INDEX((ip[0] >> shift) & 3, (ip[1] >> shift) & 3, (ip[2] >> shift) & 3);
+            uint32_t mask = child < 32 ? node.mask[0] >> child : node.mask[1] >> (child - 32);
+            if (!(mask & 1u)) {
+                break;
+            }
+            uint32_t rank = child < 32 ? (uint32_t)__builtin_popcount(node.mask[0] & ((1u << child) - 1u))
+                                       : (uint32_t)(__builtin_popcount(node.mask[0]) + __builtin_popcount(node.mask[1] & ((1u << (child - 32)) - 1u)));
+            if (node.kind != RAXEL_TREE64_NODE_INTERIOR) {
+                *t_hit = t;
+                *material = node.kind == RAXEL_TREE64_NODE_SOLID ? node.first : words[gpu_world->tree.pool_offset + node.first + rank];
+                if (axis >= 0) {
+                    normal[axis] = rd[axis] > 0.0f ? -1.0f : 1.0f;
+                }
+                return 1;
+            }
+            level--;
+            stack[level] = node.first + rank * RAXEL_TREE64_NODE_WORDS;
+            node = __raxel_render_tree64_node(gpu_world, stack[level]);
+        }
+
+        // Skip the empty child cell.
+        int32_t cell_size = 1 << shift;
+        int32_t cell_min[3];
+        float t_exit = 1e30f;
+        for (int k = 0; k < 3; k++) {
+            cell_min[k] = ip[k] & ~(cell_size - 1);
+            if (rd[k] == 0.0f) {
+                continue;
+            }
+            float bound = (float)(rd[k] > 0.0f ? cell_min[k] + cell_size : cell_min[k]);
+            float tk = (bound - ro[k]) * inv_rd[k];
+            if (tk < t_exit) {
+                t_exit = tk;
+                axis = k;
+            }
+        }
+        t = t_exit;
+        if (t > __RAXEL_RENDER_MAX_DISTANCE) {
+            return 0;
+        }
+        int32_t next[3];
+        for (int k = 0; k < 3; k++) {
+            next[k] = (int32_t)floorf(ro[k] + rd[k] * t);
+            next[k] = next[k] < cell_min[k] ? cell_min[k] : (next[k] > cell_min[k] + cell_size - 1 ? cell_min[k] + cell_size - 1 : next[k]);
+        }
+        next[axis] = rd[axis] > 0.0f ? cell_min[axis] + cell_size : cell_min[axis] - 1;
+        if (next[axis] < 0 || next[axis] >= size) {
+            return 0;
+        }
+        uint32_t diff = (uint32_t)((ip[0] ^ next[0]) | (ip[1] ^ next[1]) | (ip[2] ^ next[2]));
+        level = (31 - __builtin_clz(diff)) / 2 + 1;
+        memcpy(ip, next, sizeof(ip));
+    }
+    return 0;
+}
+
+// =============================================================================
+// 3. Raymarch and Shading (raymarch and main in voxel.comp)
+// =============================================================================
+
+typedef struct __raxel_render_result {
+    float pos[3];
+    float normal[3];
+    float t_hit;
+    int hit;
+    int32_t leaf_id;
+    int32_t prim_offset;
+    int32_t n_primitives;
+    int32_t num_steps;
+} __raxel_render_result_t;
+
+static void __raxel_render_raymarch(const __raxel_voxel_world_gpu_t *gpu_world, const float ro[3], const float rd[3], __raxel_render_result_t *result) {
+    memset(result, 0, sizeof(*result));
+    result->leaf_id = -1;
+    result->prim_offset = -1;
+    if (gpu_world->backend == RAXEL_VOXEL_BACKEND_TREE64) {
+        float t;
+        uint32_t material;
+        if (__raxel_render_traverse_tree64(gpu_world, ro, rd, &t, result->normal, &material, &result->num_steps)) {
+            result->hit = 1;
+            result->t_hit = t;
+            for (int k = 0; k < 3; k++) {
+                result->pos[k] = ro[k] + t * rd[k];
+            }
+        }
+        return;
+    }
+    float t;
+    int32_t leaf;
+    if (!__raxel_render_traverse_bvh(gpu_world, ro, rd, &t, &leaf, result->normal)) {
+        return;
+    }
+    result->hit = 1;
+    result->t_hit = t;
+    result->leaf_id = leaf;
+    for (int k = 0; k < 3; k++) {
+        result->pos[k] = ro[k] + t * rd[k];
+    }
+    __raxel_render_wide_node_t leaf_node = __raxel_render_wide_node(gpu_world, leaf / RAXEL_WIDE_BVH_MAX_WIDTH);
+    uint32_t leaf_child = (uint32_t)(leaf % RAXEL_WIDE_BVH_MAX_WIDTH);
+    result->prim_offset = (int32_t)(__raxel_render_wide_child(gpu_world, &leaf_node, leaf_child) & ~RAXEL_WIDE_BVH_LEAF);
+    result->n_primitives = (int32_t)__raxel_render_wide_primitives(gpu_world, &leaf_node, leaf_child);
+}
+
+static void __raxel_render_pixel(const __raxel_voxel_world_gpu_t *gpu_world, const raxel_voxel_render_pc_t *pc, mat4 inv_view,
+                                 int32_t x, int32_t y, int32_t width, int32_t height, float color[4], int *hit) {
+    float uv[2] = { (float)x / (float)width * 2.0f - 1.0f, (float)y / (float)height * 2.0f - 1.0f };
+    uv[0] *= (float)width / (float)height;
+    float tan_fov = tanf(pc->fov * 0.5f);
+    vec4 eye = { 0.0f, 0.0f, 0.0f, 1.0f };
+    vec4 view_dir = { uv[0] * tan_fov, uv[1] * tan_fov, -1.0f, 0.0f };
+    vec4 ray_origin, ray_dir;
+    glm_mat4_mulv(inv_view, eye, ray_origin);
+    glm_mat4_mulv(inv_view, view_dir, ray_dir);
+    glm_vec3_normalize(ray_dir);
+
+    __raxel_render_result_t result;
+    __raxel_render_raymarch(gpu_world, ray_origin, ray_dir, &result);
+    *hit = result.hit;
+    color[0] = color[1] = color[2] = color[3] = 0.0f;
+
+    const uint32_t n_total_nodes = gpu_world->bvh.n_total_nodes > 0 ? gpu_world->bvh.n_total_nodes : 1;
+    switch (pc->debug_mode) {
+        case 0: {
+            if (result.hit) {
+                vec3 light_dir = { 1.0f, 1.0f, -1.0f };
+                glm_vec3_normalize(light_dir);
+                float diff = fmaxf(glm_vec3_dot(result.normal, light_dir), 0.0f);
+                color[0] = color[1] = color[2] = diff;
+                color[3] = 1.0f;
+            }
+            break;
+        }
+        case 1: {
+            if (gpu_world->backend == RAXEL_VOXEL_BACKEND_TREE64) {
+                color[0] = color[1] = color[2] = (float)result.num_steps / 64.0f;
+            } else {
+                color[0] = result.prim_offset >= 0 ? (float)result.prim_offset / __RAXEL_RENDER_MAX_PRIM_OFFSET : 0.0f;
+                color[1] = result.leaf_id >= 0 ? (float)result.leaf_id / (float)(n_total_nodes * RAXEL_WIDE_BVH_MAX_WIDTH) : 0.0f;
+                color[2] = result.n_primitives > 0 ? (float)result.n_primitives / __RAXEL_RENDER_MAX_PRIMS_PER_LEAF : 0.0f;
+            }
+            color[3] = 1.0f;
+            break;
+        }
+        case 2: {
+            float depth = result.hit ? result.t_hit / __RAXEL_RENDER_MAX_DISTANCE : 1.0f;
+            color[0] = color[1] = color[2] = depth;
+            color[3] = 1.0f;
+            break;
+        }
+        case 3: {
+            int32_t idx = y * width + x;
+            __raxel_render_wide_node_t node = __raxel_render_wide_node(gpu_world, idx % (int32_t)n_total_nodes);
+            color[0] = (node.origin[0] + 10.0f) / 20.0f;
+            color[1] = (node.origin[0] + 255.0f * node.scale[0] + 10.0f) / 20.0f;
+            color[2] = (float)(__raxel_render_wide_child(gpu_world, &node, 0) % 100u) / 100.0f;
+            color[3] = 1.0f;
+            break;
+        }
+        case 4: {
+            // only the BVH backend has chunk slots, and there may be none loaded yet
+            if (gpu_world->backend != RAXEL_VOXEL_BACKEND_BVH || gpu_world->num_loaded_chunks == 0) {
+                color[3] = 1.0f;
+                break;
+            }
+            int32_t idx = y * width + x;
+            int32_t chunk_idx = idx % (int32_t)gpu_world->num_loaded_chunks;
+            int32_t voxel_x = idx % RAXEL_VOXEL_CHUNK_SIZE;
+            int32_t voxel_y = (idx / RAXEL_VOXEL_CHUNK_SIZE) % RAXEL_VOXEL_CHUNK_SIZE;
+            int32_t voxel_z = (idx / (RAXEL_VOXEL_CHUNK_SIZE * RAXEL_VOXEL_CHUNK_SIZE)) % RAXEL_VOXEL_CHUNK_SIZE;
+            uint32_t voxel = gpu_world->chunks[chunk_idx].voxels[voxel_x + voxel_y * RAXEL_VOXEL_CHUNK_SIZE +
+                                                                 voxel_z * RAXEL_VOXEL_CHUNK_SIZE * RAXEL_VOXEL_CHUNK_SIZE].material;
+            color[0] = (float)voxel / 255.0f;
+            color[1] = (float)chunk_idx / (float)gpu_world->num_loaded_chunks;
+            color[3] = 1.0f;
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+// =============================================================================
+// 4. Tiles
+// =============================================================================
+
+typedef struct __raxel_render_job {
+    const __raxel_voxel_world_gpu_t *gpu_world;
+    const raxel_voxel_render_pc_t *pc;
+    mat4 inv_view;
+    raxel_voxel_image_t *image;
+    int32_t tiles_x;
+    uint64_t n_hits;  // added to atomically, tiles finish in any order
+} __raxel_render_job_t;
+
+static void __raxel_render_tile(void *arg, int task) {
+    __raxel_render_job_t *job = arg;
+    raxel_voxel_image_t *image = job->image;
+    int32_t x0 = (task % job->tiles_x) * RAXEL_VOXEL_RENDER_TILE_SIZE;
+    int32_t y0 = (task / job->tiles_x) * RAXEL_VOXEL_RENDER_TILE_SIZE;
+    int32_t x1 = x0 + RAXEL_VOXEL_RENDER_TILE_SIZE < image->width ? x0 + RAXEL_VOXEL_RENDER_TILE_SIZE : image->width;
+    int32_t y1 = y0 + RAXEL_VOXEL_RENDER_TILE_SIZE < image->height ? y0 + RAXEL_VOXEL_RENDER_TILE_SIZE : image->height;
+    uint64_t n_hits = 0;
+    for (int32_t y = y0; y < y1; y++) {
+        for (int32_t x = x0; x < x1; x++) {
+            int hit;
+            __raxel_render_pixel(job->gpu_world, job->pc, job->inv_view, x, y, image->width, image->height,
+                                 &image->pixels[((raxel_size_t)y * image->width + x) * 4], &hit);
+            n_hits += (uint64_t)hit;
+        }
+    }
+    __atomic_fetch_add(&job->n_hits, n_hits, __ATOMIC_RELAXED);
+}
+
+void raxel_voxel_render(const __raxel_voxel_world_gpu_t *gpu_world,
+                        const raxel_voxel_render_pc_t *pc,
+                        raxel_voxel_image_t *image,
+                        raxel_thread_pool_t *pool,
+                        raxel_voxel_render_stats_t *stats) {
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    __raxel_render_job_t job = {
+        .gpu_world = gpu_world,
+        .pc = pc,
+        .image = image,
+        .tiles_x = (image->width + RAXEL_VOXEL_RENDER_TILE_SIZE - 1) / RAXEL_VOXEL_RENDER_TILE_SIZE,
+        .n_hits = 0,
+    };
+    glm_mat4_inv((vec4 *)pc->view, job.inv_view);
+    int32_t tiles_y = (image->height + RAXEL_VOXEL_RENDER_TILE_SIZE - 1) / RAXEL_VOXEL_RENDER_TILE_SIZE;
+    int num_tiles = (int)(job.tiles_x * tiles_y);
+    if (pool) {
+        raxel_thread_pool_run(pool, num_tiles, __raxel_render_tile, &job);
+    } else {
+        for (int tile = 0; tile < num_tiles; tile++) {
+            __raxel_render_tile(&job, tile);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (stats) {
+        // the shader raymarches every pixel whatever the debug mode
+        stats->n_rays = (uint64_t)image->width * (uint64_t)image->height;
+        stats->n_hits = job.n_hits;
+        stats->ms = 1000.0 * (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e6;
+        stats->rays_per_second = stats->ms > 0.0 ? (double)stats->n_rays / (stats->ms / 1000.0) : 0.0;
+    }
+}
@@ -0,0 +1,71 @@
+#ifndef __RAXEL_VOXEL_RENDER_H__
+#define __RAXEL_VOXEL_RENDER_H__
+
+#include <cglm/cglm.h>
+#include <raxel/core/util.h>                // for raxel_allocator_t, raxel_thread_pool_t
+#include <raxel/core/voxel/raxel_voxel.h>  // for __raxel_voxel_world_gpu_t
+#include <stdint.h>
+
+// A CPU port of raxel/assets/shaders/voxel.comp, for machines without a GPU. It reads the same
+// world buffer the shader does, through the same word offsets, and writes the same colors, so an
+// image rendered here is the image the shader should produce. Keep the two in sync.
+//
+// The image is cut into tiles of RAXEL_VOXEL_RENDER_TILE_SIZE^2 pixels, the shader's workgroup
+// size, and the tiles are shared out over a thread pool.
+
+#define RAXEL_VOXEL_RENDER_TILE_SIZE 16
+
+// The shader's push constants, in the layout raxel-demo declares them with.
+typedef struct raxel_voxel_render_pc {
+    mat4 view;
+    float fov;               // vertical, in radians
+    int32_t rays_per_pixel;  // unused: the shader casts one ray per pixel whatever it is set to
+    int32_t debug_mode;      // 0 shaded, 1 BVH leaves, 2 depth, 3 raw BVH nodes, 4 raw voxels
+} raxel_voxel_render_pc_t;
+
+// An rgba32f image, row 0 first, like the shader's output image.
+typedef struct raxel_voxel_image {
+    int32_t width;
+    int32_t height;
+    float *pixels;
+    raxel_allocator_t *allocator;
+} raxel_voxel_image_t;
+
+typedef struct raxel_voxel_render_stats {
+    uint64_t n_rays;
+    uint64_t n_hits;
+    double ms;               // wall clock
+    double rays_per_second;
+} raxel_voxel_render_stats_t;
+
+void raxel_voxel_image_init(raxel_voxel_image_t *image, int32_t width, int32_t height, raxel_allocator_t *allocator);
+void raxel_voxel_image_release(raxel_voxel_image_t *image);
+
+/**
+ * Write the image as a binary PPM, 8 bits per channel, clamped to [0, 1] and without alpha.
+ *
+ * @return 0 on success, -1 if the file could not be written.
+ */
+int raxel_voxel_image_write_ppm(const raxel_voxel_image_t *image, const char *path);
+
+/**
+ * Write the image as a little-endian PFM, the exact float colors without alpha.
+ *
+ * @return 0 on success, -1 if the file could not be written.
+ */
+int raxel_voxel_image_write_pfm(const raxel_voxel_image_t *image, const char *path);
+
+/**
+ * Render a GPU world buffer into image as one dispatch of voxel.comp would. The buffer is the
+ * uploaded copy, i.e. what the mirror flushed to the device.
+ *
+ * @param pool Threads to render tiles on, NULL to render on the calling thread.
+ * @param stats If not NULL, filled with the ray count and the time it took.
+ */
+void raxel_voxel_render(const __raxel_voxel_world_gpu_t *gpu_world,
+                        const raxel_voxel_render_pc_t *pc,
+                        raxel_voxel_image_t *image,
+                        raxel_thread_pool_t *pool,
+                        raxel_voxel_render_stats_t *stats);
+
+#endif  // __RAXEL_VOXEL_RENDER_H__